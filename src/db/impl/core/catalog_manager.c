@@ -1,3 +1,4 @@
+#define _GNU_SOURCE  // for sync_file_range and open_memstream
 #include "catalog_manager.h"
 
 #include <dirent.h>
@@ -9,9 +10,12 @@
 #include <unistd.h>
 
 #include "btree.h"
+#include "column_encoding.h"
 #include "common.h"
 #include "optimizer.h"
 #include "utils.h"
+#include "wal.h"
+#include "zone_map.h"
 
 void print_column(Column *col);
 
@@ -21,6 +25,7 @@ bool is_valid_index_type(int value) {
     case BTREE_UNCLUSTERED:
     case SORTED_CLUSTERED:
     case SORTED_UNCLUSTERED:
+    case CRACKING_UNCLUSTERED:
     case NONE:
       return true;
     default:
@@ -28,11 +33,304 @@ bool is_valid_index_type(int value) {
   }
 }
 
+#define INDEX_FILE_MAGIC "CS165IDX"
+#define INDEX_FILE_VERSION 1
+
+/**
+ * @brief Header of a column's `.idx` file. The body that follows holds `sorted_data`
+ * and `positions` (`num_elements` ints each), then the serialized B-tree, if any.
+ * `column_checksum` ties the file to the column data it was built from, so an index
+ * left behind by a reload of the same size is not mapped back by mistake.
+ */
+typedef struct IndexFileHeader {
+  char magic[8];
+  uint32_t version;
+  int32_t idx_type;
+  uint64_t num_elements;
+  uint64_t btree_size;
+  uint64_t column_checksum;  // checksum64 of the column's data
+  uint64_t checksum;         // checksum64 of the body
+} IndexFileHeader;
+
+// A column whose index is loaded, built, or written by a pool task
+typedef struct ColumnIndexTask {
+  Table *table;
+  Column *col;
+} ColumnIndexTask;
+
+static void index_file_path(char *path, Table *table, Column *col) {
+  snprintf(path, MAX_PATH_LEN, "%s/%s.%s.%s.idx", STORAGE_PATH, current_db->name,
+           table->name, col->name);
+}
+
+static bool is_btree_index(IndexType idx_type) {
+  return idx_type == BTREE_CLUSTERED || idx_type == BTREE_UNCLUSTERED;
+}
+
+/**
+ * @brief Maps the column's `.idx` file back as its index. The arrays and B-tree keys
+ * point straight into a private mapping, so nothing is sorted or copied.
+ *
+ * @return 0 if the index was loaded; -1 if the file is missing, stale or corrupt, in
+ * which case the caller rebuilds the index
+ */
+static int load_column_index(Table *table, Column *col) {
+  if (col->data_type != INT) return -1;  // never persisted, see persist_column_index
+  char path[MAX_PATH_LEN];
+  index_file_path(path, table, col);
+  int fd = open(path, O_RDONLY);
+  if (fd < 0) return -1;
+
+  struct stat st;
+  if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(IndexFileHeader)) {
+    close(fd);
+    return -1;
+  }
+  size_t file_size = st.st_size;
+  // Private and writable: `cluster_idx_on` may rewrite positions without touching disk
+  char *base = mmap(NULL, file_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (base == MAP_FAILED) return -1;
+
+  IndexFileHeader *header = (IndexFileHeader *)base;
+  size_t n = col->num_elements;
+  size_t arrays_size = 2 * sizeof(int) * n;
+  const char *reason = NULL;
+  if (memcmp(header->magic, INDEX_FILE_MAGIC, sizeof(header->magic)) != 0 ||
+      header->version != INDEX_FILE_VERSION) {
+    reason = "not an index file";
+  } else if (header->idx_type != (int32_t)col->index->idx_type) {
+    reason = "index type changed";
+  } else if (header->num_elements != n ||
+             file_size != sizeof(IndexFileHeader) + arrays_size + header->btree_size) {
+    reason = "element count mismatch";
+  } else if (is_btree_index(col->index->idx_type) != (header->btree_size > 0)) {
+    reason = "missing B-tree";
+  } else if (header->column_checksum != checksum64(col->data, sizeof(int) * n)) {
+    reason = "column data changed";
+  } else if (header->checksum != checksum64(base + sizeof(IndexFileHeader),
+                                            file_size - sizeof(IndexFileHeader))) {
+    reason = "checksum mismatch";
+  }
+
+  Btree *root = NULL;
+  if (!reason && header->btree_size > 0) {
+    root = btree_deserialize(base + sizeof(IndexFileHeader) + arrays_size,
+                             header->btree_size);
+    if (!root) reason = "malformed B-tree";
+  }
+  if (reason) {
+    log_info("load_column_index: rebuilding index of %s (%s)\n", col->name, reason);
+    munmap(base, file_size);
+    return -1;
+  }
+
+  col->index->sorted_data = (int *)(base + sizeof(IndexFileHeader));
+  col->index->positions = col->index->sorted_data + n;
+  col->index->num_elements = n;
+  col->index->mmap_base = base;
+  col->index->mmap_size = file_size;
+  col->root = root;
+  log_info("Mapped index of %s from %s\n", col->name, path);
+  return 0;
+}
+
+// Maps an index back from disk, or builds it when there is no usable file
+static void load_or_build_index_task(void *arg) {
+  ColumnIndexTask *task = (ColumnIndexTask *)arg;
+  if (load_column_index(task->table, task->col) != 0) {
+    create_idx_on(task->col, NULL);
+  }
+}
+
+Status persist_column_index(Table *table, Column *col) {
+  if (!col->index || col->index->idx_type == NONE) return (Status){OK, NULL};
+  // A cracker column is rebuilt from the column by the first select after startup
+  if (col->index->idx_type == CRACKING_UNCLUSTERED) return (Status){OK, NULL};
+  // A mapped index is exactly what its file already holds
+  if (col->index->mmap_base) return (Status){OK, NULL};
+  // The index of a long or double column has no arrays; it is the clustered column
+  // itself, recounted at startup
+  if (col->data_type != INT) return (Status){OK, NULL};
+
+  char path[MAX_PATH_LEN];
+  index_file_path(path, table, col);
+  size_t n = col->num_elements;
+  if (!col->index->sorted_data || col->index->num_elements != n) {
+    // Rows were added after the index was built; let the next startup rebuild it
+    unlink(path);
+    log_info("persist_column_index: index of %s is stale; not persisted\n", col->name);
+    return (Status){OK, NULL};
+  }
+
+  size_t arrays_size = 2 * sizeof(int) * n;
+  size_t btree_size = btree_serialized_size(col->root);
+  size_t file_size = sizeof(IndexFileHeader) + arrays_size + btree_size;
+
+  // Write a temporary file and rename it over the old one, so a crash midway never
+  // leaves a half-written index under the real name
+  char tmp_path[MAX_PATH_LEN + 4];
+  snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", path);
+  int fd = open(tmp_path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+  if (fd < 0) {
+    log_err("persist_column_index: failed to open %s: %s\n", tmp_path, strerror(errno));
+    return (Status){ERROR, "Failed to open index file"};
+  }
+  if (ftruncate(fd, file_size) != 0) {
+    log_err("persist_column_index: failed to size %s: %s\n", tmp_path, strerror(errno));
+    close(fd);
+    unlink(tmp_path);
+    return (Status){ERROR, "Failed to size index file"};
+  }
+  char *base = mmap(NULL, file_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  if (base == MAP_FAILED) {
+    log_err("persist_column_index: failed to map %s: %s\n", tmp_path, strerror(errno));
+    close(fd);
+    unlink(tmp_path);
+    return (Status){ERROR, "Failed to map index file"};
+  }
+
+  char *body = base + sizeof(IndexFileHeader);
+  memcpy(body, col->index->sorted_data, sizeof(int) * n);
+  memcpy(body + sizeof(int) * n, col->index->positions, sizeof(int) * n);
+  if (btree_size > 0) btree_serialize(col->root, body + arrays_size);
+
+  IndexFileHeader *header = (IndexFileHeader *)base;
+  memcpy(header->magic, INDEX_FILE_MAGIC, sizeof(header->magic));
+  header->version = INDEX_FILE_VERSION;
+  header->idx_type = col->index->idx_type;
+  header->num_elements = n;
+  header->btree_size = btree_size;
+  header->column_checksum = checksum64(col->data, sizeof(int) * n);
+  header->checksum = checksum64(body, file_size - sizeof(IndexFileHeader));
+
+  int failed = msync(base, file_size, MS_SYNC) != 0;
+  munmap(base, file_size);
+  close(fd);
+  if (failed || rename(tmp_path, path) != 0) {
+    log_err("persist_column_index: failed to write %s: %s\n", path, strerror(errno));
+    unlink(tmp_path);
+    return (Status){ERROR, "Failed to write index file"};
+  }
+  log_info("Persisted index of %s to %s (%zu bytes)\n", col->name, path, file_size);
+  return (Status){OK, NULL};
+}
+
+static void persist_index_task(void *arg) {
+  ColumnIndexTask *task = (ColumnIndexTask *)arg;
+  persist_column_index(task->table, task->col);
+}
+
+#define ZONE_FILE_MAGIC "CS165ZON"
+#define ZONE_FILE_VERSION 1
+
+/**
+ * @brief Header of a column's `.zm` file, followed by `num_zones` mins, then as many
+ * maxs. Zones are cheap to rebuild, so any mismatch just means a rebuild.
+ */
+typedef struct ZoneFileHeader {
+  char magic[8];
+  uint32_t version;
+  uint32_t zone_size;
+  uint64_t num_elements;
+  uint64_t num_zones;
+  uint64_t checksum;  // checksum64 of the body
+} ZoneFileHeader;
+
+static void zone_file_path(char *path, Table *table, Column *col) {
+  snprintf(path, MAX_PATH_LEN, "%s/%s.%s.%s.zm", STORAGE_PATH, current_db->name,
+           table->name, col->name);
+}
+
+/**
+ * @brief Reads the column's zone map back from its `.zm` file.
+ *
+ * @return 0 if loaded; -1 if the file is missing or does not match the column, in
+ * which case the caller rebuilds the zones
+ */
+static int load_zone_map(Table *table, Column *col) {
+  char path[MAX_PATH_LEN];
+  zone_file_path(path, table, col);
+  FILE *file = fopen(path, "rb");
+  if (!file) return -1;
+
+  ZoneFileHeader header;
+  int status = -1;
+  if (fread(&header, sizeof(header), 1, file) == 1 &&
+      memcmp(header.magic, ZONE_FILE_MAGIC, sizeof(header.magic)) == 0 &&
+      header.version == ZONE_FILE_VERSION && header.zone_size == ZONE_SIZE &&
+      header.num_elements == col->num_elements &&
+      header.num_zones == num_morsels(col->num_elements, ZONE_SIZE)) {
+    zone_map_free(col);
+    size_t n_zones = header.num_zones;
+    int *body = malloc(sizeof(int) * 2 * (n_zones ? n_zones : 1));
+    if (body && fread(body, sizeof(int), 2 * n_zones, file) == 2 * n_zones &&
+        checksum64(body, sizeof(int) * 2 * n_zones) == header.checksum) {
+      col->zones.mins = body;
+      col->zones.maxs = malloc(sizeof(int) * (n_zones ? n_zones : 1));
+      if (col->zones.maxs) {
+        memcpy(col->zones.maxs, body + n_zones, sizeof(int) * n_zones);
+        col->zones.num_zones = n_zones;
+        col->zones.capacity = n_zones;
+        status = 0;
+      } else {
+        col->zones.mins = NULL;
+        free(body);
+      }
+    } else {
+      free(body);
+    }
+  }
+  fclose(file);
+  if (status != 0) log_info("load_zone_map: rebuilding zones of %s\n", col->name);
+  return status;
+}
+
+Status persist_zone_map(Table *table, Column *col) {
+  char path[MAX_PATH_LEN];
+  zone_file_path(path, table, col);
+  size_t n_zones = col->zones.num_zones;
+  if (n_zones == 0 || n_zones != num_morsels(col->num_elements, ZONE_SIZE)) {
+    unlink(path);  // no zones (or not all of them); the next startup rebuilds them
+    return (Status){OK, NULL};
+  }
+
+  ZoneFileHeader header = {.version = ZONE_FILE_VERSION,
+                           .zone_size = ZONE_SIZE,
+                           .num_elements = col->num_elements,
+                           .num_zones = n_zones};
+  memcpy(header.magic, ZONE_FILE_MAGIC, sizeof(header.magic));
+  int *body = malloc(sizeof(int) * 2 * n_zones);
+  if (!body) return (Status){ERROR, "Failed to allocate zone map buffer"};
+  memcpy(body, col->zones.mins, sizeof(int) * n_zones);
+  memcpy(body + n_zones, col->zones.maxs, sizeof(int) * n_zones);
+  header.checksum = checksum64(body, sizeof(int) * 2 * n_zones);
+
+  // Same tmp-then-rename scheme as the index files
+  char tmp_path[MAX_PATH_LEN + 4];
+  snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", path);
+  FILE *file = fopen(tmp_path, "wb");
+  int failed = !file || fwrite(&header, sizeof(header), 1, file) != 1 ||
+               fwrite(body, sizeof(int), 2 * n_zones, file) != 2 * n_zones;
+  if (file && fclose(file) != 0) failed = 1;
+  free(body);
+  if (failed || rename(tmp_path, path) != 0) {
+    log_err("persist_zone_map: failed to write %s: %s\n", path, strerror(errno));
+    unlink(tmp_path);
+    return (Status){ERROR, "Failed to write zone map file"};
+  }
+  return (Status){OK, NULL};
+}
+
+/**
+ * @brief Loads one column's metadata and maps its data file. The index, if any, is
+ * only allocated here; the caller loads or builds it.
+ */
 Status deserialize_column(Column *col, Table *table, FILE *meta_file) {
-  col->data_type = INT;  // Default to INT for the scope of this project
   size_t num_elements;
   long min_value, max_value, sum;
   int idx_type;
+  int data_type = INT;  // catalogs written before columns had a type hold ints
 
   // Load column metadata
   if (fscanf(meta_file,
@@ -43,13 +341,24 @@ Status deserialize_column(Column *col, Table *table, FILE *meta_file) {
             table->name);
     return (Status){ERROR, "Failed to read column metadata"};
   }
+  if (fscanf(meta_file, "DATA_TYPE=%d\n", &data_type) == 1 &&
+      (data_type < INT || data_type > DOUBLE)) {
+    log_err("init_db_from_disk: Invalid data type %d for column %s\n", data_type,
+            col->name);
+    return (Status){ERROR, "Invalid data type"};
+  }
+  int encode = 0;  // catalogs written before columns opted in to encodings have none
+  if (fscanf(meta_file, "ENCODED=%d\n", &encode) != 1) encode = 0;
 
   // Set column metadata
+  col->data_type = data_type;
+  col->encode = encode;
   col->num_elements = num_elements;
   col->min_value = min_value;
   col->max_value = max_value;
   col->sum = sum;
   col->is_dirty = 0;
+  col->dirty_from = num_elements;
 
   // Construct the path to the column's data file
   char col_path[MAX_PATH_LEN];
@@ -58,19 +367,27 @@ Status deserialize_column(Column *col, Table *table, FILE *meta_file) {
 
   // Open the column data file
   col->disk_fd = open(col_path, O_RDWR);
-  if (col->disk_fd < 0) {
+  col->data = NULL;
+  col->mmap_size = 0;
+  if (col->disk_fd < 0 && !(errno == ENOENT && num_elements == 0)) {
     log_err("Failed to open column data file %s\n", col_path);
     return (Status){ERROR, "Failed to open column data file"};
   }
 
-  // mmap the column data
-  col->mmap_size = col->num_elements * sizeof(int);
-  col->data = (int *)mmap(NULL, col->mmap_size, PROT_READ | PROT_WRITE, MAP_SHARED,
-                          col->disk_fd, 0);
-  if (col->data == MAP_FAILED) {
-    log_err("Error mmapping column data");
-    close(col->disk_fd);
-    return (Status){ERROR, "Failed to mmap column data"};
+  // A column created but not loaded yet has no file; it stays unmapped, as
+  // `create_column` left it, until a load creates one
+  if (col->disk_fd >= 0) {
+    col->mmap_size = col->num_elements * data_type_size(col->data_type);
+    col->data = mmap(NULL, col->mmap_size, PROT_READ | PROT_WRITE, MAP_SHARED,
+                     col->disk_fd, 0);
+    if (col->data == MAP_FAILED) {
+      log_err("Error mmapping column data");
+      close(col->disk_fd);
+      return (Status){ERROR, "Failed to mmap column data"};
+    }
+
+    if (col->data_type != INT || load_zone_map(table, col) != 0) zone_map_build(col);
+    column_encode(col);
   }
 
   // Handle index creation, if necessary
@@ -79,13 +396,12 @@ Status deserialize_column(Column *col, Table *table, FILE *meta_file) {
             col->name);
     return (Status){ERROR, "Invalid index type"};
   }
+  col->root = NULL;
   if (idx_type != NONE) {
-    col->index = (ColumnIndex *)malloc(sizeof(ColumnIndex));
-    col->index->idx_type = idx_type;
-    create_idx_on(col, NULL);
+    col->index = create_column_index(idx_type);
+    if (!col->index) return (Status){ERROR, "Failed to allocate column index"};
   } else {
     col->index = NULL;
-    col->root = NULL;
   }
 
   log_info("Loaded in %s.%s.%s with %zu elements\n", current_db->name, table->name,
@@ -147,7 +463,8 @@ Status init_db_from_disk(void) {
         }
 
         // Validate metadata values
-        if (tables_size == 0 || tables_capacity == 0 || tables_size > tables_capacity) {
+        // a database created without tables yet has neither
+        if (tables_size > tables_capacity) {
           log_err(
               "init_db_from_disk: Invalid tables_size or tables_capacity in metadata\n");
           free(current_db);
@@ -160,8 +477,12 @@ Status init_db_from_disk(void) {
         current_db->tables_capacity = tables_capacity;
 
         // Allocate memory for tables
-        current_db->tables = (Table *)malloc(current_db->tables_capacity * sizeof(Table));
-        if (!current_db->tables) {
+        current_db->tables = NULL;
+        if (current_db->tables_capacity > 0) {
+          current_db->tables =
+              (Table *)malloc(current_db->tables_capacity * sizeof(Table));
+        }
+        if (current_db->tables_capacity > 0 && !current_db->tables) {
           log_err("init_db_from_disk: Failed to allocate memory for tables\n");
           free(current_db);
           fclose(meta_file);
@@ -198,7 +519,7 @@ Status init_db_from_disk(void) {
           table->num_cols = num_cols;
 
           // Allocate memory for columns
-          table->columns = (Column *)malloc(table->col_capacity * sizeof(Column));
+          table->columns = (Column *)calloc(table->col_capacity, sizeof(Column));
           if (!table->columns) {
             log_err("init_db_from_disk: Failed to allocate memory for columns\n");
             free(current_db->tables);
@@ -210,10 +531,17 @@ Status init_db_from_disk(void) {
 
           Column *primary_col = NULL;  // Primary column for indexing, this is the first
                                        // column with clustered index
+          // Indexes are mapped back (or rebuilt) in parallel, one task per column
+          ColumnIndexTask *index_tasks = malloc(sizeof(ColumnIndexTask) * num_cols);
+          TaskGroup index_builds;
+          taskgroup_init(&index_builds);
           // Read column metadata and remap each column's data file
           for (size_t j = 0; j < table->num_cols; j++) {
             Column *col = &table->columns[j];
             if (deserialize_column(col, table, meta_file).code != OK) {
+              threadpool_wait(g_thread_pool, &index_builds);
+              taskgroup_destroy(&index_builds);
+              free(index_tasks);
               free(table->columns);
               free(current_db->tables);
               free(current_db);
@@ -222,12 +550,28 @@ Status init_db_from_disk(void) {
               return (Status){ERROR, "Failed to load column metadata"};
             }
             IndexType idx_type = col->index ? col->index->idx_type : NONE;
+            // the index of a column not loaded yet is built by its load
+            if (idx_type != NONE && col->data) {
+              ColumnIndexTask task = {table, col};
+              if (!index_tasks) {
+                load_or_build_index_task(&task);
+              } else {
+                index_tasks[j] = task;
+                if (threadpool_submit(g_thread_pool, &index_builds,
+                                      load_or_build_index_task, &index_tasks[j]) != 0) {
+                  load_or_build_index_task(&index_tasks[j]);
+                }
+              }
+            }
             if (!primary_col &&
                 (idx_type == SORTED_CLUSTERED || idx_type == BTREE_CLUSTERED)) {
               primary_col = col;
             }
             print_column(col);
           }
+          threadpool_wait(g_thread_pool, &index_builds);
+          taskgroup_destroy(&index_builds);
+          free(index_tasks);
           //   if (primary_col) {
           //     cluster_idx_on(table, primary_col, NULL);
           //   }
@@ -235,6 +579,8 @@ Status init_db_from_disk(void) {
 
         fclose(meta_file);
         closedir(dir);
+        // Inserts made after the catalog was last written are only in the log
+        wal_recover();
         log_info("Database %s successfully loaded from disk\n", current_db->name);
         return (Status){OK, "Database loaded from disk"};
       } else {
@@ -305,22 +651,75 @@ Table *get_table_from_catalog(const char *table_name) {
   return NULL;
 }
 
-Status shutdown_catalog_manager(void) {
-  cs165_log(stdout, "Shutting down catalog manager\n");
-  if (!current_db) {
-    cs165_log(stdout, "No active database to shutdown\n");
-    return (Status){ERROR, "No active database to shutdown"};
+void mark_column_dirty(Column *col, size_t from_row) {
+  if (!col->is_dirty || from_row < col->dirty_from) col->dirty_from = from_row;
+  col->is_dirty = 1;
+}
+
+// Makes the files created, renamed or removed in the storage directory durable
+static int sync_storage_dir(void) {
+  int dir_fd = open(STORAGE_PATH, O_RDONLY);
+  int status = dir_fd >= 0 && fsync(dir_fd) == 0 ? 0 : -1;
+  if (status != 0) log_err("sync_storage_dir: failed to sync %s\n", STORAGE_PATH);
+  if (dir_fd >= 0) close(dir_fd);
+  return status;
+}
+
+/**
+ * @brief Writes the dirty rows of every column back to its file and waits for them.
+ * Writeback of all the dirty ranges is started first, so the files are written in
+ * parallel, and only then waited for one at a time.
+ *
+ * Zone files are not rewritten here: a dirty column's file is removed instead, since
+ * it describes older rows, and the zones are rebuilt at startup unless a shutdown
+ * persisted them.
+ */
+static Status flush_columns(size_t *bytes_written) {
+  for (size_t i = 0; i < current_db->tables_size; i++) {
+    Table *table = &current_db->tables[i];
+    for (size_t j = 0; j < table->num_cols; j++) {
+      Column *col = &table->columns[j];
+      if (!col->is_dirty || col->disk_fd < 0 || !col->data) continue;
+      size_t width = data_type_size(col->data_type);
+#ifdef __linux__
+      sync_file_range(col->disk_fd, col->dirty_from * width,
+                      (col->num_elements - col->dirty_from) * width,
+                      SYNC_FILE_RANGE_WRITE);
+#else
+      msync(col->data, col->num_elements * width, MS_ASYNC);
+#endif
+    }
   }
 
-  // Open metadata file for writing
-  char meta_path[MAX_PATH_LEN];
-  snprintf(meta_path, MAX_PATH_LEN, "%s/%s.meta", STORAGE_PATH, current_db->name);
-  FILE *meta_file = fopen(meta_path, "w");
-  if (!meta_file) {
-    log_err("Failed to open metadata file for writing: %s\n", meta_path);
-    return (Status){ERROR, "Failed to write metadata"};
+  Status status = {OK, NULL};
+  int removed_zone_files = 0;
+  for (size_t i = 0; i < current_db->tables_size; i++) {
+    Table *table = &current_db->tables[i];
+    for (size_t j = 0; j < table->num_cols; j++) {
+      Column *col = &table->columns[j];
+      if (!col->is_dirty || col->disk_fd < 0 || !col->data) continue;
+      // also makes the size of a file grown by inserts durable
+      if (fdatasync(col->disk_fd) != 0) {
+        log_err("flush_columns: failed to sync %s: %s\n", col->name, strerror(errno));
+        status = (Status){ERROR, "Failed to sync column data"};
+        continue;
+      }
+      size_t width = data_type_size(col->data_type);
+      *bytes_written += (col->num_elements - col->dirty_from) * width;
+      col->is_dirty = 0;
+      col->dirty_from = col->num_elements;
+      char zone_path[MAX_PATH_LEN];
+      zone_file_path(zone_path, table, col);
+      if (unlink(zone_path) == 0) removed_zone_files = 1;
+    }
   }
+  // a zone file that came back after a crash could match the rows' count
+  if (removed_zone_files) sync_storage_dir();
+  return status;
+}
 
+// Writes the catalog in the text format `init_db_from_disk` reads
+static void write_catalog_meta(FILE *meta_file) {
   // Write database metadata (name, tables_size, tables_capacity)
   fprintf(meta_file, "DB_NAME=%s\nTABLES_SIZE=%zu\nTABLES_CAPACITY=%zu\n",
           current_db->name, current_db->tables_size, current_db->tables_capacity);
@@ -335,36 +734,139 @@ Status shutdown_catalog_manager(void) {
     for (size_t j = 0; j < table->num_cols; j++) {
       Column *col = &table->columns[j];
       int idx_type = col->index ? col->index->idx_type : NONE;
-
-      cs165_log(stdout, "shutting down column %s\n", col->name);
-      print_column(col);
-
       fprintf(meta_file,
               "COLUMN_NAME=%s\nNUM_ELEMENTS=%zu\nMIN_VALUE=%ld\nMAX_VALUE=%ld\nSUM=%ld\n"
-              "INDEX_TYPE=%d\n",
+              "INDEX_TYPE=%d\nDATA_TYPE=%d\nENCODED=%d\n",
               col->name, col->num_elements, col->min_value, col->max_value, col->sum,
-              idx_type);
+              idx_type, col->data_type, col->encode);
+    }
+  }
+}
 
-      if (idx_type != NONE) {
-        if (col->index->idx_type == BTREE_CLUSTERED ||
-            col->index->idx_type == BTREE_UNCLUSTERED) {
-          free_btree(col->root);
-        }
-        free(col->index->sorted_data);
-        free(col->index->positions);
-        free(col->index);
+// Whether the file at `path` holds exactly `size` bytes of `contents`
+static int file_holds(const char *path, const char *contents, size_t size) {
+  FILE *file = fopen(path, "rb");
+  if (!file) return 0;
+  char *buffer = malloc(size + 1);
+  // reading one byte more than expected tells a longer file apart
+  int same = buffer && fread(buffer, 1, size + 1, file) == size &&
+             memcmp(buffer, contents, size) == 0;
+  free(buffer);
+  fclose(file);
+  return same;
+}
+
+/**
+ * @brief Writes a new version of `disk/<db>.meta`: to a `.tmp` file first, which is
+ * synced and renamed over the old version, so a crash leaves one version or the other.
+ * Does nothing if the file already holds this version.
+ */
+static Status persist_catalog(size_t *bytes_written) {
+  char *meta = NULL;
+  size_t meta_size = 0;
+  FILE *buffer = open_memstream(&meta, &meta_size);
+  if (!buffer) return (Status){ERROR, "Failed to allocate metadata buffer"};
+  write_catalog_meta(buffer);
+  if (fclose(buffer) != 0) {
+    free(meta);
+    return (Status){ERROR, "Failed to allocate metadata buffer"};
+  }
+
+  char meta_path[MAX_PATH_LEN];
+  snprintf(meta_path, MAX_PATH_LEN, "%s/%s.meta", STORAGE_PATH, current_db->name);
+  if (file_holds(meta_path, meta, meta_size)) {
+    free(meta);
+    return (Status){OK, NULL};
+  }
+
+  char tmp_path[MAX_PATH_LEN + 4];
+  snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", meta_path);
+  FILE *meta_file = fopen(tmp_path, "w");
+  int failed = !meta_file || fwrite(meta, 1, meta_size, meta_file) != meta_size ||
+               fflush(meta_file) != 0 || fsync(fileno(meta_file)) != 0;
+  if (meta_file && fclose(meta_file) != 0) failed = 1;
+  free(meta);
+  if (failed || rename(tmp_path, meta_path) != 0) {
+    log_err("persist_catalog: failed to write %s: %s\n", meta_path, strerror(errno));
+    unlink(tmp_path);
+    return (Status){ERROR, "Failed to write metadata"};
+  }
+  // the rename, and the column files created since the last version, are entries of
+  // the storage directory
+  sync_storage_dir();
+  *bytes_written += meta_size;
+  return (Status){OK, NULL};
+}
+
+Status checkpoint_catalog(size_t *bytes_written) {
+  // The catalog must never count rows its column files do not hold yet
+  Status status = flush_columns(bytes_written);
+  if (status.code != OK) return status;
+  status = persist_catalog(bytes_written);
+  if (status.code != OK) return status;
+  wal_checkpoint();
+  return status;
+}
+
+Status shutdown_catalog_manager(void) {
+  cs165_log(stdout, "Shutting down catalog manager\n");
+  if (!current_db) {
+    cs165_log(stdout, "No active database to shutdown\n");
+    return (Status){ERROR, "No active database to shutdown"};
+  }
+
+  // Write every index that is not on disk yet, one task per column
+  size_t n_indexed = 0;
+  for (size_t i = 0; i < current_db->tables_size; i++) {
+    n_indexed += current_db->tables[i].num_cols;
+  }
+  ColumnIndexTask *persist_tasks = malloc(sizeof(ColumnIndexTask) * (n_indexed + 1));
+  TaskGroup index_writes;
+  taskgroup_init(&index_writes);
+  n_indexed = 0;
+  for (size_t i = 0; i < current_db->tables_size; i++) {
+    Table *table = &current_db->tables[i];
+    for (size_t j = 0; j < table->num_cols; j++) {
+      Column *col = &table->columns[j];
+      if (!col->index || col->index->idx_type == NONE) continue;
+      index_flush(col);  // fold inserted rows in, so the whole index is persisted
+      if (!persist_tasks) {
+        persist_column_index(table, col);
+        continue;
+      }
+      persist_tasks[n_indexed] = (ColumnIndexTask){table, col};
+      if (threadpool_submit(g_thread_pool, &index_writes, persist_index_task,
+                            &persist_tasks[n_indexed]) != 0) {
+        persist_index_task(&persist_tasks[n_indexed]);
       }
+      n_indexed++;
+    }
+  }
+  threadpool_wait(g_thread_pool, &index_writes);
+  taskgroup_destroy(&index_writes);
+  free(persist_tasks);
 
-      if (col->is_dirty) {
-        // Only truncate and sync the actual data size
-        size_t actual_size = col->num_elements * sizeof(int);
-        if (ftruncate(col->disk_fd, actual_size) == -1) {
-          log_err("Error truncating column data file");
-        }
-        if (msync(col->data, actual_size, MS_SYNC) == -1) {
-          log_err("Error syncing memory to disk");
-        }
+  // The background checkpoints left only the rows written since the last one to flush
+  size_t bytes_written = 0;
+  Status status = checkpoint_catalog(&bytes_written);
+  if (status.code != OK) log_err("shutdown_catalog_manager: %s\n", status.error_message);
+  wal_close();
+
+  for (size_t i = 0; i < current_db->tables_size; i++) {
+    Table *table = &current_db->tables[i];
+    for (size_t j = 0; j < table->num_cols; j++) {
+      Column *col = &table->columns[j];
+      cs165_log(stdout, "shutting down column %s\n", col->name);
+      print_column(col);
+
+      if (col->index && col->index->idx_type != NONE) {
+        free_idx_data(col);
+        free(col->index);
       }
+      persist_zone_map(table, col);
+      zone_map_free(col);
+      column_encoding_free(col);
+
       // unmap the column data and close the file descriptor
       if (col->data) {
         cs165_log(stdout, "num_elements: %zu\n", col->num_elements);
@@ -372,6 +874,12 @@ Status shutdown_catalog_manager(void) {
           log_err("Error unmapping memory");
         }
         if (col->disk_fd > 0) {
+          // inserts grow the file a page at a time; drop the rows past the last one
+          size_t actual_size = col->num_elements * data_type_size(col->data_type);
+          if (col->mmap_size > actual_size &&
+              ftruncate(col->disk_fd, actual_size) == -1) {
+            log_err("Error truncating column data file");
+          }
           cs165_log(stdout, "closing fd: %d\n", col->disk_fd);
           close(col->disk_fd);
         }
@@ -381,7 +889,6 @@ Status shutdown_catalog_manager(void) {
   }
 
   free(current_db->tables);
-  fclose(meta_file);
   free(current_db);
 
   cs165_log(stdout, "Metadata written and catalog manager shut down.\n");
@@ -415,7 +922,7 @@ void print_column(Column *col) {
       log_info("----------------\n");
     }
 
-    if (col->index && col->index->idx_type != NONE) {
+    if (col->index && col->index->sorted_data) {
       log_info("Sorted layer: \n================\n");
       for (size_t i = 0; i < col->num_elements; i++) {
         printf("(val: %d, pos: %d) ", col->index->sorted_data[i],
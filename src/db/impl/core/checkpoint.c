@@ -0,0 +1,119 @@
+#define _POSIX_C_SOURCE 200809L  // for clock_gettime
+#include "checkpoint.h"
+
+#include <pthread.h>
+#include <time.h>
+
+#include "catalog_manager.h"
+#include "utils.h"
+
+static struct {
+  pthread_mutex_t lock;
+  pthread_cond_t wake;
+  pthread_t thread;
+  unsigned interval_ms;
+  int running;
+  int stopping;
+  CheckpointStats stats;
+} checkpointer = {.lock = PTHREAD_MUTEX_INITIALIZER, .wake = PTHREAD_COND_INITIALIZER};
+
+// Sessions checkpoint too (see checkpoint_now), some under the shared catalog lock
+static pthread_mutex_t checkpoint_lock = PTHREAD_MUTEX_INITIALIZER;
+
+Status checkpoint_now(void) {
+  if (!current_db) return (Status){OK, NULL};
+  pthread_mutex_lock(&checkpoint_lock);
+  double t0 = get_time();
+  size_t bytes_written = 0;
+  Status status = checkpoint_catalog(&bytes_written);
+  double duration = get_time() - t0;
+  pthread_mutex_unlock(&checkpoint_lock);
+
+  if (status.code != OK) {
+    log_err("checkpoint: %s\n", status.error_message);
+  }
+  if (bytes_written == 0) return status;
+  log_perf("checkpoint: wrote %zu bytes in %.6fμs\n", bytes_written, duration);
+  pthread_mutex_lock(&checkpointer.lock);
+  checkpointer.stats.num_checkpoints++;
+  checkpointer.stats.bytes_written += bytes_written;
+  checkpointer.stats.total_duration_us += duration;
+  checkpointer.stats.last_duration_us = duration;
+  pthread_mutex_unlock(&checkpointer.lock);
+  return status;
+}
+
+static void checkpoint_once(void) {
+  catalog_read_lock();
+  checkpoint_now();
+  catalog_unlock();
+}
+
+static void *run_checkpointer(void *arg) {
+  (void)arg;
+  pthread_mutex_lock(&checkpointer.lock);
+  while (!checkpointer.stopping) {
+    struct timespec deadline;
+    clock_gettime(CLOCK_REALTIME, &deadline);
+    deadline.tv_sec += checkpointer.interval_ms / 1000;
+    deadline.tv_nsec += (long)(checkpointer.interval_ms % 1000) * 1000000;
+    if (deadline.tv_nsec >= 1000000000) {
+      deadline.tv_sec++;
+      deadline.tv_nsec -= 1000000000;
+    }
+    // woken early only to stop
+    while (!checkpointer.stopping && pthread_cond_timedwait(&checkpointer.wake,
+                                                            &checkpointer.lock,
+                                                            &deadline) == 0) {
+    }
+    if (checkpointer.stopping) break;
+    pthread_mutex_unlock(&checkpointer.lock);
+    checkpoint_once();
+    pthread_mutex_lock(&checkpointer.lock);
+  }
+  pthread_mutex_unlock(&checkpointer.lock);
+  return NULL;
+}
+
+int checkpointer_start(unsigned interval_ms) {
+  pthread_mutex_lock(&checkpointer.lock);
+  int status = 0;
+  if (!checkpointer.running) {
+    checkpointer.interval_ms = interval_ms;
+    checkpointer.stopping = 0;
+    if (pthread_create(&checkpointer.thread, NULL, run_checkpointer, NULL) != 0) {
+      status = -1;
+    }
+    checkpointer.running = status == 0;
+  }
+  pthread_mutex_unlock(&checkpointer.lock);
+  if (status != 0) log_err("checkpointer_start: failed to start the checkpointer\n");
+  return status;
+}
+
+void checkpointer_stop(void) {
+  pthread_mutex_lock(&checkpointer.lock);
+  if (!checkpointer.running) {
+    pthread_mutex_unlock(&checkpointer.lock);
+    return;
+  }
+  checkpointer.stopping = 1;
+  pthread_cond_signal(&checkpointer.wake);
+  pthread_mutex_unlock(&checkpointer.lock);
+  pthread_join(checkpointer.thread, NULL);
+
+  CheckpointStats stats;
+  checkpointer_stats(&stats);
+  log_info("checkpointer: %zu checkpoints wrote %zu bytes in %.6fμs (the last %.6fμs)\n",
+           stats.num_checkpoints, stats.bytes_written, stats.total_duration_us,
+           stats.last_duration_us);
+  pthread_mutex_lock(&checkpointer.lock);
+  checkpointer.running = 0;
+  pthread_mutex_unlock(&checkpointer.lock);
+}
+
+void checkpointer_stats(CheckpointStats *stats) {
+  pthread_mutex_lock(&checkpointer.lock);
+  *stats = checkpointer.stats;
+  pthread_mutex_unlock(&checkpointer.lock);
+}
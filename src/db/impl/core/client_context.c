@@ -1,73 +1,110 @@
 #include "client_context.h"
 
 #include <errno.h>
+#include <pthread.h>
 #include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
+#include "pipeline.h"
+#include "positions.h"
+#include "str_map.h"
+
 #define INITIAL_CHANDLE_SLOTS 1000
 #define GROWTH_FACTOR 2
 
-// TODO: Extra: to support multiple clients, consider not using a global client
-// context. Using global now for simplicity.
-ClientContext *g_client_context = NULL;
+__thread ClientContext *g_client_context = NULL;
+
+// Every live session context, so a writer can materialize pending handles across
+// sessions. Sessions come and go far less often than queries run, so a list suffices.
+static ClientContext *live_contexts = NULL;
+static pthread_mutex_t live_contexts_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static int bind_handle(ClientContext *context, const char *name, Column *new_col);
 
 static bool is_valid_handle_name(const char *name) {
   return name != NULL && strlen(name) < MAX_SIZE_NAME;
 }
 
-void init_client_context(void) {
-  if (g_client_context != NULL) {
-    return;
-  }
+// Frees a handle and the result it holds; handles never own catalog memory
+static void free_handle(void *ptr) {
+  Column *col = (Column *)ptr;
+  if (!col) return;
+  cs165_log(stdout, "free_handle: Freeing column %s\n", col->name);
+  free(col->data);
+  free(col->pending);
+  bitmap_destroy(col->bitmap);
+  positions_ranges_destroy(col->ranges);
+  free(col);
+}
 
-  g_client_context = (ClientContext *)calloc(1, sizeof(ClientContext));
-  if (!g_client_context) {
-    log_err("init_client_context: failed to allocate memory for client context\n");
-    exit(1);
+ClientContext *create_client_context(void) {
+  ClientContext *context = (ClientContext *)calloc(1, sizeof(ClientContext));
+  if (!context) {
+    log_err("create_client_context: failed to allocate memory for client context\n");
+    return NULL;
   }
 
-  g_client_context->chandle_table =
-      (Column *)calloc(INITIAL_CHANDLE_SLOTS, sizeof(Column));
-  if (!g_client_context->chandle_table) {
-    free(g_client_context);
-    g_client_context = NULL;
-    log_err("init_client_context: failed to allocate memory for chandle table\n");
-    return;
+  context->chandle_table = (Column **)calloc(INITIAL_CHANDLE_SLOTS, sizeof(Column *));
+  context->chandle_index = str_map_create(INITIAL_CHANDLE_SLOTS);
+  context->query_arena = arena_create(QUERY_ARENA_BLOCK_SIZE);
+  if (!context->chandle_table || !context->chandle_index || !context->query_arena) {
+    free(context->chandle_table);
+    str_map_destroy(context->chandle_index);
+    arena_destroy(context->query_arena);
+    free(context);
+    log_err("create_client_context: failed to allocate memory for chandle table\n");
+    return NULL;
   }
 
-  g_client_context->chandles_in_use = 0;
-  g_client_context->chandle_slots = INITIAL_CHANDLE_SLOTS;
-  g_client_context->is_batch_queries_on = 0;
-  g_client_context->is_single_core = 0;
+  context->chandles_in_use = 0;
+  context->chandle_slots = INITIAL_CHANDLE_SLOTS;
+  context->is_batch_queries_on = 0;
+  context->is_single_core = 0;
+  context->join_memory_budget = JOIN_MEMORY_BUDGET;
+  pthread_mutex_init(&context->handle_lock, NULL);
+
+  pthread_mutex_lock(&live_contexts_lock);
+  context->next = live_contexts;
+  live_contexts = context;
+  pthread_mutex_unlock(&live_contexts_lock);
   log_info("Client context initialized\n");
-  return;
+  return context;
 }
 
-void free_client_context(void) {
-  if (!g_client_context) return;
-
-  if (g_client_context->chandle_table) {
-    for (int i = 0; i < g_client_context->chandles_in_use; i++) {
-      Column *col = &g_client_context->chandle_table[i];
-      if (col) {
-        // we ignore closing col->disk_fd and munmap(col->data, col->mmap_size) since
-        // such columns should be managed by the catalog manager. this is variable pool.
-        cs165_log(stdout, "free_client_context: Freeing column %s\n", col->name);
-        free(col->data);
-        memset(col, 0, sizeof(Column));  // Clear sensitive data
-      }
-    }
-    free(g_client_context->chandle_table);
+void free_client_context(ClientContext *context) {
+  if (!context) return;
+
+  pthread_mutex_lock(&live_contexts_lock);
+  ClientContext **link = &live_contexts;
+  while (*link && *link != context) link = &(*link)->next;
+  if (*link) *link = context->next;
+  pthread_mutex_unlock(&live_contexts_lock);
+
+  // we ignore closing col->disk_fd and munmap(col->data, col->mmap_size) since such
+  // columns should be managed by the catalog manager. this is variable pool.
+  for (int i = 0; i < context->chandles_in_use; i++) {
+    free_handle(context->chandle_table[i]);
+  }
+  free(context->chandle_table);
+  str_map_destroy(context->chandle_index);
+  release_retired_handles(context);
+  if (context->batch_queries) vector_destroy(context->batch_queries);
+  arena_destroy(context->query_arena);
+  for (size_t i = 0; i < context->num_task_arenas; i++) {
+    arena_destroy(context->task_arenas[i]);
   }
+  free(context->task_arenas);
+  pthread_mutex_destroy(&context->handle_lock);
 
-  free(g_client_context);
-  g_client_context = NULL;
+  if (g_client_context == context) g_client_context = NULL;
+  free(context);
 }
 
 int create_new_handle(const char *name, Column **out_column) {
-  if (!g_client_context) {
+  ClientContext *context = g_client_context;
+  if (!context) {
     log_err("create_new_handle: client context is not initialized\n");
     return -1;
   }
@@ -77,66 +114,126 @@ int create_new_handle(const char *name, Column **out_column) {
     return -1;
   }
 
-  // Check for duplicate names.
-  //    TODO: removing this until we have an O(1) lookup. Currently, we don't expect
-  //    many handles to be created: > 100, >1000?
-  //   Also, what number of handles would be worth the overhead of a hash table?m
-  //   if (get_handle(name) != NULL) {
-  //     log_err("create_new_handle: handle with name %s already exists\n", name);
-  //     return -1;
-  //   }
-
-  // Check if resize needed
-  if (g_client_context->chandles_in_use >= g_client_context->chandle_slots) {
-    size_t new_size = g_client_context->chandle_slots * GROWTH_FACTOR;
-
-    // TODO: Fix the issue that the actual columns gets freed and not copied back into
-    // the new memory. To reproduce the issue, use a small INITIAL_CHANDLE_SLOTS value
-    // Currently, using larger INITIAL_CHANDLE_SLOTS value to avoid the issue.
-    Column *new_table =
-        (Column *)realloc(g_client_context->chandle_table, new_size * sizeof(Column));
+  Column *new_col = (Column *)calloc(1, sizeof(Column));
+  if (!new_col) {
+    log_err("create_new_handle: failed to allocate handle %s\n", name);
+    return -1;
+  }
+  if (snprintf(new_col->name, MAX_SIZE_NAME, "handle_%s", name) >= MAX_SIZE_NAME) {
+    log_err("create_new_handle: handle name %s is too long\n", name);
+    free(new_col);
+    return -1;
+  }
+
+  pthread_mutex_lock(&context->handle_lock);
+  int status = bind_handle(context, name, new_col);
+  pthread_mutex_unlock(&context->handle_lock);
+  if (status != 0) {
+    free(new_col);
+    return -1;
+  }
+  *out_column = new_col;
+  return 0;
+}
+
+// Binds `name` to `new_col` in the handle table; the caller holds the handle lock
+static int bind_handle(ClientContext *context, const char *name, Column *new_col) {
+  // Rebinding a name takes over its slot. The old result may still be an input of the
+  // running query (e.g. `s=select(s,f,0,9)`), so it is only freed after the query.
+  size_t slot;
+  if (str_map_get(context->chandle_index, name, &slot)) {
+    if (!context->retired_handles) {
+      context->retired_handles = vector_create(free_handle);
+      if (!context->retired_handles) {
+        log_err("create_new_handle: failed to retire handle %s\n", name);
+        return -1;
+      }
+    }
+    vector_push_back(context->retired_handles, context->chandle_table[slot]);
+    context->chandle_table[slot] = new_col;
+    log_info("create_new_handle: rebound handle %s at i=%zu\n", name, slot);
+    return 0;
+  }
+
+  // Check if resize needed. Only the pointer array moves; the handles stay put, so
+  // Column pointers held by operators survive the growth.
+  if (context->chandles_in_use >= context->chandle_slots) {
+    size_t new_size = context->chandle_slots * GROWTH_FACTOR;
+    Column **new_table =
+        (Column **)realloc(context->chandle_table, new_size * sizeof(Column *));
     if (!new_table) {
       log_err("create_new_handle: failed to resize chandle table\n");
       return -1;
     }
-
-    // Zero initialize new memory
-    memset(new_table + g_client_context->chandle_slots, 0,
-           (new_size - g_client_context->chandle_slots) * sizeof(Column));
-
-    g_client_context->chandle_table = new_table;
-    g_client_context->chandle_slots = new_size;
+    context->chandle_table = new_table;
+    context->chandle_slots = new_size;
   }
 
-  // Initialize new handle
-  Column *new_col = &g_client_context->chandle_table[g_client_context->chandles_in_use];
-  memset(new_col, 0, sizeof(Column));
-  snprintf(new_col->name, MAX_SIZE_NAME, "handle_%s", name);
-
-  *out_column = new_col;
-  g_client_context->chandles_in_use++;
-  log_info("create_new_handle: created new handle %s at i=%d\n", name,
-           g_client_context->chandles_in_use - 1);
+  slot = context->chandles_in_use;
+  if (str_map_put(context->chandle_index, name, slot) != 0) {
+    log_err("create_new_handle: failed to index handle %s\n", name);
+    return -1;
+  }
+  context->chandle_table[slot] = new_col;
+  context->chandles_in_use++;
+  log_info("create_new_handle: created new handle %s at i=%zu\n", name, slot);
   return 0;
 }
 
-Column *get_handle(const char *name_) {
-  if (!g_client_context || !name_) {
+void release_retired_handles(ClientContext *context) {
+  if (!context || !context->retired_handles) return;
+  vector_destroy(context->retired_handles);
+  context->retired_handles = NULL;
+}
+
+Column *get_pending_handle(const char *name) {
+  if (!g_client_context || !name) {
     log_err("get_handle: invalid arguments\n");
     return NULL;
   }
-  // adjust the name to include the handle_ prefix
-  char name[MAX_SIZE_NAME];
-  snprintf(name, MAX_SIZE_NAME, "handle_%s", name_);
-  // Search from most recent to oldest
-  cs165_log(stdout, "get_handle: searching for handle %s\n", name);
-  for (int i = g_client_context->chandles_in_use; i > 0; i--) {
-    cs165_log(stdout, "handle at i=%d: %s\n", i - 1,
-              g_client_context->chandle_table[i - 1].name);
-    Column *col = &g_client_context->chandle_table[i - 1];
-    if (col && strcmp(col->name, name) == 0) {
-      return col;
+  ClientContext *context = g_client_context;
+  size_t slot;
+  pthread_mutex_lock(&context->handle_lock);
+  Column *col = str_map_get(context->chandle_index, name, &slot)
+                    ? context->chandle_table[slot]
+                    : NULL;
+  pthread_mutex_unlock(&context->handle_lock);
+  if (!col) cs165_log(stdout, "get_handle: no handle named %s\n", name);
+  return col;
+}
+
+Column *get_positions_handle(const char *name) {
+  Column *col = get_pending_handle(name);
+  if (col && col->pending &&
+      pipeline_materialize(col, g_client_context->is_single_core,
+                           g_client_context->query_arena) != 0) {
+    log_err("get_handle: failed to materialize handle %s\n", name);
+    return NULL;
+  }
+  return col;
+}
+
+Column *get_handle(const char *name) {
+  Column *col = get_positions_handle(name);
+  if (col && (col->bitmap || col->ranges) &&
+      positions_expand(col, g_client_context->is_single_core,
+                       g_client_context->query_arena) != 0) {
+    log_err("get_handle: failed to expand handle %s\n", name);
+    return NULL;
+  }
+  return col;
+}
+
+void materialize_pending_handles(void) {
+  // The other sessions may still be sending a response out of their arenas, so the
+  // scratch comes from the caller's
+  Arena *scratch = g_client_context ? g_client_context->query_arena : NULL;
+  pthread_mutex_lock(&live_contexts_lock);
+  for (ClientContext *context = live_contexts; context; context = context->next) {
+    for (int i = 0; i < context->chandles_in_use; i++) {
+      Column *col = context->chandle_table[i];
+      if (col->pending) pipeline_materialize(col, context->is_single_core, scratch);
     }
   }
-  return NULL;
+  pthread_mutex_unlock(&live_contexts_lock);
 }
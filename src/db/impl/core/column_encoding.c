@@ -0,0 +1,128 @@
+#include "column_encoding.h"
+
+#include <string.h>
+
+#include "bitpack.h"
+#include "dictionary.h"
+#include "rle.h"
+#include "scan.h"
+#include "utils.h"
+
+int column_encode(Column *col) {
+  column_encoding_free(col);
+  size_t n = col->num_elements;
+  if (!col->encode || n == 0 || !col->data || col->data_type != INT) return 0;
+  const int *data = (const int *)col->data;
+
+  unsigned int bits = packed_bits_for(col->min_value, col->max_value);
+  if (bits <= ENCODING_MAX_BITS) {
+    col->packed = packed_create(data, n, (int)col->min_value, bits);
+    if (!col->packed) {
+      // also the case when the stats are stale and a value falls outside them
+      log_err("column_encode: failed to pack %s; scanning it unencoded\n", col->name);
+    } else {
+      log_info("column_encode: %s packed to %u-bit fields, %zu -> %zu bytes\n",
+               col->name, col->packed->width, n * sizeof(int), packed_size(col->packed));
+    }
+  } else {
+    col->dictionary = dictionary_create(data, n, DICTIONARY_MAX_VALUES);
+    if (col->dictionary) {
+      log_info("column_encode: %s dictionary-encoded, %zu values in %u-bit fields\n",
+               col->name, col->dictionary->num_values, col->dictionary->codes->width);
+    }
+  }
+
+  col->runs = rle_create(data, n, n / RLE_MIN_RUN_LENGTH);
+  if (col->runs) {
+    log_info("column_encode: %s run-length encoded, %zu runs of %zu rows\n", col->name,
+             col->runs->num_runs, n);
+  }
+  return column_is_encoded(col);
+}
+
+void column_encoding_append(Column *col, size_t row, int value) {
+  if (col->packed &&
+      (col->packed->num_elements != row || packed_append(col->packed, value) != 0)) {
+    log_info("column_encoding_append: %d does not fit the packing of %s; dropping it\n",
+             value, col->name);
+    packed_destroy(col->packed);
+    col->packed = NULL;
+  }
+  if (col->dictionary && (col->dictionary->codes->num_elements != row ||
+                          dictionary_append(col->dictionary, value) != 0)) {
+    log_info("column_encoding_append: %d is not in the dictionary of %s; dropping it\n",
+             value, col->name);
+    dictionary_destroy(col->dictionary);
+    col->dictionary = NULL;
+  }
+  if (col->runs &&
+      (rle_num_rows(col->runs) != row || rle_append(col->runs, value) != 0)) {
+    log_info("column_encoding_append: failed to extend the runs of %s; dropping them\n",
+             col->name);
+    rle_destroy(col->runs);
+    col->runs = NULL;
+  }
+}
+
+void column_encoding_free(Column *col) {
+  packed_destroy(col->packed);
+  col->packed = NULL;
+  dictionary_destroy(col->dictionary);
+  col->dictionary = NULL;
+  rle_destroy(col->runs);
+  col->runs = NULL;
+}
+
+size_t column_scan_range(const Column *col, size_t start, size_t end, int low, int high,
+                         int *out) {
+  if (col->runs) return rle_scan_range(col->runs, start, end, low, high, out);
+  if (col->packed) return packed_scan_range(col->packed, start, end, low, high, out);
+  if (col->dictionary) {
+    int lo, hi;
+    if (!dictionary_code_range(col->dictionary, low, high, &lo, &hi)) return 0;
+    return packed_scan_range(col->dictionary->codes, start, end, lo, hi, out);
+  }
+  return scan_range((const int *)col->data, start, end, low, high, NULL, out);
+}
+
+size_t column_scan_range_bits(const Column *col, size_t start, size_t end, int low,
+                              int high, uint64_t *words) {
+  if (col->runs) return rle_scan_range_bits(col->runs, start, end, low, high, words);
+  if (col->packed) {
+    return packed_scan_range_bits(col->packed, start, end, low, high, words);
+  }
+  if (col->dictionary) {
+    int lo, hi;
+    if (!dictionary_code_range(col->dictionary, low, high, &lo, &hi)) {
+      if (start < end) {
+        memset(words + start / 64, 0, sizeof(uint64_t) * ((end + 63) / 64 - start / 64));
+      }
+      return 0;
+    }
+    return packed_scan_range_bits(col->dictionary->codes, start, end, lo, hi, words);
+  }
+  return scan_range_bits((const int *)col->data, start, end, low, high, words);
+}
+
+void column_range_stats(const Column *col, size_t start, size_t end, int64_t *sum,
+                        long *min, long *max) {
+  if (col->runs) {
+    rle_range_stats(col->runs, start, end, sum, min, max);
+    return;
+  }
+  const int *data = (const int *)col->data;
+  for (size_t i = start; i < end; i++) {
+    *sum += data[i];
+    if (data[i] < *min) *min = data[i];
+    if (data[i] > *max) *max = data[i];
+  }
+}
+
+void column_decode(const Column *col, size_t start, size_t end, int *out) {
+  if (start >= end) return;
+  if (col->runs) {
+    rle_decode(col->runs, start, end, out);
+  } else {
+    memcpy(out, (const int *)col->data + start, sizeof(int) * (end - start));
+  }
+}
@@ -1,20 +1,40 @@
+#define _POSIX_C_SOURCE 200809L  // for pthread_rwlock_t
+#include <pthread.h>
+
 #include "catalog_manager.h"
+#include "checkpoint.h"
 #include "operators.h"
 #include "utils.h"
 
 // In this class, there will always be only one active database at a time
 Db *current_db;
+ThreadPool *g_thread_pool = NULL;
+
+static pthread_rwlock_t catalog_lock = PTHREAD_RWLOCK_INITIALIZER;
+
+void catalog_read_lock(void) { pthread_rwlock_rdlock(&catalog_lock); }
+
+void catalog_write_lock(void) { pthread_rwlock_wrlock(&catalog_lock); }
+
+void catalog_unlock(void) { pthread_rwlock_unlock(&catalog_lock); }
 
 Status db_startup(void) {
   cs165_log(stdout, "Startup server\n");
+  // Start the workers first: loading indexes from disk already uses them
+  g_thread_pool = threadpool_create(0);
+  if (!g_thread_pool) {
+    log_err("db_startup: failed to start the thread pool; running single-threaded\n");
+  }
   init_db_from_disk();
-  init_client_context();
+  checkpointer_start(CHECKPOINT_INTERVAL_MS);
   return (Status){OK, NULL};
 }
 
 void db_shutdown(void) {
+  checkpointer_stop();  // before the catalog it reads goes away
   shutdown_catalog_manager();
-  free_client_context();
+  threadpool_destroy(g_thread_pool);
+  g_thread_pool = NULL;
   cs165_log(stdout, "Shutdown server\n");
 }
 
@@ -36,6 +56,11 @@ void db_operator_free(DbOperator *dbo) {
       }
       break;
 
+    case SELECT:
+      // the predicates of a conjunctive select are one allocation
+      free(dbo->operator_fields.select_operator.predicates);
+      break;
+
     case LOAD:
       if (dbo->operator_fields.load_operator.file_name != NULL) {
         free(dbo->operator_fields.load_operator.file_name);
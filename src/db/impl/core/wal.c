@@ -0,0 +1,395 @@
+#define _POSIX_C_SOURCE 200809L  // for fdatasync
+#include "wal.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "catalog_manager.h"
+#include "optimizer.h"
+#include "query_exec.h"
+#include "utils.h"
+
+#define WAL_RECORD_MAGIC 0x4c415743u  // "CWAL"
+#define WAL_CREATE_MAGIC 0x4c445743u  // "CWDL"
+
+// Precedes the values of one logged insert
+typedef struct WalRecordHeader {
+  uint32_t magic;
+  uint32_t num_values;
+  uint64_t row;       // the row the values were inserted as
+  uint64_t checksum;  // checksum64 of the table name and the values
+  char table[MAX_SIZE_NAME];
+} WalRecordHeader;
+
+// One logged create of a table, a column or an index
+typedef struct WalCreateRecord {
+  uint32_t magic;
+  uint32_t kind;      // a WalCreateKind
+  uint64_t param;     // the table's column count, the column's type or the index type
+  uint64_t checksum;  // checksum64 of the fields above and the names
+  char table[MAX_SIZE_NAME];
+  char column[MAX_SIZE_NAME];
+} WalCreateRecord;
+
+// Records appended to the log but not written to its file yet
+typedef struct WalBuffer {
+  char *data;
+  size_t size;
+  size_t capacity;
+} WalBuffer;
+
+/*
+ * Positions in the log (LSNs) count the bytes appended since startup and never go back,
+ * so a session waiting on one is never confused by a checkpoint emptying the file.
+ */
+static struct {
+  pthread_mutex_t lock;
+  pthread_cond_t synced;
+  int fd;              // -1 until the first record or `wal_recover` opens the log
+  WalBuffer pending;   // appended since the last write
+  WalBuffer spare;     // the buffer being written, handed back once it is
+  uint64_t appended;   // LSN of the end of the last appended record
+  uint64_t durable;    // LSN up to which the log is written and synced
+  int syncing;         // a session is writing and syncing the log
+  int failed;          // a write or sync failed; later commits fail too
+  size_t num_commits;  // records acknowledged, and the syncs they took
+  size_t num_syncs;
+} wal = {.lock = PTHREAD_MUTEX_INITIALIZER, .synced = PTHREAD_COND_INITIALIZER, .fd = -1};
+
+static void wal_file_path(char *path) {
+  snprintf(path, MAX_PATH_LEN, "%s/%s.wal", STORAGE_PATH, current_db->name);
+}
+
+// Opens the log for appending; `truncate` drops what it held
+static int open_log(int truncate) {
+  char path[MAX_PATH_LEN];
+  wal_file_path(path);
+  wal.fd = open(path, O_WRONLY | O_CREAT | O_APPEND | (truncate ? O_TRUNC : 0), 0644);
+  if (wal.fd < 0) {
+    log_err("wal: failed to open %s: %s\n", path, strerror(errno));
+    return -1;
+  }
+  wal.failed = 0;
+  return 0;
+}
+
+static int buffer_reserve(WalBuffer *buffer, size_t size) {
+  if (buffer->size + size <= buffer->capacity) return 0;
+  size_t capacity = buffer->capacity ? buffer->capacity : 4096;
+  while (capacity < buffer->size + size) capacity *= 2;
+  char *data = realloc(buffer->data, capacity);
+  if (!data) return -1;
+  buffer->data = data;
+  buffer->capacity = capacity;
+  return 0;
+}
+
+static uint64_t record_checksum(const char *table, const InsertValue *values,
+                                size_t num_values) {
+  return checksum64(table, MAX_SIZE_NAME) ^
+         checksum64(values, sizeof(InsertValue) * num_values);
+}
+
+// Appends `head` then `tail` as one record; returns its LSN, or 0 if it was not appended
+static uint64_t append_record(const void *head, size_t head_size, const void *tail,
+                              size_t tail_size) {
+  pthread_mutex_lock(&wal.lock);
+  uint64_t lsn = 0;
+  if ((wal.fd >= 0 || open_log(1) == 0) &&
+      buffer_reserve(&wal.pending, head_size + tail_size) == 0) {
+    memcpy(wal.pending.data + wal.pending.size, head, head_size);
+    if (tail_size > 0) {
+      memcpy(wal.pending.data + wal.pending.size + head_size, tail, tail_size);
+    }
+    wal.pending.size += head_size + tail_size;
+    wal.appended += head_size + tail_size;
+    lsn = wal.appended;
+  }
+  pthread_mutex_unlock(&wal.lock);
+  return lsn;
+}
+
+uint64_t wal_log_insert(const Table *table, const InsertValue *values, size_t row) {
+  WalRecordHeader header = {.magic = WAL_RECORD_MAGIC,
+                            .num_values = (uint32_t)table->num_cols,
+                            .row = row};
+  snprintf(header.table, sizeof(header.table), "%s", table->name);
+  header.checksum = record_checksum(header.table, values, table->num_cols);
+  return append_record(&header, sizeof(header), values,
+                       sizeof(InsertValue) * table->num_cols);
+}
+
+static uint64_t create_checksum(const WalCreateRecord *record) {
+  WalCreateRecord copy = *record;
+  copy.checksum = 0;
+  return checksum64(&copy, sizeof(copy));
+}
+
+uint64_t wal_log_create(WalCreateKind kind, const char *table, const char *column,
+                        long param) {
+  WalCreateRecord record;
+  // zeroed whole, padding and name tails included, as the checksum covers them
+  memset(&record, 0, sizeof(record));
+  record.magic = WAL_CREATE_MAGIC;
+  record.kind = (uint32_t)kind;
+  record.param = (uint64_t)param;
+  strncpy(record.table, table, sizeof(record.table) - 1);
+  if (column) strncpy(record.column, column, sizeof(record.column) - 1);
+  record.checksum = create_checksum(&record);
+  return append_record(&record, sizeof(record), NULL, 0);
+}
+
+static int write_all(int fd, const char *data, size_t size) {
+  while (size > 0) {
+    ssize_t written = write(fd, data, size);
+    if (written < 0 && errno == EINTR) continue;
+    if (written <= 0) return -1;
+    data += written;
+    size -= written;
+  }
+  return 0;
+}
+
+int wal_commit(uint64_t lsn) {
+  pthread_mutex_lock(&wal.lock);
+  wal.num_commits++;
+  while (wal.durable < lsn && !wal.failed) {
+    if (wal.syncing) {
+      pthread_cond_wait(&wal.synced, &wal.lock);
+      continue;
+    }
+    // Lead a sync of everything appended so far; what is appended while it runs waits
+    // for the next one
+    wal.syncing = 1;
+    WalBuffer batch = wal.pending;
+    wal.pending = wal.spare;
+    wal.pending.size = 0;
+    wal.spare = (WalBuffer){0};
+    uint64_t target = wal.appended;
+    int fd = wal.fd;
+    pthread_mutex_unlock(&wal.lock);
+
+    int status = write_all(fd, batch.data, batch.size);
+    if (status == 0) status = fdatasync(fd);
+
+    pthread_mutex_lock(&wal.lock);
+    batch.size = 0;
+    wal.spare = batch;
+    if (status == 0) {
+      wal.durable = target;
+    } else {
+      log_err("wal_commit: failed to write the log: %s\n", strerror(errno));
+      wal.failed = 1;
+    }
+    wal.num_syncs++;
+    wal.syncing = 0;
+    pthread_cond_broadcast(&wal.synced);
+  }
+  int status = wal.durable >= lsn ? 0 : -1;
+  pthread_mutex_unlock(&wal.lock);
+  return status;
+}
+
+static Table *find_table(const char *name) {
+  for (size_t i = 0; i < current_db->tables_size; i++) {
+    if (strncmp(current_db->tables[i].name, name, MAX_SIZE_NAME) == 0) {
+      return &current_db->tables[i];
+    }
+  }
+  return NULL;
+}
+
+/**
+ * @brief Applies one record to the catalog. A row the catalog already counts is
+ * skipped, so replaying a log twice is harmless.
+ *
+ * @return 1 if applied, 0 if skipped, -1 if the record does not fit the catalog
+ */
+static int replay_record(const WalRecordHeader *header, const InsertValue *values) {
+  Table *table = find_table(header->table);
+  if (!table || table->num_cols == 0 || table->num_cols != header->num_values) {
+    log_err("wal_recover: insert into unknown table %s\n", header->table);
+    return -1;
+  }
+  size_t num_rows = table->columns[0].num_elements;
+  if (header->row < num_rows) return 0;
+  if (header->row > num_rows) {
+    log_err("wal_recover: row %lu of %s follows a missing row %zu\n",
+            (unsigned long)header->row, table->name, num_rows);
+    return -1;
+  }
+  return insert_row(table, values) == 0 ? 1 : -1;
+}
+
+/**
+ * @brief Applies one logged create to the catalog. What the catalog already holds is
+ * skipped, as for inserts.
+ *
+ * @return 1 if applied, 0 if skipped, -1 if the record does not fit the catalog
+ */
+static int replay_create(const WalCreateRecord *record) {
+  Status status;
+  Table *table = find_table(record->table);
+  if (record->kind == WAL_CREATE_TABLE) {
+    if (table) return 0;
+    create_table(current_db, record->table, (size_t)record->param, &status);
+    return status.code == OK ? 1 : -1;
+  }
+  if (!table) {
+    log_err("wal_recover: create in unknown table %s\n", record->table);
+    return -1;
+  }
+  Column *col = NULL;
+  for (size_t i = 0; i < table->num_cols; i++) {
+    if (strncmp(table->columns[i].name, record->column, MAX_SIZE_NAME) == 0) {
+      col = &table->columns[i];
+    }
+  }
+  if (record->kind == WAL_CREATE_COLUMN) {
+    if (col) return 0;
+    char name[MAX_SIZE_NAME];
+    memcpy(name, record->column, sizeof(name));
+    col = create_column(table, name, (DataType)(record->param & ~WAL_COLUMN_ENCODED),
+                        false, &status);
+    if (status.code != OK) return -1;
+    col->encode = (record->param & WAL_COLUMN_ENCODED) != 0;
+    return 1;
+  }
+  if (record->kind != WAL_CREATE_INDEX || !col) {
+    log_err("wal_recover: create of unknown column %s.%s\n", record->table,
+            record->column);
+    return -1;
+  }
+  if (col->index) return 0;
+  // the column is empty until a load, which builds the index itself
+  col->index = create_column_index((IndexType)record->param);
+  col->root = NULL;
+  return col->index ? 1 : -1;
+}
+
+long wal_recover(void) {
+  char path[MAX_PATH_LEN];
+  wal_file_path(path);
+  int fd = open(path, O_RDWR);
+  if (fd < 0) return 0;  // nothing logged since the catalog was written
+
+  struct stat st;
+  char *log = NULL;
+  size_t size = 0;
+  if (fstat(fd, &st) == 0) {
+    size = st.st_size;
+    log = malloc(size ? size : 1);
+  }
+  if (!log || (size_t)pread(fd, log, size, 0) != size) {
+    log_err("wal_recover: failed to read %s\n", path);
+    free(log);
+    close(fd);
+    return -1;
+  }
+
+  long replayed = 0;
+  size_t skipped = 0;
+  size_t offset = 0;
+  while (offset + sizeof(uint32_t) <= size) {
+    uint32_t magic;
+    memcpy(&magic, log + offset, sizeof(magic));
+    if (magic == WAL_CREATE_MAGIC) {
+      WalCreateRecord record;
+      if (offset + sizeof(record) > size) break;
+      memcpy(&record, log + offset, sizeof(record));
+      if (create_checksum(&record) != record.checksum) break;
+      int applied = replay_create(&record);
+      if (applied < 0) {
+        skipped++;
+      } else {
+        replayed += applied;
+      }
+      offset += sizeof(record);
+      continue;
+    }
+    if (offset + sizeof(WalRecordHeader) > size) break;
+    WalRecordHeader header;
+    memcpy(&header, log + offset, sizeof(header));
+    size_t values_size = sizeof(InsertValue) * header.num_values;
+    if (header.magic != WAL_RECORD_MAGIC ||
+        offset + sizeof(header) + values_size > size) {
+      break;
+    }
+    // copied out, as the records are only 8-byte aligned by chance
+    InsertValue *values = malloc(values_size ? values_size : 1);
+    if (!values) break;
+    memcpy(values, log + offset + sizeof(header), values_size);
+    if (record_checksum(header.table, values, header.num_values) != header.checksum) {
+      free(values);
+      break;
+    }
+    // A record that does not fit the catalog is skipped rather than cut off with the
+    // acknowledged records after it
+    int applied = replay_record(&header, values);
+    free(values);
+    if (applied < 0) {
+      skipped++;
+    } else {
+      replayed += applied;
+    }
+    offset += sizeof(header) + values_size;
+  }
+  if (offset < size) {
+    // A record cut short by a crash: drop it and whatever follows, so new records
+    // follow the last whole one
+    log_err("wal_recover: discarding %zu bytes at the end of %s\n", size - offset, path);
+    if (ftruncate(fd, offset) != 0) {
+      log_err("wal_recover: failed to truncate %s: %s\n", path, strerror(errno));
+    }
+  }
+  free(log);
+  close(fd);
+
+  pthread_mutex_lock(&wal.lock);
+  if (wal.fd < 0) open_log(0);
+  pthread_mutex_unlock(&wal.lock);
+  if (skipped > 0) {
+    log_err("wal_recover: skipped %zu records that do not fit the catalog\n", skipped);
+  }
+  log_info("wal_recover: replayed %ld records from %s\n", replayed, path);
+  return replayed;
+}
+
+void wal_checkpoint(void) {
+  pthread_mutex_lock(&wal.lock);
+  while (wal.syncing) pthread_cond_wait(&wal.synced, &wal.lock);
+  if (wal.fd >= 0) {
+    // What is still pending is in the catalog now too
+    wal.pending.size = 0;
+    wal.durable = wal.appended;
+    if (ftruncate(wal.fd, 0) != 0 || fdatasync(wal.fd) != 0) {
+      log_err("wal_checkpoint: failed to empty the log: %s\n", strerror(errno));
+    } else {
+      // a write or sync that failed before lost nothing the catalog does not hold now
+      wal.failed = 0;
+    }
+    pthread_cond_broadcast(&wal.synced);
+  }
+  pthread_mutex_unlock(&wal.lock);
+}
+
+void wal_close(void) {
+  pthread_mutex_lock(&wal.lock);
+  while (wal.syncing) pthread_cond_wait(&wal.synced, &wal.lock);
+  if (wal.fd >= 0) {
+    close(wal.fd);
+    wal.fd = -1;
+    log_info("wal: %zu records made durable in %zu syncs\n", wal.num_commits,
+             wal.num_syncs);
+  }
+  // Records never written belong to the database being closed
+  wal.pending.size = 0;
+  wal.durable = wal.appended;
+  pthread_cond_broadcast(&wal.synced);
+  pthread_mutex_unlock(&wal.lock);
+}
@@ -0,0 +1,127 @@
+#include "zone_map.h"
+
+#include <limits.h>
+
+#include "column_encoding.h"
+#include "utils.h"
+
+static int zone_map_reserve(ZoneMap *zones, size_t num_zones) {
+  if (num_zones <= zones->capacity) return 0;
+  size_t capacity = zones->capacity ? zones->capacity : 16;
+  while (capacity < num_zones) capacity *= 2;
+  int *mins = realloc(zones->mins, sizeof(int) * capacity);
+  if (!mins) return -1;
+  zones->mins = mins;
+  int *maxs = realloc(zones->maxs, sizeof(int) * capacity);
+  if (!maxs) return -1;
+  zones->maxs = maxs;
+  zones->capacity = capacity;
+  return 0;
+}
+
+int zone_map_build(Column *col) {
+  zone_map_free(col);
+  size_t n = col->num_elements;
+  if (n == 0 || !col->data || col->data_type != INT) return 0;
+
+  size_t num_zones = num_morsels(n, ZONE_SIZE);
+  if (zone_map_reserve(&col->zones, num_zones) != 0) {
+    log_err("zone_map_build: failed to allocate %zu zones for %s\n", num_zones,
+            col->name);
+    zone_map_free(col);
+    return -1;
+  }
+  const int *data = (const int *)col->data;
+  for (size_t z = 0; z < num_zones; z++) {
+    size_t end = (z + 1) * ZONE_SIZE < n ? (z + 1) * ZONE_SIZE : n;
+    int min_value = INT_MAX, max_value = INT_MIN;
+    for (size_t i = z * ZONE_SIZE; i < end; i++) {
+      if (data[i] < min_value) min_value = data[i];
+      if (data[i] > max_value) max_value = data[i];
+    }
+    col->zones.mins[z] = min_value;
+    col->zones.maxs[z] = max_value;
+  }
+  col->zones.num_zones = num_zones;
+  return 0;
+}
+
+int zone_map_append(Column *col, size_t row, int value) {
+  ZoneMap *zones = &col->zones;
+  size_t z = row / ZONE_SIZE;
+  // Zones only ever describe a prefix of the column; one that was dropped stays off
+  // until the next build
+  if (z > zones->num_zones || (z == zones->num_zones && row % ZONE_SIZE != 0)) return 0;
+
+  if (z == zones->num_zones) {
+    if (zone_map_reserve(zones, z + 1) != 0) {
+      log_err("zone_map_append: out of memory; dropping zones of %s\n", col->name);
+      zone_map_free(col);
+      return -1;
+    }
+    zones->mins[z] = value;
+    zones->maxs[z] = value;
+    zones->num_zones++;
+    return 0;
+  }
+  if (value < zones->mins[z]) zones->mins[z] = value;
+  if (value > zones->maxs[z]) zones->maxs[z] = value;
+  return 0;
+}
+
+void zone_map_free(Column *col) {
+  free(col->zones.mins);
+  free(col->zones.maxs);
+  col->zones = (ZoneMap){0};
+}
+
+// Whether zone `z` may hold a value in [low, high]; zones past the map always may
+static inline bool zone_may_match(const ZoneMap *zones, size_t z, int low, int high) {
+  return z >= zones->num_zones || (zones->maxs[z] >= low && zones->mins[z] <= high);
+}
+
+bool zone_map_may_match(const Column *col, size_t start, size_t end, int low, int high) {
+  if (start >= end) return false;
+  for (size_t z = start / ZONE_SIZE; z <= (end - 1) / ZONE_SIZE; z++) {
+    if (zone_may_match(&col->zones, z, low, high)) return true;
+  }
+  return false;
+}
+
+size_t zone_map_scan(const Column *col, size_t start, size_t end, int low, int high,
+                     int *out) {
+  size_t count = 0;
+  while (start < end) {
+    size_t z = start / ZONE_SIZE;
+    size_t zone_end = (z + 1) * ZONE_SIZE < end ? (z + 1) * ZONE_SIZE : end;
+    if (zone_may_match(&col->zones, z, low, high)) {
+      count += column_scan_range(col, start, zone_end, low, high, out + count);
+    }
+    start = zone_end;
+  }
+  return count;
+}
+
+double estimate_range_rows(long min_value, long max_value, size_t num_rows, int low,
+                           int high) {
+  long lo = low > min_value ? low : min_value;
+  long hi = high < max_value ? high : max_value;
+  if (num_rows == 0 || lo > hi) return 0;
+  return (double)num_rows * (hi - lo + 1) / (max_value - min_value + 1);
+}
+
+double zone_map_estimate(const Column *col, size_t num_rows, int low, int high) {
+  const ZoneMap *zones = &col->zones;
+  double estimate = 0;
+  size_t row = 0;
+  for (size_t z = 0; z < zones->num_zones && row < num_rows; z++) {
+    size_t rows = num_rows - row < ZONE_SIZE ? num_rows - row : ZONE_SIZE;
+    estimate += estimate_range_rows(zones->mins[z], zones->maxs[z], rows, low, high);
+    row += rows;
+  }
+  if (row < num_rows) {
+    estimate +=
+        estimate_range_rows(col->min_value, col->max_value, num_rows - row, low, high);
+  }
+  return estimate;
+}
@@ -244,9 +244,45 @@ char **extract_csv_columns(const char *header, int *num_columns) {
   return columns;
 }
 
+// One value of a loaded column, read as a long until the column turns out to hold
+// doubles
+typedef union CsvValue {
+  long l;
+  double d;
+} CsvValue;
+
+/**
+ * @brief Parses one csv field into `*value`, widening the column's `*type` when the field
+ * does not fit it: an integer out of the range of `int` makes the column LONG, anything
+ * that is not an integer makes it DOUBLE. The values already read are converted when the
+ * column becomes DOUBLE.
+ */
+static void parse_csv_value(const char *token, CsvValue *values, size_t count,
+                            DataType *type, CsvValue *value) {
+  char *end;
+  errno = 0;
+  long l = strtol(token, &end, 10);
+  while (isspace((unsigned char)*end)) end++;
+  if (errno == 0 && end != token && *end == '\0') {
+    if (*type == DOUBLE) {
+      value->d = (double)l;
+      return;
+    }
+    if (*type == INT && (l < INT_MIN || l > INT_MAX)) *type = LONG;
+    value->l = l;
+    return;
+  }
+  if (*type != DOUBLE) {
+    for (size_t i = 0; i < count; i++) values[i].d = (double)values[i].l;
+    *type = DOUBLE;
+  }
+  value->d = strtod(token, NULL);
+}
+
 /**
  * @brief send_column_data
- * Sends column data to the server
+ * Sends column data to the server. Each column is sent in the narrowest of INT, LONG and
+ * DOUBLE that holds all of its values.
  *
  * @param socket
  * @param csv_filename
@@ -269,8 +305,9 @@ int send_column_data(int socket, const char *csv_filename) {
   char **column_names = extract_csv_columns(line, &num_columns);
   //   cs165_log(stdout, "num of columns: %d\n", num_columns);
 
-  int **column_data = malloc(num_columns * sizeof(int *));
+  CsvValue **column_data = malloc(num_columns * sizeof(CsvValue *));
   size_t *column_sizes = calloc(num_columns, sizeof(size_t));
+  DataType *column_types = calloc(num_columns, sizeof(DataType));
 
   // count rows and allocate memory
   size_t num_rows = 0;
@@ -285,7 +322,8 @@ int send_column_data(int socket, const char *csv_filename) {
     metadata[i].min_value = INT_MAX;
     metadata[i].max_value = INT_MIN;
     metadata[i].sum = 0;
-    column_data[i] = malloc(num_rows * sizeof(int));
+    column_types[i] = INT;
+    column_data[i] = malloc(num_rows * sizeof(CsvValue));
   }
 
   // read data and calculate metadata
@@ -300,15 +338,17 @@ int send_column_data(int socket, const char *csv_filename) {
   while ((read = getline(&line, &len, file)) != -1) {
     char *token = strtok(line, ",");
     for (int i = 0; i < num_columns; i++) {
-      int value = atoi(token);
-      column_data[i][column_sizes[i]] = value;
-
-      // Update metadata
-      if (column_sizes[i] == 0 || value < metadata[i].min_value)
-        metadata[i].min_value = value;
-      if (column_sizes[i] == 0 || value > metadata[i].max_value)
-        metadata[i].max_value = value;
-      metadata[i].sum += value;
+      CsvValue *value = &column_data[i][column_sizes[i]];
+      parse_csv_value(token, column_data[i], column_sizes[i], &column_types[i], value);
+
+      // Update metadata; only meaningful while the column holds integers
+      if (column_types[i] != DOUBLE) {
+        if (column_sizes[i] == 0 || value->l < metadata[i].min_value)
+          metadata[i].min_value = value->l;
+        if (column_sizes[i] == 0 || value->l > metadata[i].max_value)
+          metadata[i].max_value = value->l;
+        metadata[i].sum += value->l;
+      }
 
       column_sizes[i]++;
       token = strtok(NULL, ",");
@@ -319,16 +359,28 @@ int send_column_data(int socket, const char *csv_filename) {
   // Send data for each column
   for (int i = 0; i < num_columns; i++) {
     metadata[i].num_elements = column_sizes[i];
+    metadata[i].data_type = column_types[i];
+    if (column_types[i] == DOUBLE) {
+      metadata[i].min_value = metadata[i].max_value = metadata[i].sum = 0;
+    }
     // log_info("Sending column %s\nWith Stats:\n\tmin: %ld\n\tmax: %ld\n\tsum: %ld\n",
     //          metadata[i].name, metadata[i].min_value, metadata[i].max_value,
     //          metadata[i].sum);
 
+    // An int column goes out as ints, compacted in place: the `j`th int is written over
+    // bytes the `j`th value has already been read from
+    if (column_types[i] == INT) {
+      int *ints = (int *)column_data[i];
+      for (size_t j = 0; j < column_sizes[i]; j++) ints[j] = (int)column_data[i][j].l;
+    }
+
     if (send(socket, &metadata[i], sizeof(ColumnMetadata), 0) == -1) {
       log_err("Error sending metadata for column %s with error %s\n", metadata[i].name,
               strerror(errno));
       return -1;
     }
-    if (send(socket, column_data[i], column_sizes[i] * sizeof(int), 0) == -1) {
+    size_t data_size = column_sizes[i] * data_type_size(column_types[i]);
+    if (send(socket, column_data[i], data_size, 0) == -1) {
       log_err("Error sending data for column %s with error %s\n", metadata[i].name,
               strerror(errno));
       return -1;
@@ -348,6 +400,7 @@ int send_column_data(int socket, const char *csv_filename) {
   }
   free(column_data);
   free(column_names);
+  free(column_types);
   free(metadata);
   free(column_sizes);
 
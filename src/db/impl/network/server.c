@@ -33,6 +33,9 @@ SOFTWARE.
  **/
 #include <errno.h>
 #include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
+#include <signal.h>
 #include <stdlib.h>
 #include <string.h>
 #include <sys/mman.h>
@@ -44,36 +47,56 @@ SOFTWARE.
 
 #include "algorithms.h"
 #include "catalog_manager.h"
+#include "checkpoint.h"
 #include "client_context.h"
+#include "column_encoding.h"
 #include "common.h"
 #include "handler.h"
 #include "optimizer.h"
 #include "utils.h"
+#include "zone_map.h"
 
 #define DEFAULT_QUERY_BUFFER_SIZE 1024
 
 int client_id = 0;
 int session_id = 0;
 
+/**
+ * A connected client, served by its own thread. The list lets a shutdown wake the
+ * sessions still blocked in `recv` and wait for them to finish.
+ */
+typedef struct Session {
+  int socket;
+  struct Session *next;
+} Session;
+
+static Session *sessions = NULL;
+static int num_sessions = 0;
+static int is_shutting_down = 0;
+static int wake_pipe[2] = {-1, -1};  // written once to stop the accept loop in main
+static pthread_mutex_t sessions_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t sessions_done = PTHREAD_COND_INITIALIZER;
+
 int receive_columns(int client_socket, message *send_message);
 
 /**
  * handle_client(client_socket)
  * This is the execution routine after a client has connected.
  * It will continually listen for messages from the client and execute queries.
+ * Every session gets its own client context, so handle names never clash.
  **/
-void handle_client(int client_socket, int *shutdown) {
+void handle_client(int client_socket, int *shutdown_requested) {
   int length = 0;
   log_info("Connected to socket: %d.\n", client_socket);
-  session_id++;
 
   // Create two messages, one from which to read and one from which to receive
   message send_message = {.status = OK_WAIT_FOR_RESPONSE, .length = 0, .payload = NULL};
   message recv_message = {.status = OK_WAIT_FOR_RESPONSE, .length = 0, .payload = NULL};
 
   // create the client context here
-  ClientContext *client_context = NULL;
-  client_context = g_client_context;
+  ClientContext *client_context = create_client_context();
+  if (!client_context) return;
+  g_client_context = client_context;
 
   // Continually receive messages from client and execute queries.
   // 1. Parse the command
@@ -87,12 +110,25 @@ void handle_client(int client_socket, int *shutdown) {
       break;
     }
     if (recv_message.status == SERVER_SHUTDOWN) {
-      *shutdown = 1;
+      *shutdown_requested = 1;
       break;
     }
 
-    if (recv_message.status == CSV_TRANSFER)
-      receive_columns(client_socket, &send_message);
+    if (recv_message.status == CSV_TRANSFER) {
+      catalog_write_lock();
+      materialize_pending_handles();  // the load overwrites the base columns
+      // the client reads no payload after a load, so only the status reports it; what
+      // the previous request left there is not this load's
+      send_message.status = OK_DONE;
+      if (receive_columns(client_socket, &send_message) != 0) {
+        send_message.status = EXECUTION_ERROR;
+      } else if (checkpoint_now().code != OK) {
+        // acknowledged once the column files and the catalog counting their rows are on
+        // disk
+        send_message.status = EXECUTION_ERROR;
+      }
+      catalog_unlock();
+    }
 
     if (recv_message.status == INCOMING_QUERY) {
       char recv_buffer[recv_message.length + 1];
@@ -115,9 +151,71 @@ void handle_client(int client_socket, int *shutdown) {
         -1) {
       log_err("Failed to send message.");
     }
+    // the payload may live in the query arena, so only now is its scratch done with;
+    // drop the pointer too so the next request cannot resend it
+    arena_reset(client_context->query_arena);
+    send_message.payload = NULL;
+    send_message.length = 0;
   }
+  free_client_context(client_context);
   log_info("Connection closed at socket %d!\n", client_socket);
-  close(client_socket);
+}
+
+/**
+ * Thread routine of a session. The socket is closed only after the session leaves the
+ * list, so a shutdown never touches a descriptor that was already reused.
+ */
+static void *run_session(void *arg) {
+  Session *session = (Session *)arg;
+  int shutdown_requested = 0;
+  handle_client(session->socket, &shutdown_requested);
+
+  pthread_mutex_lock(&sessions_lock);
+  Session **link = &sessions;
+  while (*link != session) link = &(*link)->next;
+  *link = session->next;
+  num_sessions--;
+  if (shutdown_requested && !is_shutting_down) {
+    is_shutting_down = 1;
+    if (write(wake_pipe[1], "x", 1) != 1) log_err("run_session: failed to wake main\n");
+  }
+  pthread_cond_broadcast(&sessions_done);
+  pthread_mutex_unlock(&sessions_lock);
+
+  close(session->socket);
+  free(session);
+  return NULL;
+}
+
+/**
+ * Registers a new connection and starts its session thread.
+ * Returns 0 on success, else -1 (the caller closes the socket).
+ **/
+static int start_session(int client_socket) {
+  Session *session = malloc(sizeof(Session));
+  if (!session) return -1;
+  session->socket = client_socket;
+
+  pthread_mutex_lock(&sessions_lock);
+  session->next = sessions;
+  sessions = session;
+  num_sessions++;
+  session_id++;
+  pthread_t thread;
+  int status = pthread_create(&thread, NULL, run_session, session);
+  if (status != 0) {
+    sessions = session->next;
+    num_sessions--;
+  }
+  pthread_mutex_unlock(&sessions_lock);
+
+  if (status != 0) {
+    log_err("start_session: failed to create session thread: %s\n", strerror(status));
+    free(session);
+    return -1;
+  }
+  pthread_detach(thread);
+  return 0;
 }
 
 /**
@@ -158,49 +256,93 @@ int setup_server(void) {
     return -1;
   }
 
-  if (listen(server_socket, 5) == -1) {
+  if (listen(server_socket, SOMAXCONN) == -1) {
     log_err("L%d: Failed to listen on socket.\n", __LINE__);
     return -1;
   }
 
-  // after all setup, setup db. TODO: check implications of this on concurrent clients
+  // after all setup, setup db. Sessions only start once it is loaded
   db_startup();
 
   return server_socket;
 }
 
-// Currently this main will setup the socket and accept a single client.
-// After handling the client, it will exit.
-// You WILL need to extend this to handle MULTIPLE concurrent clients
-// and remain running until it receives a shut-down command.
-//
-// Getting Started Hints:
-//      How will you extend main to handle multiple concurrent clients?
-//      Is there a maximum number of concurrent client connections you will
-//      allow? What aspects of siloes or isolation are maintained in your
-//      design? (Think `what` is shared between `whom`?)
+// Accepts clients until one of them sends a shutdown. Each connection is served by its
+// own thread with its own client context (handle namespace); what they share is the
+// catalog, guarded by the catalog reader/writer lock (see db.h), so read queries from
+// different clients run in parallel while creates, loads and inserts run alone.
 int main(void) {
   int server_socket = setup_server();
   if (server_socket < 0) {
     exit(1);
   }
+  // A client hanging up mid-response must end its session, not the whole server
+  signal(SIGPIPE, SIG_IGN);
+  if (pipe(wake_pipe) == -1) {
+    log_err("L%d: Failed to create the wake-up pipe.\n", __LINE__);
+    exit(1);
+  }
 
   log_info("Waiting for a connection %d ...\n", server_socket);
 
   struct sockaddr_un remote;
   socklen_t t = sizeof(remote);
-  int client_socket = 0;
-  int shutdown = 0;
-  while (!shutdown) {
-    if ((client_socket = accept(server_socket, (struct sockaddr *)&remote, &t)) == -1) {
+  struct pollfd fds[2] = {{.fd = server_socket, .events = POLLIN},
+                          {.fd = wake_pipe[0], .events = POLLIN}};
+  while (true) {
+    if (poll(fds, 2, -1) == -1) {
+      if (errno != EINTR) log_err("L%d: poll failed: %s\n", __LINE__, strerror(errno));
+      continue;
+    }
+    if (fds[1].revents) break;  // a session received a shutdown
+    int client_socket = accept(server_socket, (struct sockaddr *)&remote, &t);
+    if (client_socket == -1) {
       log_err("L%d: Failed to accept a new connection.\n", __LINE__);
+      continue;
     }
-    handle_client(client_socket, &shutdown);
+    if (start_session(client_socket) != 0) close(client_socket);
+  }
+
+  // Wake the sessions still waiting for queries and let them finish
+  pthread_mutex_lock(&sessions_lock);
+  for (Session *session = sessions; session; session = session->next) {
+    shutdown(session->socket, SHUT_RDWR);
   }
+  while (num_sessions > 0) pthread_cond_wait(&sessions_done, &sessions_lock);
+  pthread_mutex_unlock(&sessions_lock);
+
+  close(server_socket);
+  close(wake_pipe[0]);
+  close(wake_pipe[1]);
   db_shutdown();
   return 0;
 }
 
+/**
+ * Receives exactly `size` bytes into `buffer`, or into a scratch buffer that is thrown
+ * away when `buffer` is NULL. Returns the number of bytes received.
+ **/
+static size_t recv_column_bytes(int socket, void *buffer, size_t size, const char *name) {
+  char discard[4096];
+  size_t total_received = 0;
+  while (total_received < size) {
+    size_t want = size - total_received;
+    if (!buffer && want > sizeof(discard)) want = sizeof(discard);
+    char *into = buffer ? (char *)buffer + total_received : discard;
+    ssize_t bytes_received = recv(socket, into, want, MSG_WAITALL);
+    if (bytes_received <= 0) {
+      if (bytes_received == 0) {
+        log_err("Connection closed while receiving data for column %s\n", name);
+      } else {
+        log_err("Error receiving data for column %s: %s\n", name, strerror(errno));
+      }
+      break;
+    }
+    total_received += bytes_received;
+  }
+  return total_received;
+}
+
 int receive_columns(int socket, message *send_message) {
   log_info("Server: Receiving column data from client at socket %d\n", socket);
   ColumnMetadata metadata = {0};
@@ -238,14 +380,24 @@ int receive_columns(int socket, message *send_message) {
       log_err("Failed to find table and column for metadata %s\n", metadata.name);
       return -1;
     }
-    col->num_elements = metadata.num_elements;
-    col->min_value = metadata.min_value;
-    col->max_value = metadata.max_value;
-    col->sum = metadata.sum;
-    col->data_type = INT;
+    // The client sends the narrowest type holding the values; the column keeps its
+    // declared type, so the values may be widened but never narrowed
+    DataType sent_type = (DataType)metadata.data_type;
+    size_t sent_size = metadata.num_elements * data_type_size(sent_type);
+    if (sent_type > col->data_type) {
+      log_err("Column %s is %s but the load has %s values\n", metadata.name,
+              data_type_name(col->data_type), data_type_name(sent_type));
+      recv_column_bytes(socket, NULL, sent_size, metadata.name);
+      // the client reads no payload after a load, so only the status reports it
+      send_message->status = EXECUTION_ERROR;
+      continue;
+    }
+
+    // the encoding of an earlier load no longer matches the data
+    column_encoding_free(col);
 
     // Calculate file size
-    size_t file_size = metadata.num_elements * sizeof(int);
+    size_t file_size = metadata.num_elements * data_type_size(col->data_type);
     col->mmap_size = file_size;
 
     // Construct file path
@@ -258,12 +410,18 @@ int receive_columns(int socket, message *send_message) {
       log_err("Failed to open file for column %s: %s\n", metadata.name, strerror(errno));
       return -1;
     }
+    // The earlier load is gone with the truncated file; the rows of this one are only
+    // counted once they all arrived, so a checkpoint never records rows the file lacks
+    col->num_elements = 0;
+    col->min_value = col->max_value = col->sum = 0;
+    zone_map_free(col);
 
     // Extend file to desired size
     if (ftruncate(col->disk_fd, file_size) == -1) {
       log_err("Failed to extend file for column %s: %s\n", metadata.name,
               strerror(errno));
       close(col->disk_fd);
+      col->disk_fd = -1;
       return -1;
     }
 
@@ -274,35 +432,41 @@ int receive_columns(int socket, message *send_message) {
         mmap(NULL, file_size, PROT_READ | PROT_WRITE, MAP_SHARED, col->disk_fd, 0);
     if (col->data == MAP_FAILED) {
       log_err("Failed to mmap file for column %s: %s\n", metadata.name, strerror(errno));
+      col->data = NULL;
+      col->mmap_size = 0;
       close(col->disk_fd);
-      continue;
+      col->disk_fd = -1;
+      return -1;
     }
 
-    // Receive column data
-    size_t total_received = 0;
-    while (total_received < file_size) {
-      bytes_received = recv(socket, (char *)col->data + total_received,
-                            file_size - total_received, MSG_WAITALL);
-      if (bytes_received <= 0) {
-        if (bytes_received == 0) {
-          log_err("Connection closed while receiving data for column %s\n",
-                  metadata.name);
-        } else {
-          log_err("Error receiving data for column %s: %s\n", metadata.name,
-                  strerror(errno));
-        }
-        break;
+    // Receive column data, straight into the file unless it has to be widened
+    void *received = col->data;
+    if (sent_type != col->data_type) {
+      received = malloc(sent_size);
+      if (!received) {
+        log_err("Failed to allocate memory for column %s\n", metadata.name);
+        return -1;
       }
-      total_received += bytes_received;
     }
-
-    if (total_received != file_size) {
+    size_t total_received = recv_column_bytes(socket, received, sent_size, metadata.name);
+    if (total_received != sent_size) {
       log_err("Incomplete data received for column %s: expected %zu bytes, got %zu\n",
-              metadata.name, file_size, total_received);
+              metadata.name, sent_size, total_received);
+      if (received != col->data) free(received);
       return -1;
     }
+    if (received != col->data) {
+      widen_values(received, sent_type, metadata.num_elements, col->data, col->data_type);
+      free(received);
+    }
+    col->num_elements = metadata.num_elements;
+    col->min_value = metadata.min_value;
+    col->max_value = metadata.max_value;
+    col->sum = metadata.sum;
 
     IndexType idx_type = col->index ? col->index->idx_type : NONE;
+    // a cracker column copied before the load no longer matches the data
+    if (idx_type == CRACKING_UNCLUSTERED) free_idx_data(col);
     if (idx_type != NONE) {
       if (!primary_col && (idx_type == SORTED_CLUSTERED || idx_type == BTREE_CLUSTERED)) {
         primary_col = col;
@@ -312,25 +476,28 @@ int receive_columns(int socket, message *send_message) {
         secondary_col = col;
       }
     }
-    col->is_dirty = 0;
-    // NOTE: Differing this for `shutdown`
-    // // Ensure data is written to disk
-    // if (msync(col->data, file_size, MS_SYNC) == -1) {
-    //   log_err("Failed to sync mmap'd file for column %s: %s\n", metadata.name,
-    //           strerror(errno));
-    //   return -1;
-    // }
+    // the checkpoint after the load removes the zone file of the older load
+    zone_map_build(col);
+
+    // synced by the checkpoint that follows the load
+    mark_column_dirty(col, 0);
 
     log_info("Successfully received and stored data for column %s\n", metadata.name);
   }
 
-  if (!primary_col) return 0;
-  create_idx_on(primary_col, send_message);
-  // TODO: debug why this messes up correctness on grading server. particularly,
-  // Benchmark3
-  cluster_idx_on(table, primary_col, send_message);
+  if (primary_col) {
+    create_idx_on(primary_col, send_message);
+    // TODO: debug why this messes up correctness on grading server. particularly,
+    // Benchmark3
+    cluster_idx_on(table, primary_col, send_message);
+    // Clustering reorders every column, so the zones built above are rebuilt
+    for (size_t i = 0; i < table->num_cols; i++) zone_map_build(&table->columns[i]);
+
+    if (secondary_col) create_idx_on(secondary_col, send_message);
+  }
 
-  if (secondary_col) create_idx_on(secondary_col, send_message);
+  // Encode from the min and max sent with each column, once the rows are in place
+  for (size_t i = 0; table && i < table->num_cols; i++) column_encode(&table->columns[i]);
 
   return 0;
 }
@@ -0,0 +1,480 @@
+/**
+ * batch.c
+ *
+ * Runs the queries queued between `batch_queries()` and `batch_execute()`. A queued
+ * query is kept as text and parsed only when it runs, since the handles it reads are
+ * created by queries earlier in the batch.
+ *
+ * The handles every query reads and writes order the batch into waves, a dependency
+ * DAG cut into levels: a query runs in the first wave after every earlier query that
+ * writes a handle it reads or writes, or reads a handle it writes. So the queries of
+ * one wave are independent, and within a wave
+ *
+ *  - selects over a column that another select of the wave also reads become one
+ *    shared scan per column (see exec_batch_select), or, if the column's index
+ *    answers them, one batch of index lookups (see exec_batch_index_select);
+ *  - the other queries run as concurrent tasks on the thread pool. Queries that read
+ *    the same handle share a task and run one after the other, so only one of them
+ *    evaluates a pending input, e.g. the aggregates of a pending fetch share its fused
+ *    pass (see pipeline.h).
+ */
+#define _DEFAULT_SOURCE  // strsep, strdup
+#include <ctype.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "client_context.h"
+#include "handler.h"
+#include "parse.h"
+#include "query_exec.h"
+#include "str_map.h"
+#include "utils.h"
+
+#define BATCH_MAX_READS 4   // a join reads two value and two position vectors
+#define BATCH_MAX_WRITES 2  // a join writes two handles
+
+typedef struct BatchQuery {
+  char *text;   // the query; parsed in place when its wave runs
+  char *names;  // a copy of the text, cut into the handle names below
+  char *reads[BATCH_MAX_READS];
+  char *writes[BATCH_MAX_WRITES];
+  size_t num_reads;
+  size_t num_writes;
+  size_t wave;
+  size_t task;      // the task of its wave that runs it
+  DbOperator *dbo;  // while its wave runs
+  message result;
+} BatchQuery;
+
+// The queries of a wave that one task runs, in batch order
+typedef struct {
+  BatchQuery **queries;
+  size_t num_queries;
+  ClientContext *context;
+  Arena *scratch;
+} BatchTask;
+
+// Operators that only read the catalog and write result handles
+static const char *batchable_commands[] = {"select", "fetch", "avg", "sum", "min",
+                                           "max",    "add",   "sub", "join"};
+
+static void free_batch_query(void *ptr) {
+  BatchQuery *bq = (BatchQuery *)ptr;
+  if (!bq) return;
+  db_operator_free(bq->dbo);
+  free(bq->text);
+  free(bq->names);
+  free(bq);
+}
+
+// Handles are plain names: catalog columns have dots, and bounds are numbers or null
+static int is_handle_name(const char *token) {
+  return isalpha((unsigned char)token[0]) && !strchr(token, '.') &&
+         strcmp(token, "null") != 0;
+}
+
+/**
+ * @brief Cuts `bq->names` into the handles the query writes (before the `=`) and reads
+ * (its arguments).
+ *
+ * @return 0, or 1 if the query is not one that can be batched
+ */
+static int find_handle_names(BatchQuery *bq) {
+  char *command = strchr(bq->names, '=');
+  if (!command) return 1;  // every batchable operator writes a handle
+  *command++ = '\0';
+
+  char *handles = bq->names;
+  char *name;
+  while ((name = strsep(&handles, ",")) != NULL) {
+    name = trim_whitespace(name);
+    if (bq->num_writes == BATCH_MAX_WRITES || !is_handle_name(name)) return 1;
+    bq->writes[bq->num_writes++] = name;
+  }
+
+  command = trim_whitespace(command);
+  size_t num_commands = sizeof(batchable_commands) / sizeof(batchable_commands[0]);
+  size_t c = 0;
+  while (c < num_commands &&
+         strncmp(command, batchable_commands[c], strlen(batchable_commands[c])) != 0) {
+    c++;
+  }
+  char *args = strchr(command, '(');
+  char *end = strrchr(command, ')');
+  if (c == num_commands || !args || !end || end < args) return 1;
+  *end = '\0';
+  args++;
+
+  int is_join = strncmp(command, "join", 4) == 0;
+  char *arg;
+  while ((arg = strsep(&args, ",")) != NULL) {
+    arg = trim_whitespace(arg);
+    if (is_join && !args) break;  // the join algorithm
+    if (!is_handle_name(arg)) continue;
+    if (bq->num_reads == BATCH_MAX_READS) return 1;
+    bq->reads[bq->num_reads++] = arg;
+  }
+  return 0;
+}
+
+int batch_add_query(ClientContext *context, const char *query) {
+  BatchQuery *bq = calloc(1, sizeof(BatchQuery));
+  if (!bq) return -1;
+  bq->text = strdup(query);
+  bq->names = strdup(query);
+  if (!bq->text || !bq->names) {
+    free_batch_query(bq);
+    return -1;
+  }
+
+  int status = find_handle_names(bq);
+  if (status != 0) {
+    free_batch_query(bq);
+    return status;
+  }
+  if (!context->batch_queries) {
+    context->batch_queries = vector_create(free_batch_query);
+    if (!context->batch_queries) {
+      log_err("batch_add_query: failed to create batch queries vector\n");
+      free_batch_query(bq);
+      return -1;
+    }
+  }
+  vector_push_back(context->batch_queries, bq);
+  return 0;
+}
+
+static size_t name_id(StrMap *names, const char *name, size_t *num_names) {
+  size_t id;
+  if (str_map_get(names, name, &id)) return id;
+  id = (*num_names)++;
+  return str_map_put(names, name, id) == 0 ? id : SIZE_MAX;
+}
+
+/**
+ * @brief Puts every query in the first wave after all the queries it depends on.
+ *
+ * @return the number of waves, or 0 if out of memory
+ */
+static size_t assign_waves(BatchQuery **queries, size_t num_queries) {
+  size_t max_names = num_queries * (BATCH_MAX_READS + BATCH_MAX_WRITES);
+  StrMap *names = str_map_create(max_names);
+  // per handle: 1 + the last wave that wrote it, and 1 + the last wave that read it
+  size_t *written = calloc(max_names, sizeof(size_t));
+  size_t *read = calloc(max_names, sizeof(size_t));
+  size_t num_names = 0, num_waves = 0;
+  int ok = names && written && read;
+
+  for (size_t i = 0; ok && i < num_queries; i++) {
+    BatchQuery *bq = queries[i];
+    size_t read_ids[BATCH_MAX_READS], write_ids[BATCH_MAX_WRITES];
+    size_t wave = 0;
+    for (size_t r = 0; r < bq->num_reads; r++) {
+      read_ids[r] = name_id(names, bq->reads[r], &num_names);
+      if (read_ids[r] == SIZE_MAX) ok = 0;
+      if (ok && written[read_ids[r]] > wave) wave = written[read_ids[r]];
+    }
+    for (size_t w = 0; w < bq->num_writes; w++) {
+      write_ids[w] = name_id(names, bq->writes[w], &num_names);
+      if (write_ids[w] == SIZE_MAX) ok = 0;
+      if (ok && written[write_ids[w]] > wave) wave = written[write_ids[w]];
+      if (ok && read[write_ids[w]] > wave) wave = read[write_ids[w]];
+    }
+    if (!ok) break;
+
+    bq->wave = wave;
+    for (size_t r = 0; r < bq->num_reads; r++) {
+      if (read[read_ids[r]] < wave + 1) read[read_ids[r]] = wave + 1;
+    }
+    for (size_t w = 0; w < bq->num_writes; w++) written[write_ids[w]] = wave + 1;
+    if (wave + 1 > num_waves) num_waves = wave + 1;
+  }
+
+  str_map_destroy(names);
+  free(written);
+  free(read);
+  return ok ? num_waves : 0;
+}
+
+static int is_error(message_status status) {
+  return status != OK_DONE && status != OK_WAIT_FOR_RESPONSE;
+}
+
+static void run_batch_task(void *arg) {
+  BatchTask *task = (BatchTask *)arg;
+  // Handles live in the session's context, which pool workers do not have
+  ClientContext *saved_context = g_client_context;
+  g_client_context = task->context;
+  for (size_t i = 0; i < task->num_queries; i++) {
+    BatchQuery *bq = task->queries[i];
+    bq->dbo->scratch = task->scratch;
+    handle_dbOperator(bq->dbo, &bq->result);
+  }
+  g_client_context = saved_context;
+}
+
+// Whether another select of the wave reads the column that query `i` selects from
+static int shares_select_column(BatchQuery **queries, size_t num_queries, size_t i) {
+  Column *col = queries[i]->dbo->operator_fields.select_operator.comparator->col;
+  for (size_t j = 0; j < num_queries; j++) {
+    DbOperator *other = queries[j]->dbo;
+    if (j != i && other && other->type == SELECT &&
+        other->operator_fields.select_operator.comparator->col == col) {
+      return 1;
+    }
+  }
+  return 0;
+}
+
+/**
+ * @brief Runs the selects of a wave whose column another of its selects also reads
+ * together: selects an index answers look up their bounds together, and the others
+ * become shared scans. They are marked done by clearing their operator.
+ */
+static void run_shared_selects(BatchQuery **queries, size_t num_queries,
+                               Arena *scratch) {
+  DbOperator **selects = arena_alloc(scratch, sizeof(DbOperator *) * num_queries, 64);
+  BatchQuery **shared = arena_alloc(scratch, sizeof(BatchQuery *) * num_queries, 64);
+  DbOperator **index_selects =
+      arena_alloc(scratch, sizeof(DbOperator *) * num_queries, 64);
+  BatchQuery **index_shared =
+      arena_alloc(scratch, sizeof(BatchQuery *) * num_queries, 64);
+  if (!selects || !shared || !index_selects || !index_shared) return;  // run separately
+
+  size_t num_shared = 0, num_index_shared = 0;
+  for (size_t i = 0; i < num_queries; i++) {
+    DbOperator *dbo = queries[i]->dbo;
+    if (!dbo || dbo->type != SELECT) continue;
+    SelectOperator *select_op = &dbo->operator_fields.select_operator;
+    Column *col = select_op->comparator->col;
+    // a conjunctive select scans its own columns, and one over a long or double column
+    // runs its own typed kernel
+    if (select_op->predicates || !shares_select_column(queries, num_queries, i)) continue;
+    if (col->data_type != INT) continue;
+    if (select_uses_index(select_op->comparator)) {
+      index_selects[num_index_shared] = dbo;
+      index_shared[num_index_shared++] = queries[i];
+      continue;
+    }
+    // other selects on an indexed column (e.g. cracking) keep their own path, and a
+    // type 2 select over a position bitmap walks the bitmap instead
+    if (col->index && col->index->idx_type != NONE) continue;
+    if (select_op->comparator->ref_bitmap) continue;
+    selects[num_shared] = dbo;
+    shared[num_shared++] = queries[i];
+  }
+
+  if (num_index_shared > 0) {
+    message result = {.status = OK_DONE, .length = 0, .payload = NULL};
+    exec_batch_index_select(index_selects, num_index_shared, &result);
+    for (size_t i = 0; i < num_index_shared; i++) {
+      index_shared[i]->result = result;
+      db_operator_free(index_shared[i]->dbo);
+      index_shared[i]->dbo = NULL;
+    }
+  }
+  if (num_shared == 0) return;
+
+  message result = {.status = OK_DONE, .length = 0, .payload = NULL};
+  exec_batch_select(selects, num_shared, &result);
+  for (size_t i = 0; i < num_shared; i++) {
+    shared[i]->result = result;
+    db_operator_free(shared[i]->dbo);
+    shared[i]->dbo = NULL;
+  }
+}
+
+// Makes sure the session has `num_tasks` task arenas
+static int reserve_task_arenas(ClientContext *context, size_t num_tasks) {
+  if (context->num_task_arenas >= num_tasks) return 0;
+  Arena **arenas = realloc(context->task_arenas, sizeof(Arena *) * num_tasks);
+  if (!arenas) return -1;
+  context->task_arenas = arenas;
+  while (context->num_task_arenas < num_tasks) {
+    Arena *arena = arena_create(QUERY_ARENA_BLOCK_SIZE);
+    if (!arena) return -1;
+    context->task_arenas[context->num_task_arenas++] = arena;
+  }
+  return 0;
+}
+
+static size_t find_root(size_t *parent, size_t i) {
+  while (parent[i] != i) i = parent[i] = parent[parent[i]];
+  return i;
+}
+
+/**
+ * @brief Splits the unfinished queries of a wave into tasks, so that queries reading a
+ * common handle share one, and runs the tasks side by side on the pool.
+ */
+static void run_wave_tasks(BatchQuery **queries, size_t num_queries, DbOperator *batch) {
+  ClientContext *context = batch->context;
+  Arena *scratch = batch->scratch;
+  size_t *parent = arena_alloc(scratch, sizeof(size_t) * num_queries, 64);
+  size_t *task_of_root = arena_alloc(scratch, sizeof(size_t) * num_queries, 64);
+  StrMap *readers = str_map_create(num_queries * BATCH_MAX_READS);
+  size_t max_tasks = context->is_single_core || !g_thread_pool
+                         ? 1
+                         : 2 * threadpool_num_threads(g_thread_pool);
+  if (!parent || !task_of_root || !readers) max_tasks = 1;
+
+  // Union the queries that read a common handle
+  for (size_t i = 0; max_tasks > 1 && i < num_queries; i++) {
+    parent[i] = i;
+    for (size_t r = 0; queries[i]->dbo && r < queries[i]->num_reads; r++) {
+      size_t j;
+      if (!str_map_get(readers, queries[i]->reads[r], &j)) {
+        if (str_map_put(readers, queries[i]->reads[r], i) != 0) max_tasks = 1;
+        continue;
+      }
+      size_t root_i = find_root(parent, i), root_j = find_root(parent, j);
+      parent[root_i < root_j ? root_j : root_i] = root_i < root_j ? root_i : root_j;
+    }
+  }
+  str_map_destroy(readers);
+
+  size_t num_tasks = 0;
+  for (size_t i = 0; i < num_queries; i++) {
+    if (!queries[i]->dbo) continue;
+    if (max_tasks == 1) {
+      queries[i]->task = 0;
+      num_tasks = 1;
+      continue;
+    }
+    size_t root = find_root(parent, i);
+    // the root comes first in batch order, so it has its task already
+    if (root == i) task_of_root[i] = num_tasks++ % max_tasks;
+    queries[i]->task = task_of_root[root];
+  }
+  if (num_tasks > max_tasks) num_tasks = max_tasks;
+  if (num_tasks == 0) return;
+
+  BatchTask *tasks = arena_alloc(scratch, sizeof(BatchTask) * num_tasks, 64);
+  BatchQuery **task_queries =
+      arena_alloc(scratch, sizeof(BatchQuery *) * num_queries, 64);
+  if (!tasks || !task_queries ||
+      (num_tasks > 1 && reserve_task_arenas(context, num_tasks) != 0)) {
+    // run them all here, one after the other
+    BatchTask task = {queries, 0, context, scratch};
+    for (size_t i = 0; i < num_queries; i++) {
+      if (!queries[i]->dbo) continue;
+      task.queries = &queries[i];
+      task.num_queries = 1;
+      run_batch_task(&task);
+    }
+    return;
+  }
+
+  // Lay the tasks' queries out contiguously, each task's in batch order
+  for (size_t t = 0; t < num_tasks; t++) {
+    tasks[t] = (BatchTask){.num_queries = 0,
+                           .context = context,
+                           .scratch = num_tasks > 1 ? context->task_arenas[t] : scratch};
+  }
+  for (size_t i = 0; i < num_queries; i++) {
+    if (queries[i]->dbo) tasks[queries[i]->task].num_queries++;
+  }
+  size_t offset = 0;
+  for (size_t t = 0; t < num_tasks; t++) {
+    tasks[t].queries = task_queries + offset;
+    offset += tasks[t].num_queries;
+    tasks[t].num_queries = 0;
+  }
+  for (size_t i = 0; i < num_queries; i++) {
+    if (!queries[i]->dbo) continue;
+    BatchTask *task = &tasks[queries[i]->task];
+    task->queries[task->num_queries++] = queries[i];
+  }
+
+  if (num_tasks == 1) {
+    run_batch_task(&tasks[0]);
+    return;
+  }
+  TaskGroup group;
+  taskgroup_init(&group);
+  for (size_t t = 0; t < num_tasks; t++) {
+    if (threadpool_submit(g_thread_pool, &group, run_batch_task, &tasks[t]) != 0) {
+      run_batch_task(&tasks[t]);
+    }
+  }
+  threadpool_wait(g_thread_pool, &group);
+  taskgroup_destroy(&group);
+}
+
+// Parses the queries of a wave, now that the handles they read exist, and runs them
+static void run_wave(BatchQuery **queries, size_t num_queries, DbOperator *batch) {
+  for (size_t i = 0; i < num_queries; i++) {
+    BatchQuery *bq = queries[i];
+    bq->dbo = parse_command(bq->text, &bq->result, batch->client_fd, batch->context);
+    if (!bq->dbo && !is_error(bq->result.status)) {
+      handle_error(&bq->result, "Failed to parse batched query");
+    }
+  }
+  run_shared_selects(queries, num_queries, batch->scratch);
+  run_wave_tasks(queries, num_queries, batch);
+  for (size_t i = 0; i < num_queries; i++) {
+    db_operator_free(queries[i]->dbo);
+    queries[i]->dbo = NULL;
+  }
+}
+
+void exec_batch(DbOperator *query, message *send_message) {
+  ClientContext *context = query->context;
+  Vector *batch = context->batch_queries;
+  context->batch_queries = NULL;
+  size_t num_queries = batch ? vector_size(batch) : 0;
+  if (num_queries == 0) {
+    if (batch) vector_destroy(batch);
+    handle_error(send_message, "Empty batch queries");
+    return;
+  }
+
+  Arena *scratch = query->scratch;
+  BatchQuery **queries = arena_alloc(scratch, sizeof(BatchQuery *) * num_queries, 64);
+  BatchQuery **by_wave = arena_alloc(scratch, sizeof(BatchQuery *) * num_queries, 64);
+  size_t num_waves = 0;
+  if (queries && by_wave) {
+    for (size_t i = 0; i < num_queries; i++) queries[i] = vector_get(batch, i);
+    num_waves = assign_waves(queries, num_queries);
+  }
+  size_t *wave_start =
+      num_waves ? arena_alloc(scratch, sizeof(size_t) * (num_waves + 1), 64) : NULL;
+  if (!wave_start) {
+    vector_destroy(batch);
+    handle_error(send_message, "Failed to schedule batch");
+    return;
+  }
+
+  // Order the queries by wave, keeping batch order within a wave: a counting sort
+  // whose cursor for wave w is wave_start[w + 1], which ends up at wave w + 1's start
+  memset(wave_start, 0, sizeof(size_t) * (num_waves + 1));
+  for (size_t i = 0; i < num_queries; i++) {
+    if (queries[i]->wave + 1 < num_waves) wave_start[queries[i]->wave + 2]++;
+  }
+  for (size_t w = 1; w < num_waves; w++) wave_start[w + 1] += wave_start[w];
+  for (size_t i = 0; i < num_queries; i++) {
+    by_wave[wave_start[queries[i]->wave + 1]++] = queries[i];
+  }
+  log_info("exec_batch: %zu queries in %zu waves\n", num_queries, num_waves);
+
+  for (size_t w = 0; w < num_waves; w++) {
+    run_wave(by_wave + wave_start[w], wave_start[w + 1] - wave_start[w], query);
+  }
+
+  // Report the first query that failed, in batch order
+  *send_message = (message){.status = OK_DONE, .length = 0, .payload = NULL};
+  for (size_t i = 0; i < num_queries; i++) {
+    if (is_error(queries[i]->result.status)) {
+      *send_message = queries[i]->result;
+      break;
+    }
+  }
+  if (send_message->status == OK_DONE) {
+    send_message->payload = "Batch completed";
+    send_message->length = strlen(send_message->payload);
+  }
+  vector_destroy(batch);
+  for (size_t t = 0; t < context->num_task_arenas; t++) {
+    arena_reset(context->task_arenas[t]);
+  }
+}
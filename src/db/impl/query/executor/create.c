@@ -3,13 +3,40 @@
 #include <string.h>
 #include <sys/stat.h>  // For mkdir
 
+#include "checkpoint.h"
+#include "optimizer.h"
 #include "query_exec.h"
 #include "utils.h"
+#include "wal.h"
 
 // prototypes
 Status create_db(const char *db_name);
 Table *create_table(Db *db, const char *name, size_t num_columns, Status *status);
-Column *create_column(Table *table, const char *name, bool sorted, Status *status);
+Column *create_column(Table *table, const char *name, DataType data_type, bool sorted,
+                      Status *status);
+
+// The table holding `col`, found by address since a column does not name its table
+static const Table *table_of(const Column *col) {
+  for (size_t i = 0; i < current_db->tables_size; i++) {
+    const Table *table = &current_db->tables[i];
+    if (col >= table->columns && col < table->columns + table->num_cols) return table;
+  }
+  return NULL;
+}
+
+/**
+ * @brief Logs a create that was just applied, for the session to commit once it lets go
+ * of the catalog. If it cannot be logged, the catalog is written out instead, which
+ * holds everything the log would have.
+ *
+ * @return 0 if the create is logged or on disk, -1 otherwise
+ */
+static int log_create(DbOperator *query, WalCreateKind kind, const char *table,
+                      const char *column, long param) {
+  query->context->wal_lsn = wal_log_create(kind, table, column, param);
+  if (query->context->wal_lsn != 0) return 0;
+  return checkpoint_now().code == OK ? 0 : -1;
+}
 
 /**
  * @brief Executes a create query. This can be a
@@ -27,14 +54,26 @@ void exec_create(DbOperator *query, message *send_message) {
     Column *col = query->operator_fields.create_index_operator.col;
     IndexType idx_type = query->operator_fields.create_index_operator.idx_type;
 
+    // the cracker column only holds ints
+    if (idx_type == CRACKING_UNCLUSTERED && col->data_type != INT) {
+      handle_error(send_message, "A cracking index needs an int column");
+      return;
+    }
     cs165_log(stdout, "exec_create: Creating index on column %s\n", col->name);
-    col->index = malloc(sizeof(ColumnIndex));
-    col->index->idx_type = idx_type;
-
-    // Set these to NULL since all create_idx queries are before data is loaded
+    // The index starts empty since all create_idx queries are before data is loaded
     // The actual index is made on during `load`
-    col->index->sorted_data = NULL;
-    col->index->positions = NULL;
+    col->index = create_column_index(idx_type);
+    if (!col->index) {
+      handle_error(send_message, "Failed to allocate column index");
+      return;
+    }
+    col->root = NULL;
+    // an index on a session's handle lasts only as long as the session
+    const Table *table = table_of(col);
+    if (table && log_create(query, WAL_CREATE_INDEX, table->name, col->name,
+                            (long)idx_type) != 0) {
+      handle_error(send_message, "Failed to make index durable");
+    }
     return;
   }
 
@@ -50,24 +89,36 @@ void exec_create(DbOperator *query, message *send_message) {
 
   if (create_type == _TABLE) {
     Status create_status;
-    create_table(query->operator_fields.create_operator.db,
-                 query->operator_fields.create_operator.name,
-                 query->operator_fields.create_operator.col_count, &create_status);
+    Table *table = create_table(query->operator_fields.create_operator.db,
+                                query->operator_fields.create_operator.name,
+                                query->operator_fields.create_operator.col_count,
+                                &create_status);
     if (create_status.code != OK) {
       log_err("L%d: in execute_DbOperator: %s\n", __LINE__, create_status.error_message);
       res_msg = "Table creation failed.";
+    } else if (log_create(query, WAL_CREATE_TABLE, table->name, NULL,
+                          (long)table->col_capacity) != 0) {
+      res_msg = "Table created but could not be made durable.";
     } else {
       res_msg = "-- Table created.";
     }
   }
   if (create_type == _COLUMN) {
     Status status;
-    create_column(query->operator_fields.create_operator.table,
-                  query->operator_fields.create_operator.name, false, &status);
-    if (status.code == OK) {
-      res_msg = "-- Column created.";
-    } else {
+    Table *table = query->operator_fields.create_operator.table;
+    Column *col = create_column(table, query->operator_fields.create_operator.name,
+                                query->operator_fields.create_operator.data_type, false,
+                                &status);
+    if (status.code != OK) {
       res_msg = "Column creation failed.";
+    } else {
+      col->encode = query->operator_fields.create_operator.encoded;
+      long param = col->data_type | (col->encode ? WAL_COLUMN_ENCODED : 0);
+      if (log_create(query, WAL_CREATE_COLUMN, table->name, col->name, param) != 0) {
+        res_msg = "Column created but could not be made durable.";
+      } else {
+        res_msg = "-- Column created.";
+      }
     }
   }
 
@@ -92,6 +143,7 @@ Status create_db(const char *db_name) {
   // Remove any of databases in STORAGE_PATH, if any. Since we will only be working with
   // one database at a time.
   DIR *dir = opendir(STORAGE_PATH);
+  wal_close();  // the log of the database being replaced goes with it
   if (dir) {
     // close this dir and rm -r STORAGE_PATH
     closedir(dir);
@@ -194,7 +246,8 @@ Table *create_table(Db *db, const char *name, size_t num_columns, Status *status
   return new_table;
 }
 
-Column *create_column(Table *table, const char *name, bool sorted, Status *ret_status) {
+Column *create_column(Table *table, const char *name, DataType data_type, bool sorted,
+                      Status *ret_status) {
   (void)sorted;
   cs165_log(stdout, "Creating column %s in table %s\n", name, table->name);
 
@@ -214,16 +267,19 @@ Column *create_column(Table *table, const char *name, bool sorted, Status *ret_s
   // Initialize the new column
   Column *new_column = &table->columns[table->num_cols];
   strncpy(new_column->name, name, MAX_SIZE_NAME);
+  new_column->data_type = data_type;
   new_column->data = NULL;
   new_column->num_elements = 0;
   new_column->min_value = 0;
   new_column->max_value = 0;
   new_column->mmap_size = 0;
   new_column->disk_fd = -1;
+  new_column->encode = 0;
   new_column->index = NULL;
+  new_column->root = NULL;
 
   table->num_cols++;
-  log_info("Column %s created successfully\n", name);
+  log_info("Column %s (%s) created successfully\n", name, data_type_name(data_type));
   *ret_status = (Status){OK, "-- Column created successfully"};
   return new_column;
 }
@@ -1,20 +1,160 @@
+#include <limits.h>
 #include <string.h>
 
+#include "bitpack.h"
 #include "client_context.h"
+#include "column_encoding.h"
+#include "pipeline.h"
+#include "positions.h"
 #include "query_exec.h"
+#include "typed_kernels.h"
 #include "utils.h"
 
+#define FETCH_BLOCK_SIZE 1024  // rows of a bitmap fetched at a time; 4KB of values
+
+// Shared by all morsel tasks of one fetch; partial stats are kept per morsel
+typedef struct {
+  const int *positions;
+  const Bitmap *bitmap;  // instead of `positions`, for a select kept as a bitmap
+  const size_t *ranks;   // see positions_morsel_ranks
+  const int *values;
+  const PackedInts *packed;  // decoded instead of `values` when the column is encoded
+  int *result;
+  long *morsel_mins;
+  long *morsel_maxs;
+  int64_t *morsel_sums;
+} FetchMorselArgs;
+
+// Gathers the values of one morsel of positions and its min, max and sum
+static void fetch_morsel(size_t start_idx, size_t end_idx, void *args) {
+  FetchMorselArgs *fetch_args = (FetchMorselArgs *)args;
+  const int *positions = fetch_args->positions;
+  const int *values = fetch_args->values;
+  const PackedInts *packed = fetch_args->packed;
+  int *result = fetch_args->result;
+
+  long min_value = packed ? packed_get(packed, positions[start_idx])
+                          : values[positions[start_idx]];
+  long max_value = min_value;
+  int64_t sum = 0;
+  if (packed) {
+    // only the fetched rows of an encoded column are decoded
+    for (size_t i = start_idx; i < end_idx; i++) {
+      int value = packed_get(packed, positions[i]);
+      result[i] = value;
+      sum += value;
+      if (value < min_value) min_value = value;
+      if (value > max_value) max_value = value;
+    }
+  } else {
+    for (size_t i = start_idx; i < end_idx; i++) {
+      int value = values[positions[i]];
+      result[i] = value;
+      sum += value;
+      if (value < min_value) min_value = value;
+      if (value > max_value) max_value = value;
+    }
+  }
+
+  size_t m = start_idx / MORSEL_SIZE;
+  fetch_args->morsel_mins[m] = min_value;
+  fetch_args->morsel_maxs[m] = max_value;
+  fetch_args->morsel_sums[m] = sum;
+}
+
+/**
+ * @brief Gathers the values of the set bits in one morsel of rows of a position bitmap.
+ * The column is read front to back, one L1-sized block of rows at a time, and the
+ * statistics are taken from the block's values while they are still in L1.
+ */
+static void fetch_bitmap_morsel(size_t start_idx, size_t end_idx, void *args) {
+  FetchMorselArgs *fetch_args = (FetchMorselArgs *)args;
+  size_t m = start_idx / MORSEL_SIZE;
+  int *result = fetch_args->result + fetch_args->ranks[m];
+
+  // a morsel without set bits must not affect the min and max
+  long min_value = LONG_MAX, max_value = LONG_MIN;
+  int64_t sum = 0;
+  for (size_t block = start_idx; block < end_idx; block += FETCH_BLOCK_SIZE) {
+    size_t block_end =
+        end_idx - block < FETCH_BLOCK_SIZE ? end_idx : block + FETCH_BLOCK_SIZE;
+    size_t n;
+    if (fetch_args->packed) {
+      // blocks start on word boundaries, so the block's words are a bitmap of their own
+      int decoded[FETCH_BLOCK_SIZE];
+      Bitmap words = {.words = fetch_args->bitmap->words + block / 64,
+                      .num_bits = block_end - block};
+      packed_decode(fetch_args->packed, block, block_end, decoded);
+      n = bitmap_gather(&words, 0, block_end - block, decoded, result);
+    } else {
+      n = bitmap_gather(fetch_args->bitmap, block, block_end, fetch_args->values, result);
+    }
+    for (size_t i = 0; i < n; i++) {
+      sum += result[i];
+      if (result[i] < min_value) min_value = result[i];
+      if (result[i] > max_value) max_value = result[i];
+    }
+    result += n;
+  }
+  fetch_args->morsel_mins[m] = min_value;
+  fetch_args->morsel_maxs[m] = max_value;
+  fetch_args->morsel_sums[m] = sum;
+}
+
+/**
+ * @brief Extends a pending select into a pending fetch, so a following aggregate can run
+ * select, fetch and aggregate as one pass (see pipeline.h).
+ */
+static void defer_fetch(const PendingResult *select, FetchOperator *fetch_op,
+                        message *send_message) {
+  // copy before creating the handle, which may move the handle table
+  PendingResult *pending = malloc(sizeof(PendingResult));
+  if (!pending) {
+    handle_error(send_message, "Failed to allocate pending fetch\n");
+    return;
+  }
+  *pending = *select;
+  pending->fetch_col = fetch_op->col;
+  pending->has_stats = 0;
+
+  Column *fetch_result;
+  if (create_new_handle(fetch_op->fetch_handle, &fetch_result) != 0) {
+    free(pending);
+    handle_error(send_message, "Failed to create new handle\n");
+    log_err("L%d in exec_fetch: %s\n", __LINE__, send_message->payload);
+    return;
+  }
+  fetch_result->data_type = fetch_op->col->data_type;
+  fetch_result->pending = pending;
+  cs165_log(stdout, "exec_fetch: deferred fetch from %s\n", fetch_op->col->name);
+  send_message->status = OK_DONE;
+  send_message->payload = "Done";
+  send_message->length = strlen(send_message->payload);
+}
+
 void exec_fetch(DbOperator *query, message *send_message) {
   cs165_log(stdout, "Executing fetch query.\n");
   FetchOperator *fetch_op = &query->operator_fields.fetch_operator;
 
-  // Get the Result from the select handle
-  Column *positions = get_handle(fetch_op->select_handle);
+  // Get the Result from the select handle; a pending select stays pending
+  Column *positions = get_pending_handle(fetch_op->select_handle);
   if (!positions) {
     handle_error(send_message, "Invalid select handle\n");
     log_err("L%d in exec_fetch: %s\n", __LINE__, send_message->payload);
     return;
   }
+  if (positions->pending && !positions->pending->fetch_col && fetch_op->col &&
+      fetch_op->col->data_type == INT) {
+    defer_fetch(positions->pending, fetch_op, send_message);
+    return;
+  }
+  if (positions->pending &&
+      pipeline_materialize(positions, query->context->is_single_core,
+                           query->scratch) != 0) {
+    handle_error(send_message, "Failed to materialize select handle\n");
+    log_err("L%d in exec_fetch: %s\n", __LINE__, send_message->payload);
+    return;
+  }
   cs165_log(stdout, "exec_fetch: positions: %s\n", fetch_op->select_handle);
 
   // Get the Column to fetch from
@@ -36,14 +176,9 @@ void exec_fetch(DbOperator *query, message *send_message) {
   fetch_result->data_type = fetch_col->data_type;
   fetch_result->num_elements = positions->num_elements;
 
-  // get the size of a single element in the column
-  if (fetch_col->data_type == INT) {
-    fetch_result->data = malloc(fetch_result->num_elements * sizeof(int));
-  } else {
-    handle_error(send_message, "Fetching from non-integer column not supported\n");
-    log_err("L%d in exec_fetch: %s\n", __LINE__, send_message->payload);
-    return;
-  }
+  // Keep at least one slot so an empty fetch still owns its buffer
+  size_t capacity = fetch_result->num_elements ? fetch_result->num_elements : 1;
+  fetch_result->data = malloc(data_type_size(fetch_col->data_type) * capacity);
 
   if (!fetch_result->data) {
     handle_error(send_message, "Failed to allocate memory for result data\n");
@@ -58,6 +193,29 @@ void exec_fetch(DbOperator *query, message *send_message) {
     return;
   }
 
+  // A long or double column is gathered on this thread without statistics; aggregates
+  // over the result compute their own (see exec_aggr)
+  if (fetch_col->data_type != INT) {
+    const int *list =
+        positions_list(positions, query->context->is_single_core, query->scratch);
+    if (!list) {
+      handle_error(send_message, "Failed to decode select handle\n");
+      log_err("L%d in exec_fetch: %s\n", __LINE__, send_message->payload);
+      return;
+    }
+    if (fetch_col->data_type == LONG) {
+      typed_gather_long(fetch_col->data, list, positions->num_elements,
+                        fetch_result->data);
+    } else {
+      typed_gather_double(fetch_col->data, list, positions->num_elements,
+                          fetch_result->data);
+    }
+    send_message->status = OK_DONE;
+    send_message->payload = "Done";
+    send_message->length = strlen(send_message->payload);
+    return;
+  }
+
   //    Fetching the values
   //    -----------
 
@@ -68,22 +226,79 @@ void exec_fetch(DbOperator *query, message *send_message) {
   fetch_result->sum = 0;
 
   log_info("exec_fetch: fetching from col %s\n", fetch_col->name);
-  for (size_t i = 0; i < positions->num_elements; i++) {
-    size_t index = ((int *)positions->data)[i];
-    //   TODO: consider alternative implementation for fetching values, while updating
-    //   stats. How can we optimize with batching, SIMD, etc?
-    int value = ((int *)fetch_col->data)[index];
-    cs165_log(stdout, "index= %zu, val= %d ", index, ((int *)fetch_col->data)[index]);
-    ((int *)fetch_result->data)[i] = value;
-
-    fetch_result->sum += value;
-    if (value < fetch_result->min_value) {
-      fetch_result->min_value = value;
+  // Row ranges are copied whole, and aggregated a run at a time when the column has runs
+  if (positions->ranges) {
+    const PositionRanges *ranges = positions->ranges;
+    int *result = (int *)fetch_result->data;
+    for (size_t r = 0; r < ranges->num_ranges; r++) {
+      column_decode(fetch_col, ranges->starts[r], ranges->ends[r], result);
+      column_range_stats(fetch_col, ranges->starts[r], ranges->ends[r],
+                         &fetch_result->sum, &fetch_result->min_value,
+                         &fetch_result->max_value);
+      result += ranges->ends[r] - ranges->starts[r];
+    }
+    send_message->status = OK_DONE;
+    send_message->payload = "Done";
+    send_message->length = strlen(send_message->payload);
+    return;
+  }
+  // Large fetches gather in morsels on the thread pool; small ones stay on this thread.
+  // Through a bitmap, the morsels are of rows rather than of positions.
+  size_t n_items =
+      positions->bitmap ? positions->bitmap->num_bits : positions->num_elements;
+  ThreadPool *pool =
+      n_items >= NUM_ELEMENTS_TO_MULTITHREAD && !query->context->is_single_core
+          ? g_thread_pool
+          : NULL;
+  size_t n_morsels = num_morsels(n_items, MORSEL_SIZE);
+  long *morsel_mins = malloc(sizeof(long) * n_morsels);
+  long *morsel_maxs = malloc(sizeof(long) * n_morsels);
+  int64_t *morsel_sums = malloc(sizeof(int64_t) * n_morsels);
+  if (!morsel_mins || !morsel_maxs || !morsel_sums) {
+    free(morsel_mins);
+    free(morsel_maxs);
+    free(morsel_sums);
+    handle_error(send_message, "Failed to allocate memory for fetch statistics\n");
+    log_err("L%d in exec_fetch: %s\n", __LINE__, send_message->payload);
+    return;
+  }
+
+  FetchMorselArgs args = {
+      .positions = (int *)positions->data,
+      .bitmap = positions->bitmap,
+      .ranks = positions->bitmap
+                   ? positions_morsel_ranks(positions->bitmap, query->scratch)
+                   : NULL,
+      .values = (int *)fetch_col->data,
+      .packed = fetch_col->packed,
+      .result = (int *)fetch_result->data,
+      .morsel_mins = morsel_mins,
+      .morsel_maxs = morsel_maxs,
+      .morsel_sums = morsel_sums,
+  };
+  if (args.bitmap && !args.ranks) {
+    free(morsel_mins);
+    free(morsel_maxs);
+    free(morsel_sums);
+    handle_error(send_message, "Failed to allocate memory for fetch statistics\n");
+    log_err("L%d in exec_fetch: %s\n", __LINE__, send_message->payload);
+    return;
+  }
+  threadpool_parallel_for(pool, n_items, MORSEL_SIZE,
+                          args.bitmap ? fetch_bitmap_morsel : fetch_morsel, &args);
+
+  for (size_t m = 0; m < n_morsels; m++) {
+    fetch_result->sum += morsel_sums[m];
+    if (morsel_mins[m] < fetch_result->min_value) {
+      fetch_result->min_value = morsel_mins[m];
     }
-    if (value > fetch_result->max_value) {
-      fetch_result->max_value = value;
+    if (morsel_maxs[m] > fetch_result->max_value) {
+      fetch_result->max_value = morsel_maxs[m];
     }
   }
+  free(morsel_mins);
+  free(morsel_maxs);
+  free(morsel_sums);
 
   log_info("Fetch operation completed successfully.\n");
   send_message->status = OK_DONE;
@@ -5,18 +5,26 @@
 #include <sys/mman.h>  // for mremap
 #include <unistd.h>    // for sysconf
 
+#include "catalog_manager.h"
+#include "column_encoding.h"
+#include "optimizer.h"
 #include "query_exec.h"
 #include "utils.h"
-
-int *extend_and_update_mmap(int *mapped_addr, size_t *current_size, size_t offset,
-                            const int *new_values, size_t count, int disk_fd) {
+#include "wal.h"
+#include "zone_map.h"
+
+// Writes `count` values of `value_size` bytes at value `offset` of a column's mapping,
+// growing the file and the mapping first if needed
+void *extend_and_update_mmap(void *mapped_addr, size_t *current_size, size_t offset,
+                             const void *new_values, size_t value_size, size_t count,
+                             int disk_fd) {
   if (mapped_addr == NULL || current_size == NULL || new_values == NULL || count == 0) {
     errno = EINVAL;
     return NULL;
   }
 
   // Calculate required size
-  size_t required_size = (offset + count) * sizeof(int);
+  size_t required_size = (offset + count) * value_size;
 
   // Check if we need to extend
   if (required_size > *current_size) {
@@ -50,38 +58,78 @@ int *extend_and_update_mmap(int *mapped_addr, size_t *current_size, size_t offse
   }
 
   // Copy new values to the specified offset
-  memcpy((char *)mapped_addr + (offset * sizeof(int)), new_values, count * sizeof(int));
+  memcpy((char *)mapped_addr + (offset * value_size), new_values, count * value_size);
 
   return mapped_addr;
 }
 
-void exec_insert(DbOperator *query, message *send_message) {
-  cs165_log(stdout, "Executing insert query.\n");
-  InsertOperator *insert_op = &query->operator_fields.insert_operator;
+int stage_row(Table *table, const InsertValue *values) {
+  Column *cols = table->columns;
+  for (size_t i = 0; i < table->num_cols; i++) {
+    // every member of the union starts at its address
+    void *new_region = extend_and_update_mmap(
+        cols[i].data, &cols[i].mmap_size, cols[i].num_elements, &values[i],
+        data_type_size(cols[i].data_type), 1, cols[i].disk_fd);
+    if (new_region == NULL) return -1;
+    cols[i].data = new_region;
+  }
+  return 0;
+}
 
-  Column *cols = insert_op->table->columns;
-  size_t num_cols = insert_op->table->num_cols;
-  int *values = query->operator_fields.insert_operator.values;
-
-  for (size_t i = 0; i < num_cols; i++) {
-    cs165_log(stdout, "adding %d to col %s\n", values[i], cols[i].name);
-    int *new_region =
-        extend_and_update_mmap((int *)cols[i].data, &cols[i].mmap_size,
-                               cols[i].num_elements, &values[i], 1, cols[i].disk_fd);
-    if (new_region == NULL) {
-      send_message->status = EXECUTION_ERROR;
-      send_message->payload = "Failed to extend and update mmap";
-      send_message->length = strlen(send_message->payload);
-      return;
+void apply_staged_row(Table *table, const InsertValue *values) {
+  Column *cols = table->columns;
+  for (size_t i = 0; i < table->num_cols; i++) {
+    // the file now holds a row the catalog does not, so the next checkpoint flushes it
+    mark_column_dirty(&cols[i], cols[i].num_elements);
+    if (cols[i].data_type != INT) {
+      // zones, encodings and the statistics kept below are for int columns only; a
+      // LONG or DOUBLE index picks the row up by scanning (see create_idx_on)
+      cols[i].num_elements++;
+      continue;
     }
-    cols[i].data = new_region;
 
+    int value = values[i].i;
+    cs165_log(stdout, "adding %d to col %s\n", value, cols[i].name);
+    zone_map_append(&cols[i], cols[i].num_elements, value);
+    column_encoding_append(&cols[i], cols[i].num_elements, value);
     cols[i].num_elements++;
-    cols[i].min_value = values[i] < cols[i].min_value ? values[i] : cols[i].min_value;
-    cols[i].max_value = values[i] > cols[i].max_value ? values[i] : cols[i].max_value;
-    cols[i].sum += values[i];
-    cols[i].is_dirty = 0;
+    index_insert(&cols[i], value, cols[i].num_elements - 1);
+    cols[i].min_value = value < cols[i].min_value ? value : cols[i].min_value;
+    cols[i].max_value = value > cols[i].max_value ? value : cols[i].max_value;
+    cols[i].sum += value;
+  }
+}
+
+int insert_row(Table *table, const InsertValue *values) {
+  if (stage_row(table, values) != 0) return -1;
+  apply_staged_row(table, values);
+  return 0;
+}
+
+void exec_insert(DbOperator *query, message *send_message) {
+  cs165_log(stdout, "Executing insert query.\n");
+  InsertOperator *insert_op = &query->operator_fields.insert_operator;
+  Table *table = insert_op->table;
+  size_t row = table->num_cols > 0 ? table->columns[0].num_elements : 0;
+
+  // The row is written past the end of the columns and logged before any session can
+  // see it, so an insert that fails leaves nothing behind
+  if (stage_row(table, insert_op->values) != 0) {
+    send_message->status = EXECUTION_ERROR;
+    send_message->payload = "Failed to extend and update mmap";
+    send_message->length = strlen(send_message->payload);
+    return;
+  }
+  // The session waits for the record to be durable once it releases the catalog (see
+  // handle_query)
+  query->context->wal_lsn = wal_log_insert(table, insert_op->values, row);
+  if (query->context->wal_lsn == 0) {
+    send_message->status = EXECUTION_ERROR;
+    send_message->payload = "Failed to log insert";
+    send_message->length = strlen(send_message->payload);
+    return;
   }
+  apply_staged_row(table, insert_op->values);
 
   log_info("successfully added new values in table");
   send_message->status = OK_DONE;
@@ -1,32 +1,71 @@
+#include <errno.h>
+#include <fcntl.h>
 #include <limits.h>
+#include <stdint.h>
+#include <unistd.h>
 
 #include "client_context.h"
-#include "hash_table.h"
+#include "flat_hash.h"
 #include "optimizer.h"
+#include "positions.h"
 #include "query_exec.h"
 #include "utils.h"
 
+// The join kernels return 0 on success, -1 if they ran out of memory (or, for the grace
+// hash join, spill space); the result columns are then incomplete and left empty.
+
 // O(n * m) where n is the number of elements in psn1_col and m is the number of elements
 // in psn2_col
-void exec_nested_loop_join(Column *psn1_col, Column *psn2_col, Column *vals1_col,
-                           Column *vals2_col, Column *resL, Column *resR);
-void exec_naive_hash_join(Column *psn1_col, Column *psn2_col, Column *vals1_col,
-                          Column *vals2_col, Column *resL, Column *resR);
-void exec_grace_hash_join(Column *psn1_col, Column *psn2_col, Column *vals1_col,
-                          Column *vals2_col, Column *resL, Column *resR);
-void exec_hash_join(Column *psn1_col, Column *psn2_col, Column *vals1_col,
-                    Column *vals2_col, Column *resL, Column *resR);
+int exec_nested_loop_join(Column *psn1_col, Column *psn2_col, Column *vals1_col,
+                          Column *vals2_col, Column *resL, Column *resR,
+                          ThreadPool *pool);
+int exec_naive_hash_join(Column *psn1_col, Column *psn2_col, Column *vals1_col,
+                         Column *vals2_col, Column *resL, Column *resR,
+                         ThreadPool *pool);
+int exec_grace_hash_join(Column *psn1_col, Column *psn2_col, Column *vals1_col,
+                         Column *vals2_col, Column *resL, Column *resR, ThreadPool *pool,
+                         size_t memory_budget, Arena *scratch, size_t *bytes_spilled);
+int exec_hash_join(Column *psn1_col, Column *psn2_col, Column *vals1_col,
+                   Column *vals2_col, Column *resL, Column *resR, ThreadPool *pool,
+                   Arena *scratch);
 
 // just for experimenting on how using sorted index can improve the performance
 void exec_sorted_idx_join(Column *psn1_col, Column *psn2_col, Column *vals1_col,
                           Column *vals2_col, Column *resL, Column *resR);
 
+/**
+ * @brief The join algorithms read the position of the `i`-th value as `data[i]`, so a
+ * position bitmap or ranges are decoded into query scratch and `list`, a copy of the
+ * handle, points to it; the handle itself keeps its bitmap or ranges.
+ */
+static Column *as_position_list(Column *positions, Column *list, DbOperator *query) {
+  if (!positions->bitmap && !positions->ranges) return positions;
+  const int *data =
+      positions_list(positions, query->context->is_single_core, query->scratch);
+  if (!data) return NULL;
+  *list = *positions;
+  list->data = (void *)data;
+  list->bitmap = NULL;
+  list->ranges = NULL;
+  return list;
+}
+
 void exec_join(DbOperator *query, message *send_message) {
   JoinOperator join_op = query->operator_fields.join_operator;
-  Column *psn1_col = join_op.posn1;
-  Column *psn2_col = join_op.posn2;
+  Column psn1_list, psn2_list;
+  Column *psn1_col = as_position_list(join_op.posn1, &psn1_list, query);
+  Column *psn2_col = as_position_list(join_op.posn2, &psn2_list, query);
   Column *vals1_col = join_op.vals1;
   Column *vals2_col = join_op.vals2;
+  if (!psn1_col || !psn2_col) {
+    handle_error(send_message, "Failed to decode join positions");
+    return;
+  }
+  // the join kernels hash and compare ints
+  if (vals1_col->data_type != INT || vals2_col->data_type != INT) {
+    handle_error(send_message, "Join over long or double values not supported");
+    return;
+  }
 
   // Make column handles to store results
   Column *resL_col = NULL;
@@ -45,23 +84,122 @@ void exec_join(DbOperator *query, message *send_message) {
   resL_col->num_elements = 0;
   resR_col->num_elements = 0;
 
+  ThreadPool *pool = query->context->is_single_core ? NULL : g_thread_pool;
+  query->context->join_bytes_spilled = 0;
+
+  int status;
   switch (join_op.join_type) {
     case NESTED_LOOP:
-      exec_nested_loop_join(psn1_col, psn2_col, vals1_col, vals2_col, resL_col, resR_col);
+      status = exec_nested_loop_join(psn1_col, psn2_col, vals1_col, vals2_col, resL_col,
+                                     resR_col, pool);
       break;
     case HASH:
-      exec_hash_join(psn1_col, psn2_col, vals1_col, vals2_col, resL_col, resR_col);
+      status = exec_hash_join(psn1_col, psn2_col, vals1_col, vals2_col, resL_col,
+                              resR_col, pool, query->scratch);
       break;
     case GRACE_HASH:
-      exec_grace_hash_join(psn1_col, psn2_col, vals1_col, vals2_col, resL_col, resR_col);
+      status = exec_grace_hash_join(psn1_col, psn2_col, vals1_col, vals2_col, resL_col,
+                                    resR_col, pool, query->context->join_memory_budget,
+                                    query->scratch, &query->context->join_bytes_spilled);
       break;
     case NAIVE_HASH:
-      exec_naive_hash_join(psn1_col, psn2_col, vals1_col, vals2_col, resL_col, resR_col);
+      status = exec_naive_hash_join(psn1_col, psn2_col, vals1_col, vals2_col, resL_col,
+                                    resR_col, pool);
       break;
     default:
       send_message->status = EXECUTION_ERROR;
       send_message->payload = "Invalid join type";
       send_message->length = strlen(send_message->payload);
+      return;
+  }
+  if (status != 0) {
+    // never hand out a partial join: the handles stay, but empty
+    free(resL_col->data);
+    free(resR_col->data);
+    resL_col->data = resR_col->data = NULL;
+    resL_col->num_elements = resR_col->num_elements = 0;
+    handle_error(send_message, "Join failed: out of memory or spill space");
+  }
+}
+
+/**
+ * @brief Concatenates the per-morsel matches, in morsel order, into the result columns
+ * and frees them.
+ */
+static int gather_join_matches(MatchBuffer *morsel_matches, size_t n_morsels,
+                               Column *resL, Column *resR) {
+  size_t total = 0;
+  for (size_t m = 0; m < n_morsels; m++) total += morsel_matches[m].size;
+
+  // Keep at least one slot so an empty join still owns its buffers
+  resL->data = malloc(sizeof(int) * (total ? total : 1));
+  resR->data = malloc(sizeof(int) * (total ? total : 1));
+  int ok = resL->data && resR->data;
+
+  size_t k = 0;
+  for (size_t m = 0; m < n_morsels; m++) {
+    if (ok) {
+      memcpy((int *)resL->data + k, morsel_matches[m].left,
+             sizeof(int) * morsel_matches[m].size);
+      memcpy((int *)resR->data + k, morsel_matches[m].right,
+             sizeof(int) * morsel_matches[m].size);
+      k += morsel_matches[m].size;
+    }
+    free(morsel_matches[m].left);
+    free(morsel_matches[m].right);
+  }
+  if (!ok) {
+    log_err("gather_join_matches: failed to allocate %zu results\n", total);
+    free(resL->data);
+    free(resR->data);
+    resL->data = NULL;
+    resR->data = NULL;
+    return -1;
+  }
+  resL->num_elements = k;
+  resR->num_elements = k;
+  return 0;
+}
+
+// Shared by all morsel tasks of one join
+typedef struct {
+  const int *l_psn;
+  const int *r_psn;
+  const int *l_vals;
+  const int *r_vals;
+  size_t l_N;
+  size_t r_N;
+  size_t morsel_size;
+  FlatHashTable *ht;  // built from the left side; only read by the probes
+  MatchBuffer *morsel_matches;
+  int failed;  // set by a morsel whose matches did not fit in memory
+} JoinMorselArgs;
+
+// Compares one morsel of left rows with every right row
+static void nested_loop_morsel(size_t start_idx, size_t end_idx, void *args) {
+  JoinMorselArgs *join_args = (JoinMorselArgs *)args;
+  MatchBuffer *matches = &join_args->morsel_matches[start_idx / join_args->morsel_size];
+  for (size_t i = start_idx; i < end_idx; i++) {
+    for (size_t j = 0; j < join_args->r_N; j++) {
+      if (join_args->l_vals[i] == join_args->r_vals[j] &&
+          match_buffer_push(matches, join_args->l_psn[i], join_args->r_psn[j]) != 0) {
+        log_err("nested_loop_morsel: failed to grow match buffer\n");
+        __atomic_store_n(&join_args->failed, 1, __ATOMIC_RELAXED);
+        return;
+      }
+    }
+  }
+}
+
+// Probes the hash table with one morsel of right rows
+static void hash_probe_morsel(size_t start_idx, size_t end_idx, void *args) {
+  JoinMorselArgs *join_args = (JoinMorselArgs *)args;
+  MatchBuffer *matches = &join_args->morsel_matches[start_idx / join_args->morsel_size];
+  if (flat_ht_probe(join_args->ht, join_args->r_vals + start_idx,
+                    join_args->r_psn + start_idx, end_idx - start_idx, 1, 1,
+                    matches) != 0) {
+    log_err("hash_probe_morsel: failed to grow match buffer\n");
+    __atomic_store_n(&join_args->failed, 1, __ATOMIC_RELAXED);
   }
 }
 
@@ -74,9 +212,12 @@ void exec_join(DbOperator *query, message *send_message) {
  * @param vals2_col
  * @param resL
  * @param resR
+ * @param pool runs morsels of left rows in parallel; NULL runs them on this thread
+ * @return 0 on success, -1 if out of memory
  */
-void exec_nested_loop_join(Column *psn1_col, Column *psn2_col, Column *vals1_col,
-                           Column *vals2_col, Column *resL, Column *resR) {
+int exec_nested_loop_join(Column *psn1_col, Column *psn2_col, Column *vals1_col,
+                          Column *vals2_col, Column *resL, Column *resR,
+                          ThreadPool *pool) {
   log_debug("exec_nested_loop_join: executing nested loop join\n");
   size_t l_N = psn1_col->num_elements;
   size_t r_N = psn2_col->num_elements;
@@ -87,27 +228,36 @@ void exec_nested_loop_join(Column *psn1_col, Column *psn2_col, Column *vals1_col
   int *l_vals = (int *)vals1_col->data;
   int *r_vals = (int *)vals2_col->data;
 
-  size_t max_res_size = psn1_col->num_elements * psn2_col->num_elements;
-  resL->data = malloc(sizeof(int) * max_res_size);
-  resR->data = malloc(sizeof(int) * max_res_size);
-
-  size_t k = 0;
-  for (size_t i = 0; i < l_N; i++) {
-    for (size_t j = 0; j < r_N; j++) {
-      if (l_vals[i] == r_vals[j]) {
-        ((int *)resL->data)[k] = l_psn[i];
-        ((int *)resR->data)[k] = r_psn[j];
-        k++;
-      }
-    }
+  // Every left row costs r_N comparisons, so size morsels by comparisons, not rows
+  size_t morsel_size = r_N ? MORSEL_SIZE / r_N : MORSEL_SIZE;
+  if (morsel_size == 0) morsel_size = 1;
+  size_t n_morsels = num_morsels(l_N, morsel_size);
+  MatchBuffer *morsel_matches = calloc(n_morsels ? n_morsels : 1, sizeof(MatchBuffer));
+  if (!morsel_matches) {
+    log_err("exec_nested_loop_join: failed to allocate match buffers\n");
+    return -1;
   }
-  resL->num_elements = k;
-  resR->num_elements = k;
+
+  JoinMorselArgs args = {
+      .l_psn = l_psn,
+      .r_psn = r_psn,
+      .l_vals = l_vals,
+      .r_vals = r_vals,
+      .l_N = l_N,
+      .r_N = r_N,
+      .morsel_size = morsel_size,
+      .morsel_matches = morsel_matches,
+  };
+  threadpool_parallel_for(pool, l_N, morsel_size, nested_loop_morsel, &args);
+  int status = gather_join_matches(morsel_matches, n_morsels, resL, resR);
+  free(morsel_matches);
   log_info("exec_nested_loop_join: done\n");
+  return args.failed ? -1 : status;
 }
 
-void exec_naive_hash_join(Column *psn1_col, Column *psn2_col, Column *vals1_col,
-                          Column *vals2_col, Column *resL, Column *resR) {
+int exec_naive_hash_join(Column *psn1_col, Column *psn2_col, Column *vals1_col,
+                         Column *vals2_col, Column *resL, Column *resR,
+                         ThreadPool *pool) {
   log_debug("exec_hash_join: executing hash join\n");
 
   size_t l_N = psn1_col->num_elements;
@@ -118,94 +268,573 @@ void exec_naive_hash_join(Column *psn1_col, Column *psn2_col, Column *vals1_col,
   int *l_vals = (int *)vals1_col->data;
   int *r_vals = (int *)vals2_col->data;
 
-  // First pass: Count matches to determine exact result size
-  hashtable *ht = NULL;
-  if (allocate(&ht, l_N) != 0) {
-    log_err("exec_hash_join: failed to allocate hash table\n");
-    return;
+  // Build phase: one pass over the left relation; positions of equal keys end up
+  // contiguous, so each probe reads its matches straight out of the table
+  FlatHashTable *ht = flat_ht_build(l_vals, l_psn, l_N, 1);
+  if (!ht) {
+    log_err("exec_hash_join: failed to build hash table\n");
+    return -1;
   }
 
-  // Build phase: Insert all elements from left relation
-  for (size_t i = 0; i < l_N; i++) {
-    if (put(ht, l_vals[i], l_psn[i]) != 0) {
-      log_err("exec_hash_join: failed to insert into hash table\n");
-      deallocate(ht);
-      return;
+  // Probe phase: morsels of right rows probe the finished table in parallel
+  size_t n_morsels = num_morsels(r_N, MORSEL_SIZE);
+  MatchBuffer *morsel_matches = calloc(n_morsels ? n_morsels : 1, sizeof(MatchBuffer));
+  if (!morsel_matches) {
+    log_err("exec_hash_join: failed to allocate match buffers\n");
+    flat_ht_destroy(ht);
+    return -1;
+  }
+
+  JoinMorselArgs args = {
+      .l_psn = l_psn,
+      .r_psn = r_psn,
+      .l_vals = l_vals,
+      .r_vals = r_vals,
+      .l_N = l_N,
+      .r_N = r_N,
+      .morsel_size = MORSEL_SIZE,
+      .ht = ht,
+      .morsel_matches = morsel_matches,
+  };
+  threadpool_parallel_for(pool, r_N, MORSEL_SIZE, hash_probe_morsel, &args);
+  int status = gather_join_matches(morsel_matches, n_morsels, resL, resR);
+
+  // Clean up
+  free(morsel_matches);
+  flat_ht_destroy(ht);
+
+  log_info("exec_hash_join: done. Produced %zu results\n", resL->num_elements);
+  return args.failed ? -1 : status;
+}
+
+//    Radix-partitioned hash join
+//    -----------
+// Both inputs are split by the top bits of a multiplicative hash until a build
+// partition and its hash table fit in L2. Each pass fans out to at most
+// RADIX_BITS_PER_PASS bits so every output partition keeps a TLB entry while scattering.
+// Pass one runs over morsels of both inputs in parallel; the second pass, build and
+// probe then run as one task per first-pass partition.
+
+#define RADIX_BITS_PER_PASS 6  // 64-way fan-out per pass; about the L1 dTLB size
+#define RADIX_MAX_PASSES 2
+#define RADIX_HASH(key) ((uint32_t)(key) * 2654435761u)
+
+typedef struct {
+  int key;
+  int pos;
+} JoinTuple;
+
+// One side of a radix join, partitioned by the top `radix_bits` bits of the hash
+typedef struct {
+  const int *vals;
+  const int *psns;
+  size_t n;
+  JoinTuple *tuples;
+  size_t *hist;     // hist[m * fanout + p]: tuples of morsel m in partition p
+  size_t *offsets;  // offsets[p]: start of partition p in `tuples`; fanout + 1 entries
+} RadixSide;
+
+typedef struct {
+  RadixSide *side;
+  size_t fanout;
+  int shift;  // 32 - bits of this pass
+} RadixPassArgs;
+
+static inline size_t radix_of(int key, int shift, size_t mask) {
+  return (RADIX_HASH(key) >> shift) & mask;
+}
+
+static void radix_histogram_morsel(size_t start_idx, size_t end_idx, void *args) {
+  RadixPassArgs *pass = (RadixPassArgs *)args;
+  size_t *hist = pass->side->hist + (start_idx / MORSEL_SIZE) * pass->fanout;
+  for (size_t i = start_idx; i < end_idx; i++) {
+    hist[radix_of(pass->side->vals[i], pass->shift, pass->fanout - 1)]++;
+  }
+}
+
+static void radix_scatter_morsel(size_t start_idx, size_t end_idx, void *args) {
+  RadixPassArgs *pass = (RadixPassArgs *)args;
+  RadixSide *side = pass->side;
+  // The histogram pass turned this morsel's counts into its write offsets
+  size_t *cursor = side->hist + (start_idx / MORSEL_SIZE) * pass->fanout;
+  for (size_t i = start_idx; i < end_idx; i++) {
+    size_t p = radix_of(side->vals[i], pass->shift, pass->fanout - 1);
+    side->tuples[cursor[p]++] = (JoinTuple){side->vals[i], side->psns[i]};
+  }
+}
+
+/**
+ * @brief First partitioning pass over one input: per-morsel histograms, a prefix sum
+ * that gives every (partition, morsel) pair its own output range, then a parallel
+ * scatter. Within a partition, tuples keep their input order.
+ */
+static int radix_partition_side(RadixSide *side, size_t fanout, int shift,
+                                ThreadPool *pool, Arena *scratch) {
+  size_t n_morsels = num_morsels(side->n, MORSEL_SIZE);
+  size_t hist_size = sizeof(size_t) * (n_morsels ? n_morsels : 1) * fanout;
+  side->tuples = arena_alloc(scratch, sizeof(JoinTuple) * (side->n ? side->n : 1), 64);
+  side->hist = arena_alloc(scratch, hist_size, 64);
+  side->offsets = arena_alloc(scratch, sizeof(size_t) * (fanout + 1), 64);
+  if (!side->tuples || !side->hist || !side->offsets) return -1;
+  memset(side->hist, 0, hist_size);
+
+  RadixPassArgs pass = {side, fanout, shift};
+  threadpool_parallel_for(pool, side->n, MORSEL_SIZE, radix_histogram_morsel, &pass);
+
+  size_t offset = 0;
+  for (size_t p = 0; p < fanout; p++) {
+    side->offsets[p] = offset;
+    for (size_t m = 0; m < n_morsels; m++) {
+      size_t count = side->hist[m * fanout + p];
+      side->hist[m * fanout + p] = offset;
+      offset += count;
     }
   }
+  side->offsets[fanout] = offset;
 
-  // First probe phase: Count matches
-  size_t total_matches = 0;
-  int *matching_positions = malloc(sizeof(int) * l_N);
-  int num_matches;
+  threadpool_parallel_for(pool, side->n, MORSEL_SIZE, radix_scatter_morsel, &pass);
+  return 0;
+}
 
-  if (!matching_positions) {
-    log_err("exec_hash_join: failed to allocate matching positions buffer\n");
-    deallocate(ht);
+// Serial partitioning of `n` tuples into `fanout` ranges of `out`; fills `offsets`
+static void radix_partition_tuples(const JoinTuple *in, size_t n, JoinTuple *out,
+                                   size_t fanout, int shift, size_t *offsets) {
+  memset(offsets, 0, sizeof(size_t) * (fanout + 1));
+  for (size_t i = 0; i < n; i++) offsets[radix_of(in[i].key, shift, fanout - 1) + 1]++;
+  for (size_t p = 0; p < fanout; p++) offsets[p + 1] += offsets[p];
+
+  size_t *cursor = malloc(sizeof(size_t) * fanout);
+  if (!cursor) {
+    // fall back to one unpartitioned range; the join stays correct, only slower
+    memcpy(out, in, sizeof(JoinTuple) * n);
+    for (size_t p = 0; p < fanout; p++) offsets[p + 1] = n;
+    offsets[0] = 0;
     return;
   }
+  memcpy(cursor, offsets, sizeof(size_t) * fanout);
+  for (size_t i = 0; i < n; i++) {
+    out[cursor[radix_of(in[i].key, shift, fanout - 1)]++] = in[i];
+  }
+  free(cursor);
+}
+
+/**
+ * @brief Joins one cache-sized partition pair: builds a flat hash table over `build`
+ * and probes it with every tuple of `probe`. `build_is_left` says which side the build
+ * positions belong to.
+ */
+static int join_partition(const JoinTuple *build, size_t n_build, const JoinTuple *probe,
+                          size_t n_probe, int build_is_left, MatchBuffer *matches) {
+  if (n_build == 0 || n_probe == 0) return 0;
+
+  // JoinTuples are read in place as interleaved (key, pos) ints
+  FlatHashTable *ht = flat_ht_build(&build[0].key, &build[0].pos, n_build, 2);
+  if (!ht) return -1;
+  int status = flat_ht_probe(ht, &probe[0].key, &probe[0].pos, n_probe, 2,
+                             build_is_left, matches);
+  flat_ht_destroy(ht);
+  return status;
+}
 
-  for (size_t j = 0; j < r_N; j++) {
-    if (get(ht, r_vals[j], matching_positions, l_N, &num_matches) == 0) {
-      total_matches += num_matches;
+typedef struct {
+  RadixSide *build;
+  RadixSide *probe;
+  int build_is_left;
+  size_t sub_fanout;  // fan-out of the second pass; 1 if there is none
+  int sub_shift;
+  MatchBuffer *partition_matches;  // one per first-pass partition
+  int failed;  // set by a partition that ran out of memory
+} RadixJoinArgs;
+
+// Second pass, build and probe for first-pass partitions [start_idx, end_idx)
+static void radix_join_partitions(size_t start_idx, size_t end_idx, void *args) {
+  RadixJoinArgs *join_args = (RadixJoinArgs *)args;
+  RadixSide *build = join_args->build;
+  RadixSide *probe = join_args->probe;
+  size_t sub_fanout = join_args->sub_fanout;
+
+  for (size_t p = start_idx; p < end_idx; p++) {
+    MatchBuffer *matches = &join_args->partition_matches[p];
+    const JoinTuple *b = build->tuples + build->offsets[p];
+    const JoinTuple *s = probe->tuples + probe->offsets[p];
+    size_t n_b = build->offsets[p + 1] - build->offsets[p];
+    size_t n_s = probe->offsets[p + 1] - probe->offsets[p];
+    if (n_b == 0 || n_s == 0) continue;
+
+    if (sub_fanout == 1) {
+      if (join_partition(b, n_b, s, n_s, join_args->build_is_left, matches) != 0) {
+        log_err("radix_join_partitions: out of memory in partition %zu\n", p);
+        __atomic_store_n(&join_args->failed, 1, __ATOMIC_RELAXED);
+      }
+      continue;
+    }
+
+    JoinTuple *sub_b = malloc(sizeof(JoinTuple) * n_b);
+    JoinTuple *sub_s = malloc(sizeof(JoinTuple) * n_s);
+    size_t *b_offsets = malloc(sizeof(size_t) * (sub_fanout + 1));
+    size_t *s_offsets = malloc(sizeof(size_t) * (sub_fanout + 1));
+    if (!sub_b || !sub_s || !b_offsets || !s_offsets) {
+      log_err("radix_join_partitions: out of memory in partition %zu\n", p);
+      __atomic_store_n(&join_args->failed, 1, __ATOMIC_RELAXED);
+    } else {
+      radix_partition_tuples(b, n_b, sub_b, sub_fanout, join_args->sub_shift, b_offsets);
+      radix_partition_tuples(s, n_s, sub_s, sub_fanout, join_args->sub_shift, s_offsets);
+      for (size_t q = 0; q < sub_fanout; q++) {
+        if (join_partition(sub_b + b_offsets[q], b_offsets[q + 1] - b_offsets[q],
+                           sub_s + s_offsets[q], s_offsets[q + 1] - s_offsets[q],
+                           join_args->build_is_left, matches) != 0) {
+          log_err("radix_join_partitions: out of memory in partition %zu.%zu\n", p, q);
+          __atomic_store_n(&join_args->failed, 1, __ATOMIC_RELAXED);
+          break;
+        }
+      }
     }
+    free(sub_b);
+    free(sub_s);
+    free(b_offsets);
+    free(s_offsets);
   }
+}
 
-  // Allocate exact space needed
-  resL->data = malloc(sizeof(int) * total_matches);
-  resR->data = malloc(sizeof(int) * total_matches);
+/**
+ * @brief Number of radix bits that makes an average build partition, together with
+ * its flat hash table, fit in half of L2.
+ */
+static int radix_bits_for(size_t n_build) {
+  // up to two slots (control byte, key, group) per key, plus its value and group entry
+  size_t bytes_per_tuple = sizeof(JoinTuple) + 2 * (1 + 2 * sizeof(int)) + 3 * sizeof(int);
+  size_t max_tuples = (L2_CACHE_SIZE / 2) / bytes_per_tuple;
+  int bits = 0;
+  while (bits < RADIX_BITS_PER_PASS * RADIX_MAX_PASSES &&
+         (n_build >> bits) > max_tuples) {
+    bits++;
+  }
+  return bits;
+}
 
-  if (!resL->data || !resR->data) {
-    log_err("exec_hash_join: failed to allocate result arrays\n");
-    free(matching_positions);
-    deallocate(ht);
-    if (resL->data) free(resL->data);
-    if (resR->data) free(resR->data);
-    return;
+/**
+ * @brief Radix-partitioned hash join. Builds on the smaller input; results come out
+ * grouped by partition rather than in input order.
+ *
+ * @param pool runs the partitioning morsels and the partition joins in parallel; NULL
+ * runs everything on this thread
+ * @param scratch holds the partitioned copies of both inputs until the query ends
+ * @return 0 on success, -1 if out of memory
+ */
+int exec_hash_join(Column *psn1_col, Column *psn2_col, Column *vals1_col,
+                   Column *vals2_col, Column *resL, Column *resR, ThreadPool *pool,
+                   Arena *scratch) {
+  RadixSide left = {(int *)vals1_col->data, (int *)psn1_col->data,
+                    psn1_col->num_elements, NULL, NULL, NULL};
+  RadixSide right = {(int *)vals2_col->data, (int *)psn2_col->data,
+                     psn2_col->num_elements, NULL, NULL, NULL};
+  int build_is_left = left.n <= right.n;
+  RadixSide *build = build_is_left ? &left : &right;
+  RadixSide *probe = build_is_left ? &right : &left;
+
+  int bits = radix_bits_for(build->n);
+  int first_bits = bits < RADIX_BITS_PER_PASS ? bits : RADIX_BITS_PER_PASS;
+  int second_bits = bits - first_bits;
+  size_t fanout = (size_t)1 << first_bits;
+  int shift = first_bits ? 32 - first_bits : 0;  // one partition: the mask is 0 anyway
+  log_info("exec_hash_join: %zu x %zu rows, %d radix bits in %d pass(es)\n", left.n,
+           right.n, bits, second_bits ? 2 : 1);
+
+  MatchBuffer *partition_matches = arena_alloc(scratch, sizeof(MatchBuffer) * fanout, 64);
+  if (!partition_matches ||
+      radix_partition_side(build, fanout, shift, pool, scratch) != 0 ||
+      radix_partition_side(probe, fanout, shift, pool, scratch) != 0) {
+    log_err("exec_hash_join: failed to allocate partitions\n");
+    return -1;
   }
+  memset(partition_matches, 0, sizeof(MatchBuffer) * fanout);
+
+  RadixJoinArgs args = {
+      .build = build,
+      .probe = probe,
+      .build_is_left = build_is_left,
+      .sub_fanout = (size_t)1 << second_bits,
+      .sub_shift = 32 - bits,
+      .partition_matches = partition_matches,
+  };
+  threadpool_parallel_for(pool, fanout, 1, radix_join_partitions, &args);
+  int status = gather_join_matches(partition_matches, fanout, resL, resR);
+  log_info("exec_hash_join: done. Produced %zu results\n", resL->num_elements);
+  return args.failed ? -1 : status;
+}
 
-  // Second probe phase: Fill results
-  size_t k = 0;
-  for (size_t j = 0; j < r_N; j++) {
-    if (get(ht, r_vals[j], matching_positions, l_N, &num_matches) == 0) {
-      for (int m = 0; m < num_matches; m++) {
-        ((int *)resL->data)[k] = matching_positions[m];
-        ((int *)resR->data)[k] = r_psn[j];
-        k++;
+//    Grace hash join
+//    -----------
+// When the build side's hash table would not fit in the memory budget, both inputs are
+// hash-partitioned into temporary files under `disk/`, and partition pairs are joined
+// one at a time. A build partition that is still over budget is partitioned again with
+// a different hash; one that stops shrinking (a few heavy keys) is joined in
+// budget-sized chunks of its build side instead.
+
+#define GRACE_MAX_FANOUT 64  // open partition files per level and side
+#define GRACE_MAX_DEPTH 4
+#define GRACE_IO_TUPLES 8192  // tuples per read when streaming a partition back
+
+// One spilled partition; the file is unlinked as soon as it is created
+typedef struct {
+  FILE *file;
+  size_t n;
+} SpillPartition;
+
+// Tuples come either from the join's input columns or from a spilled partition
+typedef struct {
+  FILE *file;
+  const int *vals;
+  const int *psns;
+  size_t n;
+  size_t next;
+} TupleReader;
+
+typedef struct {
+  size_t memory_budget;
+  int build_is_left;
+  size_t bytes_spilled;
+  size_t n_partitions;
+  int max_depth;
+  MatchBuffer matches;
+} GraceJoin;
+
+static size_t read_tuples(TupleReader *reader, JoinTuple *buf, size_t capacity) {
+  if (reader->file) return fread(buf, sizeof(JoinTuple), capacity, reader->file);
+  size_t count = 0;
+  for (; count < capacity && reader->next < reader->n; count++, reader->next++) {
+    buf[count] = (JoinTuple){reader->vals[reader->next], reader->psns[reader->next]};
+  }
+  return count;
+}
+
+static inline size_t grace_partition_of(int key, int depth, size_t fanout) {
+  // every level remixes the key with its own constant, so a partition split again
+  // spreads over new sub-partitions instead of landing in one
+  uint32_t h = ((uint32_t)key ^ (0x9e3779b9u * (uint32_t)(depth + 1))) * 0x85ebca6bu;
+  h ^= h >> 16;
+  return h & (fanout - 1);
+}
+
+static FILE *open_spill_file(void) {
+  char path[MAX_PATH_LEN];
+  static size_t n_created = 0;  // only makes names unique; races just retry below
+  for (int attempt = 0; attempt < 100; attempt++) {
+    snprintf(path, MAX_PATH_LEN, "%s/grace_%d_%zu.tmp", STORAGE_PATH, (int)getpid(),
+             __sync_fetch_and_add(&n_created, 1));
+    int fd = open(path, O_RDWR | O_CREAT | O_EXCL, 0600);
+    if (fd < 0) continue;
+    // Unlinked right away: the data lives until fclose, and a crash leaves no file
+    unlink(path);
+    FILE *file = fdopen(fd, "w+b");
+    if (!file) close(fd);
+    return file;
+  }
+  log_err("open_spill_file: failed to create %s: %s\n", path, strerror(errno));
+  return NULL;
+}
+
+static void close_partitions(SpillPartition *parts, size_t fanout) {
+  for (size_t p = 0; p < fanout; p++) {
+    if (parts[p].file) fclose(parts[p].file);
+    parts[p].file = NULL;
+  }
+}
+
+/**
+ * @brief Streams every tuple of `in` into one of `fanout` spill files by its hash at
+ * `depth`, and rewinds the files for reading.
+ */
+static int grace_partition(GraceJoin *gj, TupleReader *in, int depth, size_t fanout,
+                           SpillPartition *parts) {
+  JoinTuple *buf = malloc(sizeof(JoinTuple) * GRACE_IO_TUPLES);
+  if (!buf) return -1;
+  for (size_t p = 0; p < fanout; p++) {
+    parts[p].n = 0;
+    parts[p].file = open_spill_file();
+    if (!parts[p].file) {
+      close_partitions(parts, p);
+      free(buf);
+      return -1;
+    }
+  }
+
+  int status = 0;
+  size_t n_read;
+  while (status == 0 && (n_read = read_tuples(in, buf, GRACE_IO_TUPLES)) > 0) {
+    for (size_t i = 0; i < n_read; i++) {
+      SpillPartition *part = &parts[grace_partition_of(buf[i].key, depth, fanout)];
+      if (fwrite(&buf[i], sizeof(JoinTuple), 1, part->file) != 1) {
+        log_err("grace_partition: failed to spill: %s\n", strerror(errno));
+        status = -1;
+        break;
       }
+      part->n++;
+    }
+  }
+  for (size_t p = 0; p < fanout && status == 0; p++) {
+    gj->bytes_spilled += parts[p].n * sizeof(JoinTuple);
+    if (fflush(parts[p].file) != 0 || fseek(parts[p].file, 0, SEEK_SET) != 0) status = -1;
+  }
+  gj->n_partitions += fanout;
+  free(buf);
+  if (status != 0) close_partitions(parts, fanout);
+  return status;
+}
+
+/**
+ * @brief Bytes joining `n_build` build tuples in memory takes: the tuples, read in place,
+ * and the flat hash table built over them. The table grows in powers of two of slots,
+ * so this is not linear in `n_build`.
+ */
+static size_t grace_build_bytes(size_t n_build) {
+  return n_build * sizeof(JoinTuple) + flat_ht_build_bytes(n_build);
+}
+
+// Most build tuples, up to `n_build`, that `grace_build_bytes` fits in `memory_budget`
+static size_t grace_chunk_capacity(size_t n_build, size_t memory_budget) {
+  size_t low = 0, high = n_build;
+  while (low < high) {
+    size_t mid = high - (high - low) / 2;
+    if (grace_build_bytes(mid) <= memory_budget) {
+      low = mid;
+    } else {
+      high = mid - 1;
     }
   }
+  return low;
+}
 
-  // Clean up
-  free(matching_positions);
-  deallocate(ht);
+static size_t grace_fanout_for(size_t n_build, size_t memory_budget) {
+  size_t n_needed = grace_build_bytes(n_build) / memory_budget + 1;
+  size_t fanout = 2;
+  while (fanout < n_needed * 2 && fanout < GRACE_MAX_FANOUT) fanout <<= 1;
+  return fanout;
+}
 
-  resL->num_elements = k;
-  resR->num_elements = k;
+/**
+ * @brief Joins a build partition that fits (or can no longer be split) with its probe
+ * partition: loads as much of the build side as the budget allows, streams the whole
+ * probe side past it, and repeats until the build side is used up.
+ */
+static int grace_join_in_memory(GraceJoin *gj, TupleReader *build, TupleReader *probe) {
+  size_t chunk_capacity = grace_chunk_capacity(build->n, gj->memory_budget);
+  if (chunk_capacity < GRACE_IO_TUPLES) chunk_capacity = GRACE_IO_TUPLES;
+  if (chunk_capacity > build->n) chunk_capacity = build->n;
+  JoinTuple *chunk = malloc(sizeof(JoinTuple) * (chunk_capacity ? chunk_capacity : 1));
+  JoinTuple *probe_buf = malloc(sizeof(JoinTuple) * GRACE_IO_TUPLES);
+  if (!chunk || !probe_buf) {
+    free(chunk);
+    free(probe_buf);
+    return -1;
+  }
 
-  log_info("exec_hash_join: done. Produced %zu results\n", k);
+  int status = 0;
+  size_t n_chunk;
+  while (status == 0 && (n_chunk = read_tuples(build, chunk, chunk_capacity)) > 0) {
+    if (probe->file) {
+      fseek(probe->file, 0, SEEK_SET);
+    } else {
+      probe->next = 0;
+    }
+    size_t n_probe;
+    while (status == 0 &&
+           (n_probe = read_tuples(probe, probe_buf, GRACE_IO_TUPLES)) > 0) {
+      status = join_partition(chunk, n_chunk, probe_buf, n_probe, gj->build_is_left,
+                              &gj->matches);
+    }
+  }
+  free(chunk);
+  free(probe_buf);
+  return status;
 }
 
-void exec_grace_hash_join(Column *psn1_col, Column *psn2_col, Column *vals1_col,
-                          Column *vals2_col, Column *resL, Column *resR) {
-  log_debug("exec_grace_hash_join: Not implemented; using naive hash join\n");
-  exec_naive_hash_join(psn1_col, psn2_col, vals1_col, vals2_col, resL, resR);
+static int grace_join_pair(GraceJoin *gj, TupleReader *build, TupleReader *probe,
+                           int depth, size_t parent_n_build) {
+  if (build->n == 0 || probe->n == 0) return 0;
+  if (depth > gj->max_depth) gj->max_depth = depth;
+
+  // Split again only while it helps: a partition that did not shrink is skewed
+  int over_budget = grace_build_bytes(build->n) > gj->memory_budget;
+  if (!over_budget || depth >= GRACE_MAX_DEPTH || build->n >= parent_n_build) {
+    return grace_join_in_memory(gj, build, probe);
+  }
+
+  size_t fanout = grace_fanout_for(build->n, gj->memory_budget);
+  SpillPartition build_parts[GRACE_MAX_FANOUT], probe_parts[GRACE_MAX_FANOUT];
+  if (grace_partition(gj, build, depth, fanout, build_parts) != 0) return -1;
+  if (grace_partition(gj, probe, depth, fanout, probe_parts) != 0) {
+    close_partitions(build_parts, fanout);
+    return -1;
+  }
+
+  int status = 0;
+  for (size_t p = 0; p < fanout && status == 0; p++) {
+    TupleReader sub_build = {build_parts[p].file, NULL, NULL, build_parts[p].n, 0};
+    TupleReader sub_probe = {probe_parts[p].file, NULL, NULL, probe_parts[p].n, 0};
+    status = grace_join_pair(gj, &sub_build, &sub_probe, depth + 1, build->n);
+    // done with this pair; release its disk space before the next one
+    fclose(build_parts[p].file);
+    fclose(probe_parts[p].file);
+    build_parts[p].file = probe_parts[p].file = NULL;
+  }
+  close_partitions(build_parts, fanout);
+  close_partitions(probe_parts, fanout);
+  return status;
 }
 
-void exec_hash_join(Column *psn1_col, Column *psn2_col, Column *vals1_col,
-                    Column *vals2_col, Column *resL, Column *resR) {
-  log_debug("exec_hash_join: Not implemented; using naive hash join\n");
-  exec_naive_hash_join(psn1_col, psn2_col, vals1_col, vals2_col, resL, resR);
+/**
+ * @brief Grace hash join bounded by `memory_budget` bytes of hash table. Joins whose
+ * build side fits the budget run as an in-memory radix join; larger ones spill both
+ * inputs to partition files under `disk/` and join the pairs one at a time. Only the
+ * result columns are kept in memory in full.
+ *
+ * @param bytes_spilled set to the bytes written to partition files
+ * @return 0 on success, -1 if out of memory or spill space
+ */
+int exec_grace_hash_join(Column *psn1_col, Column *psn2_col, Column *vals1_col,
+                         Column *vals2_col, Column *resL, Column *resR, ThreadPool *pool,
+                         size_t memory_budget, Arena *scratch, size_t *bytes_spilled) {
+  size_t l_N = psn1_col->num_elements;
+  size_t r_N = psn2_col->num_elements;
+  int build_is_left = l_N <= r_N;
+  size_t n_build = build_is_left ? l_N : r_N;
+
+  if (grace_build_bytes(n_build) <= memory_budget) {
+    log_info("exec_grace_hash_join: build side fits in %zu bytes; joining in memory\n",
+             memory_budget);
+    return exec_hash_join(psn1_col, psn2_col, vals1_col, vals2_col, resL, resR, pool,
+                          scratch);
+  }
+
+  TupleReader left = {NULL, (int *)vals1_col->data, (int *)psn1_col->data, l_N, 0};
+  TupleReader right = {NULL, (int *)vals2_col->data, (int *)psn2_col->data, r_N, 0};
+  GraceJoin gj = {.memory_budget = memory_budget, .build_is_left = build_is_left};
+
+  // Depth 0 always partitions: parent_n_build is larger than the build side
+  int status = build_is_left ? grace_join_pair(&gj, &left, &right, 0, SIZE_MAX)
+                             : grace_join_pair(&gj, &right, &left, 0, SIZE_MAX);
+  *bytes_spilled = gj.bytes_spilled;
+  if (status != 0) {
+    log_err("exec_grace_hash_join: failed after spilling %zu bytes\n", gj.bytes_spilled);
+    match_buffer_free(&gj.matches);
+    return -1;
+  }
+  status = gather_join_matches(&gj.matches, 1, resL, resR);
+  log_info(
+      "exec_grace_hash_join: spilled %zu bytes to %zu partitions (depth %d, budget %zu "
+      "bytes); produced %zu results\n",
+      gj.bytes_spilled, gj.n_partitions, gj.max_depth, memory_budget,
+      resL->num_elements);
+  return status;
 }
 
 // TODO: experiment on how using sorted index can improve the performance
 void exec_sorted_idx_join(Column *psn1_col, Column *psn2_col, Column *vals1_col,
                           Column *vals2_col, Column *resL, Column *resR) {
   //   First create indices on both values columns
-  vals1_col->index = malloc(sizeof(ColumnIndex));
-  vals2_col->index = malloc(sizeof(ColumnIndex));
-  vals1_col->index->idx_type = SORTED_UNCLUSTERED;
-  vals2_col->index->idx_type = SORTED_UNCLUSTERED;
+  vals1_col->index = create_column_index(SORTED_UNCLUSTERED);
+  vals2_col->index = create_column_index(SORTED_UNCLUSTERED);
   create_idx_on(vals1_col, NULL);
   create_idx_on(vals2_col, NULL);
 
@@ -1,9 +1,47 @@
 #include <limits.h>
+#include <math.h>
+#include <stdbool.h>
 
 #include "client_context.h"
+#include "pipeline.h"
 #include "query_exec.h"
+#include "typed_kernels.h"
 #include "utils.h"
 
+/**
+ * @brief Aggregates a LONG or DOUBLE column or handle. Only int columns keep their
+ * statistics as they are built, so these are computed here, in one pass of the typed
+ * kernel. A sum keeps the column type, and is a long for a LONG column whatever its
+ * size; min and max keep the column type, and an average is a double.
+ *
+ * @return 0 on success, -1 if out of memory
+ */
+static int aggregate_typed(OperatorType type, const Column *col, Column *res_col) {
+  size_t n = col->num_elements;
+  DataType res_type = type == AVG ? DOUBLE : col->data_type;
+  res_col->data = malloc(data_type_size(res_type));
+  if (!res_col->data) return -1;
+  res_col->data_type = res_type;
+
+  if (col->data_type == LONG) {
+    int64_t sum = 0;
+    long min = LONG_MAX, max = LONG_MIN;
+    typed_stats_long(col->data, n, &sum, &min, &max);
+    if (type == AVG) {
+      *(double *)res_col->data = n == 0 ? 0.0 : (double)sum / n;
+    } else {
+      long value = type == MIN ? min : type == MAX ? max : (long)sum;
+      *(long *)res_col->data = n == 0 ? 0 : value;
+    }
+  } else {
+    double sum = 0, min = INFINITY, max = -INFINITY;
+    typed_stats_double(col->data, n, &sum, &min, &max);
+    double value = type == MIN ? min : type == MAX ? max : type == AVG ? sum / n : sum;
+    *(double *)res_col->data = n == 0 ? 0.0 : value;
+  }
+  return 0;
+}
+
 void exec_aggr(DbOperator *query, message *send_message) {
   cs165_log(stdout, "Executing aggr query:\nres_handle: %s\ncol: %s\n",
             query->operator_fields.aggregate_operator.res_handle,
@@ -13,6 +51,20 @@ void exec_aggr(DbOperator *query, message *send_message) {
   AggregateOperator *aggr_op = &query->operator_fields.aggregate_operator;
   Column *col = aggr_op->col;
 
+  // A pending fetch is aggregated in one fused pass without materializing it
+  if (col->pending) {
+    int is_single_core = query->context->is_single_core;
+    Arena *scratch = query->scratch;
+    int status = col->pending->fetch_col
+                     ? pipeline_compute_stats(col, is_single_core, scratch)
+                     : pipeline_materialize(col, is_single_core, scratch);
+    if (status != 0) {
+      handle_error(send_message, "Failed to evaluate pending handle\n");
+      log_err("L%d in handle_aggr: %s\n", __LINE__, send_message->payload);
+      return;
+    }
+  }
+
   // Create a new Column to store the result
   Column *res_col;
   if (create_new_handle(aggr_op->res_handle, &res_col) != 0) {
@@ -21,7 +73,12 @@ void exec_aggr(DbOperator *query, message *send_message) {
   }
   cs165_log(stdout, "added new handle: %s\n", aggr_op->res_handle);
 
-  if (query->type == AVG) {
+  if (col->data_type != INT) {
+    if (aggregate_typed(query->type, col, res_col) != 0) {
+      handle_error(send_message, "Failed to allocate memory for result data");
+      return;
+    }
+  } else if (query->type == AVG) {
     res_col->data = malloc(sizeof(double));
     *((double *)res_col->data) =
         col->num_elements == 0 ? 0.0 : (double)col->sum / col->num_elements;
@@ -48,18 +105,46 @@ void exec_aggr(DbOperator *query, message *send_message) {
   send_message->length = strlen(send_message->payload);
 }
 
+// The values of `col` as `type`, widened into query scratch when the column is narrower
+static const void *operand_as(const Column *col, DataType type, Arena *scratch) {
+  if (col->data_type == type) return col->data;
+  void *values = arena_alloc(scratch, data_type_size(type) * (col->num_elements + 1), 64);
+  if (values) widen_values(col->data, col->data_type, col->num_elements, values, type);
+  return values;
+}
+
+/**
+ * @brief Adds or subtracts columns of which at least one is LONG or DOUBLE. The result
+ * has the wider of the two types (INT < LONG < DOUBLE), the narrower operand being
+ * widened first, so the kernel runs on one type.
+ *
+ * @return 0 on success, -1 if out of memory
+ */
+static int arithmetic_typed(DbOperator *query, const Column *col1, const Column *col2,
+                            Column *res_col) {
+  DataType type = col1->data_type > col2->data_type ? col1->data_type : col2->data_type;
+  size_t n = col1->num_elements;
+  const void *a = operand_as(col1, type, query->scratch);
+  const void *b = operand_as(col2, type, query->scratch);
+  res_col->data = malloc(data_type_size(type) * (n ? n : 1));
+  if (!a || !b || !res_col->data) return -1;
+
+  bool add = query->type == ADD;
+  if (type == LONG) {
+    (add ? typed_add_long : typed_sub_long)(a, b, n, res_col->data);
+  } else {
+    (add ? typed_add_double : typed_sub_double)(a, b, n, res_col->data);
+  }
+  res_col->data_type = type;
+  res_col->num_elements = n;
+  return 0;
+}
+
 void exec_arithmetic(DbOperator *query, message *send_message) {
   Column *col1 = query->operator_fields.arithmetic_operator.col1;
   Column *col2 = query->operator_fields.arithmetic_operator.col2;
   cs165_log(stdout, "Executing arithmetic on columns: %s, %s\n", col1->name, col2->name);
 
-  //   We currently only support ADD and SUB over integer columns
-  if (col1->data_type != INT || col2->data_type != INT) {
-    handle_error(send_message,
-                 "Arithmetic operations are only supported on integer columns");
-    log_err("L%d in handle_arithmetic: %s\n", __LINE__, send_message->payload);
-  }
-
   // Create a new Column to store the result
   Column *res_col;
   if (create_new_handle(query->operator_fields.arithmetic_operator.res_handle,
@@ -68,6 +153,20 @@ void exec_arithmetic(DbOperator *query, message *send_message) {
     log_err("L%d in handle_arithmetic: %s\n", __LINE__, send_message->payload);
   }
 
+  if (col1->data_type != INT || col2->data_type != INT) {
+    if (arithmetic_typed(query, col1, col2, res_col) != 0) {
+      handle_error(send_message, "Failed to allocate memory for result data");
+      log_err("L%d in handle_arithmetic: %s\n", __LINE__, send_message->payload);
+      return;
+    }
+    send_message->status = OK_DONE;
+    send_message->payload = "Done";
+    send_message->length = strlen(send_message->payload);
+    log_info("Arithmetic operation completed for %s, with result stored in %s\n",
+             col1->name, res_col->name);
+    return;
+  }
+
   res_col->data = malloc(col1->num_elements * sizeof(int));
   if (!res_col->data) {
     free(res_col);
@@ -0,0 +1,332 @@
+#include "pipeline.h"
+
+#include <limits.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "bitpack.h"
+#include "column_encoding.h"
+#include "positions.h"
+#include "rle.h"
+#include "scan.h"
+#include "utils.h"
+#include "zone_map.h"
+
+#define PIPELINE_BLOCK_SIZE 1024  // positions of one block stay in L1 (4KB)
+// A fetch from an encoded column decodes whole blocks once 1 in this many rows qualify
+#define PIPELINE_DECODE_RATIO 8
+
+// Shared by all morsel tasks of one pipeline run
+typedef struct {
+  const PendingResult *pending;
+  const int *select_data;
+  const int *fetch_data;           // NULL when producing positions
+  const PackedInts *fetch_packed;  // decoded instead of `fetch_data` when set
+  Bitmap select_bits;     // rows of an encoded select feeding a fetch, by block
+  int **morsel_out;       // per-morsel output, or NULL when only aggregating
+  uint64_t *bits;         // bitmap output of a select, instead of `morsel_out`
+  size_t *morsel_counts;
+  int64_t *morsel_sums;
+  long *morsel_mins;
+  long *morsel_maxs;
+} PipelineArgs;
+
+/**
+ * @brief Writes the fetched values of the qualifying rows of a block to `values` when
+ * the select or the fetch column is encoded. An encoded select is evaluated to the
+ * block's words of `select_bits` and the values are gathered through them, without
+ * listing positions. An encoded fetch column decodes the whole block into `decoded`
+ * once enough of its rows qualify, and only those rows otherwise.
+ *
+ * @return the number of values written
+ */
+static size_t encoded_block_values(const PipelineArgs *p, size_t block, size_t block_end,
+                                   int *values, int *decoded) {
+  const PendingResult *pending = p->pending;
+  if (!p->select_bits.words) {
+    size_t n = scan_range(p->select_data, block, block_end, pending->low, pending->high,
+                          NULL, values);
+    if (n >= (block_end - block) / PIPELINE_DECODE_RATIO) {
+      packed_decode(p->fetch_packed, block, block_end, decoded);
+      for (size_t i = 0; i < n; i++) values[i] = decoded[values[i] - block];
+    } else {
+      for (size_t i = 0; i < n; i++) values[i] = packed_get(p->fetch_packed, values[i]);
+    }
+    return n;
+  }
+
+  size_t n = column_scan_range_bits(pending->select_col, block, block_end, pending->low,
+                                    pending->high, p->select_bits.words);
+  if (!p->fetch_packed) {
+    return bitmap_gather(&p->select_bits, block, block_end, p->fetch_data, values);
+  }
+  if (n < (block_end - block) / PIPELINE_DECODE_RATIO) {
+    bitmap_positions(&p->select_bits, block, block_end, values);
+    for (size_t i = 0; i < n; i++) values[i] = packed_get(p->fetch_packed, values[i]);
+    return n;
+  }
+  // blocks start on word boundaries, so the block's words are a bitmap of their own
+  Bitmap block_bits = {.words = p->select_bits.words + block / 64,
+                       .num_bits = block_end - block};
+  packed_decode(p->fetch_packed, block, block_end, decoded);
+  return bitmap_gather(&block_bits, 0, block_end - block, decoded, values);
+}
+
+// Runs the fused scan over one morsel, one L1-sized block of positions at a time
+static void pipeline_morsel(size_t start_idx, size_t end_idx, void *args) {
+  PipelineArgs *p = (PipelineArgs *)args;
+  size_t m = start_idx / MORSEL_SIZE;
+  int positions[PIPELINE_BLOCK_SIZE];
+  int decoded[PIPELINE_BLOCK_SIZE];
+  int *out = p->morsel_out ? p->morsel_out[m] : NULL;
+  int encoded = p->select_bits.words || p->fetch_packed;
+
+  size_t count = 0;
+  int64_t sum = 0;
+  long min_value = LONG_MAX, max_value = LONG_MIN;
+  // Morsels line up with zones, so a whole morsel is skipped or scanned
+  if (!zone_map_may_match(p->pending->select_col, start_idx, end_idx, p->pending->low,
+                          p->pending->high)) {
+    end_idx = start_idx;
+  }
+  // Morsels also start on word boundaries, so each writes its own words of the bitmap;
+  // a skipped morsel's words stay clear
+  if (p->bits) {
+    p->morsel_counts[m] =
+        start_idx < end_idx
+            ? column_scan_range_bits(p->pending->select_col, start_idx, end_idx,
+                                     p->pending->low, p->pending->high, p->bits)
+            : 0;
+    return;
+  }
+  for (size_t block = start_idx; block < end_idx; block += PIPELINE_BLOCK_SIZE) {
+    size_t block_end =
+        block + PIPELINE_BLOCK_SIZE < end_idx ? block + PIPELINE_BLOCK_SIZE : end_idx;
+    if (!p->fetch_data) {
+      size_t n = column_scan_range(p->pending->select_col, block, block_end,
+                                   p->pending->low, p->pending->high, positions);
+      if (out) memcpy(out + count, positions, sizeof(int) * n);
+      count += n;
+      continue;
+    }
+    if (encoded) {
+      size_t n = encoded_block_values(p, block, block_end, positions, decoded);
+      for (size_t i = 0; i < n; i++) {
+        int value = positions[i];
+        if (out) out[count + i] = value;
+        sum += value;
+        if (value < min_value) min_value = value;
+        if (value > max_value) max_value = value;
+      }
+      count += n;
+      continue;
+    }
+    size_t n = scan_range(p->select_data, block, block_end, p->pending->low,
+                          p->pending->high, NULL, positions);
+    for (size_t i = 0; i < n; i++) {
+      int value = p->fetch_data[positions[i]];
+      if (out) out[count + i] = value;
+      sum += value;
+      if (value < min_value) min_value = value;
+      if (value > max_value) max_value = value;
+    }
+    count += n;
+  }
+  p->morsel_counts[m] = count;
+  p->morsel_sums[m] = sum;
+  p->morsel_mins[m] = min_value;
+  p->morsel_maxs[m] = max_value;
+}
+
+/**
+ * @brief `run_pipeline` for a select over a run-length encoded column. The select is
+ * answered a run at a time as row ranges, which a select handle keeps as its result (see
+ * positions.h). A fetch copies each range, and aggregates it a run at a time when the
+ * fetched column has runs too, never looking at single rows.
+ */
+static int run_ranges(Column *handle, int materialize, Arena *scratch) {
+  PendingResult *pending = handle->pending;
+  const RunLengths *runs = pending->select_col->runs;
+  size_t n_rows = pending->is_empty ? 0 : pending->num_rows;
+  // never more ranges than runs
+  size_t *starts = arena_alloc(scratch, sizeof(size_t) * (runs->num_runs + 1), 64);
+  size_t *ends = arena_alloc(scratch, sizeof(size_t) * (runs->num_runs + 1), 64);
+  if (!starts || !ends) {
+    log_err("run_ranges: out of memory for %s\n", handle->name);
+    return -1;
+  }
+  size_t n_ranges =
+      rle_select_ranges(runs, 0, n_rows, pending->low, pending->high, starts, ends);
+  size_t total = 0;
+  for (size_t r = 0; r < n_ranges; r++) total += ends[r] - starts[r];
+
+  Column *fetch_col = pending->fetch_col;
+  PositionRanges *ranges = NULL;
+  int *data = NULL;
+  if (materialize && !fetch_col) {
+    ranges = positions_ranges_create(n_ranges);
+    if (!ranges) {
+      log_err("run_ranges: out of memory for %s\n", handle->name);
+      return -1;
+    }
+    memcpy(ranges->starts, starts, sizeof(size_t) * n_ranges);
+    memcpy(ranges->ends, ends, sizeof(size_t) * n_ranges);
+    ranges->num_ranges = n_ranges;
+  } else if (materialize) {
+    // Keep at least one slot so an empty result still owns its buffer
+    data = malloc(sizeof(int) * (total ? total : 1));
+    if (!data) {
+      log_err("run_ranges: out of memory for %s\n", handle->name);
+      return -1;
+    }
+  }
+
+  // An empty result keeps the inverted bounds, as in run_pipeline, but over a clustered
+  // column the bounds stay 0, as exec_fetch leaves them after the index lookup this
+  // select replaces
+  handle->num_elements = total;
+  handle->sum = 0;
+  const ColumnIndex *index = pending->select_col->index;
+  if (fetch_col && (total > 0 || !index || index->idx_type == NONE)) {
+    long min_value = fetch_col->max_value, max_value = fetch_col->min_value;
+    size_t k = 0;
+    for (size_t r = 0; r < n_ranges; r++) {
+      column_range_stats(fetch_col, starts[r], ends[r], &handle->sum, &min_value,
+                         &max_value);
+      if (data) column_decode(fetch_col, starts[r], ends[r], data + k);
+      k += ends[r] - starts[r];
+    }
+    handle->min_value = min_value;
+    handle->max_value = max_value;
+  }
+  pending->has_stats = 1;
+  if (materialize) {
+    handle->data_type = INT;
+    handle->data = data;
+    handle->ranges = ranges;
+  }
+  return 0;
+}
+
+/**
+ * @brief Runs the pipeline of `handle` over its rows and sets its statistics. With
+ * `materialize`, also writes its positions (select) or values (fetch) to `handle->data`;
+ * a select that is expected to qualify many rows gets a bitmap instead, and one over a
+ * run-length encoded column gets row ranges (see positions.h).
+ */
+static int run_pipeline(Column *handle, int materialize, int is_single_core,
+                        Arena *scratch) {
+  PendingResult *pending = handle->pending;
+  if (pending->select_col->runs) return run_ranges(handle, materialize, scratch);
+  size_t n_rows = pending->is_empty ? 0 : pending->num_rows;
+  size_t n_morsels = num_morsels(n_rows, MORSEL_SIZE);
+  ThreadPool *pool =
+      n_rows >= NUM_ELEMENTS_TO_MULTITHREAD && !is_single_core ? g_thread_pool : NULL;
+  Bitmap *bitmap = NULL;
+  if (materialize && !pending->fetch_col &&
+      positions_use_bitmap(
+          zone_map_estimate(pending->select_col, n_rows, pending->low, pending->high),
+          n_rows)) {
+    bitmap = bitmap_create(n_rows);
+    if (!bitmap) {
+      log_err("run_pipeline: out of memory for %s\n", handle->name);
+      return -1;
+    }
+  }
+
+  PipelineArgs args = {
+      .pending = pending,
+      .select_data = (const int *)pending->select_col->data,
+      .fetch_data = pending->fetch_col ? (const int *)pending->fetch_col->data : NULL,
+      .fetch_packed = pending->fetch_col ? pending->fetch_col->packed : NULL,
+      .morsel_out = materialize && !bitmap
+                        ? arena_alloc(scratch, sizeof(int *) * (n_morsels + 1), 64)
+                        : NULL,
+      .bits = bitmap ? bitmap->words : NULL,
+      .morsel_counts = arena_alloc(scratch, sizeof(size_t) * (n_morsels + 1), 64),
+      .morsel_sums = arena_alloc(scratch, sizeof(int64_t) * (n_morsels + 1), 64),
+      .morsel_mins = arena_alloc(scratch, sizeof(long) * (n_morsels + 1), 64),
+      .morsel_maxs = arena_alloc(scratch, sizeof(long) * (n_morsels + 1), 64),
+  };
+  int status = 0;
+  if (pending->fetch_col && column_is_encoded(pending->select_col) && n_rows > 0) {
+    args.select_bits.num_bits = n_rows;
+    args.select_bits.words =
+        arena_alloc(scratch, sizeof(uint64_t) * bitmap_num_words(n_rows), 64);
+    if (!args.select_bits.words) status = -1;
+  }
+  if ((materialize && !bitmap && !args.morsel_out) || !args.morsel_counts ||
+      !args.morsel_sums ||
+      !args.morsel_mins || !args.morsel_maxs) {
+    status = -1;
+  }
+  for (size_t m = 0; status == 0 && args.morsel_out && m < n_morsels; m++) {
+    size_t rows = m + 1 < n_morsels ? MORSEL_SIZE : n_rows - m * MORSEL_SIZE;
+    args.morsel_out[m] = arena_alloc(scratch, sizeof(int) * rows, 64);
+    if (!args.morsel_out[m]) status = -1;
+  }
+  if (status == 0 &&
+      threadpool_parallel_for(pool, n_rows, MORSEL_SIZE, pipeline_morsel, &args) != 0) {
+    status = -1;
+  }
+
+  size_t total = 0;
+  for (size_t m = 0; status == 0 && m < n_morsels; m++) total += args.morsel_counts[m];
+  int *data = NULL;
+  if (status == 0 && args.morsel_out) {
+    // Keep at least one slot so an empty result still owns its buffer
+    data = malloc(sizeof(int) * (total ? total : 1));
+    if (!data) status = -1;
+  }
+
+  if (status == 0) {
+    // Same conventions as exec_fetch: an empty result keeps the inverted bounds
+    handle->num_elements = total;
+    handle->sum = 0;
+    if (pending->fetch_col) {
+      handle->min_value = pending->fetch_col->max_value;
+      handle->max_value = pending->fetch_col->min_value;
+    }
+    size_t k = 0;
+    for (size_t m = 0; m < n_morsels; m++) {
+      if (data) memcpy(data + k, args.morsel_out[m], sizeof(int) * args.morsel_counts[m]);
+      k += args.morsel_counts[m];
+      if (!pending->fetch_col || args.morsel_counts[m] == 0) continue;
+      handle->sum += args.morsel_sums[m];
+      if (args.morsel_mins[m] < handle->min_value) handle->min_value = args.morsel_mins[m];
+      if (args.morsel_maxs[m] > handle->max_value) handle->max_value = args.morsel_maxs[m];
+    }
+    pending->has_stats = 1;
+    if (materialize) {
+      handle->data_type = INT;
+      handle->data = data;
+      handle->bitmap = bitmap;
+    }
+  } else {
+    bitmap_destroy(bitmap);
+  }
+
+  if (status != 0) log_err("run_pipeline: out of memory for %s\n", handle->name);
+  return status;
+}
+
+int pipeline_compute_stats(Column *handle, int is_single_core, Arena *scratch) {
+  if (!handle || !handle->pending) return -1;
+  if (handle->pending->has_stats) return 0;
+  double t0 = get_time();
+  int status = run_pipeline(handle, 0, is_single_core, scratch);
+  log_perf("pipeline_compute_stats: %zu of %zu rows qualified in %.6fμs\n",
+           handle->num_elements, handle->pending->num_rows, get_time() - t0);
+  return status;
+}
+
+int pipeline_materialize(Column *handle, int is_single_core, Arena *scratch) {
+  if (!handle || !handle->pending) return 0;
+  if (run_pipeline(handle, 1, is_single_core, scratch) != 0) return -1;
+  log_info("pipeline_materialize: materialized %zu elements of %s as a %s\n",
+           handle->num_elements, handle->name,
+           handle->bitmap ? "bitmap" : handle->ranges ? "ranges" : "list");
+  free(handle->pending);
+  handle->pending = NULL;
+  return 0;
+}
@@ -0,0 +1,112 @@
+#include "positions.h"
+
+#include <string.h>
+
+#include "utils.h"
+
+// Shared by all morsel tasks decoding one bitmap
+typedef struct {
+  const Bitmap *bitmap;
+  const size_t *ranks;
+  int *out;
+} DecodeArgs;
+
+static void decode_morsel(size_t start_idx, size_t end_idx, void *args) {
+  DecodeArgs *decode = (DecodeArgs *)args;
+  size_t m = start_idx / MORSEL_SIZE;
+  bitmap_positions(decode->bitmap, start_idx, end_idx, decode->out + decode->ranks[m]);
+}
+
+bool positions_use_bitmap(double est_matches, size_t num_rows) {
+  return num_rows > 0 && est_matches >= num_rows * BITMAP_MIN_SELECTIVITY;
+}
+
+size_t *positions_morsel_ranks(const Bitmap *bitmap, Arena *scratch) {
+  size_t n_morsels = num_morsels(bitmap->num_bits, MORSEL_SIZE);
+  size_t *ranks = arena_alloc(scratch, sizeof(size_t) * (n_morsels + 1), 64);
+  if (!ranks) return NULL;
+  ranks[0] = 0;
+  for (size_t m = 0; m < n_morsels; m++) {
+    size_t end = (m + 1) * MORSEL_SIZE < bitmap->num_bits ? (m + 1) * MORSEL_SIZE
+                                                          : bitmap->num_bits;
+    ranks[m + 1] = ranks[m] + bitmap_count(bitmap, m * MORSEL_SIZE, end);
+  }
+  return ranks;
+}
+
+// Writes the positions of `bitmap` to `out`, one morsel per task
+static int decode_bitmap(const Bitmap *bitmap, int is_single_core, Arena *scratch,
+                         int *out) {
+  DecodeArgs args = {bitmap, positions_morsel_ranks(bitmap, scratch), out};
+  if (!args.ranks) return -1;
+  ThreadPool *pool = bitmap->num_bits >= NUM_ELEMENTS_TO_MULTITHREAD && !is_single_core
+                         ? g_thread_pool
+                         : NULL;
+  return threadpool_parallel_for(pool, bitmap->num_bits, MORSEL_SIZE, decode_morsel,
+                                 &args);
+}
+
+// Writes the rows of every range of `ranges` to `out`
+static void decode_ranges(const PositionRanges *ranges, int *out) {
+  for (size_t r = 0; r < ranges->num_ranges; r++) {
+    for (size_t row = ranges->starts[r]; row < ranges->ends[r]; row++) *out++ = (int)row;
+  }
+}
+
+// Writes the positions of a bitmap or ranges handle to `out`
+static int decode_handle(const Column *handle, int is_single_core, Arena *scratch,
+                         int *out) {
+  if (handle->ranges) {
+    decode_ranges(handle->ranges, out);
+    return 0;
+  }
+  return decode_bitmap(handle->bitmap, is_single_core, scratch, out);
+}
+
+PositionRanges *positions_ranges_create(size_t capacity) {
+  PositionRanges *ranges = calloc(1, sizeof(PositionRanges));
+  if (!ranges) return NULL;
+  ranges->starts = malloc(sizeof(size_t) * (capacity ? capacity : 1));
+  ranges->ends = malloc(sizeof(size_t) * (capacity ? capacity : 1));
+  if (!ranges->starts || !ranges->ends) {
+    positions_ranges_destroy(ranges);
+    return NULL;
+  }
+  return ranges;
+}
+
+void positions_ranges_destroy(PositionRanges *ranges) {
+  if (!ranges) return;
+  free(ranges->starts);
+  free(ranges->ends);
+  free(ranges);
+}
+
+const int *positions_list(const Column *handle, int is_single_core, Arena *scratch) {
+  if (!handle->bitmap && !handle->ranges) return (const int *)handle->data;
+  size_t n = handle->num_elements ? handle->num_elements : 1;
+  int *positions = arena_alloc(scratch, sizeof(int) * n, 64);
+  if (!positions || decode_handle(handle, is_single_core, scratch, positions) != 0) {
+    log_err("positions_list: failed to decode the positions of %s\n", handle->name);
+    return NULL;
+  }
+  return positions;
+}
+
+int positions_expand(Column *handle, int is_single_core, Arena *scratch) {
+  if (!handle->bitmap && !handle->ranges) return 0;
+  // Keep at least one slot so an empty result still owns its buffer
+  int *positions = malloc(sizeof(int) * (handle->num_elements ? handle->num_elements : 1));
+  if (!positions || decode_handle(handle, is_single_core, scratch, positions) != 0) {
+    free(positions);
+    log_err("positions_expand: failed to expand the positions of %s\n", handle->name);
+    return -1;
+  }
+  bitmap_destroy(handle->bitmap);
+  handle->bitmap = NULL;
+  positions_ranges_destroy(handle->ranges);
+  handle->ranges = NULL;
+  handle->data = positions;
+  log_info("positions_expand: %zu positions of %s\n", handle->num_elements, handle->name);
+  return 0;
+}
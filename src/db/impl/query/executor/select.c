@@ -1,38 +1,102 @@
-#include <pthread.h>
+#include <limits.h>
+#include <math.h>
 #include <stdbool.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
-#include <unistd.h>
 
 #include "client_context.h"
+#include "column_encoding.h"
 #include "handler.h"
 #include "operators.h"
 #include "optimizer.h"
 #include "parse.h"
+#include "pipeline.h"
+#include "positions.h"
 #include "query_exec.h"
+#include "scan.h"
+#include "typed_kernels.h"
 #include "utils.h"
 #include "vector.h"
+#include "zone_map.h"
 
 #define BLOCK_SIZE 1024       // TODO: adjust based on L1 cache size
 #define TEMP_BUFFER_SIZE 256  // Size for temporary results
-
-// Define a structure to hold thread-specific results for each query
+// A conjunctive select stops scanning whole blocks for its next predicate and looks up
+// the values of the remaining candidates instead once fewer than 1 row in this many is
+// one
+#define CONJUNCTION_SPARSE_RATIO 16
+// A cracking select puts its positions back in row order through a bitmap of all rows
+// once at least 1 row in this many qualifies, and sorts them below that
+#define CRACK_ORDER_MIN_RATIO 4096
+// Results per query and morsel a shared scan starts with; a morsel that selects more
+// grows its buffer on the worker
+#define SHARED_SCAN_INITIAL_RESULTS 4096
+
+// Results of one morsel of a multi-core select, one array per query
 typedef struct {
-  int **data;            // Array of result arrays, one per query
-  size_t *num_elements;  // Array of element counts, one per query
-} ThreadResultBuffer;
+  int **data;               // Array of result arrays, one per query
+  size_t *num_elements;     // Array of element counts, one per query
+  size_t *capacity;         // Array of result array sizes, one per query
+  size_t initial_capacity;  // arrays still this size live in query scratch
+} MorselResultBuffer;
 
-// Define a structure to pass data to threads
+// Shared by all morsel tasks of one multi-core select
 typedef struct {
   const int *data;
-  size_t start_idx;
-  size_t end_idx;
+  size_t num_elements;
   Comparator **comparators;
-  ThreadResultBuffer *thread_buffers;
+  MorselResultBuffer *morsel_buffers;  // one per morsel
+  size_t num_queries;
+  Column **result_columns;  // used by the merge step
+  size_t **offsets;         // offsets[m][q]: where morsel m's results for q start
+  int failed;               // set by a morsel that could not grow its results
+} SelectMorselArgs;
+
+// The selects of a batch that read the same values: one column, or for type 2 selects
+// one fetched vector with its positions. Each group is answered by one shared scan.
+typedef struct {
+  const int *data;
+  const int *ref_posns;
+  size_t num_elements;
+  Comparator **comparators;  // the group's slice of the batch's arrays
+  Column **result_columns;
   size_t num_queries;
-} ThreadArgs;
+  SelectMorselArgs args;
+  size_t first_task;  // index of its first morsel among all the groups' morsels
+} SelectGroup;
+
+// Runs `fn` on morsels of several groups as one parallel loop
+typedef struct {
+  SelectGroup *groups;
+  size_t num_groups;
+  range_fn fn;
+} SelectGroupTasks;
+
+// Shared by all morsel tasks of a type 2 select whose positions are a bitmap
+typedef struct {
+  const Bitmap *ref_bitmap;  // rows the values were fetched from
+  const size_t *ranks;       // see positions_morsel_ranks
+  const int *values;         // values[k] belongs to the k-th set bit of `ref_bitmap`
+  int low;
+  int high;
+  uint64_t *out_bits;        // qualifying rows as a bitmap, or
+  int *out_posns;            // as positions, morsel m's from ranks[m] on
+  size_t *morsel_counts;
+} BitmapSelectArgs;
+
+// Shared by all morsel tasks of a conjunctive select
+typedef struct {
+  const Column **cols;  // most selective predicate first
+  const int **values;
+  int *lows;
+  int *highs;
+  size_t num_predicates;
+  uint64_t *out_bits;  // qualifying rows as a bitmap, or
+  int *out_posns;      // as positions, morsel m's from row m * MORSEL_SIZE on
+  size_t *morsel_counts;
+} ConjunctionArgs;
 
 // Function prototypes
 size_t select_values_singlecore(const int *data, size_t num_elements,
@@ -46,10 +110,32 @@ int batch_select_single_core_optimized(const int *data, size_t num_elements,
                                        size_t num_queries);
 int batch_select_multi_core(const int *data, size_t num_elements,
                             Comparator **comparators, Column **result_columns,
-                            size_t num_queries);
+                            size_t num_queries, Arena *scratch);
 
 void double_probe_select(Column *column, Comparator *comparator, Column *result,
                          message *send_message);
+static bool comparator_to_range(Comparator *comparator, int *low, int *high);
+static bool can_defer_select(Column *column, Comparator *comparator);
+static bool uses_zone_map(const int *data, Comparator *comparator);
+static int append_index_delta(Column *column, Comparator *comparator, Column *result);
+static int *copy_result(const int *scratch, size_t n);
+static void select_over_bitmap(DbOperator *query, Column *result,
+                               message *send_message);
+static void select_conjunction(DbOperator *query, Column *result,
+                               message *send_message);
+static void select_cracking(DbOperator *query, Column *result, message *send_message);
+static void select_typed(DbOperator *query, Column *result, message *send_message);
+static int run_select_groups(SelectGroup *groups, size_t num_groups, ThreadPool *pool,
+                             Arena *scratch);
+
+bool select_uses_index(Comparator *comparator) {
+  Column *column = comparator->col;
+  IndexType idx_type = column->index ? column->index->idx_type : NONE;
+  return idx_type != NONE && idx_type != CRACKING_UNCLUSTERED &&
+         column->data_type == INT && !comparator->ref_posns &&
+         !comparator->ref_bitmap && comparator->type1 == GREATER_THAN_OR_EQUAL &&
+         comparator->p_low >= column->min_value && column->index->num_elements > 0;
+}
 
 /**
  * @brief exec_select
@@ -79,15 +165,35 @@ void exec_select(DbOperator *query, message *send_message) {
   }
   result->data_type = INT;  // Select returns an array of indices/integers
 
-  // Allocate memory for the result data
-  //   For simplicity, we will allocate the maximum possible size (for now).
-  //   TODO: replace this with a dynamic array after implementing such a data structure.
-  result->data = malloc(sizeof(int) * n_elts);
-  if (!result->data) {
-    log_err("exec_select: Failed to allocate memory for result data\n");
-    send_message->status = EXECUTION_ERROR;
-    send_message->length = 0;
-    send_message->payload = NULL;
+  if (select_op->predicates) {
+    select_conjunction(query, result, send_message);
+    return;
+  }
+
+  if (column->data_type != INT) {
+    select_typed(query, result, send_message);
+    return;
+  }
+
+  // Leave plain range selects pending: a fetch + aggregate over them then runs as one
+  // fused scan that never builds the position vector (see pipeline.h)
+  if (can_defer_select(column, comparator)) {
+    result->pending = calloc(1, sizeof(PendingResult));
+    if (result->pending) {
+      result->pending->select_col = column;
+      result->pending->num_rows = n_elts;
+      result->pending->is_empty =
+          !comparator_to_range(comparator, &result->pending->low, &result->pending->high);
+      cs165_log(stdout, "exec_select: deferred select over %s\n", column->name);
+      send_message->status = OK_DONE;
+      send_message->payload = "Done";
+      send_message->length = strlen(send_message->payload);
+      return;
+    }
+  }
+
+  if (comparator->ref_bitmap) {
+    select_over_bitmap(query, result, send_message);
     return;
   }
 
@@ -98,17 +204,21 @@ void exec_select(DbOperator *query, message *send_message) {
   //   Since indexes are on catalog columns, this `ref_posns` must always be NULL.
   int using_temp_ref_posns = 0;
 
+  if (column->index && column->index->idx_type == CRACKING_UNCLUSTERED &&
+      !comparator->ref_posns) {
+    select_cracking(query, result, send_message);
+    return;
+  }
+
   if (column->index && column->index->idx_type != NONE && !comparator->ref_posns) {
     //   Milestone 3: Index-based selection
     // double_probe_select(column, comparator, result, send_message);
     // return;
-
     // Get offset: where to start scanning based on the low value
-    if (comparator->type1 == GREATER_THAN_OR_EQUAL &&
-        comparator->p_low >= column->min_value) {
+    if (select_uses_index(comparator)) {
       // since low of query > min_value idx must be found
       size_t start_idx = idx_lookup_left(column, comparator->p_low);
-      n_elts = column->num_elements - start_idx;
+      n_elts = column->index->num_elements - start_idx;
       data = column->index->sorted_data + start_idx;
       using_temp_ref_posns = 1;
       comparator->ref_posns = column->index->positions + start_idx;
@@ -116,26 +226,48 @@ void exec_select(DbOperator *query, message *send_message) {
     }
   }
 
+  Arena *scratch = query->scratch;
   if (n_elts < NUM_ELEMENTS_TO_MULTITHREAD || query->context->is_single_core) {
     //   Milestone 1 : Single - core selection: to avoid the overhead of creating
-    //   threads
-    result->num_elements =
-        select_values_singlecore(data, n_elts, comparator, result->data);
+    //   threads. The scan writes to worst-case-sized query scratch, whose pages later
+    //   queries reuse, and the handle keeps an exact-size copy.
+    int *positions = arena_alloc(scratch, sizeof(int) * (n_elts ? n_elts : 1), 64);
+    if (positions) {
+      result->num_elements =
+          select_values_singlecore(data, n_elts, comparator, positions);
+      result->data = copy_result(positions, result->num_elements);
+    }
+    if (!result->data) {
+      result->num_elements = 0;
+      if (using_temp_ref_posns) comparator->ref_posns = NULL;
+      handle_error(send_message, "Failed to allocate memory for result data");
+      return;
+    }
     log_perf("\nqualifying range: [%ld, %ld]\n", comparator->p_low, comparator->p_high);
     log_perf("selectivity: %d/%zu = %.2f%%\n", result->num_elements, n_elts,
              (double)result->num_elements / n_elts * 100);
   } else {
     //   Milestone 2: Multi-core selection
-    Comparator **comparators = malloc(sizeof(Comparator *));
-    comparators[0] = comparator;
-    Column **result_columns = malloc(sizeof(Column *));
-    result_columns[0] = result;
-    batch_select_multi_core(data, n_elts, comparators, result_columns, 1);
+    Comparator *comparators[] = {comparator};
+    Column *result_columns[] = {result};
+    if (batch_select_multi_core(data, n_elts, comparators, result_columns, 1, scratch) !=
+        0) {
+      if (using_temp_ref_posns) comparator->ref_posns = NULL;
+      handle_error(send_message, "Failed to allocate memory for result data");
+      return;
+    }
   }
   log_info("exec_select: Selection operation completed successfully.\n");
 
   //   Reset the temporary reference positions
-  if (using_temp_ref_posns) comparator->ref_posns = NULL;
+  if (using_temp_ref_posns) {
+    comparator->ref_posns = NULL;
+    // rows inserted since the index was built are only in its delta
+    if (append_index_delta(column, comparator, result) != 0) {
+      handle_error(send_message, "Failed to allocate memory for result data");
+      return;
+    }
+  }
 
   //   set send_message
   send_message->status = OK_DONE;
@@ -144,26 +276,562 @@ void exec_select(DbOperator *query, message *send_message) {
   return;
 }
 
-void exec_batch_select(DbOperator *query, message *send_message) {
-  Vector *batch_queries = query->context->bselect_dbos;
-  if (!batch_queries || vector_size(batch_queries) == 0) {
+// The largest double below `x`, for the exclusive high bound of a select
+static double double_below(double x) {
+  if (x != x || x == -INFINITY) return x;
+  if (x == 0) return -0x1p-1074;
+  uint64_t bits;
+  memcpy(&bits, &x, sizeof(bits));
+  bits += x > 0 ? -1 : 1;  // the magnitude shrinks above 0 and grows below it
+  memcpy(&x, &bits, sizeof(x));
+  return x;
+}
+
+/**
+ * @brief Selects the rows of `[0, n)` with `low <= data[i] <= high`, or their
+ * `ref_posns`. The first `sorted` rows (always 0 with `ref_posns`) are found by binary
+ * search: in `index_values`, the sorted values of an unclustered index whose rows are
+ * `index_posns`, or in `data` itself when it is in ascending order up to there
+ * (`index_values` NULL). Only the rest is scanned.
+ */
+#define DEFINE_SELECT_SORTED_PREFIX(T, NAME)                                           \
+  static size_t select_sorted_prefix_##NAME(                                          \
+      const T *data, size_t n, size_t sorted, const T *index_values,                  \
+      const int *index_posns, T low, T high, const int *ref_posns, int *out) {        \
+    size_t k = 0;                                                                     \
+    const T *search = index_values ? index_values : data;                             \
+    size_t lo = typed_lower_bound_##NAME(search, sorted, low);                        \
+    size_t hi = typed_upper_bound_##NAME(search, sorted, high);                       \
+    for (size_t i = lo; i < hi; i++) out[k++] = index_posns ? index_posns[i] : (int)i; \
+    size_t tail = typed_select_##NAME(data + sorted, n - sorted, low, high, ref_posns, \
+                                      out + k);                                       \
+    if (sorted > 0) {                                                                 \
+      for (size_t i = k; i < k + tail; i++) out[i] += (int)sorted;                    \
+    }                                                                                 \
+    return k + tail;                                                                  \
+  }
+
+DEFINE_SELECT_SORTED_PREFIX(long, long)
+DEFINE_SELECT_SORTED_PREFIX(double, double)
+
+/**
+ * @brief Select over a LONG or DOUBLE column or handle, single-core with the typed
+ * kernels. A base column with a clustered index is binary-searched up to where its data
+ * stops being sorted (all of it once clustered), one with an unclustered index through
+ * the index's sorted values (see `create_idx_on`); the rows past either are scanned.
+ */
+static void select_typed(DbOperator *query, Column *result, message *send_message) {
+  Comparator *comparator = query->operator_fields.select_operator.comparator;
+  Column *column = comparator->col;
+  size_t n = column->num_elements;
+  Arena *scratch = query->scratch;
+
+  const int *ref_posns = comparator->ref_posns;
+  if (comparator->ref_bitmap) {
+    int *positions = arena_alloc(scratch, sizeof(int) * (n ? n : 1), 64);
+    if (!positions) {
+      handle_error(send_message, "Failed to allocate memory for result data");
+      return;
+    }
+    bitmap_positions(comparator->ref_bitmap, 0, comparator->ref_bitmap->num_bits,
+                     positions);
+    ref_posns = positions;
+  }
+  size_t sorted = 0;
+  const void *index_values = NULL;
+  const int *index_posns = NULL;
+  if (!ref_posns && column->index && column->index->idx_type != NONE) {
+    sorted = column->index->num_elements < n ? column->index->num_elements : n;
+    index_values = column->index->typed_sorted;
+    if (index_values) index_posns = column->index->positions;
+  }
+
+  int *positions = arena_alloc(scratch, sizeof(int) * (n ? n : 1), 64);
+  if (!positions) {
+    handle_error(send_message, "Failed to allocate memory for result data");
+    return;
+  }
+  bool has_low = comparator->type1 != NO_COMPARISON;
+  bool has_high = comparator->type2 != NO_COMPARISON;
+  if (column->data_type == LONG) {
+    long low = has_low ? comparator->p_low : LONG_MIN;
+    long high = has_high ? comparator->p_high - 1 : LONG_MAX;
+    if (has_high && comparator->p_high == LONG_MIN) {
+      result->num_elements = 0;  // nothing is below the smallest long
+    } else {
+      result->num_elements =
+          select_sorted_prefix_long(column->data, n, sorted, index_values, index_posns,
+                                    low, high, ref_posns, positions);
+    }
+  } else {
+    double low = has_low ? comparator->d_low : -INFINITY;
+    double high = has_high ? double_below(comparator->d_high) : INFINITY;
+    if (has_high && comparator->d_high == -INFINITY) {
+      result->num_elements = 0;
+    } else {
+      result->num_elements =
+          select_sorted_prefix_double(column->data, n, sorted, index_values,
+                                      index_posns, low, high, ref_posns, positions);
+    }
+  }
+  result->data = copy_result(positions, result->num_elements);
+  if (!result->data) {
+    result->num_elements = 0;
+    handle_error(send_message, "Failed to allocate memory for result data");
+    return;
+  }
+  log_perf("select_typed: %zu of %zu %s values of %s qualify (%zu sorted)\n",
+           result->num_elements, n, data_type_name(column->data_type), column->name,
+           sorted);
+  send_message->status = OK_DONE;
+  send_message->payload = "Done";
+  send_message->length = strlen(send_message->payload);
+}
+
+/**
+ * @brief Exact-size copy of `n` positions selected into query scratch; the copy is what
+ * a result handle keeps.
+ */
+static int *copy_result(const int *scratch, size_t n) {
+  // Keep at least one slot so a select with no matches still owns a buffer
+  int *data = malloc(sizeof(int) * (n ? n : 1));
+  if (data) memcpy(data, scratch, sizeof(int) * n);
+  return data;
+}
+
+static int compare_positions(const void *a, const void *b) {
+  int x = *(const int *)a, y = *(const int *)b;
+  return (x > y) - (x < y);
+}
+
+/**
+ * @brief Puts many positions of a cracker piece in row order by setting their bits in a
+ * bitmap over the column's rows. The result keeps the bitmap if it is dense enough, or
+ * its decoded list otherwise.
+ */
+static int order_cracked_positions(const int *positions, size_t count, size_t n_rows,
+                                   Column *result) {
+  Bitmap *bitmap = bitmap_create(n_rows);
+  if (!bitmap) return -1;
+  for (size_t i = 0; i < count; i++) bitmap_set(bitmap, positions[i]);
+  if (positions_use_bitmap(count, n_rows)) {
+    result->bitmap = bitmap;
+    return 0;
+  }
+  result->data = malloc(sizeof(int) * count);
+  if (result->data) bitmap_positions(bitmap, 0, n_rows, result->data);
+  bitmap_destroy(bitmap);
+  return result->data ? 0 : -1;
+}
+
+/**
+ * @brief Select over a column with a cracking index: the index cracks its cracker
+ * column around the bounds and the qualifying rows come out of one piece of it. The
+ * piece holds them in no particular order, so they are put back in row order, like
+ * every other select result: by sorting them when few, and through a bitmap when many.
+ */
+static void select_cracking(DbOperator *query, Column *result, message *send_message) {
+  Comparator *comparator = query->operator_fields.select_operator.comparator;
+  Column *column = comparator->col;
+  size_t n_elts = column->num_elements;
+  int low, high;
+  size_t count = 0;
+  int *positions = arena_alloc(query->scratch, sizeof(int) * (n_elts ? n_elts : 1), 64);
+  if (positions && comparator_to_range(comparator, &low, &high) &&
+      index_crack_select(column, low, high, positions, &count) != 0) {
+    positions = NULL;
+  }
+  int failed = !positions;
+  if (!failed && count >= n_elts / CRACK_ORDER_MIN_RATIO && count > 0) {
+    failed = order_cracked_positions(positions, count, n_elts, result) != 0;
+  } else if (!failed) {
+    qsort(positions, count, sizeof(int), compare_positions);
+    result->data = copy_result(positions, count);
+    failed = !result->data;
+  }
+  if (failed) {
+    handle_error(send_message, "Failed to allocate memory for result data");
+    return;
+  }
+  result->num_elements = count;
+  log_perf("selectivity: %zu/%zu = %.2f%% by cracking\n", count, n_elts,
+           n_elts ? (double)count / n_elts * 100 : 0.0);
+
+  send_message->status = OK_DONE;
+  send_message->payload = "Done";
+  send_message->length = strlen(send_message->payload);
+}
+
+/**
+ * @brief Appends the index-delta rows that satisfy `comparator` to an index scan's
+ * `result`.
+ */
+static int append_index_delta(Column *column, Comparator *comparator, Column *result) {
+  int low, high;
+  size_t delta_size = column->index->delta_size;
+  if (delta_size == 0 || !comparator_to_range(comparator, &low, &high)) return 0;
+  // results are allocated to their exact size, so grow them for the delta rows
+  int *grown = realloc(result->data, sizeof(int) * (result->num_elements + delta_size));
+  if (!grown) return -1;
+  result->data = grown;
+  result->num_elements +=
+      index_delta_select(column, low, high, grown + result->num_elements);
+  return 0;
+}
+
+/**
+ * @brief Selects the values of one morsel of rows of the position bitmap, one block of
+ * rows at a time: the block's positions are decoded into L1, and the vectorized kernel
+ * scans the block's values with them as reference positions.
+ */
+static void select_bitmap_morsel(size_t start_idx, size_t end_idx, void *args) {
+  BitmapSelectArgs *select_args = (BitmapSelectArgs *)args;
+  size_t m = start_idx / MORSEL_SIZE;
+  size_t rank = select_args->ranks[m];
+  int *out = select_args->out_posns ? select_args->out_posns + rank : NULL;
+  int positions[BLOCK_SIZE];
+  int qualifying[BLOCK_SIZE];
+
+  size_t count = 0;
+  for (size_t block = start_idx; block < end_idx; block += BLOCK_SIZE) {
+    size_t block_end = end_idx - block < BLOCK_SIZE ? end_idx : block + BLOCK_SIZE;
+    size_t n = bitmap_positions(select_args->ref_bitmap, block, block_end, positions);
+    if (n == 0) continue;
+    // the block's values are the n that follow the ones of the rows before it
+    size_t found =
+        scan_range(select_args->values + rank, 0, n, select_args->low, select_args->high,
+                   positions, out ? out + count : qualifying);
+    if (select_args->out_bits) {
+      for (size_t i = 0; i < found; i++) {
+        select_args->out_bits[qualifying[i] / 64] |= 1ULL << (qualifying[i] % 64);
+      }
+    }
+    count += found;
+    rank += n;
+  }
+  select_args->morsel_counts[m] = count;
+}
+
+/**
+ * @brief Type 2 select whose positions are a bitmap: walks the bitmap and its values
+ * together and keeps the rows whose value qualifies, as a bitmap over the same rows if
+ * many are expected to qualify and as a position list otherwise. Either way, no
+ * position list of the input is built.
+ */
+static void select_over_bitmap(DbOperator *query, Column *result,
+                               message *send_message) {
+  Comparator *comparator = query->operator_fields.select_operator.comparator;
+  const Column *values = comparator->col;
+  const Bitmap *ref_bitmap = comparator->ref_bitmap;
+  Arena *scratch = query->scratch;
+  size_t n_rows = ref_bitmap->num_bits;
+  size_t n_morsels = num_morsels(n_rows, MORSEL_SIZE);
+
+  BitmapSelectArgs args = {
+      .ref_bitmap = ref_bitmap,
+      .ranks = positions_morsel_ranks(ref_bitmap, scratch),
+      .values = (const int *)values->data,
+      .morsel_counts = arena_alloc(scratch, sizeof(size_t) * (n_morsels + 1), 64),
+  };
+  if (!args.ranks || !args.morsel_counts) {
+    handle_error(send_message, "Failed to allocate memory for result data");
+    return;
+  }
+  if (args.ranks[n_morsels] != values->num_elements) {
+    handle_error(send_message, "Positions and values differ in length");
+    return;
+  }
+
+  Bitmap *bitmap = NULL;
+  bool qualifies = comparator_to_range(comparator, &args.low, &args.high);
+  if (qualifies && positions_use_bitmap(
+                       estimate_range_rows(values->min_value, values->max_value,
+                                           values->num_elements, args.low, args.high),
+                       n_rows)) {
+    bitmap = bitmap_create(n_rows);
+    args.out_bits = bitmap ? bitmap->words : NULL;
+  } else if (qualifies) {
+    args.out_posns = arena_alloc(
+        scratch, sizeof(int) * (values->num_elements ? values->num_elements : 1), 64);
+  }
+  if (qualifies && !args.out_bits && !args.out_posns) {
+    handle_error(send_message, "Failed to allocate memory for result data");
+    return;
+  }
+
+  ThreadPool *pool =
+      n_rows >= NUM_ELEMENTS_TO_MULTITHREAD && !query->context->is_single_core
+          ? g_thread_pool
+          : NULL;
+  if (qualifies &&
+      threadpool_parallel_for(pool, n_rows, MORSEL_SIZE, select_bitmap_morsel, &args) !=
+          0) {
+    bitmap_destroy(bitmap);
+    handle_error(send_message, "Failed to select over position bitmap");
+    return;
+  }
+
+  size_t total = 0;
+  for (size_t m = 0; qualifies && m < n_morsels; m++) total += args.morsel_counts[m];
+  if (bitmap) {
+    result->bitmap = bitmap;
+  } else {
+    // the morsels' positions are compacted at their input ranks; close the gaps
+    result->data = malloc(sizeof(int) * (total ? total : 1));
+    if (!result->data) {
+      handle_error(send_message, "Failed to allocate memory for result data");
+      return;
+    }
+    size_t k = 0;
+    for (size_t m = 0; qualifies && m < n_morsels; m++) {
+      memcpy((int *)result->data + k, args.out_posns + args.ranks[m],
+             sizeof(int) * args.morsel_counts[m]);
+      k += args.morsel_counts[m];
+    }
+  }
+  result->num_elements = total;
+  log_perf("selectivity: %zu/%zu = %.2f%% as a %s\n", total, values->num_elements,
+           values->num_elements ? (double)total / values->num_elements * 100 : 0.0,
+           bitmap ? "bitmap" : "position list");
+
+  send_message->status = OK_DONE;
+  send_message->payload = "Done";
+  send_message->length = strlen(send_message->payload);
+}
+
+/**
+ * @brief Keeps the `positions` (relative to `values`) whose value is in `[low, high]`,
+ * in place and in order, without a branch on the values.
+ */
+static size_t filter_positions(const int *values, int *positions, size_t n, int low,
+                               int high) {
+  unsigned int width = (unsigned int)high - (unsigned int)low;
+  size_t count = 0;
+  for (size_t i = 0; i < n; i++) {
+    int pos = positions[i];
+    positions[count] = pos;
+    count += ((unsigned int)values[pos] - (unsigned int)low) <= width;
+  }
+  return count;
+}
+
+/**
+ * @brief Evaluates every predicate of a conjunctive select over one morsel, one
+ * `BLOCK_SIZE` block at a time so each predicate reads the block's values while the
+ * candidates are in L1. While many rows are candidates, the next predicate scans the
+ * whole block into match bits with the vectorized kernel and ANDs them in; once few
+ * are, their positions are decoded and only their values are looked up. A block with
+ * no candidates left is not read for the remaining predicates, and a morsel that a
+ * zone map rules out for any predicate is not read at all.
+ */
+static void conjunction_morsel(size_t start_idx, size_t end_idx, void *args) {
+  ConjunctionArgs *conj = (ConjunctionArgs *)args;
+  size_t m = start_idx / MORSEL_SIZE;
+  conj->morsel_counts[m] = 0;
+  for (size_t p = 0; p < conj->num_predicates; p++) {
+    if (!zone_map_may_match(conj->cols[p], start_idx, end_idx, conj->lows[p],
+                            conj->highs[p])) {
+      return;
+    }
+  }
+
+  uint64_t words[BLOCK_SIZE / 64];
+  uint64_t bits[BLOCK_SIZE / 64];
+  int positions[BLOCK_SIZE];
+  int *out = conj->out_posns ? conj->out_posns + start_idx : NULL;
+  size_t count = 0;
+  for (size_t block = start_idx; block < end_idx; block += BLOCK_SIZE) {
+    size_t len = end_idx - block < BLOCK_SIZE ? end_idx - block : BLOCK_SIZE;
+    size_t n_words = bitmap_num_words(len);
+    size_t n = scan_range_bits(conj->values[0] + block, 0, len, conj->lows[0],
+                               conj->highs[0], words);
+    size_t p = 1;
+    for (; p < conj->num_predicates && n > 0 && n * CONJUNCTION_SPARSE_RATIO >= len;
+         p++) {
+      scan_range_bits(conj->values[p] + block, 0, len, conj->lows[p], conj->highs[p],
+                      bits);
+      n = 0;
+      for (size_t w = 0; w < n_words; w++) {
+        words[w] &= bits[w];
+        n += __builtin_popcountll(words[w]);
+      }
+    }
+    if (n == 0) continue;
+
+    // every predicate was ANDed in: the block's words are its result
+    if (p == conj->num_predicates && conj->out_bits) {
+      memcpy(conj->out_bits + block / 64, words, sizeof(uint64_t) * n_words);
+      count += n;
+      continue;
+    }
+
+    Bitmap candidates = {.words = words, .num_bits = len};
+    n = bitmap_positions(&candidates, 0, len, positions);
+    for (; p < conj->num_predicates && n > 0; p++) {
+      n = filter_positions(conj->values[p] + block, positions, n, conj->lows[p],
+                           conj->highs[p]);
+    }
+    for (size_t i = 0; i < n; i++) {
+      size_t row = block + positions[i];
+      if (out) {
+        out[count + i] = (int)row;
+      } else {
+        conj->out_bits[row / 64] |= 1ULL << (row % 64);
+      }
+    }
+    count += n;
+  }
+  conj->morsel_counts[m] = count;
+}
+
+/**
+ * @brief Conjunctive select `select(<col1>,<low1>,<high1>,<col2>,...)`: one pass over
+ * the rows evaluates every predicate, most selective first by the zone-map estimates,
+ * and keeps the rows that satisfy all of them, as a bitmap if many are expected to and
+ * as a position list otherwise. No per-predicate result is materialized.
+ */
+static void select_conjunction(DbOperator *query, Column *result,
+                               message *send_message) {
+  SelectOperator *select_op = &query->operator_fields.select_operator;
+  Arena *scratch = query->scratch;
+  size_t num_predicates = select_op->num_predicates;
+  size_t n_rows = select_op->predicates[0].col->num_elements;
+  size_t n_morsels = num_morsels(n_rows, MORSEL_SIZE);
+
+  ConjunctionArgs args = {
+      .cols = arena_alloc(scratch, sizeof(Column *) * num_predicates, 64),
+      .values = arena_alloc(scratch, sizeof(int *) * num_predicates, 64),
+      .lows = arena_alloc(scratch, sizeof(int) * num_predicates, 64),
+      .highs = arena_alloc(scratch, sizeof(int) * num_predicates, 64),
+      .morsel_counts = arena_alloc(scratch, sizeof(size_t) * (n_morsels + 1), 64),
+  };
+  double *estimates = arena_alloc(scratch, sizeof(double) * num_predicates, 64);
+  if (!args.cols || !args.values || !args.lows || !args.highs || !args.morsel_counts ||
+      !estimates) {
+    handle_error(send_message, "Failed to allocate memory for result data");
+    return;
+  }
+
+  // Order the predicates by their estimated matches (insertion sort: there are few).
+  // One that qualifies every value is left out, and one that qualifies none empties
+  // the result.
+  bool qualifies = true;
+  double est_matches = n_rows;
+  for (size_t i = 0; i < num_predicates; i++) {
+    Comparator *comparator = &select_op->predicates[i];
+    Column *col = comparator->col;
+    if (col->data_type != INT) {
+      handle_error(send_message, "Conjunctive select over a long or double column");
+      return;
+    }
+    if (col->num_elements != n_rows) {
+      handle_error(send_message, "Conjunctive select over columns of different tables");
+      return;
+    }
+    int low, high;
+    if (!comparator_to_range(comparator, &low, &high)) {
+      qualifies = false;
+      continue;
+    }
+    if (low == INT_MIN && high == INT_MAX) continue;
+    double estimate = zone_map_estimate(col, n_rows, low, high);
+    est_matches = n_rows ? est_matches * (estimate / n_rows) : 0;
+    size_t k = args.num_predicates++;
+    for (; k > 0 && estimates[k - 1] > estimate; k--) {
+      args.cols[k] = args.cols[k - 1];
+      args.lows[k] = args.lows[k - 1];
+      args.highs[k] = args.highs[k - 1];
+      estimates[k] = estimates[k - 1];
+    }
+    args.cols[k] = col;
+    args.lows[k] = low;
+    args.highs[k] = high;
+    estimates[k] = estimate;
+  }
+  if (args.num_predicates == 0) {
+    // every row qualifies; scan one column anyway for the result
+    args.cols[0] = select_op->predicates[0].col;
+    args.lows[0] = INT_MIN;
+    args.highs[0] = INT_MAX;
+    args.num_predicates = 1;
+  }
+  for (size_t p = 0; p < args.num_predicates; p++) {
+    args.values[p] = (const int *)args.cols[p]->data;
+  }
+
+  // predicates are taken to be independent, so their selectivities multiply
+  Bitmap *bitmap = NULL;
+  if (qualifies && positions_use_bitmap(est_matches, n_rows)) {
+    bitmap = bitmap_create(n_rows);
+    args.out_bits = bitmap ? bitmap->words : NULL;
+  } else if (qualifies) {
+    args.out_posns = arena_alloc(scratch, sizeof(int) * (n_rows ? n_rows : 1), 64);
+  }
+  if (qualifies && !args.out_bits && !args.out_posns) {
+    handle_error(send_message, "Failed to allocate memory for result data");
+    return;
+  }
+
+  ThreadPool *pool =
+      n_rows >= NUM_ELEMENTS_TO_MULTITHREAD && !query->context->is_single_core
+          ? g_thread_pool
+          : NULL;
+  if (qualifies &&
+      threadpool_parallel_for(pool, n_rows, MORSEL_SIZE, conjunction_morsel, &args) !=
+          0) {
+    bitmap_destroy(bitmap);
+    handle_error(send_message, "Failed to run conjunctive select");
+    return;
+  }
+
+  size_t total = 0;
+  for (size_t m = 0; qualifies && m < n_morsels; m++) total += args.morsel_counts[m];
+  if (bitmap) {
+    result->bitmap = bitmap;
+  } else {
+    // every morsel's positions start at its first row; close the gaps
+    result->data = malloc(sizeof(int) * (total ? total : 1));
+    if (!result->data) {
+      handle_error(send_message, "Failed to allocate memory for result data");
+      return;
+    }
+    size_t k = 0;
+    for (size_t m = 0; qualifies && m < n_morsels; m++) {
+      memcpy((int *)result->data + k, args.out_posns + m * MORSEL_SIZE,
+             sizeof(int) * args.morsel_counts[m]);
+      k += args.morsel_counts[m];
+    }
+  }
+  result->num_elements = total;
+  log_perf("conjunction of %zu predicates: %zu/%zu = %.2f%% as a %s\n",
+           args.num_predicates, total, n_rows,
+           n_rows ? (double)total / n_rows * 100 : 0.0,
+           bitmap ? "bitmap" : "position list");
+
+  send_message->status = OK_DONE;
+  send_message->payload = "Done";
+  send_message->length = strlen(send_message->payload);
+}
+
+/**
+ * @brief Runs selects of a batch. Selects that read the same values share one scan,
+ * and the scans of different columns run in parallel on the pool, so a batch over `k`
+ * columns reads each of them once.
+ */
+void exec_batch_select(DbOperator **selects, size_t num_queries, message *send_message) {
+  if (num_queries == 0) {
     send_message->status = EXECUTION_ERROR;
     send_message->payload = "Empty batch queries";
     send_message->length = strlen(send_message->payload);
     return;
   }
 
-  // Get the column from the first query to determine data size
-  DbOperator *first_query = vector_get(batch_queries, 0);
-  SelectOperator *first_select = &first_query->operator_fields.select_operator;
-  Column *source_column = first_select->comparator->col;
-  size_t num_elements = source_column->num_elements;
-
-  // Create results for all queries in the batch
-  size_t num_queries = vector_size(batch_queries);
-  Column **result_columns = malloc(sizeof(Column *) * num_queries);
-  Comparator **comparators = malloc(sizeof(Comparator *) * num_queries);
-  if (!result_columns || !comparators) {
+  Arena *scratch = selects[0]->scratch;
+  Column **result_columns = arena_alloc(scratch, sizeof(Column *) * num_queries, 64);
+  Comparator **comparators = arena_alloc(scratch, sizeof(Comparator *) * num_queries, 64);
+  SelectGroup *groups = arena_alloc(scratch, sizeof(SelectGroup) * num_queries, 64);
+  size_t *group_of = arena_alloc(scratch, sizeof(size_t) * num_queries, 64);
+  if (!result_columns || !comparators || !groups || !group_of) {
     log_err(
         "exec_batch_select: Memory allocation for result columns or comparators "
         "failed\n");
@@ -173,58 +841,163 @@ void exec_batch_select(DbOperator *query, message *send_message) {
     return;
   }
 
-  // Initialize result columns and comparators
+  // Group the selects by the values they read
+  size_t num_groups = 0;
   for (size_t i = 0; i < num_queries; i++) {
-    DbOperator *curr_query = vector_get(batch_queries, i);
-    SelectOperator *select_op = &curr_query->operator_fields.select_operator;
-
-    result_columns[i] = NULL;
-    if (create_new_handle(select_op->res_handle, &result_columns[i]) != 0) {
-      // Clean up previously allocated columns
-      for (size_t j = 0; j < i; j++) {
-        free(result_columns[j]->data);
-        free(result_columns[j]);
-      }
-      free(result_columns);
+    Comparator *comparator = selects[i]->operator_fields.select_operator.comparator;
+    const int *data = (const int *)comparator->col->data;
+    size_t g = 0;
+    while (g < num_groups &&
+           (groups[g].data != data || groups[g].ref_posns != comparator->ref_posns)) {
+      g++;
+    }
+    if (g == num_groups) {
+      groups[num_groups++] = (SelectGroup){.data = data,
+                                           .ref_posns = comparator->ref_posns,
+                                           .num_elements = comparator->col->num_elements};
+    }
+    group_of[i] = g;
+    groups[g].num_queries++;
+  }
+
+  // Give every group a contiguous slice of the arrays, keeping the batch's order
+  // within it
+  size_t offset = 0;
+  for (size_t g = 0; g < num_groups; g++) {
+    groups[g].comparators = comparators + offset;
+    groups[g].result_columns = result_columns + offset;
+    offset += groups[g].num_queries;
+    groups[g].num_queries = 0;
+  }
+
+  // The handles belong to the client context, so on failure the ones already created
+  // just stay empty
+  for (size_t i = 0; i < num_queries; i++) {
+    SelectOperator *select_op = &selects[i]->operator_fields.select_operator;
+    SelectGroup *group = &groups[group_of[i]];
 
+    Column *result = NULL;
+    if (create_new_handle(select_op->res_handle, &result) != 0) {
       send_message->status = EXECUTION_ERROR;
       send_message->payload = "Failed to create result handle";
       send_message->length = strlen(send_message->payload);
       return;
     }
+    result->data_type = INT;
+    result->num_elements = 0;
+    group->comparators[group->num_queries] = select_op->comparator;
+    group->result_columns[group->num_queries++] = result;
+  }
 
-    result_columns[i]->data_type = INT;
-    result_columns[i]->data = malloc(sizeof(int) * num_elements);
-    result_columns[i]->num_elements = 0;
+  ThreadPool *pool = selects[0]->context->is_single_core ? NULL : g_thread_pool;
+  log_info("exec_batch_select: %zu selects over %zu columns\n", num_queries, num_groups);
+  if (run_select_groups(groups, num_groups, pool, scratch) != 0) {
+    handle_error(send_message, "Failed to allocate memory for result data");
+    return;
+  }
 
-    comparators[i] = select_op->comparator;
+  send_message->status = OK_DONE;
+  send_message->payload = "Batch select completed";
+  send_message->length = strlen(send_message->payload);
+}
 
-    if (!result_columns[i]->data) {
-      // Clean up on failure
-      for (size_t j = 0; j <= i; j++) {
-        free(result_columns[j]->data);
-        free(result_columns[j]);
-      }
-      free(result_columns);
+// Arguments of the tasks that cut the results of `exec_batch_index_select`
+typedef struct {
+  Comparator **comparators;
+  Column **result_columns;
+  size_t *bounds;  // bounds[2q], bounds[2q + 1]: the slice of `positions` of query q
+  int failed;
+} IndexSliceArgs;
+
+static void index_slice_task(size_t q, size_t q_end, void *arg) {
+  IndexSliceArgs *args = (IndexSliceArgs *)arg;
+  (void)q_end;
+  Comparator *comparator = args->comparators[q];
+  Column *column = comparator->col;
+  Column *result = args->result_columns[q];
+  size_t start = args->bounds[2 * q], end = args->bounds[2 * q + 1];
+  result->num_elements = end > start ? end - start : 0;
+  result->data = malloc(sizeof(int) * (result->num_elements ? result->num_elements : 1));
+  if (!result->data) {
+    result->num_elements = 0;
+    args->failed = 1;
+    return;
+  }
+  memcpy(result->data, column->index->positions + start,
+         sizeof(int) * result->num_elements);
+  // rows inserted since the index was built are only in its delta
+  if (append_index_delta(column, comparator, result) != 0) args->failed = 1;
+}
 
-      send_message->status = EXECUTION_ERROR;
-      send_message->payload = "Memory allocation failed";
-      send_message->length = strlen(send_message->payload);
+/**
+ * @brief Runs selects of a batch that an index answers (see `select_uses_index`). Each
+ * query's range is a slice of its index's `positions`, so the bounds of all the
+ * queries on a column are looked up together (see `idx_lower_bounds`) rather than
+ * with a descent each, and the slices are then copied out in parallel. The results
+ * are the ones `exec_select` gives: positions in value order, then the delta rows.
+ */
+void exec_batch_index_select(DbOperator **selects, size_t num_queries,
+                             message *send_message) {
+  Arena *scratch = selects[0]->scratch;
+  Comparator **comparators = arena_alloc(scratch, sizeof(Comparator *) * num_queries, 64);
+  Column **result_columns = arena_alloc(scratch, sizeof(Column *) * num_queries, 64);
+  int *keys = arena_alloc(scratch, sizeof(int) * 2 * num_queries, 64);
+  size_t *key_slots = arena_alloc(scratch, sizeof(size_t) * 2 * num_queries, 64);
+  size_t *found = arena_alloc(scratch, sizeof(size_t) * 2 * num_queries, 64);
+  size_t *bounds = arena_alloc(scratch, sizeof(size_t) * 2 * num_queries, 64);
+  unsigned char *done = arena_alloc(scratch, num_queries, 64);
+  if (!comparators || !result_columns || !keys || !key_slots || !found || !bounds ||
+      !done) {
+    handle_error(send_message, "Memory allocation failed");
+    return;
+  }
+  memset(done, 0, num_queries);
+
+  for (size_t q = 0; q < num_queries; q++) {
+    SelectOperator *select_op = &selects[q]->operator_fields.select_operator;
+    comparators[q] = select_op->comparator;
+    if (create_new_handle(select_op->res_handle, &result_columns[q]) != 0) {
+      handle_error(send_message, "Failed to create result handle");
       return;
     }
+    result_columns[q]->data_type = INT;
+    result_columns[q]->num_elements = 0;
   }
 
-  if (query->context->is_single_core) {
-    batch_select_single_core((int *)source_column->data, num_elements, comparators,
-                             result_columns, num_queries);
-  } else {
-    batch_select_multi_core((int *)source_column->data, num_elements, comparators,
-                            result_columns, num_queries);
+  // Look up the bounds of all the queries on a column at once, a column at a time
+  for (size_t q = 0; q < num_queries; q++) {
+    if (done[q]) continue;
+    Column *column = comparators[q]->col;
+    size_t num_keys = 0;
+    for (size_t p = q; p < num_queries; p++) {
+      if (comparators[p]->col != column) continue;
+      done[p] = 1;
+      int low, high;
+      size_t num_rows = column->index->num_elements;
+      // an empty range or one open above has a bound without a lookup
+      bounds[2 * p] = bounds[2 * p + 1] = num_rows;
+      if (!comparator_to_range(comparators[p], &low, &high)) continue;
+      keys[num_keys] = low;
+      key_slots[num_keys++] = 2 * p;
+      if (high == INT_MAX) continue;
+      keys[num_keys] = high + 1;
+      key_slots[num_keys++] = 2 * p + 1;
+    }
+    if (idx_lower_bounds(column, keys, num_keys, found) != 0) {
+      handle_error(send_message, "Failed to allocate memory for index lookups");
+      return;
+    }
+    for (size_t k = 0; k < num_keys; k++) bounds[key_slots[k]] = found[k];
+  }
+
+  IndexSliceArgs args = {comparators, result_columns, bounds, 0};
+  ThreadPool *pool = selects[0]->context->is_single_core ? NULL : g_thread_pool;
+  log_info("exec_batch_index_select: %zu selects answered by their index\n", num_queries);
+  if (threadpool_parallel_for(pool, num_queries, 1, index_slice_task, &args) != 0 ||
+      args.failed) {
+    handle_error(send_message, "Failed to allocate memory for result data");
+    return;
   }
-  // Clean up and set success message
-  free(result_columns);
-  vector_destroy(batch_queries);
-  query->context->bselect_dbos = NULL;
 
   send_message->status = OK_DONE;
   send_message->payload = "Batch select completed";
@@ -272,25 +1045,85 @@ bool should_include(int value, Comparator *comparator) {
   return false;
 }
 
-// Basic selection function (initial version)
+/**
+ * @brief Converts a comparator into the inclusive `[low, high]` int range that the scan
+ * kernels evaluate. `select(col, null, null)` qualifies every value.
+ *
+ * @return false if no int value can qualify, e.g. `select(col, 10, 5)`
+ */
+static bool comparator_to_range(Comparator *comparator, int *low, int *high) {
+  long int lo = comparator->type1 == NO_COMPARISON ? INT_MIN : comparator->p_low;
+  long int hi = comparator->type2 == NO_COMPARISON ? INT_MAX : comparator->p_high - 1;
+  if (lo > INT_MAX || hi < INT_MIN || lo > hi) return false;
+  *low = lo < INT_MIN ? INT_MIN : (int)lo;
+  *high = hi > INT_MAX ? INT_MAX : (int)hi;
+  return true;
+}
+
+/**
+ * @brief Whether a select can be left pending for the fused pipeline: a type 1 select
+ * over an unindexed base column, or over a clustered one whose runs answer it as row
+ * ranges (see rle.h). Other indexed columns keep their index lookup, and handles
+ * (`handle_` prefix) may be rebound before the select is consumed.
+ */
+static bool can_defer_select(Column *column, Comparator *comparator) {
+  if (comparator->ref_posns || comparator->ref_bitmap || column->data_type != INT) {
+    return false;
+  }
+  IndexType idx_type = column->index ? column->index->idx_type : NONE;
+  bool clustered = idx_type == BTREE_CLUSTERED || idx_type == SORTED_CLUSTERED;
+  if (idx_type != NONE && !(clustered && column->runs)) return false;
+  return strncmp(column->name, "handle_", strlen("handle_")) != 0;
+}
+
+// Number of leading elements of sorted `data` that are <= `value`
+static size_t sorted_upper_bound(const int *data, size_t num_elements, int value) {
+  size_t left = 0, right = num_elements;
+  while (left < right) {
+    size_t mid = left + (right - left) / 2;
+    if (data[mid] <= value) {
+      left = mid + 1;
+    } else {
+      right = mid;
+    }
+  }
+  return left;
+}
+
+/**
+ * @brief Whether a select over `data` is a plain scan of its base column, whose zone map
+ * can then skip blocks. Index scans and type 2 selects read other arrays.
+ */
+static bool uses_zone_map(const int *data, Comparator *comparator) {
+  return comparator->col && data == comparator->col->data && !comparator->ref_posns &&
+         !comparator->on_sorted_data && comparator->col->zones.num_zones > 0;
+}
+
+/**
+ * @brief Scans `data` with the fastest range-select kernel the CPU supports (see
+ * `scan.h`); `result_indices` must have room for `num_elements` positions.
+ */
 size_t select_values_singlecore(const int *data, size_t num_elements,
                                 Comparator *comparator, int *result_indices) {
   if (result_indices == NULL) {
-    log_err("select_values_basic: result_indices is NULL\n");
-    return -1;
+    log_err("select_values_singlecore: result_indices is NULL\n");
+    return 0;
   }
-  int *ref_posns = comparator->ref_posns;
-  int can_terminate = comparator->on_sorted_data && comparator->p_high;
+  int low, high;
+  if (!comparator_to_range(comparator, &low, &high)) return 0;
 
-  size_t result_count = 0;
-  for (size_t i = 0; i < num_elements; i += 1) {
-    if (can_terminate && comparator->p_high < data[i]) break;
-    if (should_include(data[i], comparator)) {
-      result_indices[result_count++] = ref_posns ? (size_t)ref_posns[i] : i;
-    }
+  // On sorted data nothing past the first value > high can qualify
+  if (comparator->on_sorted_data) {
+    num_elements = sorted_upper_bound(data, num_elements, high);
   }
-  log_info("select_values_basic: Found %zu matching elements out of %zu\n", result_count,
-           num_elements);
+
+  size_t result_count =
+      uses_zone_map(data, comparator)
+          ? zone_map_scan(comparator->col, 0, num_elements, low, high, result_indices)
+          : scan_range(data, 0, num_elements, low, high, comparator->ref_posns,
+                       result_indices);
+  log_info("select_values_singlecore: Found %zu matching elements out of %zu\n",
+           result_count, num_elements);
   return result_count;
 }
 
@@ -328,127 +1161,258 @@ int batch_select_single_core(const int *data, size_t num_elements,
                                             result_columns, num_queries);
 }
 
-// Worker function for each thread
-void *thread_worker(void *args) {
-  ThreadArgs *thread_args = (ThreadArgs *)args;
-  const int *data = thread_args->data;
-  size_t start_idx = thread_args->start_idx;
-  size_t end_idx = thread_args->end_idx;
-  Comparator **comparators = thread_args->comparators;
-  ThreadResultBuffer *thread_buffers = thread_args->thread_buffers;
-  size_t num_queries = thread_args->num_queries;
+/**
+ * @brief Makes room for `n` more results of query `q` in a morsel's buffer. Buffers
+ * start in query scratch; one that fills up is copied to a larger heap buffer here, on
+ * the worker, and merge_morsel frees it.
+ */
+static int reserve_morsel_results(MorselResultBuffer *buffer, size_t q, size_t n) {
+  size_t needed = buffer->num_elements[q] + n;
+  if (needed <= buffer->capacity[q]) return 0;
+  size_t capacity = buffer->capacity[q] * 2 < MORSEL_SIZE ? buffer->capacity[q] * 2
+                                                           : MORSEL_SIZE;
+  if (capacity < needed) capacity = needed;
+  int *grown = malloc(sizeof(int) * capacity);
+  if (!grown) return -1;
+  memcpy(grown, buffer->data[q], sizeof(int) * buffer->num_elements[q]);
+  if (buffer->capacity[q] > buffer->initial_capacity) free(buffer->data[q]);
+  buffer->data[q] = grown;
+  buffer->capacity[q] = capacity;
+  return 0;
+}
 
-  // Initialize local buffers for this thread
+static void free_grown_results(MorselResultBuffer *buffer, size_t num_queries) {
   for (size_t q = 0; q < num_queries; q++) {
-    thread_buffers->data[q] =
-        malloc(sizeof(int) * (end_idx - start_idx));  // Over-allocate
-    thread_buffers->num_elements[q] = 0;
+    if (buffer->capacity[q] > buffer->initial_capacity) free(buffer->data[q]);
+    buffer->capacity[q] = buffer->initial_capacity;
   }
+}
 
-  for (size_t i = start_idx; i < end_idx; i++) {
-    int current_value = data[i];
-
-    for (size_t q = 0; q < num_queries; q++) {
-      Comparator *comparator = comparators[q];
-
-      if (should_include(current_value, comparator)) {
-        int *result_data = thread_buffers->data[q];
-        size_t curr_idx = thread_buffers->num_elements[q];
-
-        result_data[curr_idx] =
-            comparator->ref_posns ? (size_t)comparator->ref_posns[i] : i;
+// Scans one morsel for every query into the morsel's own result buffers
+static void select_morsel(size_t start_idx, size_t end_idx, void *args) {
+  SelectMorselArgs *select_args = (SelectMorselArgs *)args;
+  const int *data = select_args->data;
+  Comparator **comparators = select_args->comparators;
+  size_t num_queries = select_args->num_queries;
+  MorselResultBuffer *buffer = &select_args->morsel_buffers[start_idx / MORSEL_SIZE];
+
+  for (size_t q = 0; q < num_queries; q++) buffer->num_elements[q] = 0;
+
+  // A single query gets the vectorized kernel over the whole morsel; its buffer holds
+  // the whole morsel
+  if (num_queries == 1) {
+    int low, high;
+    if (!comparator_to_range(comparators[0], &low, &high)) return;
+    if (uses_zone_map(data, comparators[0])) {
+      buffer->num_elements[0] = zone_map_scan(comparators[0]->col, start_idx, end_idx,
+                                              low, high, buffer->data[0]);
+    } else {
+      buffer->num_elements[0] = scan_range(data, start_idx, end_idx, low, high,
+                                           comparators[0]->ref_posns, buffer->data[0]);
+    }
+    return;
+  }
 
-        thread_buffers->num_elements[q]++;
+  // Only queries whose range overlaps this morsel's zones look at its values
+  size_t active[num_queries];
+  int lows[num_queries], highs[num_queries];
+  const Column *base_cols[num_queries];  // scanned through its encoding, if any
+  size_t num_active = 0;
+  for (size_t q = 0; q < num_queries; q++) {
+    int low, high;
+    if (!comparator_to_range(comparators[q], &low, &high)) continue;
+    bool is_base = uses_zone_map(data, comparators[q]);
+    if (is_base &&
+        !zone_map_may_match(comparators[q]->col, start_idx, end_idx, low, high)) {
+      continue;
+    }
+    base_cols[num_active] = is_base ? comparators[q]->col : NULL;
+    lows[num_active] = low;
+    highs[num_active] = high;
+    active[num_active++] = q;
+  }
+  if (num_active == 0) return;
+
+  // Shared scan: every active query runs the vectorized kernel over one block while
+  // the block is still in L1, so the morsel is read from memory once
+  for (size_t block = start_idx; block < end_idx; block += BLOCK_SIZE) {
+    size_t block_end = end_idx - block < BLOCK_SIZE ? end_idx : block + BLOCK_SIZE;
+    for (size_t a = 0; a < num_active; a++) {
+      size_t q = active[a];
+      if (reserve_morsel_results(buffer, q, block_end - block) != 0) {
+        select_args->failed = 1;
+        return;
       }
+      int *out = buffer->data[q] + buffer->num_elements[q];
+      buffer->num_elements[q] +=
+          base_cols[a] ? column_scan_range(base_cols[a], block, block_end, lows[a],
+                                           highs[a], out)
+                       : scan_range(data, block, block_end, lows[a], highs[a],
+                                    comparators[q]->ref_posns, out);
     }
   }
-
-  return NULL;
 }
 
-int batch_select_multi_core(const int *data, size_t num_elements,
-                            Comparator **comparators, Column **result_columns,
-                            size_t num_queries) {
-  if (!data || !comparators || !result_columns) {
-    log_err("batch_select_with_one_pass: Invalid input\n");
-    return -1;
-  }
-
-  // Get the number of available cores
-  size_t num_threads = sysconf(_SC_NPROCESSORS_ONLN);
-  pthread_t threads[num_threads];
-  ThreadArgs thread_args[num_threads];
-
-  // Allocate thread-local buffers
-  ThreadResultBuffer thread_buffers[num_threads];
-  for (size_t t = 0; t < num_threads; t++) {
-    thread_buffers[t].data = malloc(sizeof(int *) * num_queries);
-    thread_buffers[t].num_elements = malloc(sizeof(size_t) * num_queries);
+// Copies one morsel's results to their final place in every result column
+static void merge_morsel(size_t start_idx, size_t end_idx, void *args) {
+  (void)end_idx;
+  SelectMorselArgs *select_args = (SelectMorselArgs *)args;
+  size_t m = start_idx / MORSEL_SIZE;
+  MorselResultBuffer *buffer = &select_args->morsel_buffers[m];
+
+  for (size_t q = 0; q < select_args->num_queries; q++) {
+    if (buffer->num_elements[q] > 0) {
+      memcpy((int *)select_args->result_columns[q]->data + select_args->offsets[m][q],
+             buffer->data[q], sizeof(int) * buffer->num_elements[q]);
+    }
   }
+  free_grown_results(buffer, select_args->num_queries);
+}
 
-  // Determine chunk size
-  size_t chunk_size = (num_elements + num_threads - 1) / num_threads;
-
-  // Create threads
-  for (size_t t = 0; t < num_threads; t++) {
-    thread_args[t].data = data;
-    thread_args[t].start_idx = t * chunk_size;
-    thread_args[t].end_idx =
-        (t + 1) * chunk_size < num_elements ? (t + 1) * chunk_size : num_elements;
-    thread_args[t].comparators = comparators;
-    thread_args[t].thread_buffers = &thread_buffers[t];
-    thread_args[t].num_queries = num_queries;
-
-    if (pthread_create(&threads[t], NULL, thread_worker, &thread_args[t]) != 0) {
-      log_err("Error creating thread %zu\n", t);
-      return -1;
+/**
+ * @brief Carves every morsel's result buffers out of `scratch`, on the calling thread.
+ * A lone query gets room for a whole morsel; a shared scan starts every query small.
+ */
+static int init_select_morsels(SelectMorselArgs *args, Arena *scratch) {
+  size_t num_queries = args->num_queries;
+  size_t n_morsels = num_morsels(args->num_elements, MORSEL_SIZE);
+  args->morsel_buffers = arena_alloc(scratch, sizeof(MorselResultBuffer) * n_morsels, 64);
+  args->offsets = arena_alloc(scratch, sizeof(size_t *) * n_morsels, 64);
+  args->failed = 0;
+  int ok = args->morsel_buffers && args->offsets;
+  for (size_t m = 0; ok && m < n_morsels; m++) {
+    MorselResultBuffer *buffer = &args->morsel_buffers[m];
+    size_t rows = m + 1 < n_morsels ? MORSEL_SIZE : args->num_elements - m * MORSEL_SIZE;
+    buffer->initial_capacity = num_queries == 1 || rows < SHARED_SCAN_INITIAL_RESULTS
+                                   ? rows
+                                   : SHARED_SCAN_INITIAL_RESULTS;
+    buffer->data = arena_alloc(scratch, sizeof(int *) * num_queries, 64);
+    buffer->num_elements = arena_alloc(scratch, sizeof(size_t) * num_queries, 64);
+    buffer->capacity = arena_alloc(scratch, sizeof(size_t) * num_queries, 64);
+    args->offsets[m] = arena_alloc(scratch, sizeof(size_t) * num_queries, 64);
+    ok = buffer->data && buffer->num_elements && buffer->capacity && args->offsets[m];
+    for (size_t q = 0; ok && q < num_queries; q++) {
+      buffer->data[q] = arena_alloc(scratch, sizeof(int) * buffer->initial_capacity, 64);
+      buffer->capacity[q] = buffer->initial_capacity;
+      buffer->num_elements[q] = 0;
+      ok = buffer->data[q] != NULL;
     }
   }
-
-  // Wait for threads to complete
-  for (size_t t = 0; t < num_threads; t++) {
-    pthread_join(threads[t], NULL);
+  if (!ok) {
+    log_err("init_select_morsels: failed to allocate %zu morsel buffers\n", n_morsels);
+    return -1;
   }
+  return 0;
+}
 
-  // Merge thread-local buffers into global result_columns
-  for (size_t q = 0; q < num_queries; q++) {
+// Sizes every result column and gives each morsel its slice of it
+static void size_select_results(SelectMorselArgs *args) {
+  size_t n_morsels = num_morsels(args->num_elements, MORSEL_SIZE);
+  MorselResultBuffer *morsel_buffers = args->morsel_buffers;
+  for (size_t q = 0; q < args->num_queries; q++) {
     size_t total_elements = 0;
+    for (size_t m = 0; m < n_morsels; m++) {
+      args->offsets[m][q] = total_elements;
+      total_elements += morsel_buffers[m].num_elements[q];
+    }
 
-    // Calculate total elements for this query
-    for (size_t t = 0; t < num_threads; t++) {
-      total_elements += thread_buffers[t].num_elements[q];
+    // Keep at least one slot so a select with no matches still owns a buffer
+    Column *result = args->result_columns[q];
+    free(result->data);
+    result->data = malloc(sizeof(int) * (total_elements ? total_elements : 1));
+    if (!result->data) {
+      log_err("size_select_results: failed to allocate %zu results\n", total_elements);
+      total_elements = 0;
+      for (size_t m = 0; m < n_morsels; m++) morsel_buffers[m].num_elements[q] = 0;
     }
 
-    // Allocate enough space in the global result_columns
-    result_columns[q]->data =
-        realloc(result_columns[q]->data, sizeof(int) * total_elements);
+    log_perf("qualifying range: [%d, %d]\n", args->comparators[q]->p_low,
+             args->comparators[q]->p_high);
+    log_perf("selectivity: %d/%zu = %.2f%%\n", total_elements, args->num_elements,
+             (double)total_elements / args->num_elements * 100);
+    result->num_elements = total_elements;
+  }
+}
 
-    // Copy data from each thread-local buffer
-    size_t offset = 0;
-    for (size_t t = 0; t < num_threads; t++) {
-      size_t num_elements = thread_buffers[t].num_elements[q];
-      memcpy((int *)result_columns[q]->data + offset, thread_buffers[t].data[q],
-             sizeof(int) * num_elements);
-      offset += num_elements;
+// Maps the loop's morsel indices back to (group, morsel) and runs the group's task
+static void run_group_morsels(size_t start_idx, size_t end_idx, void *args) {
+  SelectGroupTasks *tasks = (SelectGroupTasks *)args;
+  for (size_t t = start_idx; t < end_idx; t++) {
+    // a batch has few groups, so a linear search is enough
+    size_t g = 0;
+    while (g + 1 < tasks->num_groups && tasks->groups[g + 1].first_task <= t) g++;
+    SelectGroup *group = &tasks->groups[g];
+    size_t morsel_start = (t - group->first_task) * MORSEL_SIZE;
+    size_t morsel_end = group->num_elements - morsel_start < MORSEL_SIZE
+                            ? group->num_elements
+                            : morsel_start + MORSEL_SIZE;
+    tasks->fn(morsel_start, morsel_end, &group->args);
+  }
+}
 
-      // Free thread-local buffer
-      free(thread_buffers[t].data[q]);
-    }
+/**
+ * @brief Answers every group with one shared scan. The morsels of all groups make up
+ * one parallel loop on `pool` (serial when NULL), so scans of different columns run
+ * side by side; a second loop concatenates the per-morsel results in morsel order, so
+ * every result column stays sorted by position and gets an exact-size allocation.
+ */
+static int run_select_groups(SelectGroup *groups, size_t num_groups, ThreadPool *pool,
+                             Arena *scratch) {
+  size_t num_tasks = 0;
+  for (size_t g = 0; g < num_groups; g++) {
+    SelectGroup *group = &groups[g];
+    group->args = (SelectMorselArgs){
+        .data = group->data,
+        .num_elements = group->num_elements,
+        .comparators = group->comparators,
+        .num_queries = group->num_queries,
+        .result_columns = group->result_columns,
+    };
+    if (init_select_morsels(&group->args, scratch) != 0) return -1;
+    group->first_task = num_tasks;
+    num_tasks += num_morsels(group->num_elements, MORSEL_SIZE);
+  }
 
-    log_perf("qualifying range: [%d, %d]\n", comparators[q]->p_low,
-             comparators[q]->p_high);
-    log_perf("selectivity: %d/%zu = %.2f%%\n", total_elements, num_elements,
-             (double)total_elements / num_elements * 100);
-    result_columns[q]->num_elements = total_elements;
+  SelectGroupTasks tasks = {groups, num_groups, select_morsel};
+  int failed = threadpool_parallel_for(pool, num_tasks, 1, run_group_morsels, &tasks);
+  for (size_t g = 0; g < num_groups; g++) failed |= groups[g].args.failed;
+  if (!failed) {
+    for (size_t g = 0; g < num_groups; g++) size_select_results(&groups[g].args);
+    tasks.fn = merge_morsel;
+    failed = threadpool_parallel_for(pool, num_tasks, 1, run_group_morsels, &tasks);
+    if (!failed) return 0;
   }
 
-  // Free thread-local buffer metadata
-  for (size_t t = 0; t < num_threads; t++) {
-    free(thread_buffers[t].data);
-    free(thread_buffers[t].num_elements);
+  log_err("run_select_groups: failed to scan %zu groups\n", num_groups);
+  for (size_t g = 0; g < num_groups; g++) {
+    size_t n_morsels = num_morsels(groups[g].num_elements, MORSEL_SIZE);
+    for (size_t m = 0; m < n_morsels; m++) {
+      free_grown_results(&groups[g].args.morsel_buffers[m], groups[g].num_queries);
+    }
   }
+  return -1;
+}
 
-  return 0;
+/**
+ * @brief Runs all `num_queries` selects over `data` as morsel-sized tasks on the
+ * shared thread pool (see run_select_groups). The per-morsel buffers come from
+ * `scratch`; each result column gets an exact-size allocation.
+ */
+int batch_select_multi_core(const int *data, size_t num_elements,
+                            Comparator **comparators, Column **result_columns,
+                            size_t num_queries, Arena *scratch) {
+  if (!data || !comparators || !result_columns) {
+    log_err("batch_select_multi_core: Invalid input\n");
+    return -1;
+  }
+  SelectGroup group = {
+      .data = data,
+      .num_elements = num_elements,
+      .comparators = comparators,
+      .result_columns = result_columns,
+      .num_queries = num_queries,
+  };
+  return run_select_groups(&group, 1, g_thread_pool, scratch);
 }
 
 // Function to perform double-probe selection
@@ -565,9 +1529,16 @@ int batch_select_single_core_optimized(const int *data, size_t num_elements,
         (num_elements - base_idx) < BLOCK_SIZE ? (num_elements - base_idx) : BLOCK_SIZE;
     const int *block_data = &data[base_idx];
 
-    // First pass: Build bitmaps for all queries
+    // First pass: Build bitmaps for all queries, skipping blocks their zones rule out
     for (size_t q = 0; q < num_queries; q++) {
       clear_bitmap(&query_bitmaps[q]);
+      int low, high;
+      if (!comparator_to_range(comparators[q], &low, &high)) continue;
+      if (uses_zone_map(data, comparators[q]) &&
+          !zone_map_may_match(comparators[q]->col, base_idx, base_idx + block_size, low,
+                              high)) {
+        continue;
+      }
       mark_matches_bitmap(block_data, block_size, comparators[q], &query_bitmaps[q]);
     }
 
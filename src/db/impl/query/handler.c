@@ -1,30 +1,84 @@
 #include "handler.h"
 
+#include <ctype.h>
 #include <string.h>
 
+#include "checkpoint.h"
 #include "utils.h"
+#include "wal.h"
 char *handle_print(DbOperator *query);
-void handle_batched_queries(DbOperator *query, message *send_message);
-void handle_dbOperator(DbOperator *query, message *send_message);
+
+// The operator of `query`, past the handle it assigns to, if any
+static const char *query_command(const char *query) {
+  const char *command = strchr(query, '=');
+  command = command ? command + 1 : query;
+  while (isspace((unsigned char)*command)) command++;
+  return command;
+}
+
+/**
+ * @brief Whether `query` changes the catalog and so needs it exclusively. Decided from
+ * the raw text, because parsing already resolves catalog pointers.
+ */
+static int query_writes_catalog(const char *query) {
+  const char *command = query_command(query);
+  return strncmp(command, "create", 6) == 0 ||
+         strncmp(command, "relational_insert", 17) == 0;
+}
 
 void handle_query(char *query, message *send_message, int client_socket,
                   ClientContext *client_context) {
-  // 1. Parse command
-  //    Query string is converted into a request for an database operator
-  DbOperator *dbo = parse_command(query, send_message, client_socket, client_context);
-  // 2. Handle request, if appropriate
-  if (dbo) {
-    // If batching queries, add to batch
-    int should_batch_query =
-        is_batch_queries_on(client_context) && !(dbo->type == EXEC_BATCH);
-    if (should_batch_query && add_query_to_batch(dbo) == 0) {
-      cs165_log(stdout, "Added query to batch\n");
-      send_message->status = OK_DONE;
-    } else {
+  int writes_catalog = query_writes_catalog(query);
+  int creates_db = strncmp(query_command(query), "create(db", 9) == 0;
+  if (writes_catalog) {
+    catalog_write_lock();
+  } else {
+    catalog_read_lock();
+  }
+
+  // If batching queries, add to batch. Batched queries are parsed when the batch runs,
+  // since the handles they read are only created by the queries before them.
+  int batched = is_batch_queries_on(client_context) == 1
+                    ? batch_add_query(client_context, query)
+                    : 1;
+  if (batched == 0) {
+    cs165_log(stdout, "Added query to batch\n");
+    send_message->status = OK_DONE;
+  } else if (batched < 0) {
+    handle_error(send_message, "Failed to add query to batch");
+  } else {
+    // 1. Parse command
+    //    Query string is converted into a request for an database operator
+    DbOperator *dbo = parse_command(query, send_message, client_socket, client_context);
+    // 2. Handle request, if appropriate
+    if (dbo) {
       handle_dbOperator(dbo, send_message);
       db_operator_free(dbo);
     }
   }
+  release_retired_handles(client_context);
+  // The log belongs to a database, so a new one is acknowledged once its catalog is on
+  // disk; the creates in it are logged like inserts
+  if (creates_db && checkpoint_now().code != OK) {
+    handle_error(send_message, "Failed to make create durable");
+  }
+  catalog_unlock();
+
+  // A create or insert is acknowledged once its log record is durable. Waiting outside
+  // the catalog lock lets the changes of other sessions join the same sync.
+  if (client_context->wal_lsn) {
+    if (wal_commit(client_context->wal_lsn) != 0) {
+      // The change is applied and other sessions may have read it already, so rather
+      // than take it back it is made durable by a checkpoint, which also empties the log
+      catalog_read_lock();
+      Status status = checkpoint_now();
+      catalog_unlock();
+      if (status.code != OK) {
+        handle_error(send_message, "Applied but could not be made durable");
+      }
+    }
+    client_context->wal_lsn = 0;
+  }
 }
 
 /**
@@ -38,6 +92,8 @@ void handle_dbOperator(DbOperator *query, message *send_message) {
   switch (query->type) {
     case CREATE:
     case CREATE_INDEX:
+      // a clustered index reorders its table under any pending select
+      materialize_pending_handles();
       exec_create(query, send_message);
       break;
     case SELECT: {
@@ -72,46 +128,37 @@ void handle_dbOperator(DbOperator *query, message *send_message) {
       exec_insert(query, send_message);
       break;
     case EXEC_BATCH: {
-      // Currently supports only batch select queries, per milestone 2 requirements
       double t0 = get_time();
-      handle_batched_queries(query, send_message);
-      log_client_perf(stdout, "\thandle_batched_queries: t = %.6fμs\n", get_time() - t0);
+      exec_batch(query, send_message);
+      log_client_perf(stdout, "\texec_batch: t = %.6fμs\n", get_time() - t0);
       set_batch_queries(query->context, 0);
     } break;
     case JOIN:
       exec_join(query, send_message);
       break;
+    case PRINT_STATS: {
+      char *result = handle_print_stats(query);
+      if (!result) {
+        handle_error(send_message, "Failed to print stats");
+        return;
+      }
+      send_message->status = OK_DONE;
+      send_message->length = strlen(result);
+      send_message->payload = result;
+    } break;
     default:
       cs165_log(stdout, "execute_DbOperator: Unknown query type\n");
       break;
   }
 }
 
-/**
- * @brief handle_batched_queries
- * Executes a batch of select queries in parallel
- *
- * @param query DbOperator containing the batched queries
- * @param send_message message to send back to the client
- */
-void handle_batched_queries(DbOperator *query, message *send_message) {
-  if (!query->context || !query->context->bselect_dbos) {
-    log_err("handle_batched_queries: Invalid query\n");
-    handle_error(send_message, "Invalid batched query");
-  } else {
-    handle_error(send_message,
-                 "handle_batched_queries: invalid batched query execution request\nOnly "
-                 "batched select queries are supported");
-  }
-  exec_batch_select(query, send_message);
-}
-
 /**
  * @brief Executes a print operation by constructing a string representation
  * of the columns in row-major format
  *
  * @param query DbOperator containing the print operation
- * @return char* Allocated string containing the formatted output
+ * @return char* the formatted output, allocated from the session's query arena so it
+ * lives until the response has been sent
  */
 char *handle_print(DbOperator *query) {
   cs165_log(stdout, "handle_print: starting\n");
@@ -128,9 +175,25 @@ char *handle_print(DbOperator *query) {
   size_t num_rows = print_op->columns[0]->num_elements;
 
   // Calculate required buffer size (estimate)
-  // Assume max 20 chars per number plus separator and newline
-  size_t buffer_size = (num_rows * print_op->num_columns * 21) + 1;
-  char *result = malloc(buffer_size);
+  // Assume max 20 chars per number plus separator and newline; a double takes as many
+  // as the widest value of its column
+  size_t row_size = 0;
+  for (size_t col = 0; col < print_op->num_columns; col++) {
+    Column *column = print_op->columns[col];
+    size_t width = 21;
+    if (column->data_type == DOUBLE) {
+      const double *data = (const double *)column->data;
+      double widest = 0;
+      for (size_t row = 0; row < num_rows; row++) {
+        double magnitude = data[row] < 0 ? -data[row] : data[row];
+        if (magnitude > widest) widest = magnitude;
+      }
+      width = snprintf(NULL, 0, "%f", -widest) + 1;
+    }
+    row_size += width;
+  }
+  size_t buffer_size = num_rows * row_size + 1;
+  char *result = arena_alloc(query->scratch, buffer_size, 1);
   if (!result) return NULL;
 
   char *current = result;
@@ -158,14 +221,10 @@ char *handle_print(DbOperator *query) {
         printed = snprintf(current, remaining, "%f", data[row]);
       } else {
         log_err("handle_print: Unsupported data type\n");
-        free(result);
         return NULL;
       }
 
-      if (printed >= remaining) {
-        free(result);
-        return NULL;
-      }
+      if (printed >= remaining) return NULL;
 
       current += printed;
       remaining -= printed;
@@ -188,6 +247,21 @@ char *handle_print(DbOperator *query) {
   return result;
 }
 
+char *handle_print_stats(DbOperator *query) {
+  CheckpointStats checkpoints;
+  checkpointer_stats(&checkpoints);
+  size_t buffer_size = 256;
+  char *result = arena_alloc(query->scratch, buffer_size, 1);
+  if (!result) return NULL;
+  snprintf(result, buffer_size,
+           "join_bytes_spilled=%zu\ncheckpoints=%zu\ncheckpoint_bytes_written=%zu\n"
+           "checkpoint_total_us=%.6f\ncheckpoint_last_us=%.6f",
+           query->context->join_bytes_spilled, checkpoints.num_checkpoints,
+           checkpoints.bytes_written, checkpoints.total_duration_us,
+           checkpoints.last_duration_us);
+  return result;
+}
+
 void set_batch_queries(ClientContext *client_context, int is_on) {
   if (!client_context) {
     log_err("set_batch_select: client context is not initialized\n");
@@ -204,41 +278,3 @@ int is_batch_queries_on(ClientContext *client_context) {
   }
   return client_context->is_batch_queries_on;
 }
-
-void db_operator_free_wrapper(void *ptr) { db_operator_free((DbOperator *)ptr); }
-
-int add_query_to_batch(DbOperator *query) {
-  log_info("add_query_to_batch: adding a query to batch\n");
-  if (query->type != SELECT) {  // The caller (server.c) ensures query is Non-null
-    log_err("add_query_to_batch: Support for non-SELECT queries not implemented yet\n");
-    return -1;
-  }
-
-  ClientContext *context = query->context;
-
-  if (!context->bselect_dbos) {
-    context->bselect_dbos = vector_create(db_operator_free_wrapper);
-    if (!context->bselect_dbos) {
-      log_err("add_query_to_batch: failed to create batch queries vector\n");
-      return -1;
-    }
-    //   } else {
-    //     // Ensure the previous query's column is the same as current query's column
-    //     // This is guaranteed from project requirements, so we can skip this check,
-    //     until we
-    //     // are extending for extra credit.
-    //     DbOperator *prev_query = (DbOperator *)vector_get(
-    //         context->bselect_dbos, vector_size(context->bselect_dbos) - 1);
-    //     if (prev_query->operator_fields.select_operator.comparator->col !=
-    //         query->operator_fields.select_operator.comparator->col) {
-    //       log_err(
-    //           "add_query_to_batch: previous select query's column is different from
-    //           current " "query's column\n");
-    //       return;
-    //     }
-  }
-
-  vector_push_back(context->bselect_dbos, query);
-  log_info("add_query_to_batch: added query to batch\n");
-  return 0;
-}
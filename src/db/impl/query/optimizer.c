@@ -1,16 +1,138 @@
 #include "optimizer.h"
 
+#include <limits.h>
+#include <sys/mman.h>
+
 #include "algorithms.h"
 #include "btree.h"
+#include "catalog_manager.h"
+#include "cracker.h"
+#include "typed_kernels.h"
 
 void reorder_nums(int *data, size_t n_elements, int *idx_order);
 
+// Arguments of one column's reorder task in `cluster_idx_on`
+typedef struct {
+  Column *col;
+  int *idx_order;
+} ReorderTask;
+
+static void reorder_column_task(void *arg) {
+  ReorderTask *task = (ReorderTask *)arg;
+  Column *col = task->col;
+  if (col->data_type == INT) {
+    reorder_nums(col->data, col->num_elements, task->idx_order);
+    return;
+  }
+  void *scratch = malloc(data_type_size(col->data_type) * col->num_elements);
+  if (!scratch) {
+    log_err("reorder_column_task: failed to allocate scratch for %s\n", col->name);
+    return;
+  }
+  if (col->data_type == LONG) {
+    typed_reorder_long(col->data, col->num_elements, task->idx_order, scratch);
+  } else {
+    typed_reorder_double(col->data, col->num_elements, task->idx_order, scratch);
+  }
+  free(scratch);
+}
+
+// Length of the longest sorted prefix of a LONG or DOUBLE column
+static size_t sorted_prefix_length(const Column *col) {
+  size_t n = col->num_elements, i = 1;
+  if (col->data_type == LONG) {
+    const long *data = col->data;
+    while (i < n && data[i - 1] <= data[i]) i++;
+  } else {
+    const double *data = col->data;
+    while (i < n && data[i - 1] <= data[i]) i++;
+  }
+  return n < i ? n : i;
+}
+
+/**
+ * @brief A background merge of an index's delta into its main arrays. The merge works
+ * on a copy of the delta and only reads the main arrays, so lookups keep using both
+ * until the next insert installs the result (see `index_poll_merge`).
+ */
+typedef struct IndexMerge {
+  const int *main_data;
+  const int *main_positions;
+  size_t main_n;
+  int *delta_data;  // copies, owned by the merge
+  int *delta_positions;
+  size_t delta_n;
+  size_t rows_merged;  // delta rows at positions below this are part of the merge
+  int build_btree;
+
+  int *sorted_data;  // results
+  int *positions;
+  Btree *root;
+  int failed;
+  TaskGroup group;
+} IndexMerge;
+
+static void free_index_merge(IndexMerge *merge) {
+  threadpool_wait(g_thread_pool, &merge->group);
+  taskgroup_destroy(&merge->group);
+  free(merge->delta_data);
+  free(merge->delta_positions);
+  free(merge);
+}
+
+ColumnIndex *create_column_index(IndexType idx_type) {
+  ColumnIndex *index = calloc(1, sizeof(ColumnIndex));
+  if (!index) return NULL;
+  index->idx_type = idx_type;
+  pthread_mutex_init(&index->crack_lock, NULL);
+  return index;
+}
+
+void free_idx_data(Column *col) {
+  if (!col->index) return;
+  cracker_destroy(col->index->cracker);
+  col->index->cracker = NULL;
+  if (col->index->merge) {
+    IndexMerge *merge = col->index->merge;
+    threadpool_wait(g_thread_pool, &merge->group);
+    free(merge->sorted_data);
+    free(merge->positions);
+    free_btree(merge->root);
+    free_index_merge(merge);
+    col->index->merge = NULL;
+  }
+  free(col->index->delta_data);
+  free(col->index->delta_positions);
+  free(col->index->typed_sorted);
+  col->index->typed_sorted = NULL;
+  col->index->delta_data = NULL;
+  col->index->delta_positions = NULL;
+  col->index->delta_size = 0;
+  col->index->delta_capacity = 0;
+
+  free_btree(col->root);
+  col->root = NULL;
+  if (col->index->mmap_base) {
+    munmap(col->index->mmap_base, col->index->mmap_size);
+  } else {
+    free(col->index->sorted_data);
+    free(col->index->positions);
+  }
+  col->index->sorted_data = NULL;
+  col->index->positions = NULL;
+  col->index->num_elements = 0;
+  col->index->mmap_base = NULL;
+  col->index->mmap_size = 0;
+}
+
 void init_column_index(Column *col, message *send_message) {
   if (!col->index) {
     handle_error(send_message,
                  "Column index should have been initialized before loading data");
     return;
   }
+  // Rebuilding replaces whatever the index held before
+  free_idx_data(col);
 
   // Allocate and copy the data from the column to the index (Not sorted yet)
   col->index->sorted_data = malloc(sizeof(int) * col->num_elements);
@@ -24,14 +146,72 @@ void init_column_index(Column *col, message *send_message) {
   memcpy(col->index->sorted_data, col->data, sizeof(int) * col->num_elements);
 
   // Sort the data and keep track of the original positions
-  if (sort(col->index->sorted_data, col->num_elements, col->index->positions) != 0) {
+  double start = get_time();
+  if (sort_parallel(g_thread_pool, col->index->sorted_data, col->num_elements,
+                    col->index->positions) != 0) {
     handle_error(send_message, "Failed to sort data");
     log_err("init_column_index: Failed to sort data\n");
     return;
   }
+  col->index->num_elements = col->num_elements;
+
+  // the sort's scratch, a value and a position per row (see sort_parallel)
+  log_perf("init_column_index: sorted %zu values of %s in %.0fμs with %zu KB scratch\n",
+           col->num_elements, col->name, get_time() - start,
+           2 * sizeof(int) * col->num_elements / 1024);
+}
+/**
+ * @brief Builds the index of an unclustered LONG or DOUBLE column: its values sorted
+ * into `typed_sorted` and their rows into `positions`. A B-tree index is built the same
+ * way, as the B-tree only holds ints; selects binary-search the sorted values.
+ */
+static void init_typed_column_index(Column *col, message *send_message) {
+  size_t n = col->num_elements;
+  size_t width = data_type_size(col->data_type);
+  void *sorted = malloc(width * (n ? n : 1));
+  int *positions = malloc(sizeof(int) * (n ? n : 1));
+  int status = -1;
+  if (sorted && positions) {
+    memcpy(sorted, col->data, width * n);
+    double start = get_time();
+    status = col->data_type == LONG ? typed_argsort_long(sorted, n, positions)
+                                    : typed_argsort_double(sorted, n, positions);
+    log_perf("init_typed_column_index: sorted %zu values of %s in %.0fμs\n", n,
+             col->name, get_time() - start);
+  }
+  if (status != 0) {
+    free(sorted);
+    free(positions);
+    handle_error(send_message, "Failed to allocate memory for sorted data");
+    log_err("init_typed_column_index: Failed to sort %s\n", col->name);
+    return;
+  }
+  col->index->typed_sorted = sorted;
+  col->index->positions = positions;
+  col->index->num_elements = n;
 }
+
 void create_idx_on(Column *col, message *send_message) {
   if (!col->index || col->index->idx_type == NONE) return;
+  if (col->data_type != INT) {
+    free_idx_data(col);
+    IndexType idx_type = col->index->idx_type;
+    if (idx_type == SORTED_UNCLUSTERED || idx_type == BTREE_UNCLUSTERED) {
+      init_typed_column_index(col, send_message);
+      return;
+    }
+    // A clustered index is the sorted prefix of the column, all of it once clustered;
+    // selects search the prefix and scan the rest
+    col->index->num_elements = sorted_prefix_length(col);
+    log_info("create_idx_on: %s column %s is sorted up to row %zu\n",
+             data_type_name(col->data_type), col->name, col->index->num_elements);
+    return;
+  }
+  // A cracking index is built by the selects themselves, from the data they find
+  if (col->index->idx_type == CRACKING_UNCLUSTERED) {
+    free_idx_data(col);
+    return;
+  }
 
   // Any column with an index needs to have ColumnIndex initialized
   init_column_index(col, send_message);
@@ -40,7 +220,7 @@ void create_idx_on(Column *col, message *send_message) {
   IndexType idx_type = col->index->idx_type;
   if (idx_type == BTREE_CLUSTERED || idx_type == BTREE_UNCLUSTERED) {
     // Create the btree index
-    col->root = init_btree(col->index->sorted_data, col->num_elements, BTREE_FANOUT);
+    col->root = init_btree(col->index->sorted_data, col->num_elements);
     if (!col->root) {
       log_err("Failed to create btree index for column %s\n", col->name);
       return;
@@ -51,16 +231,65 @@ void create_idx_on(Column *col, message *send_message) {
   }
 }
 
+/**
+ * @brief Sorts a LONG or DOUBLE primary column in place.
+ *
+ * @return the order to reorder the other columns by (`order[i]` is the old row of new
+ * row `i`), or NULL if out of memory
+ */
+static int *sort_typed_column(Column *col) {
+  size_t n = col->num_elements;
+  int *order = malloc(sizeof(int) * (n ? n : 1));
+  if (!order) return NULL;
+  int status = col->data_type == LONG ? typed_argsort_long(col->data, n, order)
+                                      : typed_argsort_double(col->data, n, order);
+  if (status != 0) {
+    free(order);
+    return NULL;
+  }
+  col->index->num_elements = n;
+  return order;
+}
+
 void cluster_idx_on(Table *table, Column *primary_col, message *send_message) {
   (void)send_message;
   // Cluster the primary column if it exists
-  int *idx_order = primary_col->index->positions;
+  int *typed_order = NULL;
+  if (primary_col->data_type != INT) {
+    typed_order = sort_typed_column(primary_col);
+    if (!typed_order) {
+      log_err("cluster_idx_on: failed to sort %s\n", primary_col->name);
+      return;
+    }
+  }
+  int *idx_order = typed_order ? typed_order : primary_col->index->positions;
 
+  // Every other column is reordered independently, one task per column
+  ReorderTask *tasks = malloc(sizeof(ReorderTask) * table->num_cols);
+  if (!tasks) {
+    log_err("cluster_idx_on: failed to allocate reorder tasks\n");
+    free(typed_order);
+    return;
+  }
+  TaskGroup group;
+  taskgroup_init(&group);
   for (size_t i = 0; i < table->num_cols; i++) {
     Column *col = &table->columns[i];
+    mark_column_dirty(col, 0);  // every row may move
     if (col == primary_col) continue;
-    reorder_nums(col->data, col->num_elements, idx_order);
+    tasks[i] = (ReorderTask){col, idx_order};
+    if (threadpool_submit(g_thread_pool, &group, reorder_column_task, &tasks[i]) != 0) {
+      reorder_column_task(&tasks[i]);
+    }
   }
+  threadpool_wait(g_thread_pool, &group);
+  taskgroup_destroy(&group);
+  free(tasks);
+  if (typed_order) {
+    free(typed_order);  // the primary column was sorted in place
+    return;
+  }
+
   memcpy(primary_col->data, primary_col->index->sorted_data,
          sizeof(int) * primary_col->num_elements);
 
@@ -70,17 +299,222 @@ void cluster_idx_on(Table *table, Column *primary_col, message *send_message) {
   }
 }
 
+// Index of the first element of sorted `data` greater than `value`
+static size_t first_greater(const int *data, size_t n, int value) {
+  size_t left = 0, right = n;
+  while (left < right) {
+    size_t mid = left + (right - left) / 2;
+    if (data[mid] <= value) {
+      left = mid + 1;
+    } else {
+      right = mid;
+    }
+  }
+  return left;
+}
+
+// Merges the delta copy into fresh main arrays and rebuilds the B-tree over them
+static void merge_index_task(void *arg) {
+  IndexMerge *merge = (IndexMerge *)arg;
+  size_t n = merge->main_n + merge->delta_n;
+  merge->sorted_data = malloc(sizeof(int) * n);
+  merge->positions = malloc(sizeof(int) * n);
+  if (!merge->sorted_data || !merge->positions) {
+    merge->failed = 1;
+    return;
+  }
+
+  // Main rows go first among equal values, like the stable sort of a full rebuild
+  size_t i = 0, j = 0, k = 0;
+  while (i < merge->main_n || j < merge->delta_n) {
+    if (j == merge->delta_n ||
+        (i < merge->main_n && merge->main_data[i] <= merge->delta_data[j])) {
+      merge->sorted_data[k] = merge->main_data[i];
+      merge->positions[k++] = merge->main_positions[i++];
+    } else {
+      merge->sorted_data[k] = merge->delta_data[j];
+      merge->positions[k++] = merge->delta_positions[j++];
+    }
+  }
+  if (merge->build_btree) {
+    merge->root = init_btree(merge->sorted_data, n);
+    if (!merge->root) merge->failed = 1;
+  }
+}
+
+static void start_index_merge(Column *col) {
+  ColumnIndex *index = col->index;
+  IndexMerge *merge = calloc(1, sizeof(IndexMerge));
+  if (!merge) return;  // the delta just keeps growing until the next insert retries
+  merge->delta_data = malloc(sizeof(int) * index->delta_size);
+  merge->delta_positions = malloc(sizeof(int) * index->delta_size);
+  if (!merge->delta_data || !merge->delta_positions) {
+    free(merge->delta_data);
+    free(merge->delta_positions);
+    free(merge);
+    return;
+  }
+  memcpy(merge->delta_data, index->delta_data, sizeof(int) * index->delta_size);
+  memcpy(merge->delta_positions, index->delta_positions, sizeof(int) * index->delta_size);
+  merge->delta_n = index->delta_size;
+  merge->main_data = index->sorted_data;
+  merge->main_positions = index->positions;
+  merge->main_n = index->num_elements;
+  merge->rows_merged = col->num_elements;
+  merge->build_btree =
+      index->idx_type == BTREE_CLUSTERED || index->idx_type == BTREE_UNCLUSTERED;
+  taskgroup_init(&merge->group);
+  index->merge = merge;
+  if (threadpool_submit(g_thread_pool, &merge->group, merge_index_task, merge) != 0) {
+    merge_index_task(merge);
+  }
+  log_info("start_index_merge: merging %zu delta rows into the index of %s\n",
+           merge->delta_n, col->name);
+}
+
+// Swaps in the merged arrays and drops the merged rows from the delta
+static void install_index_merge(Column *col) {
+  ColumnIndex *index = col->index;
+  IndexMerge *merge = index->merge;
+  threadpool_wait(g_thread_pool, &merge->group);
+  index->merge = NULL;
+  if (merge->failed) {
+    log_err("install_index_merge: merge for %s ran out of memory\n", col->name);
+    free(merge->sorted_data);
+    free(merge->positions);
+    free_btree(merge->root);
+    free_index_merge(merge);
+    return;
+  }
+
+  // Release the old main arrays but keep the delta (free_idx_data would drop it)
+  free_btree(col->root);
+  if (index->mmap_base) {
+    munmap(index->mmap_base, index->mmap_size);
+  } else {
+    free(index->sorted_data);
+    free(index->positions);
+  }
+  index->mmap_base = NULL;
+  index->mmap_size = 0;
+  index->sorted_data = merge->sorted_data;
+  index->positions = merge->positions;
+  index->num_elements = merge->main_n + merge->delta_n;
+  col->root = merge->root;
+
+  size_t kept = 0;
+  for (size_t i = 0; i < index->delta_size; i++) {
+    if ((size_t)index->delta_positions[i] < merge->rows_merged) continue;
+    index->delta_data[kept] = index->delta_data[i];
+    index->delta_positions[kept++] = index->delta_positions[i];
+  }
+  index->delta_size = kept;
+  free_index_merge(merge);
+}
+
+void index_poll_merge(Column *col) {
+  if (col->index && col->index->merge && taskgroup_done(&col->index->merge->group)) {
+    install_index_merge(col);
+  }
+}
+
+void index_flush(Column *col) {
+  if (!col->index || col->index->idx_type == NONE) return;
+  if (col->index->merge) install_index_merge(col);
+  if (col->index->delta_size == 0) return;
+  start_index_merge(col);
+  if (col->index->merge) install_index_merge(col);
+}
+
+void index_insert(Column *col, int value, size_t row) {
+  ColumnIndex *index = col->index;
+  if (!index || index->idx_type == NONE) return;
+  if (index->idx_type == CRACKING_UNCLUSTERED) {
+    // Without room for the row, the next select copies the column afresh
+    if (index->cracker && cracker_insert(index->cracker, value, (int)row) != 0) {
+      free_idx_data(col);
+    }
+    return;
+  }
+  index_poll_merge(col);
+
+  if (index->delta_size == index->delta_capacity) {
+    size_t capacity = index->delta_capacity ? index->delta_capacity * 2 : 256;
+    int *data = realloc(index->delta_data, sizeof(int) * capacity);
+    if (data) index->delta_data = data;
+    int *positions = data ? realloc(index->delta_positions, sizeof(int) * capacity) : NULL;
+    if (!positions) {
+      // Without room for the row, rebuild the whole index from the column instead
+      log_err("index_insert: out of memory for the delta of %s; rebuilding\n",
+              col->name);
+      create_idx_on(col, NULL);
+      return;
+    }
+    index->delta_positions = positions;
+    index->delta_capacity = capacity;
+  }
+
+  // Keep the delta sorted; after any equal values so it stays in insertion order
+  size_t slot = first_greater(index->delta_data, index->delta_size, value);
+  memmove(index->delta_data + slot + 1, index->delta_data + slot,
+          sizeof(int) * (index->delta_size - slot));
+  memmove(index->delta_positions + slot + 1, index->delta_positions + slot,
+          sizeof(int) * (index->delta_size - slot));
+  index->delta_data[slot] = value;
+  index->delta_positions[slot] = (int)row;
+  index->delta_size++;
+
+  if (index->delta_size >= INDEX_DELTA_MERGE_THRESHOLD && !index->merge) {
+    start_index_merge(col);
+  }
+}
+
+size_t index_delta_select(Column *col, int low, int high, int *out) {
+  ColumnIndex *index = col->index;
+  if (!index || index->delta_size == 0 || low > high) return 0;
+  // values >= low are those > low - 1
+  size_t start = low == INT_MIN ? 0 : first_greater(index->delta_data, index->delta_size,
+                                                     low - 1);
+  size_t end = first_greater(index->delta_data, index->delta_size, high);
+  memcpy(out, index->delta_positions + start, sizeof(int) * (end - start));
+  return end - start;
+}
+
+int index_crack_select(Column *col, int low, int high, int *out, size_t *count) {
+  ColumnIndex *index = col->index;
+  pthread_mutex_lock(&index->crack_lock);
+  if (!index->cracker) {
+    index->cracker = cracker_create(col->data, col->num_elements);
+    if (!index->cracker) {
+      pthread_mutex_unlock(&index->crack_lock);
+      return -1;
+    }
+    log_info("index_crack_select: copied %zu rows of %s to its cracker column\n",
+             col->num_elements, col->name);
+  }
+  size_t start, end;
+  cracker_select(index->cracker, low, high, &start, &end);
+  // the next select may move these rows, so copy them out before letting it in
+  memcpy(out, index->cracker->positions + start, sizeof(int) * (end - start));
+  *count = end - start;
+  log_info("index_crack_select: %zu rows of %s in %zu pieces\n", *count, col->name,
+           index->cracker->num_cracks + 1);
+  pthread_mutex_unlock(&index->crack_lock);
+  return 0;
+}
+
 size_t idx_lookup_left(Column *col, int value) {
   if (!col->index || col->index->idx_type == NONE) {
     log_err("idx_lookup: Column %s does not have an index\n", col->name);
     return 0;
   }
   int *sorted_data = col->index->sorted_data;
-  size_t num_elements = col->num_elements;
+  size_t num_elements = col->index->num_elements;  // rows in the delta are not here
   IndexType idx_type = col->index->idx_type;
   //   ssize_t match_idx = 0;
 
   // Handle edge cases
+  if (num_elements == 0) return 0;
   if (value <= sorted_data[0]) return 0;
   if (value >= sorted_data[num_elements - 1]) return num_elements - 1;
 
@@ -132,8 +566,9 @@ size_t idx_lookup_right(Column *col, int value) {
   }
 
   int *sorted_data = col->index->sorted_data;
-  size_t num_elements = col->num_elements;
+  size_t num_elements = col->index->num_elements;
   IndexType idx_type = col->index->idx_type;
+  if (num_elements == 0) return 0;
   //   ssize_t match_idx = 0;
 
   //   // Handle edge cases
@@ -167,6 +602,60 @@ size_t idx_lookup_right(Column *col, int value) {
   return 0;
 }
 
+// A key of `idx_lower_bounds` with its place in the caller's order
+typedef struct {
+  int key;
+  size_t slot;
+} IndexProbe;
+
+static int compare_probes(const void *a, const void *b) {
+  const IndexProbe *pa = (const IndexProbe *)a, *pb = (const IndexProbe *)b;
+  return (pa->key > pb->key) - (pa->key < pb->key);
+}
+
+int idx_lower_bounds(Column *column, const int *keys, size_t n, size_t *out) {
+  if (n == 0) return 0;
+  IndexProbe *probes = malloc(sizeof(IndexProbe) * n);
+  int *sorted_keys = malloc(sizeof(int) * n);
+  size_t *bounds = malloc(sizeof(size_t) * n);
+  if (!probes || !sorted_keys || !bounds) {
+    free(probes);
+    free(sorted_keys);
+    free(bounds);
+    return -1;
+  }
+  for (size_t k = 0; k < n; k++) probes[k] = (IndexProbe){keys[k], k};
+  qsort(probes, n, sizeof(IndexProbe), compare_probes);
+  for (size_t k = 0; k < n; k++) sorted_keys[k] = probes[k].key;
+
+  const int *sorted_data = column->index->sorted_data;
+  size_t num_elements = column->index->num_elements;
+  if (column->root) {
+    lookup_batch(sorted_keys, n, column->root, 1, bounds);
+  } else {
+    // one pass over the sorted data: every search starts where the previous key ended
+    size_t from = 0;
+    for (size_t k = 0; k < n; k++) {
+      size_t left = from, right = num_elements;
+      while (left < right) {
+        size_t mid = left + (right - left) / 2;
+        if (sorted_data[mid] < sorted_keys[k]) {
+          left = mid + 1;
+        } else {
+          right = mid;
+        }
+      }
+      bounds[k] = from = left;
+    }
+  }
+  for (size_t k = 0; k < n; k++) out[probes[k].slot] = bounds[k];
+
+  free(probes);
+  free(sorted_keys);
+  free(bounds);
+  return 0;
+}
+
 void reorder_nums(int *data, size_t n_elements, int *idx_order) {
   // Handle empty array case
   if (n_elements == 0) return;
@@ -181,9 +670,7 @@ void reorder_nums(int *data, size_t n_elements, int *idx_order) {
   }
 
   // Copy back to original array
-  for (size_t i = 0; i < n_elements; i++) {
-    data[i] = temp[i];
-  }
+  memcpy(data, temp, n_elements * sizeof(int));
 
   free(temp);
 }
@@ -20,6 +20,7 @@
 #include "catalog_manager.h"
 #include "client_context.h"
 #include "handler.h"
+#include "positions.h"
 #include "utils.h"
 
 // Function prototypes
@@ -105,6 +106,13 @@ DbOperator *parse_command(char *query_command, message *send_message, int client
   } else if (strncmp(query_command, "add", 3) == 0) {
     query_command += 3;
     dbo = parse_arithmetic(query_command, handle, ADD);
+  } else if (strncmp(query_command, "print_stats()", 13) == 0) {
+    dbo = malloc(sizeof(DbOperator));
+    if (!dbo) {
+      handle_error(send_message, "Failed to allocate stats query");
+      return NULL;
+    }
+    dbo->type = PRINT_STATS;
   } else if (strncmp(query_command, "print", 5) == 0) {
     query_command += 5;
     dbo = parse_print(query_command);
@@ -125,6 +133,16 @@ DbOperator *parse_command(char *query_command, message *send_message, int client
   } else if (strncmp(query_command, "single_core_execute", 19) == 0) {
     context->is_single_core = 0;
     send_message->status = OK_DONE;
+  } else if (strncmp(query_command, "join_memory_budget", 18) == 0) {
+    char *end = NULL;
+    unsigned long long budget = strtoull(query_command + 19, &end, 10);
+    if (query_command[18] != '(' || end == query_command + 19 || *end != ')' ||
+        budget == 0) {
+      handle_error(send_message, "join_memory_budget expects a positive byte count");
+      return NULL;
+    }
+    context->join_memory_budget = budget;
+    send_message->status = OK_DONE;
   } else if (strncmp(query_command, "join", 4) == 0) {
     query_command += 4;
     dbo = parse_join(query_command, handle, send_message);
@@ -135,6 +153,7 @@ DbOperator *parse_command(char *query_command, message *send_message, int client
 
   dbo->client_fd = client_socket;
   dbo->context = context;
+  dbo->scratch = context->query_arena;
   return dbo;
 }
 
@@ -158,7 +177,11 @@ char *next_token(char **tokenizer, message_status *status) {
  * them, and returns a DbOperator if the arguments are valid. Otherwise, it returns NULL.
  * Example original query:
  *      - create(col,"col1",db1.tbl1)
- *      - create(col,"col2",db1.tbl1)
+ *      - create(col,"col2",db1.tbl1,long)   --- a column of long (or double) values;
+ *                                               int when no type is given
+ *      - create(col,"col3",db1.tbl1,encoded) --- an int column that keeps
+ *                                                encodings for selects (see
+ *                                                column_encoding.h); may follow a type
  *
  * @param create_arguments the string representing the arguments to create a column
  * @return DbOperator*
@@ -168,6 +191,12 @@ DbOperator *parse_create_column(char *create_arguments) {
   char **create_arguments_index = &create_arguments;
   char *column_name = next_token(create_arguments_index, &status);
   char *db_and_table_name = next_token(create_arguments_index, &status);
+  // the type and the `encoded` option, if given
+  char *options[2] = {NULL, NULL};
+  size_t num_options = 0;
+  while (num_options < 2 && *create_arguments_index) {
+    options[num_options++] = next_token(create_arguments_index, &status);
+  }
 
   // not enough arguments
   if (status == INCORRECT_FORMAT) {
@@ -178,14 +207,30 @@ DbOperator *parse_create_column(char *create_arguments) {
   // split db and table name
   char *db_name = strsep(&db_and_table_name, ".");
   char *table_name = db_and_table_name;
+  if (!table_name) {
+    log_err("L%d: parse_create_column failed. incorrect format\n", __LINE__);
+    return NULL;
+  }
 
   // last character should be a ')', replace it with a null-terminating character
-  int last_char = strlen(table_name) - 1;
-  if (table_name[last_char] != ')') {
+  char *last_arg = num_options > 0 ? options[num_options - 1] : table_name;
+  int last_char = strlen(last_arg) - 1;
+  if (*create_arguments_index || last_char < 0 || last_arg[last_char] != ')') {
     log_err("L%d: parse_create_column failed. incorrect format\n", __LINE__);
     return NULL;
   }
-  table_name[last_char] = '\0';
+  last_arg[last_char] = '\0';
+  DataType data_type = INT;
+  int encoded = 0;
+  for (size_t i = 0; i < num_options; i++) {
+    char *option = trim_whitespace(options[i]);
+    if (strcmp(option, "encoded") == 0) {
+      encoded = 1;
+    } else if (parse_data_type(option, &data_type) != 0) {
+      log_err("L%d: parse_create_column failed. Unknown type %s\n", __LINE__, option);
+      return NULL;
+    }
+  }
   // Get the column name free of quotation marks
   column_name = trim_quotes(column_name);
   // check that the database argument is the current active database
@@ -206,6 +251,8 @@ DbOperator *parse_create_column(char *create_arguments) {
   strcpy(dbo->operator_fields.create_operator.name, column_name);
   dbo->operator_fields.create_operator.db = current_db;
   dbo->operator_fields.create_operator.table = table;
+  dbo->operator_fields.create_operator.data_type = data_type;
+  dbo->operator_fields.create_operator.encoded = encoded;
   return dbo;
 }
 
@@ -319,6 +366,7 @@ Column *get_chandle_or_dbtblcol(char *name) {
  * create(idx,db1.tbl4.col3,sorted,clustered)  --- Create a clustered index on col3
  * create(idx,db1.tbl4.col2,btree,unclustered) -- Create an unclustered btree index on
  * col2
+ * create(idx,db1.tbl4.col1,cracking,unclustered) -- Crack col1 as selects come in
  *
  * @param args: e.g. db1.tbl4.col3,sorted,clustered)
  * @return DbOperator* with col, IndexType: btree_clustered, sorted_unclustered, etc.
@@ -359,6 +407,9 @@ DbOperator *parse_create_index(char *args) {
     idx_type = SORTED_CLUSTERED;
   } else if (strcmp(index_type, "sorted") == 0 && strcmp(clustered, "unclustered") == 0) {
     idx_type = SORTED_UNCLUSTERED;
+  } else if (strcmp(index_type, "cracking") == 0 &&
+             strcmp(clustered, "unclustered") == 0) {
+    idx_type = CRACKING_UNCLUSTERED;
   } else {
     log_err(
         "L%d: parse_create_index failed. got bad index type: type=%s, cluster_type=%s\n",
@@ -459,11 +510,22 @@ DbOperator *parse_insert(char *query_command, message *send_message) {
     dbo->type = INSERT;
     dbo->operator_fields.insert_operator.table = insert_table;
     dbo->operator_fields.insert_operator.values =
-        malloc(sizeof(int) * insert_table->num_cols);
-    // parse inputs until we reach the end. Turn each given string into an integer.
+        malloc(sizeof(InsertValue) * insert_table->num_cols);
+    // parse inputs until we reach the end. Turn each given string into a value of the
+    // type of its column.
     while ((token = strsep(command_index, ",")) != NULL) {
-      int insert_val = atoi(token);
-      dbo->operator_fields.insert_operator.values[columns_inserted] = insert_val;
+      if (columns_inserted < insert_table->num_cols) {
+        InsertValue *value =
+            &dbo->operator_fields.insert_operator.values[columns_inserted];
+        DataType data_type = insert_table->columns[columns_inserted].data_type;
+        if (data_type == LONG) {
+          value->l = atol(token);
+        } else if (data_type == DOUBLE) {
+          value->d = atof(token);
+        } else {
+          value->i = atoi(token);
+        }
+      }
       columns_inserted++;
     }
     // check that we received the correct number of input values
@@ -482,6 +544,71 @@ DbOperator *parse_insert(char *query_command, message *send_message) {
   }
 }
 
+/**
+ * @brief Parses the `<low>,<high>` bounds of a select into `comparator`; `null` leaves
+ * that side open.
+ */
+static void parse_select_bounds(char **command_index, Comparator *comparator,
+                                message_status *status) {
+  char *low_str = next_token(command_index, status);
+  if (*status == INCORRECT_FORMAT) return;
+  if (strcmp(low_str, "null") == 0) {
+    comparator->type1 = NO_COMPARISON;
+  } else {
+    comparator->type1 = GREATER_THAN_OR_EQUAL;
+    comparator->p_low = atol(low_str);
+    comparator->d_low = atof(low_str);
+    cs165_log(stdout, "parse_select: low_val: %ld\n", comparator->p_low);
+  }
+
+  char *high_str = next_token(command_index, status);
+  if (*status == INCORRECT_FORMAT) return;
+  if (strcmp(high_str, "null") == 0) {
+    comparator->type2 = NO_COMPARISON;
+  } else {
+    comparator->type2 = LESS_THAN;
+    comparator->p_high = atol(high_str);
+    comparator->d_high = atof(high_str);
+    cs165_log(stdout, "parse_select: high_val: %ld\n", comparator->p_high);
+  }
+}
+
+/**
+ * @brief Parses the `(<col>,<low>,<high>)` triples of a conjunctive select, e.g.
+ * `select(db1.tbl1.col1,10,20,db1.tbl1.col2,null,5)`, which qualifies the rows whose
+ * values satisfy every triple. The columns must have the same number of rows, e.g. be
+ * columns of one table.
+ */
+static DbOperator *parse_conjunctive_select(char **command_index, size_t num_predicates,
+                                            char *handle) {
+  message_status status = OK_DONE;
+  Comparator *predicates = calloc(num_predicates, sizeof(Comparator));
+  if (!predicates) return NULL;
+  for (size_t p = 0; p < num_predicates; p++) {
+    char *db_tbl_col_name = next_token(command_index, &status);
+    if (status == INCORRECT_FORMAT) break;
+    parse_select_bounds(command_index, &predicates[p], &status);
+    if (status == INCORRECT_FORMAT) break;
+    predicates[p].col = get_chandle_or_dbtblcol(db_tbl_col_name);
+    if (!predicates[p].col) {
+      log_err("L%d: parse_select: column %s not found\n", __LINE__, db_tbl_col_name);
+      status = OBJECT_NOT_FOUND;
+      break;
+    }
+  }
+  DbOperator *dbo = status == OK_DONE ? malloc(sizeof(DbOperator)) : NULL;
+  if (!dbo) {
+    free(predicates);
+    return NULL;
+  }
+  dbo->type = SELECT;
+  dbo->operator_fields.select_operator.comparator = &predicates[0];
+  dbo->operator_fields.select_operator.predicates = predicates;
+  dbo->operator_fields.select_operator.num_predicates = num_predicates;
+  dbo->operator_fields.select_operator.res_handle = strdup(handle);
+  return dbo;
+}
+
 /**
  * @brief parse_select
  * This method takes in a string representing the arguments to select from a table, parses
@@ -490,6 +617,8 @@ DbOperator *parse_insert(char *query_command, message *send_message) {
  * Example query (without a handle):
  *     - select(db1.tbl1.col1,null,20)   --- select all values strictly less than 20
  *     - select(db1.tbl1.col1,20,40)     --- select all values between 20 (incl.) and 40
+ *     - select(db1.tbl1.col1,20,40,db1.tbl1.col2,null,5)
+ *                                       --- select the rows matching both ranges
  *
  * @param query_command
  * @param handle  the handle to the result of this select query
@@ -510,6 +639,10 @@ DbOperator *parse_select(char *query_command, char *handle) {
       comma_count++;
     }
   }
+  // Conjunctive: (<col>,<low>,<high>) repeated, at least twice
+  if (comma_count >= 5 && (comma_count + 1) % 3 == 0) {
+    return parse_conjunctive_select(command_index, (comma_count + 1) / 3, handle);
+  }
   char *posn_vec = NULL;
   if (comma_count == 3) {  // Type 2: (<posn_vec>,<val_vec>,<low>,<high>)
     posn_vec = next_token(command_index, &status);
@@ -521,32 +654,14 @@ DbOperator *parse_select(char *query_command, char *handle) {
   DbOperator *dbo = malloc(sizeof(DbOperator));
   dbo->type = SELECT;
   dbo->operator_fields.select_operator.comparator = malloc(sizeof(Comparator));
+  dbo->operator_fields.select_operator.predicates = NULL;
+  dbo->operator_fields.select_operator.num_predicates = 1;
 
-  char *low_str = next_token(command_index, &status);
-  if (status == INCORRECT_FORMAT) {
-    return NULL;
-  }
-  if (strcmp(low_str, "null") == 0) {
-    dbo->operator_fields.select_operator.comparator->type1 = NO_COMPARISON;
-  } else {
-    dbo->operator_fields.select_operator.comparator->type1 = GREATER_THAN_OR_EQUAL;
-    dbo->operator_fields.select_operator.comparator->p_low = atol(low_str);
-    cs165_log(stdout, "parse_select: low_val: %ld\n",
-              dbo->operator_fields.select_operator.comparator->p_low);
-  }
-
-  char *high_str = next_token(command_index, &status);
+  parse_select_bounds(command_index, dbo->operator_fields.select_operator.comparator,
+                      &status);
   if (status == INCORRECT_FORMAT) {
     return NULL;
   }
-  if (strcmp(high_str, "null") == 0) {
-    dbo->operator_fields.select_operator.comparator->type2 = NO_COMPARISON;
-  } else {
-    dbo->operator_fields.select_operator.comparator->type2 = LESS_THAN;
-    dbo->operator_fields.select_operator.comparator->p_high = atol(high_str);
-    cs165_log(stdout, "parse_select: high_val: %ld\n",
-              dbo->operator_fields.select_operator.comparator->p_high);
-  }
 
   // Try getting column from catalog manager
   cs165_log(stdout, "parse_select: getting column %s from catalog\n", db_tbl_col_name);
@@ -558,6 +673,7 @@ DbOperator *parse_select(char *query_command, char *handle) {
   cs165_log(stdout, "parse_select: got column %s\n", col->name);
   dbo->operator_fields.select_operator.comparator->col = col;
   dbo->operator_fields.select_operator.comparator->ref_posns = NULL;
+  dbo->operator_fields.select_operator.comparator->ref_bitmap = NULL;
 
   // We let the query handler decide on this before execution
   dbo->operator_fields.select_operator.comparator->on_sorted_data = 0;
@@ -565,7 +681,14 @@ DbOperator *parse_select(char *query_command, char *handle) {
 
   // If posn_vec is not NULL, then we have a type 2 select query
   if (posn_vec) {
-    Column *posn_col = get_handle(posn_vec);
+    // positions kept as a bitmap are walked as such (see select_over_bitmap), ranges
+    // are expanded to a list
+    Column *posn_col = get_positions_handle(posn_vec);
+    if (posn_col && posn_col->ranges &&
+        positions_expand(posn_col, g_client_context->is_single_core,
+                         g_client_context->query_arena) != 0) {
+      posn_col = NULL;
+    }
     if (!posn_col) {
       db_operator_free(dbo);
       log_err("L%d: parse_select: posn_vec %s not found\n", __LINE__, posn_vec);
@@ -585,6 +708,7 @@ DbOperator *parse_select(char *query_command, char *handle) {
     // }
     // log_info("parse_select: posn_vec sanity check passed\n");
     dbo->operator_fields.select_operator.comparator->ref_posns = posn_col->data;
+    dbo->operator_fields.select_operator.comparator->ref_bitmap = posn_col->bitmap;
   }
 
   return dbo;
@@ -660,7 +784,9 @@ DbOperator *parse_aggr(char *query_command, char *res_handle, OperatorType type)
   char *col_handle = trim_parenthesis(query_command);
   cs165_log(stdout, "res_handle: %s, col: %s\n", res_handle, col_handle);
 
-  Column *col = get_chandle_or_dbtblcol(col_handle);
+  // Aggregates evaluate pending fetches themselves, so don't materialize them here
+  Column *col = strchr(col_handle, '.') ? get_column_from_catalog(col_handle)
+                                        : get_pending_handle(col_handle);
   if (!col) {
     log_err("L%d: parse_aggr failed. Bad column name\n", __LINE__);
     return NULL;
@@ -842,8 +968,8 @@ DbOperator *parse_join(char *query_command, char *handle, message *send_message)
   if (status == INCORRECT_FORMAT) handle_error(send_message, error_message);
 
   // Get the columns from the catalog
-  Column *psn1_col = get_handle(psn1);
-  Column *psn2_col = get_handle(psn2);
+  Column *psn1_col = get_positions_handle(psn1);
+  Column *psn2_col = get_positions_handle(psn2);
   Column *vals1_col = get_handle(vals1);
   Column *vals2_col = get_handle(vals2);
 
@@ -14,6 +14,8 @@
 #include <time.h>
 #include <unistd.h>
 
+#include "typed_kernels.h"
+
 #define ANSI_COLOR_RED "\x1b[31m"
 #define ANSI_COLOR_GREEN "\x1b[32m"
 #define ANSI_COLOR_RESET "\x1b[0m"
@@ -237,3 +239,69 @@ ssize_t recv_message_safe(int socket, void *buffer, size_t length) {
   }
   return total_received;
 }
+
+size_t data_type_size(DataType type) {
+  switch (type) {
+    case LONG:
+      return sizeof(long);
+    case DOUBLE:
+      return sizeof(double);
+    default:
+      return sizeof(int);
+  }
+}
+
+const char *data_type_name(DataType type) {
+  switch (type) {
+    case LONG:
+      return "long";
+    case DOUBLE:
+      return "double";
+    default:
+      return "int";
+  }
+}
+
+int parse_data_type(const char *name, DataType *type) {
+  DataType types[] = {INT, LONG, DOUBLE};
+  for (size_t i = 0; i < sizeof(types) / sizeof(types[0]); i++) {
+    if (strcmp(name, data_type_name(types[i])) == 0) {
+      *type = types[i];
+      return 0;
+    }
+  }
+  return -1;
+}
+
+void widen_values(const void *values, DataType from, size_t n, void *out, DataType to) {
+  if (from == INT && to == LONG) {
+    typed_convert_int_long(values, n, out);
+  } else if (from == INT && to == DOUBLE) {
+    typed_convert_int_double(values, n, out);
+  } else if (from == LONG && to == DOUBLE) {
+    typed_convert_long_double(values, n, out);
+  } else {
+    memcpy(out, values, n * data_type_size(from));
+  }
+}
+
+uint64_t checksum64(const void *data, size_t size) {
+  // Four independent multiply-xor lanes over 8-byte words keep the multiplier busy;
+  // this runs at several GB/s, far cheaper than rebuilding what the file holds
+  const uint64_t prime = 0x100000001b3ULL;
+  uint64_t lanes[4] = {0xcbf29ce484222325ULL, 0x84222325cbf29ce4ULL,
+                       0x9e3779b97f4a7c15ULL, 0xc2b2ae3d27d4eb4fULL};
+  const unsigned char *bytes = (const unsigned char *)data;
+  size_t i = 0;
+  for (; i + 32 <= size; i += 32) {
+    for (int l = 0; l < 4; l++) {
+      uint64_t word;
+      memcpy(&word, bytes + i + 8 * l, sizeof(word));
+      lanes[l] = (lanes[l] ^ word) * prime;
+    }
+  }
+  uint64_t hash = lanes[0];
+  for (int l = 1; l < 4; l++) hash = (hash ^ lanes[l]) * prime;
+  for (; i < size; i++) hash = (hash ^ bytes[i]) * prime;
+  return hash ^ size;
+}
@@ -28,11 +28,13 @@ Table *create_table(Db *db, const char *name, size_t num_columns, Status *status
  *
  * @param table
  * @param name
+ * @param data_type the type of the values the column holds
  * @param sorted
  * @param ret_status
  * @return Column*
  */
-Column *create_column(Table *table, char *name, bool sorted, Status *ret_status);
+Column *create_column(Table *table, char *name, DataType data_type, bool sorted,
+                      Status *ret_status);
 
 /**
  * @brief Get the column from catalog object
@@ -50,6 +52,38 @@ Table *get_table_from_catalog(const char *table_name);
 Status load_data(const char *table_name, const char *column_name, const void *data,
                  size_t num_elements);
 
+/**
+ * @brief Write the column's sorted data, positions and B-tree levels to
+ * `disk/<db>.<tbl>.<col>.idx`, so the next startup maps them back instead of rebuilding
+ * the index. Does nothing for an index that was itself mapped from that file; removes
+ * the file if rows were inserted since the index was built.
+ */
+Status persist_column_index(Table *table, Column *col);
+
+/**
+ * @brief Write the column's zone map to `disk/<db>.<tbl>.<col>.zm`, next to its `.bin`
+ * file, so the next startup reads it instead of scanning the column. Not synced, as
+ * a file that does not pass its checksum is rebuilt; only a shutdown writes one, and
+ * checkpoints remove it once the column changes.
+ */
+Status persist_zone_map(Table *table, Column *col);
+
+/**
+ * @brief Record that rows `from_row` onwards of the column were written, so the next
+ * checkpoint flushes them to its file.
+ */
+void mark_column_dirty(Column *col, size_t from_row);
+
+/**
+ * @brief Make the files on disk current: flush the dirty rows of every column, write
+ * a new version of `disk/<db>.meta` atomically (write a temp file, sync, rename), then
+ * empty the write-ahead log, which they now cover. Call with the catalog lock held;
+ * shared is enough, as it keeps inserts and loads out.
+ *
+ * @param bytes_written incremented by the column and catalog bytes written
+ */
+Status checkpoint_catalog(size_t *bytes_written);
+
 // Shutdown the catalog manager
 Status shutdown_catalog_manager(void);
 
@@ -0,0 +1,50 @@
+#ifndef CHECKPOINT_H
+#define CHECKPOINT_H
+
+#include <stddef.h>
+
+#include "common.h"
+
+/**
+ * @brief Background thread that calls `checkpoint_catalog` every
+ * `CHECKPOINT_INTERVAL_MS`, so column data and the catalog reach disk while the server
+ * runs rather than all at shutdown. A shutdown then only flushes what changed since the
+ * last checkpoint, and a recovery replays at most one interval of the write-ahead log.
+ *
+ * A checkpoint holds the catalog lock shared: queries keep running, inserts and loads
+ * wait for it.
+ */
+#define CHECKPOINT_INTERVAL_MS 2000
+
+// What the checkpoints that wrote anything cost so far
+typedef struct CheckpointStats {
+  size_t num_checkpoints;
+  size_t bytes_written;      // column data and catalog, over all of them
+  double total_duration_us;
+  double last_duration_us;
+} CheckpointStats;
+
+/**
+ * @brief Starts the checkpointer; call once the database is loaded.
+ *
+ * @return 0 on success, -1 if the thread could not be started
+ */
+int checkpointer_start(unsigned interval_ms);
+
+/**
+ * @brief Stops the checkpointer, waiting for a checkpoint in progress, and logs its
+ * stats. Call before `shutdown_catalog_manager`.
+ */
+void checkpointer_stop(void);
+
+void checkpointer_stats(CheckpointStats *stats);
+
+/**
+ * @brief Runs a checkpoint right away and counts it in the stats. Loads and new
+ * databases call it before they are acknowledged, as the log does not hold them, and so
+ * does a create or insert whose log record could not be appended or synced. Call with
+ * the catalog lock held; one checkpoint runs at a time.
+ */
+Status checkpoint_now(void);
+
+#endif
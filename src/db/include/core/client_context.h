@@ -1,27 +1,92 @@
 #ifndef CLIENT_CONTEXT_H
 #define CLIENT_CONTEXT_H
 
+#include <pthread.h>
+#include <stdint.h>
+
 #include "db.h"
+#include "mempool.h"
+#include "str_map.h"
 #include "utils.h"
 #include "vector.h"
 
 /*
- * holds the information necessary to refer to a result column
+ * holds the information necessary to refer to a result column. Every client session
+ * owns one, so handle names never collide across connections.
  */
 typedef struct ClientContext {
-  Column *chandle_table;
+  Column **chandle_table;  // one allocation per handle, so Column* survive table growth
   int chandles_in_use;
   int chandle_slots;
+  StrMap *chandle_index;     // handle name -> slot in chandle_table
+  Vector *retired_handles;   // handles replaced by a rebind, freed after the query
+  pthread_mutex_t handle_lock;  // guards the above; batch tasks create handles at once
   int is_batch_queries_on;
   int is_single_core;
-  Vector *bselect_dbos;  // Vector of DbOperators for batched select queries
+  size_t join_memory_budget;  // bytes a grace hash join may use before spilling
+  size_t join_bytes_spilled;  // by the session's last join; see print_stats()
+  Vector *batch_queries;  // queries queued since batch_queries(), see batch.c
+  Arena *query_arena;    // scratch of the running query; reset once its response is sent
+  Arena **task_arenas;   // scratch of the tasks a batch runs concurrently, one each
+  size_t num_task_arenas;
+  uint64_t wal_lsn;  // log position of the session's unacknowledged insert, see wal.h
+  struct ClientContext *next;  // registry of live sessions, see client_context.c
 } ClientContext;
 
-extern ClientContext *g_client_context;
+/**
+ * @brief The context of the session running on the calling thread; set by the session
+ * thread (see server.c) and NULL elsewhere, e.g. on thread pool workers.
+ */
+extern __thread ClientContext *g_client_context;
 
-void init_client_context(void);
-void free_client_context(void);
+/**
+ * @brief Allocates a session context and registers it, so writers can reach its pending
+ * handles. Returns NULL on allocation failure.
+ */
+ClientContext *create_client_context(void);
+
+/**
+ * @brief Unregisters a session context and frees its handles.
+ */
+void free_client_context(ClientContext *context);
+
+/**
+ * @brief Creates the handle `name` in the calling session's context. If the name is
+ * already bound, the new handle takes its slot and the old one is retired: it stays
+ * readable until `release_retired_handles`, since the query may still be reading it.
+ * Safe to call from the concurrent tasks of a batch.
+ */
 int create_new_handle(const char *name, Column **out_column);
+
+/**
+ * @brief Frees the handles retired by rebinds; run once the current query is done.
+ */
+void release_retired_handles(ClientContext *context);
+
+/**
+ * @brief Looks up a handle, materializing it first if it is pending (see pipeline.h) and
+ * turning a select result kept as a bitmap or ranges into a position list (see
+ * positions.h).
+ */
 Column *get_handle(const char *name);
 
+/**
+ * @brief Like `get_handle`, but a select result kept as a bitmap or ranges stays one;
+ * for the operators that read every form of positions (fetch, type 2 select, join).
+ */
+Column *get_positions_handle(const char *name);
+
+/**
+ * @brief Looks up a handle without materializing it; for the operators that can consume
+ * a pending handle directly.
+ */
+Column *get_pending_handle(const char *name);
+
+/**
+ * @brief Materializes the pending handles of every session; run before anything that
+ * rewrites base columns in place (loads, clustered index builds). The caller holds the
+ * catalog write lock, so no other session is running a query.
+ */
+void materialize_pending_handles(void);
+
 #endif
@@ -0,0 +1,67 @@
+#ifndef COLUMN_ENCODING_H
+#define COLUMN_ENCODING_H
+
+#include <stdint.h>
+
+#include "db.h"
+
+/**
+ * @brief (Re)builds the encodings of a base int column created `encoded` from its data,
+ * each kept only when the column suits it (see `ENCODING_MAX_BITS`,
+ * `DICTIONARY_MAX_VALUES` and `RLE_MIN_RUN_LENGTH`):
+ *
+ * - `packed`: frame-of-reference + bit-packing, when its values span few bits
+ *   (bitpack.h);
+ * - `dictionary`: order-preserving dictionary codes, bit-packed, when its values are too
+ *   far apart for `packed` but few of them are distinct (dictionary.h);
+ * - `runs`: run-length encoding, when it has long runs (rle.h). It is kept next to either
+ *   of the others.
+ *
+ * An encoding is a copy kept in memory next to the column's file, which stays in the
+ * plain format that fetches, joins and indexes read; hence a column only gets one when
+ * it asks for it. Out of memory, the column is left without the encoding. Call after
+ * the data is replaced wholesale, e.g. by a load.
+ *
+ * @return 1 if the column now has an encoding, 0 if not
+ */
+int column_encode(Column *col);
+
+/**
+ * @brief Appends the value just written at row `row` of the column's data to its
+ * encodings. An encoding the value does not fit (outside the frame, not in the
+ * dictionary) is dropped, so scans fall back to the plain data until the next
+ * `column_encode`.
+ */
+void column_encoding_append(Column *col, size_t row, int value);
+
+void column_encoding_free(Column *col);
+
+// Whether the column has an encoding that `column_scan_range` reads instead of its data
+static inline int column_is_encoded(const Column *col) {
+  return col->packed || col->dictionary || col->runs;
+}
+
+/**
+ * @brief `scan_range` over rows `[start, end)` of a base column: on its runs, packed
+ * codes or dictionary codes when it has them, on its data otherwise.
+ *
+ * @return the number of positions written to `out`
+ */
+size_t column_scan_range(const Column *col, size_t start, size_t end, int low, int high,
+                         int *out);
+
+// Same as `column_scan_range`, for `scan_range_bits`
+size_t column_scan_range_bits(const Column *col, size_t start, size_t end, int low,
+                              int high, uint64_t *words);
+
+/**
+ * @brief Adds the values of rows `[start, end)` of a base column to `*sum` and folds them
+ * into `*min` and `*max`; a run at a time when the column is run-length encoded.
+ */
+void column_range_stats(const Column *col, size_t start, size_t end, int64_t *sum,
+                        long *min, long *max);
+
+// Copies rows `[start, end)` of a base column to `out[0 .. end - start)`
+void column_decode(const Column *col, size_t start, size_t end, int *out);
+
+#endif
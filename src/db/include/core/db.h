@@ -1,10 +1,12 @@
 #ifndef DB_H
 #define DB_H
 
+#include <pthread.h>
 #include <stdlib.h>
 
 #include "btree.h"
 #include "common.h"
+#include "threadpool.h"
 
 /**
  * @brief ColumnIndex is the sorted copy of the base data in a column.
@@ -16,15 +18,54 @@
  * - `sorted_data`: the sorted data array
  * - `positions`: the positions of the data in the original array
  * - `idx_type`: the type of index (see `IndexType` enum)
- * The number of elements in the `sorted_data` and `positions` arrays must be the same as
- * column's `Column->num_elements`. So storing it would be redundant (maybe helpful tho)
+ * - `num_elements`: the number of rows in `sorted_data`/`positions`
+ * - `mmap_base`/`mmap_size`: set when the arrays (and the B-tree levels) point into the
+ *   column's `.idx` file rather than into heap memory; see `load_column_index`
+ * - `delta_data`/`delta_positions`: rows inserted since the arrays were built, kept
+ *   sorted by value; lookups consult them alongside the main arrays, and a background
+ *   merge folds them in once there are `INDEX_DELTA_MERGE_THRESHOLD` of them (see
+ *   `index_insert`). `num_elements + delta_size` is always the column's row count.
+ * - `merge`: the background merge in flight, if any
+ * - `cracker`: a `CRACKING_UNCLUSTERED` index keeps none of the above; its cracker
+ *   column is copied from the column by the first select and reorganized by every
+ *   select after it (see `index_crack_select`). `crack_lock` serializes those
+ *   selects, which otherwise run side by side under the catalog read lock.
+ * - On a LONG or DOUBLE column, a clustered index keeps none of the above either:
+ *   `num_elements` is the length of the column's sorted prefix, the whole column once
+ *   it is clustered. An unclustered one keeps its sorted values in `typed_sorted`
+ *   instead of `sorted_data`, and their rows in `positions`; rows inserted since it
+ *   was built are past `num_elements` and scanned (see `create_idx_on`).
  */
 typedef struct ColumnIndex {
   int *sorted_data;
   int *positions;
+  void *typed_sorted;
   IndexType idx_type;
+  size_t num_elements;
+  void *mmap_base;
+  size_t mmap_size;
+  int *delta_data;
+  int *delta_positions;
+  size_t delta_size;
+  size_t delta_capacity;
+  struct IndexMerge *merge;
+  struct Cracker *cracker;
+  pthread_mutex_t crack_lock;
 } ColumnIndex;
 
+/**
+ * @brief Min and max of every `ZONE_SIZE`-row block of a base column, so scans can skip
+ * blocks whose range cannot satisfy a predicate. Zone `z` covers rows
+ * `[z * ZONE_SIZE, (z + 1) * ZONE_SIZE)`; the last zone may be partial. Empty
+ * (`num_zones == 0`) on handles and on columns that have no data yet.
+ */
+typedef struct ZoneMap {
+  int *mins;
+  int *maxs;
+  size_t num_zones;
+  size_t capacity;
+} ZoneMap;
+
 typedef struct Column {
   char name[MAX_SIZE_NAME];
   DataType data_type;
@@ -34,13 +75,29 @@ typedef struct Column {
   size_t mmap_size;  // can be derived from mmap_size (clean up later), also a result
                      // column doesn't need to have this; what'd this mean for `insert`?
   int disk_fd;
-  int is_dirty;  // a flag to indicate if the column has been modified
+  int is_dirty;       // rows were written since the column was last flushed to its file
+  size_t dirty_from;  // the first of them; see `mark_column_dirty`
   //   void *index;
   size_t num_elements;
   // Stat metrics
   long min_value;
   long max_value;
   int64_t sum;
+  ZoneMap zones;  // base columns only; see zone_map.h
+  // Encoded copies of `data` that selects and fetches read instead, on base columns
+  // created `encoded` that suit them; see column_encoding.h. `data` stays the stored
+  // copy.
+  int encode;                      // created `encoded`
+  struct PackedInts *packed;       // values spanning few bits
+  struct Dictionary *dictionary;   // few distinct values
+  struct RunLengths *runs;         // long runs, e.g. after clustering
+  // Set on a select/fetch handle whose data has not been computed yet; see pipeline.h
+  struct PendingResult *pending;
+  // Set on a select handle that keeps its positions as a bitmap rather than in `data`;
+  // see positions.h
+  struct Bitmap *bitmap;
+  // Set on a select handle that keeps its positions as row ranges; see positions.h
+  struct PositionRanges *ranges;
 } Column;
 
 /**
@@ -82,6 +139,18 @@ typedef struct Db {
 
 extern Db *current_db;
 
+// Worker threads shared by all parallel operators; created once in `db_startup`
+extern ThreadPool *g_thread_pool;
+
+/**
+ * @brief Reader/writer lock over the catalog (`current_db` and everything reachable from
+ * it). Sessions hold it shared for read queries, so those run in parallel, and
+ * exclusively for anything that creates, loads, inserts or builds an index.
+ */
+void catalog_read_lock(void);
+void catalog_write_lock(void);
+void catalog_unlock(void);
+
 /*
  * Use this command to see if databases that were persisted start up properly. If
  * files don't load as expected, this can return an error.
@@ -0,0 +1,87 @@
+#ifndef WAL_H
+#define WAL_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "operators.h"
+
+/**
+ * @brief Write-ahead log of the creates and inserts made since the catalog was last
+ * written, in `disk/<db>.wal`.
+ *
+ * Every create and insert appends a record while it holds the catalog write lock, an
+ * insert before it applies the row, so the log is in the order the changes are applied.
+ * The session acknowledges the change only after `wal_commit`, outside the lock: one
+ * session syncs the log for every record appended so far while the others wait for it,
+ * so the changes of concurrent sessions share one `fdatasync` (group commit) and none
+ * of them pays for writing the catalog or an `msync` of the column files.
+ *
+ * At startup, `wal_recover` re-applies the creates the catalog lacks and the rows past
+ * its row counts, skips the records that do not fit it and cuts off a torn record at
+ * the tail. Once the catalog and the column files are written again, `wal_checkpoint`
+ * empties the log.
+ */
+
+// What a create record makes
+typedef enum WalCreateKind {
+  WAL_CREATE_TABLE,
+  WAL_CREATE_COLUMN,
+  WAL_CREATE_INDEX,
+} WalCreateKind;
+
+// Set in the param of a column created `encoded`, next to its DataType
+#define WAL_COLUMN_ENCODED 0x100
+
+/**
+ * @brief Appends an insert of `values` (one per column) as row `row` of `table`. Call
+ * with the catalog write lock held, right before the row is applied (see `stage_row`).
+ *
+ * @return the log position that `wal_commit` waits for, or 0 if the record could not be
+ * appended
+ */
+uint64_t wal_log_insert(const Table *table, const InsertValue *values, size_t row);
+
+/**
+ * @brief Appends a create that was just applied. Call with the catalog write lock held.
+ *
+ * @param table the table created, or the table of the column
+ * @param column the column created or indexed; NULL for a table
+ * @param param the column count of a table, the DataType of a column (with
+ * `WAL_COLUMN_ENCODED`) or the IndexType of an index
+ * @return as for `wal_log_insert`
+ */
+uint64_t wal_log_create(WalCreateKind kind, const char *table, const char *column,
+                        long param);
+
+/**
+ * @brief Waits until the log is durable up to `lsn`, syncing it if no other session is
+ * already doing so. Call without the catalog lock.
+ *
+ * @return 0 on success, -1 if the log could not be written or synced
+ */
+int wal_commit(uint64_t lsn);
+
+/**
+ * @brief Re-applies the log of the database just loaded by `init_db_from_disk` and
+ * keeps it open for the records that follow.
+ *
+ * @return the number of records replayed, or -1 if the log could not be read
+ */
+long wal_recover(void);
+
+/**
+ * @brief Empties the log; call once the catalog and the column files it covers are on
+ * disk. A log that failed to be written or synced works again once emptied.
+ */
+void wal_checkpoint(void);
+
+/**
+ * @brief Closes the log, e.g. before `create_db` replaces the database. The next record
+ * starts a new one.
+ */
+void wal_close(void);
+
+void test_wal(void);
+
+#endif
@@ -0,0 +1,57 @@
+#ifndef ZONE_MAP_H
+#define ZONE_MAP_H
+
+#include <stdbool.h>
+
+#include "db.h"
+
+/**
+ * @brief (Re)builds `col->zones` from the column's data. Call after the data is
+ * replaced wholesale, e.g. by a load. Only int columns get zones.
+ *
+ * @return 0 on success, -1 if out of memory (the column is then left without zones)
+ */
+int zone_map_build(Column *col);
+
+/**
+ * @brief Folds the value just appended at row `row` into its zone, starting a new zone
+ * when the row is the first of one.
+ *
+ * @return 0 on success, -1 if out of memory (the zones are then dropped, so scans fall
+ * back to reading every block)
+ */
+int zone_map_append(Column *col, size_t row, int value);
+
+void zone_map_free(Column *col);
+
+/**
+ * @brief Whether any row of `[start, end)` may hold a value in `[low, high]`. Always
+ * true when the column has no zones for that range.
+ */
+bool zone_map_may_match(const Column *col, size_t start, size_t end, int low, int high);
+
+/**
+ * @brief `column_scan_range` over rows `[start, end)` of a base column that skips every
+ * zone whose min/max excludes `[low, high]`. `out` must have room for `end - start`
+ * positions.
+ *
+ * @return the number of positions written to `out`
+ */
+size_t zone_map_scan(const Column *col, size_t start, size_t end, int low, int high,
+                     int *out);
+
+/**
+ * @brief Estimated number of the `num_rows` values in `[min_value, max_value]` that
+ * fall in `[low, high]`, assuming they are spread evenly over that range.
+ */
+double estimate_range_rows(long min_value, long max_value, size_t num_rows, int low,
+                           int high);
+
+/**
+ * @brief Estimated number of rows of `[0, num_rows)` of a base column with a value in
+ * `[low, high]`: `estimate_range_rows` per zone, or over the column's min and max where
+ * it has no zones.
+ */
+double zone_map_estimate(const Column *col, size_t num_rows, int low, int high);
+
+#endif
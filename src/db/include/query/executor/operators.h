@@ -19,6 +19,8 @@ typedef struct CreateOperator {
   Db *db;
   Table *table;
   int col_count;
+  DataType data_type;  // of a new column
+  int encoded;         // a new column keeps encodings; see column_encoding.h
 } CreateOperator;
 
 typedef struct CreateIndexOperator {
@@ -29,9 +31,16 @@ typedef struct CreateIndexOperator {
 /*
  * necessary fields for insertion
  */
+// One inserted value, in the type of its column
+typedef union InsertValue {
+  int i;
+  long l;
+  double d;
+} InsertValue;
+
 typedef struct InsertOperator {
   Table *table;
-  int *values;
+  InsertValue *values;
 } InsertOperator;
 /*
  * necessary fields for insertion
@@ -47,8 +56,11 @@ typedef struct LoadOperator {
 typedef struct Comparator {
   Column *col;      // the column to compare against.
   int *ref_posns;   // original positions of the values in the column.
+  struct Bitmap *ref_bitmap;  // the same positions kept as a bitmap (see positions.h)
   long int p_low;   // used in equality and ranges.
   long int p_high;  // used in range compares.
+  double d_low;     // the same bounds, for a DOUBLE column
+  double d_high;
   ComparatorType type1;
   ComparatorType type2;
   int on_sorted_data;
@@ -57,6 +69,10 @@ typedef struct Comparator {
 typedef struct SelectOperator {
   char *res_handle;
   Comparator *comparator;
+  // A conjunctive select keeps its predicates here, `comparator` being the first;
+  // NULL for a select with one predicate
+  Comparator *predicates;
+  size_t num_predicates;
 } SelectOperator;
 
 typedef struct FetchOperator {
@@ -113,12 +129,15 @@ typedef union OperatorFields {
  * client_fd: the file descriptor of the client that this operator will return to
  * context: the context of the operator in question. This context holds the local
  * results of the client in question.
+ * scratch: temporary memory of the operator; the session's query arena, or the own
+ * arena of the batch task running it (see batch.c)
  */
 typedef struct DbOperator {
   OperatorType type;
   OperatorFields operator_fields;
   int client_fd;
   ClientContext *context;
+  Arena *scratch;
 } DbOperator;
 
 void db_operator_free(DbOperator *query);
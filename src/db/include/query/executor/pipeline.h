@@ -0,0 +1,53 @@
+#ifndef PIPELINE_H
+#define PIPELINE_H
+
+#include "db.h"
+#include "mempool.h"
+
+/**
+ * @brief Fused select -> fetch -> aggregate pipeline.
+ *
+ * A range select over an unindexed (or clustered and run-length encoded) base column
+ * does not build its position vector right away; its handle records the predicate
+ * instead. A fetch through such a handle records the column to gather from. When an
+ * aggregate reads the fetch handle, the whole chain runs as one pass over cache-sized
+ * blocks: the SIMD scan kernel selects positions into a block-local buffer, and the
+ * qualifying values are gathered and folded straight into the running count, sum, min
+ * and max. Neither the positions nor the fetched values are materialized. Over a
+ * run-length encoded column, the select is answered as row ranges instead, and the
+ * aggregate folds in whole runs.
+ *
+ * Any other use of a pending handle (print, join, a type 2 select, ...) goes through
+ * `get_handle`, which materializes it first, so the deferral is invisible to the rest
+ * of the executor.
+ */
+typedef struct PendingResult {
+  Column *select_col;  // column the select scans
+  size_t num_rows;     // rows of `select_col` when the select ran; later inserts are
+                       // not part of its result
+  int low;             // inclusive range the select qualifies
+  int high;
+  int is_empty;        // no value can qualify, e.g. select(col, 10, 5)
+  Column *fetch_col;   // NULL for a select handle; the gathered column for a fetch
+  int has_stats;       // the handle's count, sum, min and max are already computed
+} PendingResult;
+
+/**
+ * @brief Aggregates a pending fetch handle in one fused pass, filling in its
+ * `num_elements`, `sum`, `min_value` and `max_value` without materializing its data.
+ * Per-morsel state comes from the `scratch` arena of the running query.
+ *
+ * @return 0 on success, -1 if out of memory
+ */
+int pipeline_compute_stats(Column *handle, int is_single_core, Arena *scratch);
+
+/**
+ * @brief Computes the data of a pending handle (positions for a select, as a list, a
+ * bitmap or ranges, see positions.h; values for a fetch) and clears `handle->pending`.
+ * No-op for a handle that is not pending.
+ *
+ * @return 0 on success, -1 if out of memory
+ */
+int pipeline_materialize(Column *handle, int is_single_core, Arena *scratch);
+
+#endif
@@ -0,0 +1,82 @@
+#ifndef POSITIONS_H
+#define POSITIONS_H
+
+#include <stdbool.h>
+
+#include "bitmap.h"
+#include "db.h"
+#include "mempool.h"
+
+/**
+ * @brief Adaptive representation of select results.
+ *
+ * A select handle keeps its qualifying positions in one of three forms, picked from the
+ * estimated selectivity, or the encoding of the column, when the select runs:
+ *
+ * - a position list in `data`: one int per qualifying row, ascending. Cheapest when
+ *   few rows qualify.
+ * - a bitmap over the rows the select read, in `bitmap` (`data` stays NULL): one bit
+ *   per row however many qualify, so it is the smaller form once more than 1 row in 32
+ *   qualifies, and a fetch through it reads the column front to back.
+ * - row ranges, in `ranges` (`data` stays NULL): what a select over a run-length
+ *   encoded column produces, one range per stretch of qualifying runs. A fetch copies
+ *   each range at once, and aggregates a run-length encoded column a run at a time.
+ *
+ * `num_elements` is the number of qualifying rows in every form. Fetch, type 2 select
+ * and join read all of them; they get their inputs through `get_positions_handle`.
+ * Every other operator goes through `get_handle`, which turns a bitmap or ranges into
+ * a list first.
+ */
+
+/**
+ * @brief Qualifying rows as `num_ranges` ascending, disjoint ranges
+ * `[starts[r], ends[r])`.
+ */
+typedef struct PositionRanges {
+  size_t *starts;
+  size_t *ends;
+  size_t num_ranges;
+} PositionRanges;
+
+/**
+ * @brief Allocates room for `capacity` ranges, none used yet.
+ *
+ * @return NULL if out of memory
+ */
+PositionRanges *positions_ranges_create(size_t capacity);
+
+void positions_ranges_destroy(PositionRanges *ranges);
+
+/**
+ * @brief Whether a select expected to qualify `est_matches` of `num_rows` rows keeps its
+ * result as a bitmap (see `BITMAP_MIN_SELECTIVITY`).
+ */
+bool positions_use_bitmap(double est_matches, size_t num_rows);
+
+/**
+ * @brief Number of set bits before every morsel of `bitmap`: entry `m` is the rank of
+ * row `m * MORSEL_SIZE`, and the entry after the last morsel is the total. With them,
+ * the morsels of a bitmap are processed in parallel, each knowing where its part of a
+ * dense output starts.
+ *
+ * @return NULL if out of memory
+ */
+size_t *positions_morsel_ranks(const Bitmap *bitmap, Arena *scratch);
+
+/**
+ * @brief The position list of a select handle: its `data`, or its bitmap or ranges
+ * decoded into `scratch`.
+ *
+ * @return NULL if out of memory
+ */
+const int *positions_list(const Column *handle, int is_single_core, Arena *scratch);
+
+/**
+ * @brief Replaces the bitmap or ranges of a select handle by a position list in `data`.
+ * No-op for a handle that holds a list.
+ *
+ * @return 0 on success, -1 if out of memory
+ */
+int positions_expand(Column *handle, int is_single_core, Arena *scratch);
+
+#endif
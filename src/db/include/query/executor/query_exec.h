@@ -1,6 +1,8 @@
 #ifndef SELECT_H
 #define SELECT_H
 
+#include <stdbool.h>
+
 #include "operators.h"
 
 // CREATE Operations
@@ -14,7 +16,14 @@ void exec_create(DbOperator *query, message *send_message);
 
 // Executes a select query
 void exec_select(DbOperator *query, message *send_message);
-void exec_batch_select(DbOperator *query, message *send_message);
+// Executes selects as shared scans, one per column they read
+void exec_batch_select(DbOperator **selects, size_t num_selects, message *send_message);
+// Whether a select is answered by its column's sorted or B-tree index
+bool select_uses_index(Comparator *comparator);
+// Executes selects answered by an index, looking up the bounds of each column's
+// selects together
+void exec_batch_index_select(DbOperator **selects, size_t num_selects,
+                             message *send_message);
 
 // Executes a fetch query
 void exec_fetch(DbOperator *query, message *send_message);
@@ -25,6 +34,27 @@ void exec_fetch(DbOperator *query, message *send_message);
 // Executes an insert query
 void exec_insert(DbOperator *query, message *send_message);
 
+/**
+ * @brief Appends one row of `values` (one per column) to a table's columns and to their
+ * zones, encodings, indexes and statistics: `stage_row`, then `apply_staged_row`. Used
+ * by log replay (wal.h).
+ *
+ * @return 0 on success, -1 if a column file could not be extended
+ */
+int insert_row(Table *table, const InsertValue *values);
+
+/**
+ * @brief Writes one row of `values` past the last row of a table's columns, growing
+ * their files if needed. No session sees it until `apply_staged_row`, so an insert can
+ * stage its row, log it, and only then apply it.
+ *
+ * @return 0 on success, -1 if a column file could not be extended
+ */
+int stage_row(Table *table, const InsertValue *values);
+
+// Counts the row `stage_row` wrote in, with its zones, encodings, indexes and statistics
+void apply_staged_row(Table *table, const InsertValue *values);
+
 // MATH Operations
 //----------------
 
@@ -37,6 +67,21 @@ void exec_arithmetic(DbOperator *query, message *send_message);
 //----------------
 void exec_join(DbOperator *query, message *send_message);
 
+// BATCH Operations
+//-----------------
+
+/**
+ * @brief Queues `query` on the session's batch if it only reads the catalog (select,
+ * fetch, aggregates, arithmetic, join). It is parsed when the batch runs, once the
+ * handles it reads exist.
+ *
+ * @return 0 if queued, 1 if the query cannot be batched and should run now, -1 on error
+ */
+int batch_add_query(ClientContext *context, const char *query);
+
+// Runs the queued batch, independent queries side by side
+void exec_batch(DbOperator *query, message *send_message);
+
 // DELETE Operations
 //------------------
 
@@ -9,8 +9,15 @@
 
 void handle_query(char *query, message *send_message, int client_socket,
                   ClientContext *client_context);
+// Executes a parsed operator; batches run their queries through it too
+void handle_dbOperator(DbOperator *query, message *send_message);
+/**
+ * @brief Formats the stats `print_stats()` answers with, one `name=value` per line,
+ * into the query arena: the bytes the session's last join spilled to disk, and what the
+ * checkpoints that wrote anything cost so far (see `checkpointer_stats`).
+ */
+char *handle_print_stats(DbOperator *query);
 int is_batch_queries_on(ClientContext *client_context);
 void set_batch_queries(ClientContext *client_context, int is_on);
-int add_query_to_batch(DbOperator *query);
 
 #endif /* QUERY_HANDLER_H */
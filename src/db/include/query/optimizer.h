@@ -4,10 +4,64 @@
 #include "operators.h"
 #include "utils.h"
 
+/**
+ * @brief Allocates an empty index of type `idx_type` for a column; its data is built by
+ * `create_idx_on`.
+ *
+ * @return NULL if out of memory
+ */
+ColumnIndex* create_column_index(IndexType idx_type);
+
 // For handling index creation
 void create_idx_on(Column* col, message* send_message);
 void cluster_idx_on(Table* table, Column* primary_col, message* send_message);
 
+/**
+ * @brief Release the index's sorted data, positions and B-tree, unmapping them if they
+ * were loaded from an index file. `col->index` itself (and its type) is kept.
+ */
+void free_idx_data(Column* col);
+
+/**
+ * @brief Adds row `row` (already appended to the column, holding `value`) to the
+ * column's index by inserting it into the index's sorted delta. Once the delta holds
+ * `INDEX_DELTA_MERGE_THRESHOLD` rows, a pool task merges it into `sorted_data`,
+ * `positions` and the B-tree in the background.
+ */
+void index_insert(Column* col, int value, size_t row);
+
+/**
+ * @brief Installs a finished background merge, if any. This swaps the arrays lookups
+ * read, so only writers call it (inserts, under the catalog write lock); lookups just
+ * read the main arrays and the delta, which stay correct until the install.
+ */
+void index_poll_merge(Column* col);
+
+/**
+ * @brief Merges the whole delta into the main arrays before returning, e.g. before
+ * the index is persisted.
+ */
+void index_flush(Column* col);
+
+/**
+ * @brief Writes the positions of delta rows with `low <= value <= high` to `out`, in
+ * value order; the main arrays' part of a lookup comes from `idx_lookup_*`.
+ *
+ * @return the number of positions written
+ */
+size_t index_delta_select(Column* col, int low, int high, int* out);
+
+/**
+ * @brief Select on a column with a `CRACKING_UNCLUSTERED` index: cracks its cracker
+ * column around `low` and `high` (copying the column first if no select has yet) and
+ * writes the positions of the rows with `low <= value <= high` to `out`, in no
+ * particular order. `out` must have room for every row of the column. Safe to call
+ * from concurrent selects.
+ *
+ * @return 0 on success, -1 if out of memory
+ */
+int index_crack_select(Column* col, int low, int high, int* out, size_t* count);
+
 /**
  * @brief Uses `col->index` to return the index of a value in the column's data.
  *
@@ -27,4 +81,14 @@ size_t idx_lookup_left(Column* column, int value);
 
 size_t idx_lookup_right(Column* column, int value);
 
+/**
+ * @brief For each of the `n` keys, the number of values of the index's main arrays
+ * that are `< key`, i.e. where a range starting at `key` starts in `positions`. The
+ * keys are looked up in ascending order: a B-tree descends for all of them in one
+ * interleaved batch, and a sorted index searches each key only past the previous one.
+ *
+ * @return 0 on success, -1 if out of memory
+ */
+int idx_lower_bounds(Column* column, const int* keys, size_t n, size_t* out);
+
 #endif /*  OPTIMIZER_H */
@@ -13,13 +13,36 @@
 #define HANDLE_MAX_SIZE 64
 #define MAX_PATH_LEN 512
 #define NUM_ELEMENTS_TO_MULTITHREAD 10000
+#define MORSEL_SIZE 65536  // elements per parallel task: 256KB of ints, about L2 size
+#define ZONE_SIZE MORSEL_SIZE  // rows per zone-map entry; one zone per select morsel
+#define L2_CACHE_SIZE (256 * 1024)  // bytes of per-core L2 that partitioned operators target
+// Default hash table budget of a grace hash join; change per session with
+// `join_memory_budget(<bytes>)`
+#define JOIN_MEMORY_BUDGET (512UL * 1024 * 1024)
+// Estimated share of its rows a select must qualify to keep its result as a bitmap
+// (1 bit per row) rather than a position list (32 bits per qualifying row). A bitmap
+// is smaller from 1/32 on, but its readers walk every word, so below a quarter the
+// list is faster to consume.
+#define BITMAP_MIN_SELECTIVITY 0.25
+// Widest code a column is bit-packed with (see column_encoding.h); at most 15 bits
+// keeps every code at half the size of an int or less
+#define ENCODING_MAX_BITS 15
+// Wider columns with at most this many distinct values are dictionary-encoded instead,
+// their codes then fitting the same fields
+#define DICTIONARY_MAX_VALUES (1 << ENCODING_MAX_BITS)
+// Shortest average run at which a column is also kept run-length encoded; sorted and
+// clustered columns get there, and their selects then work a run at a time
+#define RLE_MIN_RUN_LENGTH 32
 #define STORAGE_PATH "disk"
 
 // CSV Transfer Constants
 #define CSV_BUFFER_SIZE 1024
 #define MAX_COLUMNS 100  // TODO: Make this dynamic in upcoming milestones
 #define CSV_CHUNK_SIZE 4096
-#define BTREE_FANOUT 1024
+// Smallest slab of a session's query arena (see mempool.h): one huge page
+#define QUERY_ARENA_BLOCK_SIZE (2 << 20)
+// Inserted rows an index buffers in its sorted delta before merging it in the background
+#define INDEX_DELTA_MERGE_THRESHOLD 4096
 
 typedef struct {
   char column_name[256];  // of the form "db.table.column"
@@ -29,12 +52,15 @@ typedef struct {
   char data[CSV_CHUNK_SIZE];
 } CSVChunk;
 
+// Sent by the client ahead of each column of a load; `num_elements` values of
+// `data_type` follow. The statistics are only filled in for integer columns.
 typedef struct ColumnMetadata {
   char name[MAX_SIZE_NAME];
   size_t num_elements;
   long min_value;
   long max_value;
   long sum;
+  int data_type;  // a DataType: the narrowest type holding every value of the column
 } ColumnMetadata;
 /**
  * DataType
@@ -64,6 +90,7 @@ typedef enum OperatorType {
   ADD,
   SUB,
   JOIN,
+  PRINT_STATS,
   SHUTDOWN,
 } OperatorType;
 
@@ -89,6 +116,8 @@ typedef enum IndexType {
   SORTED_CLUSTERED,
   SORTED_UNCLUSTERED,
   NONE,
+  // after NONE so catalogs persisted before it keep their numbering
+  CRACKING_UNCLUSTERED,
 } IndexType;
 /**
  * @brief  Parses the following 4 types of join queries:
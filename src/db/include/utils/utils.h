@@ -8,6 +8,7 @@
 #define __UTILS_H__
 
 #include <stdarg.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <string.h>
 #include <sys/socket.h>
@@ -73,4 +74,24 @@ ssize_t recv_message_safe(int socket, void *buffer, size_t length);
 // Get current time in microseconds
 double get_time(void);
 
+// Bytes one value of a column of type `type` takes, in memory and in its data file
+size_t data_type_size(DataType type);
+
+// "int", "long" or "double", the names `create(col, ...)` takes
+const char *data_type_name(DataType type);
+
+/**
+ * @brief The type named `name` (see `data_type_name`).
+ *
+ * @return 0 on success, -1 if `name` names no type
+ */
+int parse_data_type(const char *name, DataType *type);
+
+// Copies `n` values of type `from` to `out` as the same or a wider type `to`, in the
+// order INT < LONG < DOUBLE
+void widen_values(const void *values, DataType from, size_t n, void *out, DataType to);
+
+// 64-bit checksum of `size` bytes, used to validate files mapped back from disk
+uint64_t checksum64(const void *data, size_t size);
+
 #endif /* __UTILS_H__ */
@@ -0,0 +1,120 @@
+/**
+ * bench_bitpack.c
+ *
+ * Microbenchmark for range selects on frame-of-reference + bit-packed columns
+ * (`lib/impl/bitpack.c`) against the best `scan_range` kernel on the same values
+ * stored as plain ints, at several code widths and selectivities, both for the
+ * position-list and the bitmap output. Also reports the cost of decoding every row
+ * one at a time with `packed_get`, as a sparse fetch does, and a block at a time with
+ * `packed_decode`, as a dense one does.
+ *
+ * Usage: ./bench_bitpack [num_rows] [repetitions]     (defaults: 100M rows, 5 reps)
+ */
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "bitpack.h"
+#include "scan.h"
+#include "utils.h"
+
+static void report(const char* name, unsigned int bits, double selectivity, size_t n,
+                   size_t n_reps, double t_us, size_t n_found) {
+  double rows_per_sec = (double)n * n_reps / (t_us / 1e6);
+  printf("%-13s %4u %7.1f%% %12zu %10.2f %14.2f\n", name, bits, selectivity * 100,
+         n_found, t_us / n_reps / 1e3, rows_per_sec / 1e6);
+}
+
+int main(int argc, char** argv) {
+  size_t n = argc > 1 ? strtoull(argv[1], NULL, 10) : 100000000;
+  size_t n_reps = argc > 2 ? strtoull(argv[2], NULL, 10) : 5;
+  if (n == 0 || n_reps == 0) {
+    fprintf(stderr, "usage: %s [num_rows] [repetitions]\n", argv[0]);
+    return 1;
+  }
+
+  int* data = malloc(sizeof(int) * n);
+  int* out = malloc(sizeof(int) * n);
+  uint64_t* words = malloc(sizeof(uint64_t) * ((n + 63) / 64));
+  if (!data || !out || !words) {
+    fprintf(stderr, "bench_bitpack: failed to allocate %zu rows\n", n);
+    return 1;
+  }
+
+  printf("rows: %zu, repetitions: %zu, plain kernel: %s\n\n", n, n_reps,
+         scan_kernel_name(scan_best_kernel()));
+  printf("%-13s %4s %8s %12s %10s %14s\n", "scan", "bits", "select", "qualifying",
+         "ms/scan", "Mrows/s");
+
+  unsigned int widths[] = {4, 8, 12, 15};
+  double selectivities[] = {0.01, 0.1, 0.5};
+  srand(42);
+  for (size_t w = 0; w < sizeof(widths) / sizeof(widths[0]); w++) {
+    unsigned int bits = widths[w];
+    int range = 1 << bits;
+    for (size_t i = 0; i < n; i++) data[i] = rand() % range;
+    PackedInts* packed = packed_create(data, n, 0, bits);
+    if (!packed) {
+      fprintf(stderr, "bench_bitpack: failed to pack %u-bit codes\n", bits);
+      return 1;
+    }
+
+    for (size_t s = 0; s < sizeof(selectivities) / sizeof(selectivities[0]); s++) {
+      int high = (int)(range * selectivities[s]);
+      high = high > 0 ? high - 1 : 0;
+
+      size_t n_found = 0, n_packed = 0;
+      double t0 = get_time();
+      for (size_t r = 0; r < n_reps; r++) {
+        n_found = scan_range(data, 0, n, 0, high, NULL, out);
+      }
+      report("plain", bits, selectivities[s], n, n_reps, get_time() - t0, n_found);
+
+      t0 = get_time();
+      for (size_t r = 0; r < n_reps; r++) {
+        n_packed = packed_scan_range(packed, 0, n, 0, high, out);
+      }
+      report("packed", bits, selectivities[s], n, n_reps, get_time() - t0, n_packed);
+      if (n_packed != n_found) {
+        fprintf(stderr, "bench_bitpack: packed scan found %zu rows, expected %zu\n",
+                n_packed, n_found);
+        return 1;
+      }
+
+      t0 = get_time();
+      for (size_t r = 0; r < n_reps; r++) {
+        n_found = scan_range_bits(data, 0, n, 0, high, words);
+      }
+      report("plain bits", bits, selectivities[s], n, n_reps, get_time() - t0, n_found);
+
+      t0 = get_time();
+      for (size_t r = 0; r < n_reps; r++) {
+        n_packed = packed_scan_range_bits(packed, 0, n, 0, high, words);
+      }
+      report("packed bits", bits, selectivities[s], n, n_reps, get_time() - t0, n_packed);
+    }
+
+    long sum = 0;
+    double t0 = get_time();
+    for (size_t i = 0; i < n; i++) sum += packed_get(packed, i);
+    double t_get = get_time() - t0;
+    printf("%-13s %4u %8s %12ld %10.2f %14.2f\n", "packed_get", bits, "-", sum,
+           t_get / 1e3, (double)n / t_get);
+
+    sum = 0;
+    t0 = get_time();
+    for (size_t block = 0; block < n; block += 1024) {
+      size_t block_end = block + 1024 < n ? block + 1024 : n;
+      packed_decode(packed, block, block_end, out);
+      for (size_t i = 0; i < block_end - block; i++) sum += out[i];
+    }
+    double t_decode = get_time() - t0;
+    printf("%-13s %4u %8s %12ld %10.2f %14.2f\n\n", "packed_decode", bits, "-", sum,
+           t_decode / 1e3, (double)n / t_decode);
+    packed_destroy(packed);
+  }
+
+  free(data);
+  free(out);
+  free(words);
+  return 0;
+}
@@ -0,0 +1,89 @@
+/**
+ * bench_btree.c
+ *
+ * Microbenchmark for B-tree point lookups (`lib/impl/btree.c`) on a sorted column of
+ * distinct values: a binary search over the column, one `lookup` per key, and
+ * `lookup_batch` over all the keys. Keys are drawn uniformly from the column, so at
+ * large sizes every descent misses the cache below the top levels.
+ *
+ * Usage: ./bench_btree [num_rows] [num_lookups]     (defaults: 10M rows, 1M lookups)
+ */
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "algorithms.h"
+#include "btree.h"
+#include "utils.h"
+
+static void report(const char* name, double t_us, size_t n_lookups) {
+  printf("%-14s %10.2f %12.1f\n", name, t_us / 1e3, t_us * 1e3 / n_lookups);
+}
+
+int main(int argc, char** argv) {
+  size_t n = argc > 1 ? strtoull(argv[1], NULL, 10) : 10000000;
+  size_t n_lookups = argc > 2 ? strtoull(argv[2], NULL, 10) : 1000000;
+  if (n < 2 || n_lookups == 0) {
+    fprintf(stderr, "usage: %s [num_rows >= 2] [num_lookups]\n", argv[0]);
+    return 1;
+  }
+
+  int* data = malloc(sizeof(int) * n);
+  int* keys = malloc(sizeof(int) * n_lookups);
+  size_t* expected = malloc(sizeof(size_t) * n_lookups);
+  size_t* out = malloc(sizeof(size_t) * n_lookups);
+  if (!data || !keys || !expected || !out) {
+    fprintf(stderr, "bench_btree: failed to allocate %zu rows\n", n);
+    return 1;
+  }
+  for (size_t i = 0; i < n; i++) data[i] = (int)(i * 3);
+  srand(42);
+  for (size_t k = 0; k < n_lookups; k++) {
+    keys[k] = data[(((size_t)rand() << 16) ^ (size_t)rand()) % n];
+  }
+
+  double t0 = get_time();
+  Btree* tree = init_btree(data, n);
+  double t_build = get_time() - t0;
+  if (!tree) {
+    fprintf(stderr, "bench_btree: failed to build the tree\n");
+    return 1;
+  }
+  printf("rows: %zu, lookups: %zu, levels: %zu, build: %.2f ms\n\n", n, n_lookups,
+         tree->n_levels, t_build / 1e3);
+  printf("%-14s %10s %12s\n", "lookup", "ms", "ns/lookup");
+
+  t0 = get_time();
+  for (size_t k = 0; k < n_lookups; k++) {
+    expected[k] = binary_search_left(data, n, keys[k]);
+  }
+  report("binary search", get_time() - t0, n_lookups);
+
+  t0 = get_time();
+  for (size_t k = 0; k < n_lookups; k++) out[k] = lookup(keys[k], tree, 1);
+  report("btree", get_time() - t0, n_lookups);
+  for (size_t k = 0; k < n_lookups; k++) {
+    if (out[k] != expected[k]) {
+      fprintf(stderr, "bench_btree: lookup of %d: %zu, expected %zu\n", keys[k], out[k],
+              expected[k]);
+      return 1;
+    }
+  }
+
+  t0 = get_time();
+  lookup_batch(keys, n_lookups, tree, 1, out);
+  report("btree batched", get_time() - t0, n_lookups);
+  for (size_t k = 0; k < n_lookups; k++) {
+    if (out[k] != expected[k]) {
+      fprintf(stderr, "bench_btree: batched lookup of %d: %zu, expected %zu\n", keys[k],
+              out[k], expected[k]);
+      return 1;
+    }
+  }
+
+  free_btree(tree);
+  free(data);
+  free(keys);
+  free(expected);
+  free(out);
+  return 0;
+}
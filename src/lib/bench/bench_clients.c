@@ -0,0 +1,158 @@
+/**
+ * bench_clients.c
+ *
+ * Throughput benchmark for the multi-client server. Replays a file of queries from
+ * 1, 2, 4, ... up to `max_clients` concurrent connections, each with its own session,
+ * and reports queries per second at every level. Load the data and start `./server`
+ * first; the queries should only read (select/fetch/aggregates/print), so every client
+ * can replay the same file.
+ *
+ * Usage: ./bench_clients queries.dsl [max_clients] [repetitions]   (defaults: 8, 20)
+ */
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "common.h"
+#include "utils.h"
+
+#define MAX_QUERIES 1024
+#define MAX_QUERY_LEN 1024
+
+static char queries[MAX_QUERIES][MAX_QUERY_LEN];
+static size_t n_queries = 0;
+
+typedef struct ClientRun {
+  size_t n_reps;
+  size_t n_done;  // queries answered
+  int failed;
+} ClientRun;
+
+static int connect_to_server(void) {
+  int client_socket = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (client_socket == -1) return -1;
+  struct sockaddr_un remote;
+  remote.sun_family = AF_UNIX;
+  strncpy(remote.sun_path, SOCK_PATH, sizeof(remote.sun_path) - 1);
+  remote.sun_path[sizeof(remote.sun_path) - 1] = '\0';
+  size_t len = strlen(remote.sun_path) + sizeof(remote.sun_family) + 1;
+  if (connect(client_socket, (struct sockaddr*)&remote, len) == -1) {
+    close(client_socket);
+    return -1;
+  }
+  return client_socket;
+}
+
+// Sends one query and drains its response, like `client.c` does
+static int run_query(int client_socket, char* query, char** buffer, size_t* capacity) {
+  message send_message = {.status = INCOMING_QUERY, .length = strlen(query)};
+  message recv_message;
+  if (send(client_socket, &send_message, sizeof(message), 0) == -1 ||
+      send(client_socket, query, send_message.length, 0) == -1) {
+    return -1;
+  }
+  if (recv(client_socket, &recv_message, sizeof(message), MSG_WAITALL) !=
+      sizeof(message)) {
+    return -1;
+  }
+  if ((recv_message.status == OK_WAIT_FOR_RESPONSE || recv_message.status == OK_DONE) &&
+      (int)recv_message.length > 0) {
+    if ((size_t)recv_message.length > *capacity) {
+      char* grown = realloc(*buffer, recv_message.length);
+      if (!grown) return -1;
+      *buffer = grown;
+      *capacity = recv_message.length;
+    }
+    if (recv_message_safe(client_socket, *buffer, recv_message.length) <= 0) return -1;
+  }
+  return 0;
+}
+
+static void* client_thread(void* arg) {
+  ClientRun* run = (ClientRun*)arg;
+  int client_socket = connect_to_server();
+  if (client_socket == -1) {
+    run->failed = 1;
+    return NULL;
+  }
+  char* buffer = NULL;
+  size_t capacity = 0;
+  for (size_t r = 0; r < run->n_reps && !run->failed; r++) {
+    for (size_t q = 0; q < n_queries; q++) {
+      if (run_query(client_socket, queries[q], &buffer, &capacity) != 0) {
+        run->failed = 1;
+        break;
+      }
+      run->n_done++;
+    }
+  }
+  free(buffer);
+  close(client_socket);
+  return NULL;
+}
+
+int main(int argc, char** argv) {
+  size_t max_clients = argc > 2 ? strtoull(argv[2], NULL, 10) : 8;
+  size_t n_reps = argc > 3 ? strtoull(argv[3], NULL, 10) : 20;
+  FILE* file = argc > 1 ? fopen(argv[1], "r") : NULL;
+  if (!file || max_clients == 0 || n_reps == 0) {
+    fprintf(stderr, "usage: %s queries.dsl [max_clients] [repetitions]\n", argv[0]);
+    return 1;
+  }
+  while (n_queries < MAX_QUERIES && fgets(queries[n_queries], MAX_QUERY_LEN, file)) {
+    char* line = queries[n_queries];
+    if (strlen(line) <= 1 || strncmp(line, "--", 2) == 0) continue;
+    if (strncmp(line, "shutdown", 8) == 0) continue;
+    n_queries++;
+  }
+  fclose(file);
+  if (n_queries == 0) {
+    fprintf(stderr, "bench_clients: no queries in %s\n", argv[1]);
+    return 1;
+  }
+
+  pthread_t* threads = malloc(sizeof(pthread_t) * max_clients);
+  ClientRun* runs = malloc(sizeof(ClientRun) * max_clients);
+  if (!threads || !runs) {
+    fprintf(stderr, "bench_clients: failed to allocate %zu clients\n", max_clients);
+    return 1;
+  }
+
+  printf("queries per client: %zu x %zu repetitions\n\n", n_queries, n_reps);
+  printf("%8s %12s %12s %10s\n", "clients", "queries", "queries/s", "speedup");
+  double base_qps = 0;
+  for (size_t n_clients = 1; n_clients <= max_clients; n_clients *= 2) {
+    double t0 = get_time();
+    for (size_t c = 0; c < n_clients; c++) {
+      runs[c] = (ClientRun){.n_reps = n_reps, .n_done = 0, .failed = 0};
+      if (pthread_create(&threads[c], NULL, client_thread, &runs[c]) != 0) {
+        runs[c].failed = 1;
+        threads[c] = pthread_self();
+      }
+    }
+    size_t n_done = 0;
+    int failed = 0;
+    for (size_t c = 0; c < n_clients; c++) {
+      if (!pthread_equal(threads[c], pthread_self())) pthread_join(threads[c], NULL);
+      n_done += runs[c].n_done;
+      failed |= runs[c].failed;
+    }
+    double t_us = get_time() - t0;
+    if (failed) {
+      fprintf(stderr, "bench_clients: a client failed; is the server running?\n");
+      return 1;
+    }
+
+    double qps = n_done / (t_us / 1e6);
+    if (n_clients == 1) base_qps = qps;
+    printf("%8zu %12zu %12.1f %9.2fx\n", n_clients, n_done, qps, qps / base_qps);
+  }
+
+  free(threads);
+  free(runs);
+  return 0;
+}
@@ -0,0 +1,128 @@
+/**
+ * bench_cracking.c
+ *
+ * Microbenchmark for the cracking index (`lib/impl/cracker.c`) against the sorted
+ * unclustered index and a plain scan, on the query sequence of the experiments1
+ * generator (tests 16-19): `col2` holds values uniform in `[0, N / 5)`, and every query
+ * selects a range of width `N / 5000` starting uniformly in `[0, N / 8)`.
+ *
+ * The sorted index pays for a full sort before its first query and answers every query
+ * with two binary searches; the cracker copies the column and partitions only the pieces
+ * that the queries cut. Reports cumulative time, index setup included, after a growing
+ * number of queries.
+ *
+ * Usage: ./bench_cracking [num_rows] [num_queries]     (defaults: 10M rows, 1000 queries)
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "algorithms.h"
+#include "cracker.h"
+#include "scan.h"
+#include "utils.h"
+
+// Number of values `< value` in sorted `data`
+static size_t lower_bound(const int* data, size_t n, int value) {
+  size_t left = 0, right = n;
+  while (left < right) {
+    size_t mid = left + (right - left) / 2;
+    if (data[mid] < value) {
+      left = mid + 1;
+    } else {
+      right = mid;
+    }
+  }
+  return left;
+}
+
+static int is_checkpoint(size_t q) {
+  for (size_t c = 1; c <= q; c *= 10) {
+    if (q == c) return 1;
+  }
+  return 0;
+}
+
+int main(int argc, char** argv) {
+  size_t n = argc > 1 ? strtoull(argv[1], NULL, 10) : 10000000;
+  size_t n_queries = argc > 2 ? strtoull(argv[2], NULL, 10) : 1000;
+  if (n < 5000 || n_queries == 0) {
+    fprintf(stderr, "usage: %s [num_rows >= 5000] [num_queries]\n", argv[0]);
+    return 1;
+  }
+
+  int* column = malloc(sizeof(int) * n);
+  int* sorted = malloc(sizeof(int) * n);
+  int* positions = malloc(sizeof(int) * n);
+  int* out = malloc(sizeof(int) * n);
+  int* lows = malloc(sizeof(int) * n_queries);
+  if (!column || !sorted || !positions || !out || !lows) {
+    fprintf(stderr, "bench_cracking: failed to allocate %zu rows\n", n);
+    return 1;
+  }
+  srand(42);
+  for (size_t i = 0; i < n; i++) column[i] = rand() % (int)(n / 5);
+  for (size_t q = 0; q < n_queries; q++) lows[q] = rand() % (int)(n / 8);
+  int width = (int)(n / 5000);
+
+  printf("rows: %zu, queries: %zu, range width: %d\n\n", n, n_queries, width);
+  printf("%8s %14s %14s %14s %12s\n", "queries", "scan ms", "sorted ms", "cracking ms",
+         "pieces");
+
+  double t_scan = 0, t_sorted = 0, t_cracking = 0;
+  size_t checksum_scan = 0, checksum_sorted = 0, checksum_cracking = 0;
+
+  // Setup: the sorted index sorts a copy; the cracker only copies
+  double t0 = get_time();
+  memcpy(sorted, column, sizeof(int) * n);
+  sort(sorted, n, positions);
+  t_sorted += get_time() - t0;
+
+  t0 = get_time();
+  Cracker* cracker = cracker_create(column, n);
+  t_cracking += get_time() - t0;
+  if (!cracker) {
+    fprintf(stderr, "bench_cracking: failed to create the cracker\n");
+    return 1;
+  }
+
+  for (size_t q = 0; q < n_queries; q++) {
+    int low = lows[q], high = lows[q] + width - 1;
+
+    t0 = get_time();
+    checksum_scan += scan_range(column, 0, n, low, high, NULL, out);
+    t_scan += get_time() - t0;
+
+    // both indexes hand back the qualifying positions, as a select does
+    t0 = get_time();
+    size_t start = lower_bound(sorted, n, low);
+    size_t end = lower_bound(sorted, n, high + 1);
+    memcpy(out, positions + start, sizeof(int) * (end - start));
+    checksum_sorted += end - start;
+    t_sorted += get_time() - t0;
+
+    t0 = get_time();
+    cracker_select(cracker, low, high, &start, &end);
+    memcpy(out, cracker->positions + start, sizeof(int) * (end - start));
+    checksum_cracking += end - start;
+    t_cracking += get_time() - t0;
+
+    if (is_checkpoint(q + 1) || q + 1 == n_queries) {
+      printf("%8zu %14.2f %14.2f %14.2f %12zu\n", q + 1, t_scan / 1e3, t_sorted / 1e3,
+             t_cracking / 1e3, cracker->num_cracks + 1);
+    }
+  }
+  if (checksum_scan != checksum_sorted || checksum_scan != checksum_cracking) {
+    fprintf(stderr, "bench_cracking: results differ (scan %zu, sorted %zu, cracking %zu)\n",
+            checksum_scan, checksum_sorted, checksum_cracking);
+    return 1;
+  }
+
+  cracker_destroy(cracker);
+  free(column);
+  free(sorted);
+  free(positions);
+  free(out);
+  free(lows);
+  return 0;
+}
@@ -0,0 +1,107 @@
+/**
+ * bench_sort.c
+ *
+ * Microbenchmark for the index build sort in `lib/impl/algorithms.c`: the radix sort,
+ * serial and across a worker pool, against the `qsort` of (value, `size_t` position)
+ * pairs that `sort` used before. Values are uniform in `[0, range)`, so a small range
+ * also shows the passes the radix sort skips.
+ *
+ * Usage: ./bench_sort [num_rows] [num_threads] [range]
+ *        (defaults: 10M rows, one thread per core, full int range)
+ */
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "algorithms.h"
+#include "threadpool.h"
+#include "utils.h"
+
+typedef struct {
+  int value;
+  size_t index;
+} IndexedValue;
+
+static int compare_indexed(const void* a, const void* b) {
+  const IndexedValue* ia = (const IndexedValue*)a;
+  const IndexedValue* ib = (const IndexedValue*)b;
+  return (ia->value > ib->value) - (ia->value < ib->value);
+}
+
+// Reference: the qsort-based sort
+static void sort_qsort(int* data, size_t n, int* positions) {
+  IndexedValue* pairs = malloc(sizeof(IndexedValue) * n);
+  for (size_t i = 0; i < n; i++) pairs[i] = (IndexedValue){data[i], i};
+  qsort(pairs, n, sizeof(IndexedValue), compare_indexed);
+  for (size_t i = 0; i < n; i++) {
+    data[i] = pairs[i].value;
+    positions[i] = (int)pairs[i].index;
+  }
+  free(pairs);
+}
+
+static void report(const char* name, double t_us, size_t n, size_t scratch_bytes) {
+  printf("%-16s %10.2f %14.2f %12.1f\n", name, t_us / 1e3, n / (t_us / 1e6) / 1e6,
+         scratch_bytes / (1024.0 * 1024.0));
+}
+
+int main(int argc, char** argv) {
+  size_t n = argc > 1 ? strtoull(argv[1], NULL, 10) : 10000000;
+  size_t n_threads = argc > 2 ? strtoull(argv[2], NULL, 10) : 0;
+  long long range = argc > 3 ? strtoll(argv[3], NULL, 10) : 0;
+  if (n == 0 || range < 0) {
+    fprintf(stderr, "usage: %s [num_rows] [num_threads] [range]\n", argv[0]);
+    return 1;
+  }
+
+  int* column = malloc(sizeof(int) * n);
+  int* data = malloc(sizeof(int) * n);
+  int* positions = malloc(sizeof(int) * n);
+  int* expected = malloc(sizeof(int) * n);
+  if (!column || !data || !positions || !expected) {
+    fprintf(stderr, "bench_sort: failed to allocate %zu rows\n", n);
+    return 1;
+  }
+  srand(42);
+  for (size_t i = 0; i < n; i++) {
+    unsigned int r = ((unsigned int)rand() << 16) ^ (unsigned int)rand();
+    column[i] = range ? (int)(r % range) : (int)r;
+  }
+
+  ThreadPool* pool = threadpool_create(n_threads);
+  printf("rows: %zu, threads: %zu, range: %s\n\n", n, threadpool_num_threads(pool),
+         range ? argv[3] : "full");
+  printf("%-16s %10s %14s %12s\n", "sort", "ms", "Mrows/s", "scratch MB");
+
+  memcpy(data, column, sizeof(int) * n);
+  double t0 = get_time();
+  sort_qsort(data, n, positions);
+  report("qsort pairs", get_time() - t0, n, sizeof(IndexedValue) * n);
+  memcpy(expected, data, sizeof(int) * n);
+
+  memcpy(data, column, sizeof(int) * n);
+  t0 = get_time();
+  sort(data, n, positions);
+  report("radix", get_time() - t0, n, 2 * sizeof(int) * n);
+  if (memcmp(data, expected, sizeof(int) * n) != 0) {
+    fprintf(stderr, "bench_sort: radix sort result differs\n");
+    return 1;
+  }
+
+  memcpy(data, column, sizeof(int) * n);
+  t0 = get_time();
+  sort_parallel(pool, data, n, positions);
+  report("radix parallel", get_time() - t0, n, 2 * sizeof(int) * n);
+  if (memcmp(data, expected, sizeof(int) * n) != 0) {
+    fprintf(stderr, "bench_sort: parallel radix sort result differs\n");
+    return 1;
+  }
+
+  threadpool_destroy(pool);
+  free(column);
+  free(data);
+  free(positions);
+  free(expected);
+  return 0;
+}
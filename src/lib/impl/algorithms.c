@@ -1,26 +1,74 @@
 #include "algorithms.h"
 
 #include <stdio.h>
+#include <stdint.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include "utils.h"
 
-typedef struct {
-  int value;     // Data value
-  size_t index;  // Original position
-} IndexedValue;
+// LSD radix sort: 11-bit digits, so three passes cover a 32-bit key
+#define RADIX_BITS 11
+#define RADIX_BUCKETS (1 << RADIX_BITS)
+#define RADIX_PASSES 3
+
+// A parallel sort gives every worker a run of at least this many values
+#define SORT_MIN_RUN (1 << 16)
+
+// Flips the sign bit so that unsigned order of the keys is signed order of the values
+static inline unsigned int radix_key(int value) {
+  return (unsigned int)value ^ 0x80000000u;
+}
+
+static inline size_t radix_digit(int value, int pass) {
+  return (radix_key(value) >> (pass * RADIX_BITS)) & (RADIX_BUCKETS - 1);
+}
 
 /**
- * @brief Comparator function for qsort, sorts by the `value` field in ascending order.
+ * @brief Stable LSD radix sort of `data` with `positions` alongside, ping-ponging
+ * through `tmp_data`/`tmp_positions`. One read of the input builds the histograms of
+ * all passes; a pass whose digit is the same for every value is skipped, so a column
+ * of small values only pays for the passes its range needs.
+ *
+ * @return 1 if the sorted values ended up in the `tmp_*` arrays, 0 if in place
  */
-int compare_fn(const void* a, const void* b) {
-  const IndexedValue* ia = (const IndexedValue*)a;
-  const IndexedValue* ib = (const IndexedValue*)b;
-  return (ia->value > ib->value) - (ia->value < ib->value);  // Return 1, 0, or -1
+static int radix_sort_run(int* data, int* positions, int* tmp_data, int* tmp_positions,
+                          size_t n) {
+  size_t counts[RADIX_PASSES][RADIX_BUCKETS] = {{0}};
+  for (size_t i = 0; i < n; i++) {
+    for (int pass = 0; pass < RADIX_PASSES; pass++) {
+      counts[pass][radix_digit(data[i], pass)]++;
+    }
+  }
+
+  int *src = data, *src_pos = positions, *dst = tmp_data, *dst_pos = tmp_positions;
+  int in_tmp = 0;
+  for (int pass = 0; pass < RADIX_PASSES; pass++) {
+    size_t* count = counts[pass];
+    if (count[radix_digit(src[0], pass)] == n) continue;
+
+    size_t offset = 0;
+    for (size_t b = 0; b < RADIX_BUCKETS; b++) {
+      size_t c = count[b];
+      count[b] = offset;
+      offset += c;
+    }
+    for (size_t i = 0; i < n; i++) {
+      size_t at = count[radix_digit(src[i], pass)]++;
+      dst[at] = src[i];
+      dst_pos[at] = src_pos[i];
+    }
+    int *t = src, *t_pos = src_pos;
+    src = dst, src_pos = dst_pos;
+    dst = t, dst_pos = t_pos;
+    in_tmp = !in_tmp;
+  }
+  return in_tmp;
 }
 
 /**
  * @brief Sorts the `data` in ascending order and keeps track of their original positions.
+ * The sort is stable: equal values keep their positions in ascending order.
  *
  * The caller should be responsible for memory management of arrays: `data` and
  * `original_pos`. That is, allocating enough memory and free-ing it later.
@@ -31,38 +79,178 @@ int compare_fn(const void* a, const void* b) {
  * @return int Returns 0 on success, or -1 on error (e.g., NULL pointers).
  */
 int sort(int* data, size_t n_elements, int* original_pos) {
+  return sort_parallel(NULL, data, n_elements, original_pos);
+}
+
+// State shared by the tasks of one `sort_parallel`
+typedef struct {
+  int* data;
+  int* positions;
+  int* tmp_data;
+  int* tmp_positions;
+  size_t n;
+  size_t run_size;
+  size_t n_runs;
+  int* splitters;     // partition p holds the values in [splitters[p - 1], splitters[p])
+  size_t* cuts;       // cuts[p * n_runs + r]: where partition p starts in run r
+  size_t* out_start;  // out_start[p]: where partition p starts in the output
+} ParallelSort;
+
+// Sorts one run into the `tmp_*` arrays
+static void sort_run_task(size_t start, size_t end, void* arg) {
+  ParallelSort* ps = (ParallelSort*)arg;
+  for (size_t i = start; i < end; i++) ps->positions[i] = (int)i;
+  size_t n = end - start;
+  if (!radix_sort_run(ps->data + start, ps->positions + start, ps->tmp_data + start,
+                      ps->tmp_positions + start, n)) {
+    memcpy(ps->tmp_data + start, ps->data + start, sizeof(int) * n);
+    memcpy(ps->tmp_positions + start, ps->positions + start, sizeof(int) * n);
+  }
+}
+
+// Number of values `< value` in sorted `data`
+static size_t lower_bound(const int* data, size_t n, int value) {
+  size_t left = 0, right = n;
+  while (left < right) {
+    size_t mid = left + (right - left) / 2;
+    if (data[mid] < value) {
+      left = mid + 1;
+    } else {
+      right = mid;
+    }
+  }
+  return left;
+}
+
+/**
+ * @brief Merges partition `p` of every run from the `tmp_*` arrays into its slice of
+ * the output. There are only as many runs as workers, so the smallest head is found
+ * by a scan over the heads; ties go to the earlier run, which keeps the sort stable.
+ */
+static void merge_partition_task(size_t p, size_t p_end, void* arg) {
+  ParallelSort* ps = (ParallelSort*)arg;
+  (void)p_end;
+  size_t n_runs = ps->n_runs;
+  size_t heads[n_runs], ends[n_runs];
+  for (size_t r = 0; r < n_runs; r++) {
+    heads[r] = ps->cuts[p * n_runs + r];
+    ends[r] = ps->cuts[(p + 1) * n_runs + r];
+  }
+  size_t out = ps->out_start[p], out_end = ps->out_start[p + 1];
+  for (; out < out_end; out++) {
+    size_t best = SIZE_MAX;
+    for (size_t r = 0; r < n_runs; r++) {
+      if (heads[r] < ends[r] &&
+          (best == SIZE_MAX || ps->tmp_data[heads[r]] < ps->tmp_data[heads[best]])) {
+        best = r;
+      }
+    }
+    ps->data[out] = ps->tmp_data[heads[best]];
+    ps->positions[out] = ps->tmp_positions[heads[best]];
+    heads[best]++;
+  }
+}
+
+static int compare_ints(const void* a, const void* b) {
+  int x = *(const int*)a, y = *(const int*)b;
+  return (x > y) - (x < y);
+}
+
+/**
+ * @brief Splits the sorted runs into `n_runs` partitions by value, so every partition
+ * can be merged into its own slice of the output independently. The splitters are
+ * the quantiles of a sample of every run's own quantiles.
+ */
+static void partition_runs(ParallelSort* ps) {
+  size_t n_runs = ps->n_runs;
+  size_t n_samples = n_runs * (n_runs - 1);
+  int samples[n_samples];
+  for (size_t r = 0; r < n_runs; r++) {
+    size_t start = r * ps->run_size;
+    size_t len = (r + 1 == n_runs ? ps->n : start + ps->run_size) - start;
+    for (size_t s = 1; s < n_runs; s++) {
+      samples[r * (n_runs - 1) + s - 1] = ps->tmp_data[start + len * s / n_runs];
+    }
+  }
+  qsort(samples, n_samples, sizeof(int), compare_ints);
+  for (size_t p = 1; p < n_runs; p++) ps->splitters[p - 1] = samples[p * n_runs - 1];
+
+  for (size_t p = 0; p <= n_runs; p++) {
+    ps->out_start[p] = 0;
+    for (size_t r = 0; r < n_runs; r++) {
+      size_t start = r * ps->run_size;
+      size_t end = r + 1 == n_runs ? ps->n : start + ps->run_size;
+      size_t cut = p == 0         ? start
+                   : p == n_runs ? end
+                                 : start + lower_bound(ps->tmp_data + start, end - start,
+                                                       ps->splitters[p - 1]);
+      ps->cuts[p * n_runs + r] = cut;
+      ps->out_start[p] += cut - start;
+    }
+  }
+}
+
+int sort_parallel(ThreadPool* pool, int* data, size_t n_elements, int* original_pos) {
   if (!data || !original_pos || n_elements == 0) {
     log_err("%Ld: sort: Invalid input; data=%p, original_pos=%p, n_elements=%zu\n",
             __LINE__, data, original_pos, n_elements);
     return -1;  // Error: Invalid input
   }
 
-  // Create an auxiliary array to store values and their original indices
-  IndexedValue* indexed_array = (IndexedValue*)malloc(n_elements * sizeof(IndexedValue));
-  if (!indexed_array) {
-    log_err("%Ld: sort: Failed to allocate memory for indexed_array\n", __LINE__);
+  // The scratch is a second copy of the values and positions: 8 bytes per value
+  int* tmp_data = malloc(n_elements * sizeof(int));
+  int* tmp_positions = malloc(n_elements * sizeof(int));
+  if (!tmp_data || !tmp_positions) {
+    log_err("%Ld: sort: Failed to allocate memory for the scratch arrays\n", __LINE__);
+    free(tmp_data);
+    free(tmp_positions);
     return -1;
   }
 
-  // Populate the auxiliary array
-  for (size_t i = 0; i < n_elements; i++) {
-    indexed_array[i].value = data[i];
-    indexed_array[i].index = i;
-  }
+  size_t n_runs = pool ? threadpool_num_threads(pool) : 1;
+  if (n_runs > n_elements / SORT_MIN_RUN) n_runs = n_elements / SORT_MIN_RUN;
 
-  // Sort the auxiliary array using qsort
-  qsort(indexed_array, n_elements, sizeof(IndexedValue), compare_fn);
-
-  // Write sorted values back to `data` and store original positions
-  for (size_t i = 0; i < n_elements; i++) {
-    data[i] = indexed_array[i].value;
-    original_pos[i] = indexed_array[i].index;
+  int status = 0;
+  if (n_runs <= 1) {
+    for (size_t i = 0; i < n_elements; i++) original_pos[i] = (int)i;
+    if (radix_sort_run(data, original_pos, tmp_data, tmp_positions, n_elements)) {
+      memcpy(data, tmp_data, sizeof(int) * n_elements);
+      memcpy(original_pos, tmp_positions, sizeof(int) * n_elements);
+    }
+  } else {
+    // Every worker sorts a run into the scratch, then merges one value range of all
+    // the runs back into `data`
+    ParallelSort ps = {.data = data,
+                       .positions = original_pos,
+                       .tmp_data = tmp_data,
+                       .tmp_positions = tmp_positions,
+                       .n = n_elements,
+                       .run_size = (n_elements + n_runs - 1) / n_runs};
+    ps.n_runs = num_morsels(n_elements, ps.run_size);
+    ps.splitters = malloc(sizeof(int) * ps.n_runs);
+    ps.cuts = malloc(sizeof(size_t) * (ps.n_runs + 1) * ps.n_runs);
+    ps.out_start = malloc(sizeof(size_t) * (ps.n_runs + 1));
+    if (!ps.splitters || !ps.cuts || !ps.out_start ||
+        threadpool_parallel_for(pool, n_elements, ps.run_size, sort_run_task, &ps) != 0) {
+      status = -1;
+    } else if (ps.n_runs == 1) {
+      memcpy(data, tmp_data, sizeof(int) * n_elements);
+      memcpy(original_pos, tmp_positions, sizeof(int) * n_elements);
+    } else {
+      partition_runs(&ps);
+      status = threadpool_parallel_for(pool, ps.n_runs, 1, merge_partition_task, &ps);
+    }
+    if (status != 0) {
+      log_err("%Ld: sort: Failed to schedule the parallel sort\n", __LINE__);
+    }
+    free(ps.splitters);
+    free(ps.cuts);
+    free(ps.out_start);
   }
 
-  // Free the auxiliary array
-  free(indexed_array);
-
-  return 0;
+  free(tmp_data);
+  free(tmp_positions);
+  return status;
 }
 
 size_t binary_search_right(int* sorted_data, size_t num_elements, int value) {
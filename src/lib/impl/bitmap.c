@@ -0,0 +1,178 @@
+#include "bitmap.h"
+
+#include <pthread.h>
+#include <stdlib.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define BITMAP_HAS_X86 1
+#endif
+
+typedef size_t (*positions_kernel)(const uint64_t*, size_t, size_t, int*);
+typedef size_t (*gather_kernel)(const uint64_t*, size_t, size_t, const int*, int*);
+
+// One position per set bit; clearing the lowest set bit never branches on data
+static size_t positions_scalar(const uint64_t* words, size_t first_word, size_t end_word,
+                               int* out) {
+  size_t count = 0;
+  for (size_t w = first_word; w < end_word; w++) {
+    for (uint64_t bits = words[w]; bits; bits &= bits - 1) {
+      out[count++] = (int)(w * 64 + __builtin_ctzll(bits));
+    }
+  }
+  return count;
+}
+
+static size_t gather_scalar(const uint64_t* words, size_t first_word, size_t end_word,
+                            const int* values, int* out) {
+  size_t count = 0;
+  for (size_t w = first_word; w < end_word; w++) {
+    for (uint64_t bits = words[w]; bits; bits &= bits - 1) {
+      out[count++] = values[w * 64 + __builtin_ctzll(bits)];
+    }
+  }
+  return count;
+}
+
+#ifdef BITMAP_HAS_X86
+
+// entry `m` lists the set bits of byte `m`, padded with zeros to 8 lanes
+static int32_t byte_positions[256][8] __attribute__((aligned(32)));
+
+static void init_byte_positions(void) {
+  for (int mask = 0; mask < 256; mask++) {
+    int k = 0;
+    for (int bit = 0; bit < 8; bit++) {
+      if (mask & (1 << bit)) byte_positions[mask][k++] = bit;
+    }
+    for (; k < 8; k++) byte_positions[mask][k] = 0;
+  }
+}
+
+/**
+ * @brief Turns every byte of a word into its positions with one table load, one add
+ * and one 8-lane store, so a dense word costs 8 steps instead of one per set bit.
+ * Stores write a whole vector, so the words that end the range with fewer than 8
+ * positions to spare go to the scalar kernel and nothing is written past the last
+ * position.
+ */
+__attribute__((target("avx2,popcnt"))) static size_t positions_avx2(
+    const uint64_t* words, size_t first_word, size_t end_word, int* out) {
+  size_t total = 0;
+  for (size_t w = first_word; w < end_word; w++) total += __builtin_popcountll(words[w]);
+
+  const __m256i step = _mm256_set1_epi32(8);
+  size_t count = 0;
+  size_t w = first_word;
+  for (; w < end_word; w++) {
+    uint64_t bits = words[w];
+    if (!bits) continue;
+    if (total - count < (size_t)__builtin_popcountll(bits) + 8) break;
+    __m256i base = _mm256_set1_epi32((int)(w * 64));
+    for (int b = 0; b < 8; b++, bits >>= 8) {
+      unsigned int mask = bits & 0xFF;
+      __m256i lanes = _mm256_load_si256((const __m256i*)byte_positions[mask]);
+      _mm256_storeu_si256((__m256i*)(out + count), _mm256_add_epi32(lanes, base));
+      count += __builtin_popcount(mask);
+      base = _mm256_add_epi32(base, step);
+    }
+  }
+  return count + positions_scalar(words, w, end_word, out + count);
+}
+
+/**
+ * @brief Same walk as `positions_avx2`, but the table entry permutes the byte's 8
+ * values instead, so the selected values are compacted straight from a sequential load
+ * without computing their positions. Only the last word with set bits can reach past
+ * the end of the column, and it always goes to the scalar kernel.
+ */
+__attribute__((target("avx2,popcnt"))) static size_t gather_avx2(
+    const uint64_t* words, size_t first_word, size_t end_word, const int* values,
+    int* out) {
+  size_t total = 0;
+  for (size_t w = first_word; w < end_word; w++) total += __builtin_popcountll(words[w]);
+
+  size_t count = 0;
+  size_t w = first_word;
+  for (; w < end_word; w++) {
+    uint64_t bits = words[w];
+    if (!bits) continue;
+    if (total - count < (size_t)__builtin_popcountll(bits) + 8) break;
+    const int* block = values + w * 64;
+    for (int b = 0; b < 8; b++, bits >>= 8) {
+      unsigned int mask = bits & 0xFF;
+      __m256i lanes = _mm256_load_si256((const __m256i*)byte_positions[mask]);
+      __m256i v = _mm256_loadu_si256((const __m256i*)(block + b * 8));
+      _mm256_storeu_si256((__m256i*)(out + count), _mm256_permutevar8x32_epi32(v, lanes));
+      count += __builtin_popcount(mask);
+    }
+  }
+  return count + gather_scalar(words, w, end_word, values, out + count);
+}
+
+#endif  // BITMAP_HAS_X86
+
+static positions_kernel positions_fn = positions_scalar;
+static gather_kernel gather_fn = gather_scalar;
+static pthread_once_t bitmap_init_once = PTHREAD_ONCE_INIT;
+
+static void bitmap_init(void) {
+#ifdef BITMAP_HAS_X86
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx2")) {
+    init_byte_positions();
+    positions_fn = positions_avx2;
+    gather_fn = gather_avx2;
+  }
+#endif
+}
+
+Bitmap* bitmap_create(size_t num_bits) {
+  Bitmap* bitmap = malloc(sizeof(Bitmap));
+  if (!bitmap) return NULL;
+  // Keep at least one word so an empty bitmap still owns a buffer
+  size_t num_words = bitmap_num_words(num_bits);
+  bitmap->words = calloc(num_words ? num_words : 1, sizeof(uint64_t));
+  if (!bitmap->words) {
+    free(bitmap);
+    return NULL;
+  }
+  bitmap->num_bits = num_bits;
+  return bitmap;
+}
+
+void bitmap_destroy(Bitmap* bitmap) {
+  if (!bitmap) return;
+  free(bitmap->words);
+  free(bitmap);
+}
+
+size_t bitmap_count(const Bitmap* bitmap, size_t start, size_t end) {
+  size_t count = 0;
+  for (size_t w = start / 64; w < bitmap_num_words(end); w++) {
+    count += __builtin_popcountll(bitmap->words[w]);
+  }
+  return count;
+}
+
+size_t bitmap_positions(const Bitmap* bitmap, size_t start, size_t end, int* out) {
+  pthread_once(&bitmap_init_once, bitmap_init);
+  return positions_fn(bitmap->words, start / 64, bitmap_num_words(end), out);
+}
+
+size_t bitmap_gather(const Bitmap* bitmap, size_t start, size_t end, const int* values,
+                     int* out) {
+  pthread_once(&bitmap_init_once, bitmap_init);
+  return gather_fn(bitmap->words, start / 64, bitmap_num_words(end), values, out);
+}
+
+size_t bitmap_and(Bitmap* dst, const Bitmap* a, const Bitmap* b, size_t start,
+                  size_t end) {
+  size_t count = 0;
+  for (size_t w = start / 64; w < bitmap_num_words(end); w++) {
+    uint64_t word = a->words[w] & b->words[w];
+    dst->words[w] = word;
+    count += __builtin_popcountll(word);
+  }
+  return count;
+}
@@ -0,0 +1,335 @@
+#include "bitpack.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "bitmap.h"
+#include "scan.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define BITPACK_HAS_X86 1
+#endif
+
+// Rows a packed position scan turns into a bitmap before decoding the positions
+#define PACKED_CHUNK_ROWS 4096
+
+unsigned int packed_bits_for(long min_value, long max_value) {
+  unsigned int bits = 0;
+  if (max_value <= min_value) return 0;
+  unsigned long range = (unsigned long)(max_value - min_value);
+  while (bits < 64 && (range >> bits) != 0) bits++;
+  return bits;
+}
+
+static inline size_t packed_num_words(const PackedInts* packed, size_t capacity) {
+  return capacity / 64 * packed->width;
+}
+
+static inline int packed_fits(const PackedInts* packed, int value, uint64_t* code) {
+  long c = (long)value - packed->base;
+  if (c < 0 || (unsigned long)c >> packed->bits != 0) return 0;
+  *code = (uint64_t)c;
+  return 1;
+}
+
+static inline void packed_put(PackedInts* packed, size_t row, uint64_t code) {
+  size_t r = row % 64;
+  packed->words[row / 64 * packed->width + (r & (packed->width - 1))] |=
+      code << (r & ~(size_t)(packed->width - 1));
+}
+
+PackedInts* packed_create(const int* values, size_t n, int base, unsigned int bits) {
+  if (bits > PACKED_MAX_BITS) return NULL;
+  PackedInts* packed = calloc(1, sizeof(PackedInts));
+  if (!packed) return NULL;
+  packed->base = base;
+  packed->width = 4;
+  while (packed->width < bits + 1) packed->width *= 2;
+  packed->bits = packed->width - 1;
+  packed->per_word = 64 / packed->width;
+  for (unsigned int f = 0; f < packed->per_word; f++) {
+    packed->ones |= 1ULL << (f * packed->width);
+    packed->delimiters |= 1ULL << (f * packed->width + packed->bits);
+  }
+
+  packed->capacity = n ? (n + 63) / 64 * 64 : 64;
+  packed->words = calloc(packed_num_words(packed, packed->capacity), sizeof(uint64_t));
+  if (!packed->words) {
+    packed_destroy(packed);
+    return NULL;
+  }
+  // every value must fit the requested bits, even though the fields have room for more
+  unsigned long max_code = bits ? (1UL << bits) - 1 : 0;
+  for (size_t i = 0; i < n; i++) {
+    uint64_t code;
+    if (!packed_fits(packed, values[i], &code) || code > max_code) {
+      packed_destroy(packed);
+      return NULL;
+    }
+    packed_put(packed, i, code);
+  }
+  packed->num_elements = n;
+  return packed;
+}
+
+void packed_destroy(PackedInts* packed) {
+  if (!packed) return;
+  free(packed->words);
+  free(packed);
+}
+
+int packed_append(PackedInts* packed, int value) {
+  uint64_t code;
+  if (!packed_fits(packed, value, &code)) return -1;
+  if (packed->num_elements == packed->capacity) {
+    size_t old_words = packed_num_words(packed, packed->capacity);
+    size_t new_words = old_words * 2;
+    uint64_t* words = realloc(packed->words, sizeof(uint64_t) * new_words);
+    if (!words) return -1;
+    memset(words + old_words, 0, sizeof(uint64_t) * (new_words - old_words));
+    packed->words = words;
+    packed->capacity *= 2;
+  }
+  packed_put(packed, packed->num_elements++, code);
+  return 0;
+}
+
+/**
+ * @brief Decodes the whole segments of rows `[start, end)`, leaving the rows of a last
+ * partial one. Inlined for each field width, which lets the compiler vectorize the
+ * loop over a segment's words.
+ *
+ * @return the first row not decoded
+ */
+static inline __attribute__((always_inline)) size_t decode_segments(
+    const PackedInts* packed, unsigned int width, size_t start, size_t end, int* out) {
+  uint64_t mask = (1ULL << (width - 1)) - 1;
+  int base = packed->base;
+  size_t row = start;
+  // field `f` of the segment's words holds rows `f * width ..`
+  for (; row + 64 <= end; row += 64) {
+    const uint64_t* words = packed->words + row / 64 * width;
+    int* segment_out = out + (row - start);
+    for (unsigned int f = 0; f < 64 / width; f++) {
+      for (unsigned int i = 0; i < width; i++) {
+        segment_out[f * width + i] = base + (int)((words[i] >> (f * width)) & mask);
+      }
+    }
+  }
+  return row;
+}
+
+static size_t decode_scalar(const PackedInts* packed, size_t start, size_t end,
+                            int* out) {
+  switch (packed->width) {
+    case 4:
+      return decode_segments(packed, 4, start, end, out);
+    case 8:
+      return decode_segments(packed, 8, start, end, out);
+    case 16:
+      return decode_segments(packed, 16, start, end, out);
+    default:
+      return decode_segments(packed, 32, start, end, out);
+  }
+}
+
+#ifdef BITPACK_HAS_X86
+__attribute__((target("avx2"))) static size_t decode_avx2(const PackedInts* packed,
+                                                          size_t start, size_t end,
+                                                          int* out) {
+  switch (packed->width) {
+    case 4:
+      return decode_segments(packed, 4, start, end, out);
+    case 8:
+      return decode_segments(packed, 8, start, end, out);
+    case 16:
+      return decode_segments(packed, 16, start, end, out);
+    default:
+      return decode_segments(packed, 32, start, end, out);
+  }
+}
+#endif
+
+void packed_decode(const PackedInts* packed, size_t start, size_t end, int* out) {
+#ifdef BITPACK_HAS_X86
+  size_t row = scan_best_kernel() == SCAN_AVX2 ? decode_avx2(packed, start, end, out)
+                                               : decode_scalar(packed, start, end, out);
+#else
+  size_t row = decode_scalar(packed, start, end, out);
+#endif
+  for (; row < end; row++) out[row - start] = packed_get(packed, row);
+}
+
+/**
+ * @brief Translates `[low, high]` into the inclusive code range `[lo, hi]`.
+ *
+ * @return 0 if no code can qualify
+ */
+static int code_range(const PackedInts* packed, int low, int high, uint64_t* lo,
+                      uint64_t* hi) {
+  long max_code = (long)((1ULL << packed->bits) - 1);
+  long from = (long)low - packed->base, to = (long)high - packed->base;
+  if (from < 0) from = 0;
+  if (to > max_code) to = max_code;
+  if (from > to) return 0;
+  *lo = (uint64_t)from;
+  *hi = (uint64_t)to;
+  return 1;
+}
+
+/**
+ * @brief Bit `r` is set for every row `r` of segment `segment` whose code is in
+ * `[lo, hi]`, given `lo_rep = lo * ones` and `hi_rep = (hi * ones) | delimiters`. In
+ * every field, `(x | D) - lo` keeps the delimiter exactly when `x >= lo`, and
+ * `(hi | D) - x` exactly when `x <= hi`.
+ */
+static inline uint64_t segment_matches(const PackedInts* packed, size_t segment,
+                                       uint64_t lo_rep, uint64_t hi_rep) {
+  const uint64_t* words = packed->words + segment * packed->width;
+  uint64_t delimiters = packed->delimiters, matches = 0;
+  for (unsigned int i = 0; i < packed->width; i++) {
+    uint64_t x = words[i];
+    matches |= (((x | delimiters) - lo_rep) & (hi_rep - x) & delimiters) >>
+               (packed->bits - i);
+  }
+  return matches;
+}
+
+#ifdef BITPACK_HAS_X86
+
+// Same as `segment_matches`, four words of the segment at a time
+__attribute__((target("avx2"))) static inline uint64_t segment_matches_avx2(
+    const PackedInts* packed, size_t segment, uint64_t lo_rep, uint64_t hi_rep) {
+  const uint64_t* words = packed->words + segment * packed->width;
+  const __m256i delimiters = _mm256_set1_epi64x((long long)packed->delimiters);
+  const __m256i lo = _mm256_set1_epi64x((long long)lo_rep);
+  const __m256i hi = _mm256_set1_epi64x((long long)hi_rep);
+  const __m256i four = _mm256_set1_epi64x(4);
+  long long bits = packed->bits;
+  __m256i shifts = _mm256_setr_epi64x(bits, bits - 1, bits - 2, bits - 3);
+  __m256i acc = _mm256_setzero_si256();
+  unsigned int i = 0;
+  for (; i + 4 <= packed->width; i += 4) {
+    __m256i x = _mm256_loadu_si256((const __m256i*)(words + i));
+    __m256i ge = _mm256_sub_epi64(_mm256_or_si256(x, delimiters), lo);
+    __m256i le = _mm256_sub_epi64(hi, x);
+    __m256i m = _mm256_and_si256(_mm256_and_si256(ge, le), delimiters);
+    acc = _mm256_or_si256(acc, _mm256_srlv_epi64(m, shifts));
+    shifts = _mm256_sub_epi64(shifts, four);
+  }
+  __m128i halves =
+      _mm_or_si128(_mm256_castsi256_si128(acc), _mm256_extracti128_si256(acc, 1));
+  uint64_t matches = (uint64_t)_mm_cvtsi128_si64(halves) |
+                     (uint64_t)_mm_cvtsi128_si64(_mm_unpackhi_epi64(halves, halves));
+  for (; i < packed->width; i++) {
+    uint64_t x = words[i];
+    matches |= (((x | packed->delimiters) - lo_rep) & (hi_rep - x) &
+                packed->delimiters) >>
+               (packed->bits - i);
+  }
+  return matches;
+}
+
+#endif  // BITPACK_HAS_X86
+
+/**
+ * @brief Writes the select's bitmap word of every segment in `[first, last)` to
+ * `words[0 .. last - first)`, including the rows past the last one. Inlined into a
+ * scalar and an AVX2 version, which differ only in how they match a segment.
+ *
+ * @return the number of bits set
+ */
+static inline __attribute__((always_inline)) size_t scan_segments_with(
+    int avx2, const PackedInts* packed, size_t first, size_t last, uint64_t lo,
+    uint64_t hi, uint64_t* words) {
+  uint64_t lo_rep = lo * packed->ones, hi_rep = (hi * packed->ones) | packed->delimiters;
+  size_t count = 0;
+  for (size_t segment = first; segment < last; segment++) {
+#ifdef BITPACK_HAS_X86
+    uint64_t bits = avx2 ? segment_matches_avx2(packed, segment, lo_rep, hi_rep)
+                         : segment_matches(packed, segment, lo_rep, hi_rep);
+#else
+    (void)avx2;
+    uint64_t bits = segment_matches(packed, segment, lo_rep, hi_rep);
+#endif
+    words[segment - first] = bits;
+    count += __builtin_popcountll(bits);
+  }
+  return count;
+}
+
+static size_t scan_segments_scalar(const PackedInts* packed, size_t first, size_t last,
+                                   uint64_t lo, uint64_t hi, uint64_t* words) {
+  return scan_segments_with(0, packed, first, last, lo, hi, words);
+}
+
+#ifdef BITPACK_HAS_X86
+__attribute__((target("avx2"))) static size_t scan_segments_avx2(
+    const PackedInts* packed, size_t first, size_t last, uint64_t lo, uint64_t hi,
+    uint64_t* words) {
+  return scan_segments_with(1, packed, first, last, lo, hi, words);
+}
+#endif
+
+/**
+ * @brief The select's bitmap of rows `[start, end)`, one word per segment of
+ * `[start / 64, ceil(end / 64))` into `words`, with the bits of rows outside the range
+ * cleared. Picks the AVX2 version when the scan kernels found the CPU has AVX2.
+ *
+ * @return the number of bits set
+ */
+static size_t scan_segments(const PackedInts* packed, size_t start, size_t end,
+                            uint64_t lo, uint64_t hi, uint64_t* words) {
+  size_t first = start / 64, last = (end + 63) / 64;
+  size_t count;
+#ifdef BITPACK_HAS_X86
+  if (scan_best_kernel() == SCAN_AVX2) {
+    count = scan_segments_avx2(packed, first, last, lo, hi, words);
+  } else {
+    count = scan_segments_scalar(packed, first, last, lo, hi, words);
+  }
+#else
+  count = scan_segments_scalar(packed, first, last, lo, hi, words);
+#endif
+  uint64_t before = words[0] & ((1ULL << (start % 64)) - 1);
+  count -= __builtin_popcountll(before);
+  words[0] &= ~before;
+  if (end % 64) {
+    uint64_t after = words[last - first - 1] & ~((1ULL << (end % 64)) - 1);
+    count -= __builtin_popcountll(after);
+    words[last - first - 1] &= ~after;
+  }
+  return count;
+}
+
+size_t packed_scan_range(const PackedInts* packed, size_t start, size_t end, int low,
+                         int high, int* out) {
+  uint64_t lo, hi;
+  if (start >= end || !code_range(packed, low, high, &lo, &hi)) return 0;
+  uint64_t chunk[PACKED_CHUNK_ROWS / 64];
+  size_t count = 0;
+  for (size_t from = start; from < end;) {
+    size_t first_row = from / 64 * 64;
+    size_t to = first_row + PACKED_CHUNK_ROWS < end ? first_row + PACKED_CHUNK_ROWS : end;
+    if (scan_segments(packed, from, to, lo, hi, chunk)) {
+      Bitmap bitmap = {.words = chunk, .num_bits = to - first_row};
+      size_t n_found = bitmap_positions(&bitmap, 0, to - first_row, out + count);
+      for (size_t i = count; i < count + n_found; i++) out[i] += (int)first_row;
+      count += n_found;
+    }
+    from = to;
+  }
+  return count;
+}
+
+size_t packed_scan_range_bits(const PackedInts* packed, size_t start, size_t end,
+                              int low, int high, uint64_t* words) {
+  if (start >= end) return 0;
+  uint64_t lo, hi;
+  if (!code_range(packed, low, high, &lo, &hi)) {
+    memset(words + start / 64, 0, sizeof(uint64_t) * ((end + 63) / 64 - start / 64));
+    return 0;
+  }
+  return scan_segments(packed, start, end, lo, hi, words + start / 64);
+}
@@ -1,214 +1,309 @@
+#define _POSIX_C_SOURCE 200112L  // posix_memalign
+
 #include "btree.h"
 
+#include <limits.h>
 #include <sys/types.h>
 
-#include "algorithms.h"
-#include "btree.h"
 #include "utils.h"
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+// Keys of a level rounded up to whole nodes
+static inline size_t padded_keys(size_t n_keys) {
+  return (n_keys + BTREE_NODE_KEYS - 1) / BTREE_NODE_KEYS * BTREE_NODE_KEYS;
+}
+
 /**
- * @brief Create a Btree level node
- *
- * @pre 🚨 The Caller must ensure that `data` array is sorted and has unique values!!
- *
- * @param data
- * @param n_uniques
- * @param stride
- * @param fanout
- * @param first_idxes
- * @param last_idxes
- * ️
- * @return Btree*
+ * @brief Number of keys of the node `< key`. The padding is `INT_MAX`, which no key is
+ * less than, so it never counts.
  */
-Btree* create_level(int* data, size_t n_uniques, size_t stride, size_t fanout,
-                    size_t* first_idxes, size_t* last_idxes) {
-  size_t n_keys = stride > 0 ? (n_uniques + stride - 1) / stride : 0;
-  if (n_keys == 0) return NULL;
-
-  Btree* node = malloc(sizeof(Btree));
-  node->keys = malloc(sizeof(int) * n_keys);
-  node->n_keys = n_keys;
-  node->child_ptr = NULL;
-
-  // Global bookkeeping; see todo in btree.h
-  node->fanout = fanout;
-  node->first_unique_idxes = first_idxes;
-  node->last_unique_idxes = last_idxes;
-  node->n_uniques = n_uniques;
-
-  // Take every stride-th element
-  size_t key_idx = 0;
-  for (size_t i = 0; i < n_uniques && key_idx < n_keys; i += stride) {
-    node->keys[key_idx] = data[i];
-    key_idx++;
-  }
-
-  return node;
+static inline size_t node_count_less(const int* node, int key) {
+#if defined(__SSE2__)
+  __m128i k = _mm_set1_epi32(key);
+  __m128i lt0 = _mm_cmplt_epi32(_mm_loadu_si128((const __m128i*)node), k);
+  __m128i lt1 = _mm_cmplt_epi32(_mm_loadu_si128((const __m128i*)(node + 4)), k);
+  __m128i lt2 = _mm_cmplt_epi32(_mm_loadu_si128((const __m128i*)(node + 8)), k);
+  __m128i lt3 = _mm_cmplt_epi32(_mm_loadu_si128((const __m128i*)(node + 12)), k);
+  // every lane is a 0/-1 mask; pack them to bytes and count the set bits
+  __m128i bytes = _mm_packs_epi16(_mm_packs_epi32(lt0, lt1), _mm_packs_epi32(lt2, lt3));
+  return __builtin_popcount(_mm_movemask_epi8(bytes));
+#else
+  size_t count = 0;
+  for (size_t i = 0; i < BTREE_NODE_KEYS; i++) count += node[i] < key;
+  return count;
+#endif
 }
 
-Btree* init_btree(int* data, size_t n_elts, size_t fanout) {
-  if (!data || n_elts == 0 || fanout < 2) return NULL;
+/**
+ * @brief Number of unique values `< key`, descending one node per level. A node's
+ * count `c` says the answer lies under its child `c - 1`: that child starts with a
+ * value `< key` and the next one with a value that is not.
+ */
+static size_t btree_rank_less(const Btree* tree, int key) {
+  size_t node = 0, rank = 0;
+  for (size_t l = 0; l < tree->n_levels; l++) {
+    const int* level = tree->keys + tree->level_start[l];
+    rank = node * BTREE_NODE_KEYS + node_count_less(level + node * BTREE_NODE_KEYS, key);
+    if (rank == 0) return 0;
+    node = rank - 1;
+  }
+  return rank;
+}
+
+// Turns the rank of `key` among the unique values into a `lookup` result
+static inline size_t rank_to_index(const Btree* tree, size_t rank, int is_left) {
+  if (is_left) {
+    return rank < tree->n_uniques ? tree->first_unique_idxes[rank]
+                                  : tree->last_unique_idxes[tree->n_uniques - 1] + 1;
+  }
+  return rank > 0 ? tree->last_unique_idxes[rank - 1] : 0;
+}
+
+// Computes where each level starts in the node array; returns the number of keys
+static size_t layout_levels(Btree* tree) {
+  size_t total = 0;
+  for (size_t l = 0; l < tree->n_levels; l++) {
+    tree->level_start[l] = total;
+    total += padded_keys(tree->level_keys[l]);
+  }
+  return total;
+}
+
+Btree* init_btree(int* data, size_t n_elts) {
+  if (!data || n_elts == 0) return NULL;
   /*
   Some book keeping first: keep elements in `data` unique and store their first
   and last occurrences (indices) of unique vals in the `data` array
-  If we have sample input: data[] = {2, 2, 2, 5, 5, 1, 7, 7, 7, 8}; n_elts = 10;
+  If we have sample input: data[] = {1, 1, 1, 2, 2, 5, 7, 7, 7, 8}; n_elts = 10;
                                 i = [0, 1, 2, 3, 4, 5, 6, 7, 8, 9]
    We want:
-        - unique_sorted = {2, 5, 1, 7, 8}
+        - unique_sorted = {1, 2, 5, 7, 8}
         -  first_left   = {0, 3, 5, 6, 9}
         -  first_right  = {2, 4, 5, 8, 9}
-
   */
-  size_t* first_left = malloc(sizeof(size_t) * n_elts);
-  size_t* first_right = malloc(sizeof(size_t) * n_elts);
-  int* unique_sorted = malloc(sizeof(int) * n_elts);
+  size_t n_uniques = 1;
+  for (size_t i = 1; i < n_elts; i++) n_uniques += data[i] != data[i - 1];
 
-  unique_sorted[0] = data[0];
-  first_left[0] = 0;
-  size_t n_uniques = 0;
+  Btree* tree = calloc(1, sizeof(Btree));
+  if (!tree) return NULL;
+  tree->n_uniques = n_uniques;
+  tree->first_unique_idxes = malloc(sizeof(size_t) * n_uniques);
+  tree->last_unique_idxes = malloc(sizeof(size_t) * n_uniques);
 
-  for (size_t i = 1; i < n_elts; i++) {
-    if (data[i] != data[i - 1]) {
-      first_right[n_uniques] = i - 1;  // Close off the current unique element
-      n_uniques++;                     // Move to the next unique index
-      first_left[n_uniques] = i;       // Start new unique element
-      unique_sorted[n_uniques] = data[i];
-    }
+  // Level sizes, leaves up: every level keeps the first key of each node below it
+  size_t sizes[BTREE_MAX_LEVELS];
+  size_t depth = 0;
+  sizes[depth++] = n_uniques;
+  while (sizes[depth - 1] > BTREE_NODE_KEYS) {
+    sizes[depth] = (sizes[depth - 1] + BTREE_NODE_KEYS - 1) / BTREE_NODE_KEYS;
+    depth++;
   }
-  first_right[n_uniques] = n_elts - 1;  // Close off the last unique element
-  // Set `n_uniques` to the actual number of unique elements
-  n_uniques++;
+  tree->n_levels = depth;
+  for (size_t l = 0; l < depth; l++) tree->level_keys[l] = sizes[depth - 1 - l];
+  size_t total = layout_levels(tree);
 
-  // Calculate number of levels needed: this is (log_{fanout} n_elts) - 1
-  //  a -1 because the last level with all values is the `data` array itself
-  size_t stride = 1;
-  size_t n_levels = 0;
-  while (stride * fanout < n_uniques) {
-    stride *= fanout;
-    n_levels++;
+  void* keys = NULL;
+  if (!tree->first_unique_idxes || !tree->last_unique_idxes ||
+      posix_memalign(&keys, 64, sizeof(int) * total) != 0) {
+    free_btree(tree);
+    return NULL;
   }
+  tree->keys = keys;
 
-  n_levels++;  // Add the last level
-
-  Btree** levels = malloc(sizeof(Btree*) * (n_levels));
-  size_t current_stride = stride;
-
-  // Create each level, starting from the root
-  for (size_t i = 0; i < n_levels; i++) {
-    levels[i] = create_level(unique_sorted, n_uniques, current_stride, fanout, first_left,
-                             first_right);
-    current_stride /= fanout;
+  int* leaves = tree->keys + tree->level_start[depth - 1];
+  size_t u = 0;
+  leaves[0] = data[0];
+  tree->first_unique_idxes[0] = 0;
+  for (size_t i = 1; i < n_elts; i++) {
+    if (data[i] != data[i - 1]) {
+      tree->last_unique_idxes[u] = i - 1;  // Close off the current unique element
+      u++;                                 // Move to the next unique index
+      tree->first_unique_idxes[u] = i;     // Start new unique element
+      leaves[u] = data[i];
+    }
   }
+  tree->last_unique_idxes[u] = n_elts - 1;  // Close off the last unique element
 
-  // Link the levels
-  for (size_t i = 0; i < n_levels - 1; i++) {
-    levels[i]->child_ptr = levels[i + 1];
+  // Fill the inner levels bottom up from the level below, and pad every level
+  for (size_t l = depth; l-- > 0;) {
+    int* level = tree->keys + tree->level_start[l];
+    if (l + 1 < depth) {
+      const int* below = tree->keys + tree->level_start[l + 1];
+      for (size_t j = 0; j < tree->level_keys[l]; j++) {
+        level[j] = below[j * BTREE_NODE_KEYS];
+      }
+    }
+    for (size_t j = tree->level_keys[l]; j < padded_keys(tree->level_keys[l]); j++) {
+      level[j] = INT_MAX;
+    }
   }
-
-  // Save the root and cleanup
-  Btree* root = levels[0];
-  free(levels);
-
-  return root;
+  return tree;
 }
 
 size_t lookup(int key, Btree* tree, int is_left) {
-  if (!tree || tree->n_keys == 0) return 0;  // Empty tree -> would start at 0
-
-  Btree* current = tree;
-  size_t pos = 0;
-
-  cs165_log(stdout, "lookup: looking up %d in Btree\n", key);
-  // Navigate to leaf level
-  while (current && current->child_ptr) {
-    if (pos < current->n_keys &&
-        (is_left ? key > current->keys[pos] : key >= current->keys[pos])) {
-      pos = binary_search_left(current->keys + pos, current->n_keys - pos, key);
-    }
+  if (!tree || tree->n_uniques == 0) return 0;  // Empty tree -> would start at 0
+  // A right lookup wants the values `<= key`, i.e. `< key + 1`
+  size_t rank = is_left           ? btree_rank_less(tree, key)
+                : key == INT_MAX ? tree->n_uniques
+                                 : btree_rank_less(tree, key + 1);
+  return rank_to_index(tree, rank, is_left);
+}
 
-    current = current->child_ptr;
-    pos = pos * current->fanout;
-  }
+// Descents advanced together by `lookup_batch`: enough to cover a cache miss per level
+#define BTREE_BATCH_WIDTH 16
 
-  // At leaf level, find position
-  cs165_log(stdout, "lookup: at leaf level, looking for key=%d, pos=%zu\n", key, pos);
-  pos = 0;
-  while (pos < current->n_keys &&
-         (is_left ? key > current->keys[pos] : key >= current->keys[pos])) {
-    pos++;
+void lookup_batch(const int* keys, size_t n, Btree* tree, int is_left, size_t* out) {
+  if (!tree || tree->n_uniques == 0) {
+    memset(out, 0, sizeof(size_t) * n);
+    return;
   }
-  cs165_log(stdout, "lookup: at leaf level, found key=%d, pos=%zu\n", key, pos);
+  for (size_t base = 0; base < n; base += BTREE_BATCH_WIDTH) {
+    size_t width = n - base < BTREE_BATCH_WIDTH ? n - base : BTREE_BATCH_WIDTH;
+    int probe[BTREE_BATCH_WIDTH];
+    size_t node[BTREE_BATCH_WIDTH], rank[BTREE_BATCH_WIDTH];
+    int done[BTREE_BATCH_WIDTH];
+    for (size_t i = 0; i < width; i++) {
+      int key = keys[base + i];
+      done[i] = !is_left && key == INT_MAX;
+      probe[i] = is_left || done[i] ? key : key + 1;
+      node[i] = 0;
+      rank[i] = done[i] ? tree->n_uniques : 0;
+    }
 
-  // If we're looking for leftmost (is_left true):
-  // - If key exists: return first occurrence index
-  // - If key doesn't exist: return index of the first element >= key
-  if (is_left) {
-    if (pos < current->n_keys && current->keys[pos] == key) {
-      cs165_log(stdout, "Left lookup: found key=%d at pos=%zu\n", key, pos);
-      log_info("returning first_unique_idxes[%zu] = %d\n", pos,
-               current->first_unique_idxes[pos]);
-      return current->first_unique_idxes[pos];
+    for (size_t l = 0; l < tree->n_levels; l++) {
+      const int* level = tree->keys + tree->level_start[l];
+      const int* next =
+          l + 1 < tree->n_levels ? tree->keys + tree->level_start[l + 1] : NULL;
+      for (size_t i = 0; i < width; i++) {
+        if (done[i]) continue;
+        rank[i] = node[i] * BTREE_NODE_KEYS +
+                  node_count_less(level + node[i] * BTREE_NODE_KEYS, probe[i]);
+        if (rank[i] == 0) {
+          done[i] = 1;
+          continue;
+        }
+        node[i] = rank[i] - 1;
+        if (next) __builtin_prefetch(next + node[i] * BTREE_NODE_KEYS);
+      }
     }
-    cs165_log(stdout, "Right lookup: found  key=%d at pos=%zu\n", key, pos);
-    cs165_log(stdout, "returning first_unique_idxes[%zu] = %d\n", pos,
-              pos > 0 ? current->first_unique_idxes[pos - 1] : 0);
-    return pos < current->n_keys ? current->first_unique_idxes[pos] : tree->n_keys;
-  }
-
-  // If we're looking for rightmost (is_left false):
-  // - If key exists: return last occurrence index
-  // - If key doesn't exist: return index of last element less than key
-  else {
-    if (pos < current->n_keys && current->keys[pos] == key) {
-      return current->last_unique_idxes[pos];
+    for (size_t i = 0; i < width; i++) {
+      out[base + i] = rank_to_index(tree, rank[i], is_left);
     }
-    return pos > 0 ? current->last_unique_idxes[pos - 1] : 0;
-  }
-}
-
-void print_tree_helper(Btree* tree) {
-  if (!tree) return;
-  log_info("Node:  [");
-  for (size_t i = 0; i < tree->n_keys; i++) {
-    log_info(" %d ", tree->keys[i]);
-  }
-  log_info("]\n");
-
-  if (tree->child_ptr) {
-    print_tree(tree->child_ptr);
   }
 }
 
 void print_tree(Btree* tree) {
   if (!tree) return;
-  print_tree_helper(tree);
+  for (size_t l = 0; l < tree->n_levels; l++) {
+    const int* level = tree->keys + tree->level_start[l];
+    log_info("Level %zu: [", l);
+    for (size_t j = 0; j < tree->level_keys[l]; j++) {
+      log_info("%s%d", j % BTREE_NODE_KEYS == 0 && j > 0 ? " | " : " ", level[j]);
+    }
+    log_info(" ]\n");
+  }
   // Print metadata
-  log_info("]\n");
   log_info("First occurence idxes: [");
   for (size_t i = 0; i < tree->n_uniques; i++) {
-    log_info(" %d ", tree->first_unique_idxes[i]);
+    log_info(" %zu ", tree->first_unique_idxes[i]);
   }
   log_info("]\n");
   log_info("Last occurence idxes: [");
   for (size_t i = 0; i < tree->n_uniques; i++) {
-    log_info(" %d ", tree->last_unique_idxes[i]);
+    log_info(" %zu ", tree->last_unique_idxes[i]);
   }
   log_info("]\n");
 }
 
-void free_btree_nodes(Btree* tree) {
+void free_btree(Btree* tree) {
   if (!tree) return;
-
-  if (tree->child_ptr) {
-    free_btree_nodes(tree->child_ptr);
+  if (!tree->is_mapped) {
+    free(tree->keys);
+    free(tree->first_unique_idxes);
+    free(tree->last_unique_idxes);
   }
-  free(tree->keys);
+  free(tree);
 }
 
-void free_btree(Btree* tree) {
+/*
+  Serialized layout (all 8-byte aligned):
+    uint64_t node_keys, n_uniques, n_levels
+    uint64_t level_keys[n_levels]
+    size_t   first_unique_idxes[n_uniques]
+    size_t   last_unique_idxes[n_uniques]
+    int      the node array: level 0 (root), then level 1, ..., each padded to whole nodes
+*/
+static size_t btree_n_keys(Btree* tree) {
+  return tree->level_start[tree->n_levels - 1] +
+         padded_keys(tree->level_keys[tree->n_levels - 1]);
+}
+
+size_t btree_serialized_size(Btree* tree) {
+  if (!tree) return 0;
+  return sizeof(uint64_t) * (3 + tree->n_levels) + 2 * sizeof(size_t) * tree->n_uniques +
+         sizeof(int) * btree_n_keys(tree);
+}
+
+void btree_serialize(Btree* tree, void* buf) {
   if (!tree) return;
-  free_btree_nodes(tree);
+  uint64_t* header = (uint64_t*)buf;
+  header[0] = BTREE_NODE_KEYS;
+  header[1] = tree->n_uniques;
+  header[2] = tree->n_levels;
+  for (size_t l = 0; l < tree->n_levels; l++) header[3 + l] = tree->level_keys[l];
 
-  free(tree->first_unique_idxes);
-  free(tree->last_unique_idxes);
-  free(tree);
+  char* cursor = (char*)(header + 3 + tree->n_levels);
+  memcpy(cursor, tree->first_unique_idxes, sizeof(size_t) * tree->n_uniques);
+  cursor += sizeof(size_t) * tree->n_uniques;
+  memcpy(cursor, tree->last_unique_idxes, sizeof(size_t) * tree->n_uniques);
+  cursor += sizeof(size_t) * tree->n_uniques;
+  memcpy(cursor, tree->keys, sizeof(int) * btree_n_keys(tree));
+}
+
+Btree* btree_deserialize(void* buf, size_t size) {
+  if (!buf || size < 3 * sizeof(uint64_t)) return NULL;
+  uint64_t* header = (uint64_t*)buf;
+  size_t n_uniques = header[1], n_levels = header[2];
+  // A tree written with another node width (or by the old level-per-array layout)
+  // is rebuilt rather than read
+  if (header[0] != BTREE_NODE_KEYS || n_levels == 0 || n_levels > BTREE_MAX_LEVELS ||
+      size < sizeof(uint64_t) * (3 + n_levels) ||
+      n_uniques > (size - sizeof(uint64_t) * (3 + n_levels)) / (2 * sizeof(size_t))) {
+    return NULL;
+  }
+
+  Btree* tree = calloc(1, sizeof(Btree));
+  if (!tree) return NULL;
+  tree->is_mapped = 1;
+  tree->n_uniques = n_uniques;
+  tree->n_levels = n_levels;
+  // Every level must have one key per node of the level below, down to the uniques
+  int valid = header[3] > 0 && header[3] <= BTREE_NODE_KEYS &&
+              header[3 + n_levels - 1] == n_uniques;
+  for (size_t l = 0; l < n_levels; l++) {
+    tree->level_keys[l] = header[3 + l];
+    if (l > 0) {
+      valid &= tree->level_keys[l - 1] == padded_keys(header[3 + l]) / BTREE_NODE_KEYS;
+    }
+  }
+  if (!valid) {
+    free_btree(tree);
+    return NULL;
+  }
+  size_t n_keys = layout_levels(tree);
+  if (size != sizeof(uint64_t) * (3 + n_levels) + 2 * sizeof(size_t) * n_uniques +
+                  sizeof(int) * n_keys) {
+    free_btree(tree);
+    return NULL;
+  }
+
+  char* cursor = (char*)(header + 3 + n_levels);
+  tree->first_unique_idxes = (size_t*)cursor;
+  tree->last_unique_idxes = tree->first_unique_idxes + n_uniques;
+  cursor += 2 * sizeof(size_t) * n_uniques;
+  tree->keys = (int*)cursor;
+  return tree;
 }
@@ -0,0 +1,139 @@
+#include "cracker.h"
+
+#include <limits.h>
+#include <stdlib.h>
+#include <string.h>
+
+Cracker* cracker_create(const int* values, size_t n) {
+  Cracker* cracker = calloc(1, sizeof(Cracker));
+  if (!cracker) return NULL;
+  // Keep at least one slot so an empty column still owns its arrays
+  size_t capacity = n ? n : 1;
+  cracker->values = malloc(sizeof(int) * capacity);
+  cracker->positions = malloc(sizeof(int) * capacity);
+  if (!cracker->values || !cracker->positions) {
+    cracker_destroy(cracker);
+    return NULL;
+  }
+  if (n > 0) memcpy(cracker->values, values, sizeof(int) * n);
+  for (size_t i = 0; i < n; i++) cracker->positions[i] = (int)i;
+  cracker->num_elements = n;
+  cracker->capacity = capacity;
+  return cracker;
+}
+
+void cracker_destroy(Cracker* cracker) {
+  if (!cracker) return;
+  free(cracker->values);
+  free(cracker->positions);
+  free(cracker->pivots);
+  free(cracker->offsets);
+  free(cracker);
+}
+
+// Index of the first crack whose pivot is greater than `value`
+static size_t first_crack_after(const Cracker* cracker, int value) {
+  size_t left = 0, right = cracker->num_cracks;
+  while (left < right) {
+    size_t mid = left + (right - left) / 2;
+    if (cracker->pivots[mid] <= value) {
+      left = mid + 1;
+    } else {
+      right = mid;
+    }
+  }
+  return left;
+}
+
+/**
+ * @brief Moves the values `< pivot` of `[start, end)` before the others and returns the
+ * split. Every value is swapped with the first value `>= pivot` whether or not it moves,
+ * so the loop never branches on the data: half the values of a fresh piece fall on
+ * either side, which would mispredict about every other branch.
+ */
+static size_t crack_in_two(Cracker* cracker, size_t start, size_t end, int pivot) {
+  int* values = cracker->values;
+  int* positions = cracker->positions;
+  size_t split = start;
+  for (size_t i = start; i < end; i++) {
+    int value = values[i];
+    int position = positions[i];
+    values[i] = values[split];
+    positions[i] = positions[split];
+    values[split] = value;
+    positions[split] = position;
+    split += value < pivot;
+  }
+  return split;
+}
+
+static int reserve_cracks(Cracker* cracker) {
+  if (cracker->num_cracks < cracker->cracks_capacity) return 0;
+  size_t capacity = cracker->cracks_capacity ? cracker->cracks_capacity * 2 : 64;
+  int* pivots = realloc(cracker->pivots, sizeof(int) * capacity);
+  if (pivots) cracker->pivots = pivots;
+  size_t* offsets = pivots ? realloc(cracker->offsets, sizeof(size_t) * capacity) : NULL;
+  if (!offsets) return -1;
+  cracker->offsets = offsets;
+  cracker->cracks_capacity = capacity;
+  return 0;
+}
+
+size_t cracker_crack(Cracker* cracker, int pivot) {
+  size_t k = first_crack_after(cracker, pivot);
+  if (k > 0 && cracker->pivots[k - 1] == pivot) return cracker->offsets[k - 1];
+
+  // the piece between the cracks around `pivot` is the only one it splits
+  size_t start = k > 0 ? cracker->offsets[k - 1] : 0;
+  size_t end = k < cracker->num_cracks ? cracker->offsets[k] : cracker->num_elements;
+  size_t split = crack_in_two(cracker, start, end, pivot);
+
+  // Without room to remember the crack the partition still holds; a later query just
+  // redoes it
+  if (reserve_cracks(cracker) != 0) return split;
+  memmove(cracker->pivots + k + 1, cracker->pivots + k,
+          sizeof(int) * (cracker->num_cracks - k));
+  memmove(cracker->offsets + k + 1, cracker->offsets + k,
+          sizeof(size_t) * (cracker->num_cracks - k));
+  cracker->pivots[k] = pivot;
+  cracker->offsets[k] = split;
+  cracker->num_cracks++;
+  return split;
+}
+
+void cracker_select(Cracker* cracker, int low, int high, size_t* start, size_t* end) {
+  if (low > high) {
+    *start = *end = 0;
+    return;
+  }
+  *start = low == INT_MIN ? 0 : cracker_crack(cracker, low);
+  *end = high == INT_MAX ? cracker->num_elements : cracker_crack(cracker, high + 1);
+}
+
+int cracker_insert(Cracker* cracker, int value, int row) {
+  if (cracker->num_elements == cracker->capacity) {
+    size_t capacity = cracker->capacity * 2;
+    int* values = realloc(cracker->values, sizeof(int) * capacity);
+    if (values) cracker->values = values;
+    int* positions = values ? realloc(cracker->positions, sizeof(int) * capacity) : NULL;
+    if (!positions) return -1;
+    cracker->positions = positions;
+    cracker->capacity = capacity;
+  }
+
+  // The free slot starts at the end of the last piece and moves down one piece per
+  // crack above `value`
+  size_t hole = cracker->num_elements;
+  size_t k = first_crack_after(cracker, value);
+  for (size_t c = cracker->num_cracks; c > k; c--) {
+    size_t first = cracker->offsets[c - 1];
+    cracker->values[hole] = cracker->values[first];
+    cracker->positions[hole] = cracker->positions[first];
+    cracker->offsets[c - 1] = first + 1;
+    hole = first;
+  }
+  cracker->values[hole] = value;
+  cracker->positions[hole] = row;
+  cracker->num_elements++;
+  return 0;
+}
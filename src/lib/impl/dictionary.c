@@ -0,0 +1,150 @@
+#include "dictionary.h"
+
+#include <limits.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+/**
+ * @brief Open-addressing table of the distinct values of a column being encoded, with
+ * room for `max_values` of them at a load factor of at most 1/2. Once the values are
+ * sorted, each slot also gets the code of its value.
+ */
+typedef struct {
+  int* keys;
+  int* codes;
+  unsigned char* used;
+  unsigned int shift;  // 64 - log2 of the number of slots
+  size_t mask;
+  size_t size;
+} ValueTable;
+
+static inline size_t value_slot(const ValueTable* table, int value) {
+  uint64_t hash = (uint64_t)(uint32_t)value * 0x9E3779B97F4A7C15ULL;
+  size_t slot = (size_t)(hash >> table->shift);
+  while (table->used[slot] && table->keys[slot] != value) {
+    slot = (slot + 1) & table->mask;
+  }
+  return slot;
+}
+
+static int value_table_init(ValueTable* table, size_t max_values) {
+  size_t n_slots = 2;
+  unsigned int log_slots = 1;
+  while (n_slots < 2 * max_values) {
+    n_slots *= 2;
+    log_slots++;
+  }
+  table->shift = 64 - log_slots;
+  table->mask = n_slots - 1;
+  table->size = 0;
+  table->keys = malloc(sizeof(int) * n_slots);
+  table->codes = malloc(sizeof(int) * n_slots);
+  table->used = calloc(n_slots, 1);
+  return table->keys && table->codes && table->used ? 0 : -1;
+}
+
+static void value_table_free(ValueTable* table) {
+  free(table->keys);
+  free(table->codes);
+  free(table->used);
+}
+
+static int compare_ints(const void* a, const void* b) {
+  int x = *(const int*)a, y = *(const int*)b;
+  return (x > y) - (x < y);
+}
+
+// Number of values of the dictionary below `value`
+static size_t lower_bound(const Dictionary* dict, int value) {
+  size_t left = 0, right = dict->num_values;
+  while (left < right) {
+    size_t mid = left + (right - left) / 2;
+    if (dict->values[mid] < value) {
+      left = mid + 1;
+    } else {
+      right = mid;
+    }
+  }
+  return left;
+}
+
+/**
+ * @brief Fills the table with the distinct values of `values`.
+ *
+ * @return 0 on success, -1 if there are more than `max_values`
+ */
+static int collect_values(ValueTable* table, const int* values, size_t n,
+                          size_t max_values) {
+  for (size_t i = 0; i < n; i++) {
+    size_t slot = value_slot(table, values[i]);
+    if (table->used[slot]) continue;
+    if (++table->size > max_values) return -1;
+    table->used[slot] = 1;
+    table->keys[slot] = values[i];
+  }
+  return 0;
+}
+
+// Sorts the collected values into the dictionary and packs the code of every row
+static int encode_values(ValueTable* table, Dictionary* dict, const int* values,
+                         size_t n) {
+  dict->values = malloc(sizeof(int) * (table->size ? table->size : 1));
+  if (!dict->values) return -1;
+  for (size_t slot = 0; slot <= table->mask; slot++) {
+    if (table->used[slot]) dict->values[dict->num_values++] = table->keys[slot];
+  }
+  qsort(dict->values, dict->num_values, sizeof(int), compare_ints);
+  for (size_t code = 0; code < dict->num_values; code++) {
+    table->codes[value_slot(table, dict->values[code])] = (int)code;
+  }
+
+  long max_code = dict->num_values ? (long)dict->num_values - 1 : 0;
+  dict->codes = packed_create(NULL, 0, 0, packed_bits_for(0, max_code));
+  if (!dict->codes) return -1;
+  for (size_t i = 0; i < n; i++) {
+    if (packed_append(dict->codes, table->codes[value_slot(table, values[i])]) != 0) {
+      return -1;
+    }
+  }
+  return 0;
+}
+
+Dictionary* dictionary_create(const int* values, size_t n, size_t max_values) {
+  if (max_values > (1UL << PACKED_MAX_BITS)) max_values = 1UL << PACKED_MAX_BITS;
+  ValueTable table;
+  Dictionary* dict = NULL;
+  if (value_table_init(&table, max_values) == 0 &&
+      collect_values(&table, values, n, max_values) == 0) {
+    dict = calloc(1, sizeof(Dictionary));
+    if (dict && encode_values(&table, dict, values, n) != 0) {
+      dictionary_destroy(dict);
+      dict = NULL;
+    }
+  }
+  value_table_free(&table);
+  return dict;
+}
+
+void dictionary_destroy(Dictionary* dict) {
+  if (!dict) return;
+  free(dict->values);
+  packed_destroy(dict->codes);
+  free(dict);
+}
+
+int dictionary_code_range(const Dictionary* dict, int low, int high, int* lo, int* hi) {
+  if (low > high) return 0;
+  size_t from = lower_bound(dict, low);
+  // codes up to the last value <= high
+  size_t to = high == INT_MAX ? dict->num_values : lower_bound(dict, high + 1);
+  if (from >= to) return 0;
+  *lo = (int)from;
+  *hi = (int)(to - 1);
+  return 1;
+}
+
+int dictionary_append(Dictionary* dict, int value) {
+  size_t code = lower_bound(dict, value);
+  if (code == dict->num_values || dict->values[code] != value) return -1;
+  return packed_append(dict->codes, (int)code);
+}
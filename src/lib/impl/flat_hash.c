@@ -0,0 +1,226 @@
+#include "flat_hash.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#define GROUP_WIDTH 16  // control bytes compared per probe step
+#define CTRL_EMPTY 0x80
+
+// Upper bits of a 64-bit multiplicative hash: `h >> 57` is the tag, the 32 bits
+// below it pick the starting slot
+static inline uint64_t flat_hash(int key) {
+  return (uint64_t)(uint32_t)key * 0x9e3779b97f4a7c15ULL;
+}
+
+static inline uint8_t hash_tag(uint64_t h) { return (uint8_t)(h >> 57); }
+
+static inline size_t hash_start(uint64_t h, size_t mask) {
+  return (size_t)(h >> 25) & mask;
+}
+
+// Bit i set if control byte i of the group equals `byte`
+static inline uint32_t match_byte(const uint8_t* group, uint8_t byte) {
+#ifdef __SSE2__
+  __m128i ctrl = _mm_loadu_si128((const __m128i*)group);
+  return (uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(ctrl, _mm_set1_epi8((char)byte)));
+#else
+  uint32_t mask = 0;
+  for (int i = 0; i < GROUP_WIDTH; i++) mask |= (uint32_t)(group[i] == byte) << i;
+  return mask;
+#endif
+}
+
+static inline void set_ctrl(FlatHashTable* ht, size_t slot, uint8_t byte) {
+  ht->ctrl[slot] = byte;
+  // the first GROUP_WIDTH bytes are mirrored past the end so a group never wraps
+  if (slot < GROUP_WIDTH) ht->ctrl[ht->n_slots + slot] = byte;
+}
+
+/**
+ * @brief Slot holding `key`, or the empty slot where it would be inserted; `*found`
+ * tells which.
+ */
+static size_t probe_slot(const FlatHashTable* ht, int key, int* found) {
+  uint64_t h = flat_hash(key);
+  uint8_t tag = hash_tag(h);
+  size_t mask = ht->n_slots - 1;
+  size_t pos = hash_start(h, mask);
+  while (1) {
+    const uint8_t* group = ht->ctrl + pos;
+    uint32_t hits = match_byte(group, tag);
+    while (hits) {
+      size_t slot = (pos + __builtin_ctz(hits)) & mask;
+      if (ht->slot_keys[slot] == key) {
+        *found = 1;
+        return slot;
+      }
+      hits &= hits - 1;
+    }
+    uint32_t empties = match_byte(group, CTRL_EMPTY);
+    if (empties) {
+      *found = 0;
+      return (pos + __builtin_ctz(empties)) & mask;
+    }
+    pos = (pos + GROUP_WIDTH) & mask;
+  }
+}
+
+// Slots for `n` keys: at most 7/8 full even if every key is distinct
+static size_t slots_for(size_t n) {
+  size_t n_slots = GROUP_WIDTH;
+  while (n_slots - n_slots / 8 < n) n_slots <<= 1;
+  return n_slots;
+}
+
+// Bytes of the arena block a table over `n` pairs lives in
+static size_t table_footprint(size_t n) {
+  size_t n_slots = slots_for(n);
+  return sizeof(FlatHashTable) + n_slots + GROUP_WIDTH +
+         n_slots * (sizeof(int32_t) + sizeof(uint32_t)) +
+         (n + 1) * (sizeof(int) + sizeof(uint32_t)) + n * sizeof(int);
+}
+
+size_t flat_ht_build_bytes(size_t n) {
+  // group_of, first_keys and counts live until the build returns
+  return table_footprint(n) + 8 * 64 + (3 * n + 1) * sizeof(uint32_t);
+}
+
+FlatHashTable* flat_ht_build(const int* keys, const int* values, size_t n, size_t stride) {
+  if (stride == 0) stride = 1;
+  size_t n_slots = slots_for(n);
+
+  // size the arena so the whole table lands in a single block
+  size_t footprint = table_footprint(n);
+  Arena* arena = arena_create(footprint + 8 * 64);  // slack for alignment padding
+  FlatHashTable* ht = arena ? arena_alloc(arena, sizeof(FlatHashTable), 8) : NULL;
+  if (!ht) {
+    arena_destroy(arena);
+    return NULL;
+  }
+  ht->arena = arena;
+  ht->n_slots = n_slots;
+  ht->ctrl = arena_alloc(arena, ht->n_slots + GROUP_WIDTH, 64);
+  ht->slot_keys = arena_alloc(arena, sizeof(int32_t) * ht->n_slots, 64);
+  ht->slot_groups = arena_alloc(arena, sizeof(uint32_t) * ht->n_slots, 64);
+  uint32_t* group_of = malloc(sizeof(uint32_t) * (n ? n : 1));  // group of each pair
+  int* first_keys = malloc(sizeof(int) * (n ? n : 1));
+  uint32_t* counts = calloc(n + 1, sizeof(uint32_t));
+  if (!ht->ctrl || !ht->slot_keys || !ht->slot_groups || !group_of || !first_keys ||
+      !counts) {
+    free(group_of);
+    free(first_keys);
+    free(counts);
+    arena_destroy(arena);
+    return NULL;
+  }
+  memset(ht->ctrl, CTRL_EMPTY, ht->n_slots + GROUP_WIDTH);
+
+  // Pass 1: find or insert every key and count its values
+  size_t n_groups = 0;
+  for (size_t i = 0; i < n; i++) {
+    int key = keys[i * stride];
+    int found;
+    size_t slot = probe_slot(ht, key, &found);
+    if (!found) {
+      set_ctrl(ht, slot, hash_tag(flat_hash(key)));
+      ht->slot_keys[slot] = key;
+      ht->slot_groups[slot] = (uint32_t)n_groups;
+      first_keys[n_groups++] = key;
+    }
+    group_of[i] = ht->slot_groups[slot];
+    counts[group_of[i]]++;
+  }
+
+  // Pass 2: lay the groups out back to back and scatter the values into place
+  ht->n_groups = n_groups;
+  ht->n_values = n;
+  ht->group_keys = arena_alloc(arena, sizeof(int) * (n_groups ? n_groups : 1), 64);
+  ht->group_starts = arena_alloc(arena, sizeof(uint32_t) * (n_groups + 1), 64);
+  ht->values = arena_alloc(arena, sizeof(int) * (n ? n : 1), 64);
+  if (!ht->group_keys || !ht->group_starts || !ht->values) {
+    free(group_of);
+    free(first_keys);
+    free(counts);
+    arena_destroy(arena);
+    return NULL;
+  }
+  memcpy(ht->group_keys, first_keys, sizeof(int) * n_groups);
+  uint32_t offset = 0;
+  for (size_t g = 0; g < n_groups; g++) {
+    ht->group_starts[g] = offset;
+    offset += counts[g];
+    counts[g] = ht->group_starts[g];  // reuse as the group's write cursor
+  }
+  ht->group_starts[n_groups] = offset;
+  for (size_t i = 0; i < n; i++) ht->values[counts[group_of[i]]++] = values[i * stride];
+
+  free(group_of);
+  free(first_keys);
+  free(counts);
+  return ht;
+}
+
+void flat_ht_destroy(FlatHashTable* ht) {
+  if (ht) arena_destroy(ht->arena);  // the table itself lives in its arena
+}
+
+long flat_ht_find(const FlatHashTable* ht, int key) {
+  if (!ht) return -1;
+  int found;
+  size_t slot = probe_slot(ht, key, &found);
+  return found ? (long)ht->slot_groups[slot] : -1;
+}
+
+const int* flat_ht_get(const FlatHashTable* ht, int key, size_t* count) {
+  long group = flat_ht_find(ht, key);
+  if (group < 0) {
+    *count = 0;
+    return NULL;
+  }
+  *count = ht->group_starts[group + 1] - ht->group_starts[group];
+  return ht->values + ht->group_starts[group];
+}
+
+int match_buffer_push(MatchBuffer* buf, int left, int right) {
+  if (buf->size == buf->capacity) {
+    size_t new_capacity = buf->capacity ? buf->capacity * 2 : 1024;
+    int* grown_left = realloc(buf->left, sizeof(int) * new_capacity);
+    if (!grown_left) return -1;
+    buf->left = grown_left;
+    int* grown_right = realloc(buf->right, sizeof(int) * new_capacity);
+    if (!grown_right) return -1;
+    buf->right = grown_right;
+    buf->capacity = new_capacity;
+  }
+  buf->left[buf->size] = left;
+  buf->right[buf->size] = right;
+  buf->size++;
+  return 0;
+}
+
+void match_buffer_free(MatchBuffer* buf) {
+  free(buf->left);
+  free(buf->right);
+  buf->left = buf->right = NULL;
+  buf->size = buf->capacity = 0;
+}
+
+int flat_ht_probe(const FlatHashTable* ht, const int* keys, const int* payloads, size_t n,
+                  size_t stride, int values_left, MatchBuffer* out) {
+  if (stride == 0) stride = 1;
+  for (size_t i = 0; i < n; i++) {
+    size_t count;
+    const int* matches = flat_ht_get(ht, keys[i * stride], &count);
+    int payload = payloads[i * stride];
+    for (size_t m = 0; m < count; m++) {
+      int status = values_left ? match_buffer_push(out, matches[m], payload)
+                               : match_buffer_push(out, payload, matches[m]);
+      if (status != 0) return -1;
+    }
+  }
+  return 0;
+}
@@ -1 +1,139 @@
-void placeholder_mempool_c(void) {}
+#define _GNU_SOURCE  // MAP_ANONYMOUS, MADV_HUGEPAGE
+#include "mempool.h"
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <sys/mman.h>
+
+#define DEFAULT_ARENA_BLOCK_SIZE (1 << 20)
+#define OVERSIZED_CLASS (-1)
+
+struct ArenaBlock {
+  ArenaBlock* next;
+  size_t capacity;
+  size_t used;
+  size_t mapped_size;  // bytes mmap'd for the slab, 0 if it came from malloc
+  int size_class;      // OVERSIZED_CLASS for a slab made for one request
+  unsigned char data[];  // aligned per request in arena_alloc
+};
+
+static ArenaBlock* arena_new_block(size_t capacity, int size_class) {
+  ArenaBlock* block;
+  size_t mapped_size = 0;
+  if (capacity >= ARENA_HUGE_PAGE_SIZE) {
+    // Over-map by one huge page and trim, so the slab starts on a huge-page boundary
+    size_t huge = ARENA_HUGE_PAGE_SIZE;
+    mapped_size = (sizeof(ArenaBlock) + capacity + huge - 1) & ~(huge - 1);
+    unsigned char* raw = mmap(NULL, mapped_size + huge, PROT_READ | PROT_WRITE,
+                              MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (raw == MAP_FAILED) return NULL;
+    size_t lead = (huge - (uintptr_t)raw % huge) % huge;
+    if (lead) munmap(raw, lead);
+    munmap(raw + lead + mapped_size, huge - lead);
+    block = (ArenaBlock*)(raw + lead);
+#ifdef MADV_HUGEPAGE
+    madvise(block, mapped_size, MADV_HUGEPAGE);
+#endif
+    capacity = mapped_size - sizeof(ArenaBlock);
+  } else {
+    block = malloc(sizeof(ArenaBlock) + capacity);
+    if (!block) return NULL;
+  }
+  block->next = NULL;
+  block->capacity = capacity;
+  block->used = 0;
+  block->mapped_size = mapped_size;
+  block->size_class = size_class;
+  return block;
+}
+
+static void arena_free_block(ArenaBlock* block) {
+  if (block->mapped_size) {
+    munmap(block, block->mapped_size);
+  } else {
+    free(block);
+  }
+}
+
+Arena* arena_create(size_t block_size) {
+  Arena* arena = calloc(1, sizeof(Arena));
+  if (!arena) return NULL;
+  arena->block_size = block_size ? block_size : DEFAULT_ARENA_BLOCK_SIZE;
+  return arena;
+}
+
+// Bump-allocates from `block`, or returns NULL if the request does not fit
+static void* block_alloc(ArenaBlock* block, size_t size, size_t alignment) {
+  uintptr_t base = (uintptr_t)block->data;
+  size_t offset =
+      ((base + block->used + alignment - 1) & ~(uintptr_t)(alignment - 1)) - base;
+  if (offset + size > block->capacity) return NULL;
+  block->used = offset + size;
+  return (char*)block->data + offset;
+}
+
+void* arena_alloc(Arena* arena, size_t size, size_t alignment) {
+  if (!arena) return NULL;
+  if (alignment == 0) alignment = 1;
+
+  void* ptr = arena->head ? block_alloc(arena->head, size, alignment) : NULL;
+  if (!ptr) {
+    // Take the smallest class that holds the request: a cached slab if there is one
+    size_t needed = size + alignment;
+    int size_class = 0;
+    while (size_class < ARENA_NUM_CLASSES &&
+           (arena->block_size << size_class) < needed) {
+      size_class++;
+    }
+    ArenaBlock* block = NULL;
+    if (size_class == ARENA_NUM_CLASSES) {
+      block = arena_new_block(needed, OVERSIZED_CLASS);
+    } else if (arena->free_slabs[size_class]) {
+      block = arena->free_slabs[size_class];
+      arena->free_slabs[size_class] = block->next;
+      arena->bytes_cached -= block->capacity;
+    } else {
+      block = arena_new_block(arena->block_size << size_class, size_class);
+    }
+    if (!block) return NULL;
+    block->next = arena->head;
+    arena->head = block;
+    ptr = block_alloc(block, size, alignment);
+  }
+  arena->bytes_allocated += size;
+  return ptr;
+}
+
+void arena_reset(Arena* arena) {
+  if (!arena) return;
+  ArenaBlock* block = arena->head;
+  while (block) {
+    ArenaBlock* next = block->next;
+    if (block->size_class == OVERSIZED_CLASS ||
+        arena->bytes_cached + block->capacity > ARENA_MAX_CACHED_BYTES) {
+      arena_free_block(block);
+    } else {
+      block->used = 0;
+      block->next = arena->free_slabs[block->size_class];
+      arena->free_slabs[block->size_class] = block;
+      arena->bytes_cached += block->capacity;
+    }
+    block = next;
+  }
+  arena->head = NULL;
+  arena->bytes_allocated = 0;
+}
+
+void arena_destroy(Arena* arena) {
+  if (!arena) return;
+  arena_reset(arena);
+  for (int c = 0; c < ARENA_NUM_CLASSES; c++) {
+    ArenaBlock* block = arena->free_slabs[c];
+    while (block) {
+      ArenaBlock* next = block->next;
+      arena_free_block(block);
+      block = next;
+    }
+  }
+  free(arena);
+}
@@ -0,0 +1,164 @@
+#include "rle.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+RunLengths* rle_create(const int* values, size_t n, size_t max_runs) {
+  size_t num_runs = n > 0;
+  for (size_t i = 1; i < n && num_runs <= max_runs; i++) {
+    num_runs += values[i] != values[i - 1];
+  }
+  if (num_runs > max_runs) return NULL;
+
+  RunLengths* rle = calloc(1, sizeof(RunLengths));
+  if (!rle) return NULL;
+  rle->capacity = num_runs ? num_runs : 1;
+  rle->values = malloc(sizeof(int) * rle->capacity);
+  rle->ends = malloc(sizeof(size_t) * rle->capacity);
+  if (!rle->values || !rle->ends) {
+    rle_destroy(rle);
+    return NULL;
+  }
+  for (size_t i = 0; i < n; i++) {
+    if (i == 0 || values[i] != values[i - 1]) {
+      rle->values[rle->num_runs++] = values[i];
+    }
+    rle->ends[rle->num_runs - 1] = i + 1;
+  }
+  return rle;
+}
+
+void rle_destroy(RunLengths* rle) {
+  if (!rle) return;
+  free(rle->values);
+  free(rle->ends);
+  free(rle);
+}
+
+int rle_append(RunLengths* rle, int value) {
+  size_t row = rle_num_rows(rle);
+  if (rle->num_runs && rle->values[rle->num_runs - 1] == value) {
+    rle->ends[rle->num_runs - 1] = row + 1;
+    return 0;
+  }
+  if (rle->num_runs == rle->capacity) {
+    size_t capacity = rle->capacity * 2;
+    int* values = realloc(rle->values, sizeof(int) * capacity);
+    if (!values) return -1;
+    rle->values = values;
+    size_t* ends = realloc(rle->ends, sizeof(size_t) * capacity);
+    if (!ends) return -1;
+    rle->ends = ends;
+    rle->capacity = capacity;
+  }
+  rle->values[rle->num_runs] = value;
+  rle->ends[rle->num_runs++] = row + 1;
+  return 0;
+}
+
+size_t rle_find(const RunLengths* rle, size_t row) {
+  size_t left = 0, right = rle->num_runs;
+  while (left < right) {
+    size_t mid = left + (right - left) / 2;
+    if (rle->ends[mid] <= row) {
+      left = mid + 1;
+    } else {
+      right = mid;
+    }
+  }
+  return left;
+}
+
+size_t rle_select_ranges(const RunLengths* rle, size_t start, size_t end, int low,
+                         int high, size_t* starts, size_t* ends) {
+  if (start >= end) return 0;
+  size_t n_ranges = 0;
+  for (size_t r = rle_find(rle, start); r < rle->num_runs; r++) {
+    size_t run_start = r ? rle->ends[r - 1] : 0;
+    if (run_start >= end) break;
+    if (rle->values[r] < low || rle->values[r] > high) continue;
+    size_t from = run_start > start ? run_start : start;
+    size_t to = rle->ends[r] < end ? rle->ends[r] : end;
+    if (n_ranges && ends[n_ranges - 1] == from) {
+      ends[n_ranges - 1] = to;
+    } else {
+      starts[n_ranges] = from;
+      ends[n_ranges++] = to;
+    }
+  }
+  return n_ranges;
+}
+
+size_t rle_scan_range(const RunLengths* rle, size_t start, size_t end, int low, int high,
+                      int* out) {
+  if (start >= end) return 0;
+  size_t count = 0;
+  for (size_t r = rle_find(rle, start); r < rle->num_runs; r++) {
+    size_t run_start = r ? rle->ends[r - 1] : 0;
+    if (run_start >= end) break;
+    if (rle->values[r] < low || rle->values[r] > high) continue;
+    size_t to = rle->ends[r] < end ? rle->ends[r] : end;
+    for (size_t row = run_start > start ? run_start : start; row < to; row++) {
+      out[count++] = (int)row;
+    }
+  }
+  return count;
+}
+
+// Sets bits `[from, to)` of `words`
+static void set_bits(uint64_t* words, size_t from, size_t to) {
+  size_t first = from / 64, last = (to - 1) / 64;
+  uint64_t head = ~0ULL << (from % 64);
+  uint64_t tail = ~0ULL >> (63 - (to - 1) % 64);
+  if (first == last) {
+    words[first] |= head & tail;
+    return;
+  }
+  words[first] |= head;
+  for (size_t w = first + 1; w < last; w++) words[w] = ~0ULL;
+  words[last] |= tail;
+}
+
+size_t rle_scan_range_bits(const RunLengths* rle, size_t start, size_t end, int low,
+                           int high, uint64_t* words) {
+  if (start >= end) return 0;
+  memset(words + start / 64, 0, sizeof(uint64_t) * ((end + 63) / 64 - start / 64));
+  size_t count = 0;
+  for (size_t r = rle_find(rle, start); r < rle->num_runs; r++) {
+    size_t run_start = r ? rle->ends[r - 1] : 0;
+    if (run_start >= end) break;
+    if (rle->values[r] < low || rle->values[r] > high) continue;
+    size_t from = run_start > start ? run_start : start;
+    size_t to = rle->ends[r] < end ? rle->ends[r] : end;
+    set_bits(words, from, to);
+    count += to - from;
+  }
+  return count;
+}
+
+void rle_range_stats(const RunLengths* rle, size_t start, size_t end, int64_t* sum,
+                     long* min, long* max) {
+  if (start >= end) return;
+  for (size_t r = rle_find(rle, start); r < rle->num_runs; r++) {
+    size_t run_start = r ? rle->ends[r - 1] : 0;
+    if (run_start >= end) break;
+    size_t from = run_start > start ? run_start : start;
+    size_t to = rle->ends[r] < end ? rle->ends[r] : end;
+    *sum += (int64_t)rle->values[r] * (int64_t)(to - from);
+    if (rle->values[r] < *min) *min = rle->values[r];
+    if (rle->values[r] > *max) *max = rle->values[r];
+  }
+}
+
+void rle_decode(const RunLengths* rle, size_t start, size_t end, int* out) {
+  if (start >= end) return;
+  for (size_t r = rle_find(rle, start); r < rle->num_runs; r++) {
+    size_t run_start = r ? rle->ends[r - 1] : 0;
+    if (run_start >= end) break;
+    size_t to = rle->ends[r] < end ? rle->ends[r] : end;
+    int value = rle->values[r];
+    for (size_t row = run_start > start ? run_start : start; row < to; row++) {
+      out[row - start] = value;
+    }
+  }
+}
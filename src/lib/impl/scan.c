@@ -0,0 +1,270 @@
+#include "scan.h"
+
+#include <pthread.h>
+#include <stdint.h>
+
+#include "utils.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define SCAN_HAS_X86 1
+#endif
+
+typedef size_t (*scan_fn)(const int*, size_t, size_t, int, int, const int*, int*);
+typedef size_t (*scan_bits_fn)(const int*, size_t, size_t, int, int, uint64_t*);
+
+/**
+ * @brief Branch-free scalar kernel; also handles the tail of the SIMD kernels.
+ * `(unsigned)(v - low) <= (unsigned)(high - low)` is the usual single-compare range
+ * check: values below `low` wrap around to large unsigned numbers.
+ */
+static size_t scan_range_scalar(const int* data, size_t start, size_t end, int low,
+                                int high, const int* ref_posns, int* out) {
+  const unsigned int width = (unsigned int)high - (unsigned int)low;
+  size_t count = 0;
+  if (ref_posns) {
+    for (size_t i = start; i < end; i++) {
+      out[count] = ref_posns[i];
+      count += ((unsigned int)data[i] - (unsigned int)low) <= width;
+    }
+  } else {
+    for (size_t i = start; i < end; i++) {
+      out[count] = (int)i;
+      count += ((unsigned int)data[i] - (unsigned int)low) <= width;
+    }
+  }
+  return count;
+}
+
+// Scalar bitmap kernel; builds each word from 64 single-compare range checks
+static size_t scan_bits_scalar(const int* data, size_t start, size_t end, int low,
+                               int high, uint64_t* words) {
+  const unsigned int width = (unsigned int)high - (unsigned int)low;
+  size_t count = 0;
+  for (size_t base = start; base < end; base += 64) {
+    size_t n = end - base < 64 ? end - base : 64;
+    uint64_t word = 0;
+    for (size_t j = 0; j < n; j++) {
+      uint64_t match = ((unsigned int)data[base + j] - (unsigned int)low) <= width;
+      word |= match << j;
+    }
+    words[base / 64] = word;
+    count += __builtin_popcountll(word);
+  }
+  return count;
+}
+
+#ifdef SCAN_HAS_X86
+
+// compaction tables: entry `m` moves the lanes whose bit is set in `m` to the front
+static uint8_t sse_compact_lut[16][16] __attribute__((aligned(16)));
+static int32_t avx2_compact_lut[256][8] __attribute__((aligned(32)));
+
+static void init_compact_luts(void) {
+  for (int mask = 0; mask < 16; mask++) {
+    int k = 0;
+    for (int lane = 0; lane < 4; lane++) {
+      if (!(mask & (1 << lane))) continue;
+      for (int b = 0; b < 4; b++) sse_compact_lut[mask][k * 4 + b] = lane * 4 + b;
+      k++;
+    }
+    for (; k < 4; k++) {
+      for (int b = 0; b < 4; b++) sse_compact_lut[mask][k * 4 + b] = 0x80;
+    }
+  }
+  for (int mask = 0; mask < 256; mask++) {
+    int k = 0;
+    for (int lane = 0; lane < 8; lane++) {
+      if (mask & (1 << lane)) avx2_compact_lut[mask][k++] = lane;
+    }
+    for (; k < 8; k++) avx2_compact_lut[mask][k] = 0;
+  }
+}
+
+__attribute__((target("sse4.2,popcnt"))) static size_t scan_range_sse42(
+    const int* data, size_t start, size_t end, int low, int high, const int* ref_posns,
+    int* out) {
+  const __m128i lo = _mm_set1_epi32(low);
+  const __m128i hi = _mm_set1_epi32(high);
+  const __m128i step = _mm_set1_epi32(4);
+  __m128i idx = _mm_setr_epi32((int)start, (int)start + 1, (int)start + 2, (int)start + 3);
+  size_t count = 0;
+  size_t i = start;
+
+  for (; i + 4 <= end; i += 4) {
+    __m128i v = _mm_loadu_si128((const __m128i*)(data + i));
+    __m128i miss = _mm_or_si128(_mm_cmpgt_epi32(lo, v), _mm_cmpgt_epi32(v, hi));
+    unsigned int mask = ~(unsigned int)_mm_movemask_ps(_mm_castsi128_ps(miss)) & 0xF;
+    __m128i pos = ref_posns ? _mm_loadu_si128((const __m128i*)(ref_posns + i)) : idx;
+    __m128i shuf = _mm_load_si128((const __m128i*)sse_compact_lut[mask]);
+    _mm_storeu_si128((__m128i*)(out + count), _mm_shuffle_epi8(pos, shuf));
+    count += __builtin_popcount(mask);
+    idx = _mm_add_epi32(idx, step);
+  }
+  return count + scan_range_scalar(data, i, end, low, high, ref_posns, out + count);
+}
+
+__attribute__((target("avx2,popcnt"))) static size_t scan_range_avx2(
+    const int* data, size_t start, size_t end, int low, int high, const int* ref_posns,
+    int* out) {
+  const __m256i lo = _mm256_set1_epi32(low);
+  const __m256i hi = _mm256_set1_epi32(high);
+  const __m256i step = _mm256_set1_epi32(8);
+  __m256i idx = _mm256_add_epi32(_mm256_set1_epi32((int)start),
+                                 _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7));
+  size_t count = 0;
+  size_t i = start;
+
+  for (; i + 8 <= end; i += 8) {
+    __m256i v = _mm256_loadu_si256((const __m256i*)(data + i));
+    __m256i miss = _mm256_or_si256(_mm256_cmpgt_epi32(lo, v), _mm256_cmpgt_epi32(v, hi));
+    unsigned int mask = ~(unsigned int)_mm256_movemask_ps(_mm256_castsi256_ps(miss)) & 0xFF;
+    __m256i pos =
+        ref_posns ? _mm256_loadu_si256((const __m256i*)(ref_posns + i)) : idx;
+    __m256i perm = _mm256_load_si256((const __m256i*)avx2_compact_lut[mask]);
+    _mm256_storeu_si256((__m256i*)(out + count), _mm256_permutevar8x32_epi32(pos, perm));
+    count += __builtin_popcount(mask);
+    idx = _mm256_add_epi32(idx, step);
+  }
+  return count + scan_range_scalar(data, i, end, low, high, ref_posns, out + count);
+}
+
+// The bitmap kernels need no compaction: the comparison mask of each vector already
+// is the next few bits of the word
+__attribute__((target("sse4.2,popcnt"))) static size_t scan_bits_sse42(
+    const int* data, size_t start, size_t end, int low, int high, uint64_t* words) {
+  const __m128i lo = _mm_set1_epi32(low);
+  const __m128i hi = _mm_set1_epi32(high);
+  size_t count = 0;
+  size_t base = start;
+
+  for (; base + 64 <= end; base += 64) {
+    uint64_t word = 0;
+    for (int k = 0; k < 16; k++) {
+      __m128i v = _mm_loadu_si128((const __m128i*)(data + base + k * 4));
+      __m128i miss = _mm_or_si128(_mm_cmpgt_epi32(lo, v), _mm_cmpgt_epi32(v, hi));
+      uint64_t mask = ~(unsigned int)_mm_movemask_ps(_mm_castsi128_ps(miss)) & 0xF;
+      word |= mask << (k * 4);
+    }
+    words[base / 64] = word;
+    count += __builtin_popcountll(word);
+  }
+  return count + scan_bits_scalar(data, base, end, low, high, words);
+}
+
+__attribute__((target("avx2,popcnt"))) static size_t scan_bits_avx2(
+    const int* data, size_t start, size_t end, int low, int high, uint64_t* words) {
+  const __m256i lo = _mm256_set1_epi32(low);
+  const __m256i hi = _mm256_set1_epi32(high);
+  size_t count = 0;
+  size_t base = start;
+
+  for (; base + 64 <= end; base += 64) {
+    uint64_t word = 0;
+    for (int k = 0; k < 8; k++) {
+      __m256i v = _mm256_loadu_si256((const __m256i*)(data + base + k * 8));
+      __m256i miss =
+          _mm256_or_si256(_mm256_cmpgt_epi32(lo, v), _mm256_cmpgt_epi32(v, hi));
+      uint64_t mask = ~(unsigned int)_mm256_movemask_ps(_mm256_castsi256_ps(miss)) & 0xFF;
+      word |= mask << (k * 8);
+    }
+    words[base / 64] = word;
+    count += __builtin_popcountll(word);
+  }
+  return count + scan_bits_scalar(data, base, end, low, high, words);
+}
+
+#endif  // SCAN_HAS_X86
+
+static ScanKernelType best_kernel = SCAN_SCALAR;
+static pthread_once_t scan_init_once = PTHREAD_ONCE_INIT;
+
+static void scan_init(void) {
+#ifdef SCAN_HAS_X86
+  __builtin_cpu_init();
+  init_compact_luts();
+  if (__builtin_cpu_supports("avx2")) {
+    best_kernel = SCAN_AVX2;
+  } else if (__builtin_cpu_supports("sse4.2")) {
+    best_kernel = SCAN_SSE42;
+  }
+#endif
+  log_info("scan: using %s range-select kernel\n", scan_kernel_name(best_kernel));
+}
+
+static scan_fn kernel_fn(ScanKernelType type) {
+  switch (type) {
+#ifdef SCAN_HAS_X86
+    case SCAN_AVX2:
+      return scan_range_avx2;
+    case SCAN_SSE42:
+      return scan_range_sse42;
+#endif
+    default:
+      return scan_range_scalar;
+  }
+}
+
+static scan_bits_fn bits_kernel_fn(ScanKernelType type) {
+  switch (type) {
+#ifdef SCAN_HAS_X86
+    case SCAN_AVX2:
+      return scan_bits_avx2;
+    case SCAN_SSE42:
+      return scan_bits_sse42;
+#endif
+    default:
+      return scan_bits_scalar;
+  }
+}
+
+int scan_kernel_supported(ScanKernelType type) {
+  pthread_once(&scan_init_once, scan_init);
+  return type == SCAN_SCALAR || (type < NUM_SCAN_KERNELS && type <= best_kernel);
+}
+
+ScanKernelType scan_best_kernel(void) {
+  pthread_once(&scan_init_once, scan_init);
+  return best_kernel;
+}
+
+const char* scan_kernel_name(ScanKernelType type) {
+  switch (type) {
+    case SCAN_SCALAR:
+      return "scalar";
+    case SCAN_SSE42:
+      return "sse4.2";
+    case SCAN_AVX2:
+      return "avx2";
+    default:
+      return "unknown";
+  }
+}
+
+size_t scan_range_with(ScanKernelType type, const int* data, size_t start, size_t end,
+                       int low, int high, const int* ref_posns, int* out) {
+  if (!data || !out || start >= end || low > high) return 0;
+  if (!scan_kernel_supported(type)) type = SCAN_SCALAR;
+  return kernel_fn(type)(data, start, end, low, high, ref_posns, out);
+}
+
+size_t scan_range(const int* data, size_t start, size_t end, int low, int high,
+                  const int* ref_posns, int* out) {
+  return scan_range_with(scan_best_kernel(), data, start, end, low, high, ref_posns, out);
+}
+
+size_t scan_range_bits_with(ScanKernelType type, const int* data, size_t start,
+                            size_t end, int low, int high, uint64_t* words) {
+  if (!data || !words || start >= end) return 0;
+  if (low > high) {
+    for (size_t w = start / 64; w < (end + 63) / 64; w++) words[w] = 0;
+    return 0;
+  }
+  if (!scan_kernel_supported(type)) type = SCAN_SCALAR;
+  return bits_kernel_fn(type)(data, start, end, low, high, words);
+}
+
+size_t scan_range_bits(const int* data, size_t start, size_t end, int low, int high,
+                       uint64_t* words) {
+  return scan_range_bits_with(scan_best_kernel(), data, start, end, low, high, words);
+}
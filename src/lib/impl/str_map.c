@@ -0,0 +1,93 @@
+#include "str_map.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#define STR_MAP_MIN_SLOTS 16
+
+// FNV-1a: handle names are short, so a byte-at-a-time hash is cheap enough
+static uint64_t hash_str(const char* key) {
+  uint64_t h = 0xcbf29ce484222325ull;
+  for (const unsigned char* c = (const unsigned char*)key; *c; c++) {
+    h ^= *c;
+    h *= 0x100000001b3ull;
+  }
+  return h;
+}
+
+// Slot holding `key`, or the empty slot where it would go
+static StrMapSlot* find_slot(StrMapSlot* slots, size_t n_slots, const char* key,
+                             uint64_t hash) {
+  size_t mask = n_slots - 1;
+  for (size_t i = hash & mask;; i = (i + 1) & mask) {
+    StrMapSlot* slot = &slots[i];
+    if (!slot->key || (slot->hash == hash && strcmp(slot->key, key) == 0)) return slot;
+  }
+}
+
+StrMap* str_map_create(size_t expected) {
+  StrMap* map = malloc(sizeof(StrMap));
+  if (!map) return NULL;
+  size_t n_slots = STR_MAP_MIN_SLOTS;
+  while (n_slots < expected * 2) n_slots *= 2;
+  map->slots = calloc(n_slots, sizeof(StrMapSlot));
+  if (!map->slots) {
+    free(map);
+    return NULL;
+  }
+  map->n_slots = n_slots;
+  map->size = 0;
+  return map;
+}
+
+void str_map_destroy(StrMap* map) {
+  if (!map) return;
+  for (size_t i = 0; i < map->n_slots; i++) free(map->slots[i].key);
+  free(map->slots);
+  free(map);
+}
+
+static int str_map_grow(StrMap* map) {
+  size_t n_slots = map->n_slots * 2;
+  StrMapSlot* slots = calloc(n_slots, sizeof(StrMapSlot));
+  if (!slots) return -1;
+  for (size_t i = 0; i < map->n_slots; i++) {
+    StrMapSlot* old = &map->slots[i];
+    if (old->key) *find_slot(slots, n_slots, old->key, old->hash) = *old;
+  }
+  free(map->slots);
+  map->slots = slots;
+  map->n_slots = n_slots;
+  return 0;
+}
+
+int str_map_put(StrMap* map, const char* key, size_t value) {
+  if (!map || !key) return -1;
+  uint64_t hash = hash_str(key);
+  StrMapSlot* slot = find_slot(map->slots, map->n_slots, key, hash);
+  if (slot->key) {
+    slot->value = value;
+    return 0;
+  }
+
+  if ((map->size + 1) * 2 > map->n_slots) {
+    if (str_map_grow(map) != 0) return -1;
+    slot = find_slot(map->slots, map->n_slots, key, hash);
+  }
+  size_t len = strlen(key) + 1;
+  slot->key = malloc(len);
+  if (!slot->key) return -1;
+  memcpy(slot->key, key, len);
+  slot->hash = hash;
+  slot->value = value;
+  map->size++;
+  return 0;
+}
+
+int str_map_get(const StrMap* map, const char* key, size_t* value) {
+  if (!map || !key) return 0;
+  StrMapSlot* slot = find_slot(map->slots, map->n_slots, key, hash_str(key));
+  if (!slot->key) return 0;
+  if (value) *value = slot->value;
+  return 1;
+}
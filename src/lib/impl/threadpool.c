@@ -1 +1,367 @@
-void placeholder_threadpool_c(void) {}
+#include "threadpool.h"
+
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "utils.h"
+
+#define INITIAL_DEQUE_CAPACITY 64
+
+typedef struct Task {
+  task_fn fn;
+  void* arg;
+  TaskGroup* group;
+} Task;
+
+/**
+ * @brief Ring buffer of tasks. The owner works at `bottom`, thieves at `top`; both
+ * ends are guarded by one mutex, which is cheap next to a morsel-sized task.
+ */
+typedef struct TaskDeque {
+  Task* tasks;
+  size_t capacity;
+  size_t top;     // index of the oldest task
+  size_t size;
+  pthread_mutex_t lock;
+} TaskDeque;
+
+typedef struct Worker {
+  ThreadPool* pool;
+  size_t id;
+  pthread_t thread;
+} Worker;
+
+struct ThreadPool {
+  Worker* workers;
+  TaskDeque* deques;
+  size_t num_threads;
+  size_t next_deque;  // round-robin target for submissions from outside the pool
+
+  pthread_mutex_t lock;
+  pthread_cond_t has_work;
+  size_t num_queued;
+  int shutdown;
+};
+
+// The worker running on this thread, if any; lets nested submissions stay local
+static __thread Worker* current_worker = NULL;
+
+static int deque_init(TaskDeque* dq) {
+  dq->tasks = malloc(sizeof(Task) * INITIAL_DEQUE_CAPACITY);
+  if (!dq->tasks) return -1;
+  dq->capacity = INITIAL_DEQUE_CAPACITY;
+  dq->top = 0;
+  dq->size = 0;
+  pthread_mutex_init(&dq->lock, NULL);
+  return 0;
+}
+
+static void deque_destroy(TaskDeque* dq) {
+  free(dq->tasks);
+  pthread_mutex_destroy(&dq->lock);
+}
+
+static int deque_push_bottom(TaskDeque* dq, Task task) {
+  pthread_mutex_lock(&dq->lock);
+  if (dq->size == dq->capacity) {
+    // unroll the ring into a buffer twice the size
+    Task* grown = malloc(sizeof(Task) * dq->capacity * 2);
+    if (!grown) {
+      pthread_mutex_unlock(&dq->lock);
+      return -1;
+    }
+    for (size_t i = 0; i < dq->size; i++) {
+      grown[i] = dq->tasks[(dq->top + i) % dq->capacity];
+    }
+    free(dq->tasks);
+    dq->tasks = grown;
+    dq->capacity *= 2;
+    dq->top = 0;
+  }
+  dq->tasks[(dq->top + dq->size) % dq->capacity] = task;
+  dq->size++;
+  pthread_mutex_unlock(&dq->lock);
+  return 0;
+}
+
+static int deque_pop_bottom(TaskDeque* dq, Task* task) {
+  int found = 0;
+  pthread_mutex_lock(&dq->lock);
+  if (dq->size > 0) {
+    dq->size--;
+    *task = dq->tasks[(dq->top + dq->size) % dq->capacity];
+    found = 1;
+  }
+  pthread_mutex_unlock(&dq->lock);
+  return found;
+}
+
+static int deque_steal_top(TaskDeque* dq, Task* task) {
+  int found = 0;
+  pthread_mutex_lock(&dq->lock);
+  if (dq->size > 0) {
+    *task = dq->tasks[dq->top];
+    dq->top = (dq->top + 1) % dq->capacity;
+    dq->size--;
+    found = 1;
+  }
+  pthread_mutex_unlock(&dq->lock);
+  return found;
+}
+
+/**
+ * @brief Take a task for the calling thread: its own deque first (if it is a worker of
+ * `pool`), then steal from the others starting after it.
+ */
+static int take_task(ThreadPool* pool, Task* task) {
+  size_t self = 0;
+  int is_worker = current_worker && current_worker->pool == pool;
+  if (is_worker) {
+    self = current_worker->id;
+    if (deque_pop_bottom(&pool->deques[self], task)) goto found;
+  }
+  for (size_t i = 1; i <= pool->num_threads; i++) {
+    size_t victim = (self + i) % pool->num_threads;
+    if (is_worker && victim == self) continue;
+    if (deque_steal_top(&pool->deques[victim], task)) goto found;
+  }
+  return 0;
+
+found:
+  pthread_mutex_lock(&pool->lock);
+  pool->num_queued--;
+  pthread_mutex_unlock(&pool->lock);
+  return 1;
+}
+
+static void run_task(Task* task) {
+  task->fn(task->arg);
+
+  TaskGroup* group = task->group;
+  pthread_mutex_lock(&group->lock);
+  if (--group->pending == 0) pthread_cond_broadcast(&group->done);
+  pthread_mutex_unlock(&group->lock);
+}
+
+static void* worker_loop(void* arg) {
+  Worker* worker = (Worker*)arg;
+  ThreadPool* pool = worker->pool;
+  current_worker = worker;
+
+  while (1) {
+    Task task;
+    if (take_task(pool, &task)) {
+      run_task(&task);
+      continue;
+    }
+
+    pthread_mutex_lock(&pool->lock);
+    while (pool->num_queued == 0 && !pool->shutdown) {
+      pthread_cond_wait(&pool->has_work, &pool->lock);
+    }
+    int should_exit = pool->shutdown && pool->num_queued == 0;
+    pthread_mutex_unlock(&pool->lock);
+    if (should_exit) break;
+  }
+  current_worker = NULL;
+  return NULL;
+}
+
+ThreadPool* threadpool_create(size_t num_threads) {
+  if (num_threads == 0) {
+    long n_cores = sysconf(_SC_NPROCESSORS_ONLN);
+    num_threads = n_cores > 0 ? (size_t)n_cores : 1;
+  }
+
+  ThreadPool* pool = calloc(1, sizeof(ThreadPool));
+  if (!pool) return NULL;
+  pool->workers = calloc(num_threads, sizeof(Worker));
+  pool->deques = calloc(num_threads, sizeof(TaskDeque));
+  if (!pool->workers || !pool->deques) {
+    free(pool->workers);
+    free(pool->deques);
+    free(pool);
+    return NULL;
+  }
+  pthread_mutex_init(&pool->lock, NULL);
+  pthread_cond_init(&pool->has_work, NULL);
+
+  for (size_t i = 0; i < num_threads; i++) {
+    if (deque_init(&pool->deques[i]) != 0) {
+      log_err("threadpool_create: failed to allocate deque %zu\n", i);
+      for (size_t j = 0; j < i; j++) deque_destroy(&pool->deques[j]);
+      free(pool->workers);
+      free(pool->deques);
+      free(pool);
+      return NULL;
+    }
+  }
+  pool->num_threads = num_threads;
+
+  // Workers only start once every deque exists, since they steal from all of them
+  for (size_t i = 0; i < num_threads; i++) {
+    pool->workers[i].pool = pool;
+    pool->workers[i].id = i;
+    if (pthread_create(&pool->workers[i].thread, NULL, worker_loop, &pool->workers[i]) !=
+        0) {
+      log_err("threadpool_create: failed to create worker %zu\n", i);
+      pool->workers[i].pool = NULL;  // not started, so not joined
+      threadpool_destroy(pool);
+      return NULL;
+    }
+  }
+  log_info("threadpool_create: started %zu workers\n", num_threads);
+  return pool;
+}
+
+void threadpool_destroy(ThreadPool* pool) {
+  if (!pool) return;
+
+  pthread_mutex_lock(&pool->lock);
+  pool->shutdown = 1;
+  pthread_cond_broadcast(&pool->has_work);
+  pthread_mutex_unlock(&pool->lock);
+
+  for (size_t i = 0; i < pool->num_threads; i++) {
+    if (pool->workers[i].pool) pthread_join(pool->workers[i].thread, NULL);
+    deque_destroy(&pool->deques[i]);
+  }
+
+  pthread_mutex_destroy(&pool->lock);
+  pthread_cond_destroy(&pool->has_work);
+  free(pool->workers);
+  free(pool->deques);
+  free(pool);
+}
+
+size_t threadpool_num_threads(ThreadPool* pool) { return pool ? pool->num_threads : 1; }
+
+void taskgroup_init(TaskGroup* group) {
+  group->pending = 0;
+  pthread_mutex_init(&group->lock, NULL);
+  pthread_cond_init(&group->done, NULL);
+}
+
+void taskgroup_destroy(TaskGroup* group) {
+  pthread_mutex_destroy(&group->lock);
+  pthread_cond_destroy(&group->done);
+}
+
+int taskgroup_done(TaskGroup* group) {
+  pthread_mutex_lock(&group->lock);
+  int done = group->pending == 0;
+  pthread_mutex_unlock(&group->lock);
+  return done;
+}
+
+int threadpool_submit(ThreadPool* pool, TaskGroup* group, task_fn fn, void* arg) {
+  if (!group || !fn) return -1;
+  if (!pool) {
+    fn(arg);
+    return 0;
+  }
+
+  pthread_mutex_lock(&group->lock);
+  group->pending++;
+  pthread_mutex_unlock(&group->lock);
+
+  size_t target;
+  if (current_worker && current_worker->pool == pool) {
+    target = current_worker->id;
+  } else {
+    pthread_mutex_lock(&pool->lock);
+    target = pool->next_deque++ % pool->num_threads;
+    pthread_mutex_unlock(&pool->lock);
+  }
+
+  // Counted before it is pushed, so a thief taking it right away cannot take the count
+  // below zero
+  pthread_mutex_lock(&pool->lock);
+  pool->num_queued++;
+  pthread_mutex_unlock(&pool->lock);
+
+  Task task = {.fn = fn, .arg = arg, .group = group};
+  if (deque_push_bottom(&pool->deques[target], task) != 0) {
+    pthread_mutex_lock(&pool->lock);
+    pool->num_queued--;
+    pthread_mutex_unlock(&pool->lock);
+    pthread_mutex_lock(&group->lock);
+    group->pending--;
+    pthread_mutex_unlock(&group->lock);
+    return -1;
+  }
+
+  pthread_mutex_lock(&pool->lock);
+  pthread_cond_signal(&pool->has_work);
+  pthread_mutex_unlock(&pool->lock);
+  return 0;
+}
+
+void threadpool_wait(ThreadPool* pool, TaskGroup* group) {
+  if (!group) return;
+  while (1) {
+    pthread_mutex_lock(&group->lock);
+    size_t pending = group->pending;
+    pthread_mutex_unlock(&group->lock);
+    if (pending == 0) return;
+
+    // help out instead of sleeping while there is queued work
+    Task task;
+    if (pool && take_task(pool, &task)) {
+      run_task(&task);
+      continue;
+    }
+
+    // the remaining tasks are running on other threads
+    pthread_mutex_lock(&group->lock);
+    while (group->pending > 0) pthread_cond_wait(&group->done, &group->lock);
+    pthread_mutex_unlock(&group->lock);
+    return;
+  }
+}
+
+typedef struct RangeTask {
+  range_fn fn;
+  void* arg;
+  size_t start;
+  size_t end;
+} RangeTask;
+
+static void run_range_task(void* arg) {
+  RangeTask* task = (RangeTask*)arg;
+  task->fn(task->start, task->end, task->arg);
+}
+
+int threadpool_parallel_for(ThreadPool* pool, size_t n, size_t morsel_size, range_fn fn,
+                            void* arg) {
+  if (n == 0) return 0;
+  if (morsel_size == 0) morsel_size = n;
+  size_t n_morsels = num_morsels(n, morsel_size);
+
+  if (!pool || n_morsels == 1) {
+    for (size_t m = 0; m < n_morsels; m++) {
+      size_t end = (m + 1) * morsel_size < n ? (m + 1) * morsel_size : n;
+      fn(m * morsel_size, end, arg);
+    }
+    return 0;
+  }
+
+  RangeTask* tasks = malloc(sizeof(RangeTask) * n_morsels);
+  if (!tasks) return -1;
+
+  TaskGroup group;
+  taskgroup_init(&group);
+  for (size_t m = 0; m < n_morsels; m++) {
+    tasks[m].fn = fn;
+    tasks[m].arg = arg;
+    tasks[m].start = m * morsel_size;
+    tasks[m].end = (m + 1) * morsel_size < n ? (m + 1) * morsel_size : n;
+    if (threadpool_submit(pool, &group, run_range_task, &tasks[m]) != 0) {
+      run_range_task(&tasks[m]);  // could not queue it; run it here instead
+    }
+  }
+  threadpool_wait(pool, &group);
+  taskgroup_destroy(&group);
+  free(tasks);
+  return 0;
+}
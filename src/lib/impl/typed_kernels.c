@@ -0,0 +1,145 @@
+#include "typed_kernels.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+/**
+ * @brief One kernel of each kind for values of type `T`. The loops never branch on the
+ * data: a select writes every position and advances past it only when it qualifies,
+ * and the statistics keep their running values with conditional moves.
+ */
+#define DEFINE_TYPED_KERNELS(T, NAME, SUM_T)                                           \
+  size_t typed_select_##NAME(const T* values, size_t n, T low, T high,               \
+                             const int* ref_posns, int* out) {                       \
+    size_t k = 0;                                                                    \
+    if (ref_posns) {                                                                 \
+      for (size_t i = 0; i < n; i++) {                                               \
+        out[k] = ref_posns[i];                                                       \
+        k += (values[i] >= low) & (values[i] <= high);                               \
+      }                                                                              \
+    } else {                                                                         \
+      for (size_t i = 0; i < n; i++) {                                               \
+        out[k] = (int)i;                                                             \
+        k += (values[i] >= low) & (values[i] <= high);                               \
+      }                                                                              \
+    }                                                                                \
+    return k;                                                                        \
+  }                                                                                  \
+                                                                                     \
+  void typed_gather_##NAME(const T* values, const int* positions, size_t n, T* out) { \
+    for (size_t i = 0; i < n; i++) out[i] = values[positions[i]];                    \
+  }                                                                                  \
+                                                                                     \
+  void typed_stats_##NAME(const T* values, size_t n, SUM_T* sum, T* min, T* max) {    \
+    SUM_T s = 0;                                                                     \
+    T lo = *min, hi = *max;                                                          \
+    for (size_t i = 0; i < n; i++) {                                                 \
+      s += values[i];                                                                \
+      lo = values[i] < lo ? values[i] : lo;                                          \
+      hi = values[i] > hi ? values[i] : hi;                                          \
+    }                                                                                \
+    *sum += s;                                                                       \
+    *min = lo;                                                                       \
+    *max = hi;                                                                       \
+  }                                                                                  \
+                                                                                     \
+  void typed_add_##NAME(const T* a, const T* b, size_t n, T* out) {                  \
+    for (size_t i = 0; i < n; i++) out[i] = a[i] + b[i];                             \
+  }                                                                                  \
+                                                                                     \
+  void typed_sub_##NAME(const T* a, const T* b, size_t n, T* out) {                  \
+    for (size_t i = 0; i < n; i++) out[i] = a[i] - b[i];                             \
+  }                                                                                  \
+                                                                                     \
+  void typed_reorder_##NAME(T* values, size_t n, const int* order, T* scratch) {     \
+    memcpy(scratch, values, sizeof(T) * n);                                          \
+    for (size_t i = 0; i < n; i++) values[i] = scratch[order[i]];                    \
+  }                                                                                  \
+                                                                                     \
+  /* Merges the sorted runs [lo, mid) and [mid, hi) of `from` into `to` */           \
+  static void merge_runs_##NAME(const T* from, const int* from_posns, T* to,         \
+                                int* to_posns, size_t lo, size_t mid, size_t hi) {   \
+    size_t i = lo, j = mid;                                                          \
+    for (size_t k = lo; k < hi; k++) {                                               \
+      /* the left run wins ties, which keeps the sort stable */                      \
+      int take_left = i < mid && (j >= hi || !(from[j] < from[i]));                  \
+      size_t src = take_left ? i++ : j++;                                            \
+      to[k] = from[src];                                                             \
+      to_posns[k] = from_posns[src];                                                 \
+    }                                                                                \
+  }                                                                                  \
+                                                                                     \
+  int typed_argsort_##NAME(T* values, size_t n, int* positions) {                    \
+    T* tmp = malloc(sizeof(T) * (n ? n : 1));                                        \
+    int* tmp_posns = malloc(sizeof(int) * (n ? n : 1));                              \
+    if (!tmp || !tmp_posns) {                                                        \
+      free(tmp);                                                                     \
+      free(tmp_posns);                                                               \
+      return -1;                                                                     \
+    }                                                                                \
+    for (size_t i = 0; i < n; i++) positions[i] = (int)i;                            \
+    /* bottom-up merge sort, the runs doubling each pass between the two buffers */  \
+    T* from = values;                                                                \
+    int* from_posns = positions;                                                     \
+    T* to = tmp;                                                                     \
+    int* to_posns = tmp_posns;                                                       \
+    for (size_t width = 1; width < n; width *= 2) {                                  \
+      for (size_t lo = 0; lo < n; lo += 2 * width) {                                 \
+        size_t mid = lo + width < n ? lo + width : n;                                \
+        size_t hi = lo + 2 * width < n ? lo + 2 * width : n;                         \
+        merge_runs_##NAME(from, from_posns, to, to_posns, lo, mid, hi);              \
+      }                                                                              \
+      T* swap = from;                                                                \
+      from = to;                                                                     \
+      to = swap;                                                                     \
+      int* swap_posns = from_posns;                                                  \
+      from_posns = to_posns;                                                         \
+      to_posns = swap_posns;                                                         \
+    }                                                                                \
+    if (from != values) {                                                            \
+      memcpy(values, from, sizeof(T) * n);                                           \
+      memcpy(positions, from_posns, sizeof(int) * n);                                \
+    }                                                                                \
+    free(tmp);                                                                       \
+    free(tmp_posns);                                                                 \
+    return 0;                                                                        \
+  }                                                                                  \
+                                                                                     \
+  size_t typed_lower_bound_##NAME(const T* values, size_t n, T value) {              \
+    size_t left = 0, right = n;                                                      \
+    while (left < right) {                                                           \
+      size_t mid = left + (right - left) / 2;                                        \
+      if (values[mid] < value) {                                                     \
+        left = mid + 1;                                                              \
+      } else {                                                                       \
+        right = mid;                                                                 \
+      }                                                                              \
+    }                                                                                \
+    return left;                                                                     \
+  }                                                                                  \
+                                                                                     \
+  size_t typed_upper_bound_##NAME(const T* values, size_t n, T value) {              \
+    size_t left = 0, right = n;                                                      \
+    while (left < right) {                                                           \
+      size_t mid = left + (right - left) / 2;                                        \
+      if (values[mid] <= value) {                                                    \
+        left = mid + 1;                                                              \
+      } else {                                                                       \
+        right = mid;                                                                 \
+      }                                                                              \
+    }                                                                                \
+    return left;                                                                     \
+  }
+
+DEFINE_TYPED_KERNELS(int, int, int64_t)
+DEFINE_TYPED_KERNELS(long, long, int64_t)
+DEFINE_TYPED_KERNELS(double, double, double)
+
+#define DEFINE_TYPED_CONVERT(FROM, TO)                                      \
+  void typed_convert_##FROM##_##TO(const FROM* values, size_t n, TO* out) { \
+    for (size_t i = 0; i < n; i++) out[i] = (TO)values[i];                  \
+  }
+
+DEFINE_TYPED_CONVERT(int, long)
+DEFINE_TYPED_CONVERT(int, double)
+DEFINE_TYPED_CONVERT(long, double)
@@ -3,10 +3,13 @@
 
 #include <stddef.h>
 
+#include "threadpool.h"
+
 size_t binary_search_left(int* sorted_data, size_t num_elements, int value);
 size_t binary_search_right(int* sorted_data, size_t num_elements, int value);
 /**
  * @brief sorts the `data` in ascending order and keeps track of their original positions.
+ * A stable LSD radix sort: equal values keep their original positions in ascending order.
  *
  * The caller should be responsible for memory management of arrays: `data` and
  * `original_pos`. That is, allocating enough memory and free-ing it later.
@@ -17,6 +20,14 @@ size_t binary_search_right(int* sorted_data, size_t num_elements, int value);
  * @return int
  */
 int sort(int* data, size_t n_elements, int* original_pos);
+
+/**
+ * @brief `sort` across the workers of `pool`: every worker radix sorts a run of the
+ * data, then merges one value range of all the runs into the output. Needs the same
+ * scratch as `sort`, 8 bytes per value. Runs on the calling thread if `pool` is NULL
+ * or the data is too small to split.
+ */
+int sort_parallel(ThreadPool* pool, int* data, size_t n_elements, int* original_pos);
 void test_sort(void);
 
 #endif
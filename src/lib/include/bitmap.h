@@ -0,0 +1,75 @@
+#ifndef BITMAP_H
+#define BITMAP_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * @brief A plain bitmap over the rows `[0, num_bits)` of a column: bit `i` of
+ * `words[i / 64]` is set when row `i` qualifies. It costs one bit per row however many
+ * rows qualify, so it is the compact form of a dense select result, where a position
+ * list costs 32 bits per qualifying row. Bits past `num_bits` in the last word are
+ * always 0.
+ *
+ * Range arguments `[start, end)` must start on a word boundary (a multiple of 64), and
+ * end on one or at `num_bits`, so disjoint ranges never share a word and can be
+ * processed by different threads.
+ */
+typedef struct Bitmap {
+  uint64_t* words;
+  size_t num_bits;
+} Bitmap;
+
+static inline size_t bitmap_num_words(size_t num_bits) { return (num_bits + 63) / 64; }
+
+/**
+ * @brief Allocates a bitmap of `num_bits` bits, all clear.
+ *
+ * @return NULL if out of memory
+ */
+Bitmap* bitmap_create(size_t num_bits);
+
+void bitmap_destroy(Bitmap* bitmap);
+
+static inline int bitmap_test(const Bitmap* bitmap, size_t i) {
+  return (bitmap->words[i / 64] >> (i % 64)) & 1;
+}
+
+static inline void bitmap_set(Bitmap* bitmap, size_t i) {
+  bitmap->words[i / 64] |= 1ULL << (i % 64);
+}
+
+// Number of set bits in `[start, end)`
+size_t bitmap_count(const Bitmap* bitmap, size_t start, size_t end);
+
+/**
+ * @brief Writes the positions of the set bits of `[start, end)` to `out`, ascending.
+ * Uses an AVX2 kernel when the CPU has one; either way nothing is written past the
+ * last position, so ranges can be decoded side by side into one array.
+ *
+ * @return the number of positions written
+ */
+size_t bitmap_positions(const Bitmap* bitmap, size_t start, size_t end, int* out);
+
+/**
+ * @brief Writes `values[i]` for every set bit `i` of `[start, end)` to `out`, in row
+ * order: a fetch through the bitmap. `values` must have a value for every row of
+ * `[start, end)`. Like `bitmap_positions`, it writes nothing past the last value.
+ *
+ * @return the number of values written
+ */
+size_t bitmap_gather(const Bitmap* bitmap, size_t start, size_t end, const int* values,
+                     int* out);
+
+/**
+ * @brief `dst = a & b` over `[start, end)`; all three cover the same rows. `dst` may be
+ * `a` or `b`.
+ *
+ * @return the number of bits set in `dst` over the range
+ */
+size_t bitmap_and(Bitmap* dst, const Bitmap* a, const Bitmap* b, size_t start,
+                  size_t end);
+
+void test_bitmap(void);
+
+#endif
@@ -0,0 +1,104 @@
+#ifndef BITPACK_H
+#define BITPACK_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Widest code `packed_create` accepts
+#define PACKED_MAX_BITS 31
+
+/**
+ * @brief Frame-of-reference + bit-packing of an int column: row `i` is stored as the
+ * code `value - base`, in the horizontal layout of BitWeaving/H.
+ *
+ * Each code sits in a field of `width` bits whose top bit (the delimiter) is always 0,
+ * `per_word = 64 / width` fields to a 64-bit word. The delimiters let a range predicate
+ * run on a whole word of codes with a few integer operations and no decoding:
+ * subtracting within every field at once cannot borrow across fields, and each field's
+ * delimiter comes out set exactly when its code qualifies. `width` is rounded up to 4,
+ * 8, 16 or 32 bits, so fields tile words exactly and the predicate runs on whole SIMD
+ * vectors of words.
+ *
+ * Words are grouped in segments of `width` words holding 64 consecutive rows: row `r`
+ * of a segment is field `r / width` of its word `r % width`. Shifting the result of
+ * word `i` right by `bits - i` then moves the delimiter of row `r` to bit `r`, so
+ * OR-ing the shifted results of a segment gives the word of the select's bitmap for its
+ * rows, without visiting them one by one.
+ */
+typedef struct PackedInts {
+  uint64_t* words;
+  size_t num_elements;
+  size_t capacity;  // rows the words have room for, a multiple of 64
+  int base;
+  unsigned int bits;      // of a code: `width - 1`
+  unsigned int width;     // of a field: 4, 8, 16 or 32
+  unsigned int per_word;  // fields per word
+  uint64_t ones;          // the low bit of every field: `c * ones` repeats `c` in each
+  uint64_t delimiters;    // the delimiter bit of every field
+} PackedInts;
+
+// Bits needed for the codes of values in `[min_value, max_value]`
+unsigned int packed_bits_for(long min_value, long max_value);
+
+/**
+ * @brief Packs the `n` values with frame `base` and codes of at least `bits` bits.
+ *
+ * @return NULL if out of memory, `bits > PACKED_MAX_BITS`, or a value does not fit
+ * the frame
+ */
+PackedInts* packed_create(const int* values, size_t n, int base, unsigned int bits);
+
+void packed_destroy(PackedInts* packed);
+
+// Bytes of codes held, the room left for appends included
+static inline size_t packed_size(const PackedInts* packed) {
+  return packed->capacity / 64 * packed->width * sizeof(uint64_t);
+}
+
+/**
+ * @brief Appends `value` as row `num_elements`. It only needs to fit the field, whose
+ * `bits` may be more than the column was packed with.
+ *
+ * @return 0 on success, -1 if it does not fit the frame or out of memory
+ */
+int packed_append(PackedInts* packed, int value);
+
+// Decodes row `row` alone
+static inline int packed_get(const PackedInts* packed, size_t row) {
+  size_t r = row % 64;
+  uint64_t word = packed->words[row / 64 * packed->width + (r & (packed->width - 1))];
+  uint64_t code = (word >> (r & ~(size_t)(packed->width - 1))) &
+                  ((1ULL << packed->bits) - 1);
+  return (int)((long)packed->base + (long)code);
+}
+
+/**
+ * @brief Decodes rows `[start, end)` to `out[0 .. end - start)`, a segment at a time,
+ * which beats `packed_get` row by row once a good share of the rows is needed. `start`
+ * must be a multiple of 64.
+ */
+void packed_decode(const PackedInts* packed, size_t start, size_t end, int* out);
+
+/**
+ * @brief `scan_range` on the codes: writes the rows of `[start, end)` whose value is
+ * in `[low, high]` to `out`, ascending, evaluating the predicate a word of codes at a
+ * time.
+ *
+ * @return the number of rows written
+ */
+size_t packed_scan_range(const PackedInts* packed, size_t start, size_t end, int low,
+                         int high, int* out);
+
+/**
+ * @brief `scan_range_bits` on the codes: sets bit `i` of `words` for every qualifying
+ * `i` in `[start, end)` and clears it for every other. `start` must be a multiple of
+ * 64, and whole words are written.
+ *
+ * @return the number of bits set
+ */
+size_t packed_scan_range_bits(const PackedInts* packed, size_t start, size_t end,
+                              int low, int high, uint64_t* words);
+
+void test_bitpack(void);
+
+#endif
@@ -2,51 +2,54 @@
 #define BTREE_H
 
 #include <stddef.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <sys/types.h>
 
+// Keys per node: one 64-byte cache line of ints
+#define BTREE_NODE_KEYS 16
+// 16^16 keys is more than any index holds
+#define BTREE_MAX_LEVELS 16
+
 /**
- * @brief Btree node structure
- *
- * This represents an internal node in the B-tree.
- *
- * Since, we're optimizing for just lookups, we decided to:
- * - Fill factor = 100% (all internal nodes are full)
- * - internal nodes are contiguous in memory
- *      - store the keys in an array of integers
- *      - a pointer to the next level of the tree (the first element of the next level)
- * - The last level's child_ptr always points to the `data` array
- *
- * Since during lookups, we need all values to compare against, and only follow one
- * pointer (see CS165_FALL2024_Class13 slide 26 & 27).
+ * @brief A static, pointer-free B+-tree over the unique values of a sorted array, laid
+ * out like a CSS-tree (cache-sensitive search tree).
  *
+ * Since we're optimizing for just lookups, we decided to:
+ * - Fill factor = 100% (all nodes are full, except the last node of each level)
+ * - a node is `BTREE_NODE_KEYS` keys in one cache line, and the levels are stored root
+ *   first in one cache-line aligned array, so there are no child pointers: the
+ *   children of node `j` are nodes `j * BTREE_NODE_KEYS + c` of the next level
+ * - level `l` holds every `BTREE_NODE_KEYS^(depth - l)`-th unique value, and the last
+ *   level holds them all; the last node of a level is padded with `INT_MAX`
  *
+ * A lookup reads one cache line per level and compares a key against a whole node at
+ * once (SSE2 where available), so a descent costs O(log n) with a small, fixed
+ * number of cache misses. `lookup_batch` interleaves several descents and prefetches
+ * the next node of each, so their cache misses overlap.
  */
 typedef struct Btree {
-  struct Btree* child_ptr;
-  int* keys;
-  size_t n_keys;
+  int* keys;  // every level, root first; level `l` starts at `keys + level_start[l]`
+  size_t n_levels;
+  size_t level_start[BTREE_MAX_LEVELS];
+  size_t level_keys[BTREE_MAX_LEVELS];  // keys of each level, padding excluded
 
-  // Global bookkeeping for unique values, etc.
-  size_t fanout;
+  // Bookkeeping for the unique values (the last level)
   size_t n_uniques;
   size_t* first_unique_idxes;
   size_t* last_unique_idxes;
+  int is_mapped;  // keys and unique idxes point into a mapped file; see btree_deserialize
 } Btree;
 
-// TODO: refactor the above by moving global bookkeeping to a separate struct, say
-// BtreeIndex below, time permitting. they don't change per level node
-// typedef struct BtreeIndex {
-//   Btree* root;
-//   size_t fanout;
-//   size_t n_uniques;
-//   size_t* first_unique_idxes;
-//   size_t* last_unique_idxes;
-// };
-
-Btree* init_btree(int* data, size_t n_elts, size_t fanout);
+/**
+ * @brief Build the tree over sorted `data`. The tree keeps its own copy of the
+ * unique values, so `data` may change or go away afterwards.
+ *
+ * @return the tree, or NULL if `data` is empty or out of memory
+ */
+Btree* init_btree(int* data, size_t n_elts);
 
 /**
  * @brief Lookup a key in the B-tree.
@@ -55,14 +58,40 @@ Btree* init_btree(int* data, size_t n_elts, size_t fanout);
  * @param tree The root of the B-tree.
  * @param is_left indicator for whether the caller is looking for first or last occurence
  * @return an index `i` in the `data` array such that
- *      `data[i - 1] < data[i] <= key` for i > 0 else 0,      if `is_left` is true (1)
+ *      `data[i - 1] < key <= data[i]` (`n_elts` if every value is `< key`), if `is_left`
  * OR
- *      `data[i] >= key > data[i + 1]` for i < n_elts,        if `is_left` is false (0)
+ *      `data[i] <= key < data[i + 1]` (0 if every value is `> key`),        otherwise
  */
 size_t lookup(int key, Btree* tree, int is_left);
 
+/**
+ * @brief `lookup` of each of the `n` keys into `out`. The descents of a group of keys
+ * advance one level at a time, and every step prefetches the node the next one reads.
+ */
+void lookup_batch(const int* keys, size_t n, Btree* tree, int is_left, size_t* out);
+
 void print_tree(Btree* tree);
 
+/**
+ * @brief Number of bytes `btree_serialize` writes for `tree`.
+ */
+size_t btree_serialized_size(Btree* tree);
+
+/**
+ * @brief Write the node array and the unique-value bookkeeping into `buf`, which
+ * must hold `btree_serialized_size(tree)` bytes and be 8-byte aligned.
+ */
+void btree_serialize(Btree* tree, void* buf);
+
+/**
+ * @brief Rebuild a tree written by `btree_serialize` without copying anything: keys and
+ * bookkeeping arrays point into `buf`, which must outlive the tree (e.g. a mapped index
+ * file). `free_btree` then only frees the tree itself.
+ *
+ * @return the root, or NULL if `buf` does not hold a valid tree
+ */
+Btree* btree_deserialize(void* buf, size_t size);
+
 /**
  * @brief Free all memory allocated for the B-tree; not the data array.
  *
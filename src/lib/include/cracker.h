@@ -0,0 +1,61 @@
+#ifndef CRACKER_H
+#define CRACKER_H
+
+#include <stddef.h>
+
+/**
+ * @brief A cracker column: a copy of a column's values, with their row positions, that
+ * range queries partially sort as a side effect (database cracking). Every query cracks
+ * the piece that holds each of its bounds in two around the bound, so the values it
+ * selects end up contiguous and later queries only partition the pieces they cut.
+ * There is no upfront sort; the column converges towards sorted where queries go.
+ *
+ * The cracker index is the list of cracks so far, ascending by pivot: crack `k` puts
+ * every value `< pivots[k]` before `offsets[k]` and every other value from it on.
+ */
+typedef struct Cracker {
+  int* values;
+  int* positions;  // positions[i] is the row of values[i] in the column
+  size_t num_elements;
+  size_t capacity;
+  int* pivots;
+  size_t* offsets;
+  size_t num_cracks;
+  size_t cracks_capacity;
+} Cracker;
+
+/**
+ * @brief Copies the `n` values of a column into a new, uncracked cracker column.
+ *
+ * @return NULL if out of memory
+ */
+Cracker* cracker_create(const int* values, size_t n);
+
+void cracker_destroy(Cracker* cracker);
+
+/**
+ * @brief Cracks the piece that holds `pivot` around it, unless a crack at `pivot`
+ * exists already.
+ *
+ * @return the offset of the first value `>= pivot`
+ */
+size_t cracker_crack(Cracker* cracker, int pivot);
+
+/**
+ * @brief Cracks around `low` and `high` so the values in `[low, high]` become
+ * `values[*start..*end)`, with their rows at the same offsets of `positions`.
+ */
+void cracker_select(Cracker* cracker, int low, int high, size_t* start, size_t* end);
+
+/**
+ * @brief Adds row `row` holding `value`: it goes to the end of its piece, and every
+ * later piece moves its first value to its end to make room, so an insert costs one
+ * move per later piece rather than a shift of the array.
+ *
+ * @return 0 on success, -1 if out of memory (the cracker is then unchanged)
+ */
+int cracker_insert(Cracker* cracker, int value, int row);
+
+void test_cracker(void);
+
+#endif
@@ -0,0 +1,52 @@
+#ifndef DICTIONARY_H
+#define DICTIONARY_H
+
+#include <stddef.h>
+
+#include "bitpack.h"
+
+/**
+ * @brief Order-preserving dictionary encoding of an int column: `values` holds the
+ * column's distinct values in ascending order, and row `i` is stored as the index of its
+ * value in `values`, bit-packed in `codes` (see bitpack.h). Codes compare like the values
+ * they stand for, so a range predicate on values is a range predicate on codes, and runs
+ * on the packed codes however wide the values themselves are.
+ */
+typedef struct Dictionary {
+  int* values;
+  size_t num_values;
+  PackedInts* codes;  // frame 0: a row's code is its index in `values`
+} Dictionary;
+
+/**
+ * @brief Encodes the `n` values if they have at most `max_values` distinct ones, which
+ * must be at most `1 << PACKED_MAX_BITS`.
+ *
+ * @return NULL if they have more, or if out of memory
+ */
+Dictionary* dictionary_create(const int* values, size_t n, size_t max_values);
+
+void dictionary_destroy(Dictionary* dict);
+
+/**
+ * @brief Translates the value range `[low, high]` into the code range `[*lo, *hi]`.
+ *
+ * @return 0 if no value of the dictionary is in the range
+ */
+int dictionary_code_range(const Dictionary* dict, int low, int high, int* lo, int* hi);
+
+/**
+ * @brief Appends `value` as the next row. Only values already in the dictionary can be
+ * appended: a new one would need a code between two existing ones.
+ *
+ * @return 0 on success, -1 if `value` is not in the dictionary or out of memory
+ */
+int dictionary_append(Dictionary* dict, int value);
+
+static inline int dictionary_get(const Dictionary* dict, size_t row) {
+  return dict->values[packed_get(dict->codes, row)];
+}
+
+void test_dictionary(void);
+
+#endif
@@ -0,0 +1,89 @@
+#ifndef FLAT_HASH_H
+#define FLAT_HASH_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "mempool.h"
+
+/**
+ * @brief A build-once, open-addressing multimap from int keys to int values.
+ *
+ * Layout follows Swiss tables: one control byte per slot holds either EMPTY or a 7-bit
+ * tag from the key's hash, so a probe compares 16 tags with one SIMD instruction and
+ * only touches key slots whose tag matches. Slots map a key to its group; all values of
+ * a group are stored contiguously (in insertion order), so a lookup returns a pointer
+ * and a count instead of walking a chain. Groups are numbered in order of first
+ * appearance, which is what a group-by needs. Everything lives in one arena and is
+ * freed together.
+ */
+typedef struct FlatHashTable {
+  uint8_t* ctrl;      // n_slots control bytes, then 16 mirrored ones for wraparound
+  int32_t* slot_keys;
+  uint32_t* slot_groups;
+  size_t n_slots;     // power of two, kept at most 7/8 full
+
+  size_t n_groups;        // distinct keys
+  int* group_keys;        // key of each group
+  uint32_t* group_starts; // n_groups + 1 offsets into `values`
+  int* values;
+  size_t n_values;
+
+  Arena* arena;
+} FlatHashTable;
+
+/**
+ * @brief Build a table over `n` (key, value) pairs read as `keys[i * stride]` and
+ * `values[i * stride]`, so interleaved tuples can be passed without copying (stride 2
+ * for `{int key; int value;}` pairs).
+ *
+ * @return NULL if out of memory
+ */
+FlatHashTable* flat_ht_build(const int* keys, const int* values, size_t n, size_t stride);
+
+void flat_ht_destroy(FlatHashTable* ht);
+
+/**
+ * @brief Peak bytes `flat_ht_build` allocates for `n` pairs: the table's arena (control
+ * bytes and slots, rounded up to a power of two at most 7/8 full, plus the groups and
+ * values) and the per-pair temporaries of the build. Lets a caller fit a build into a
+ * memory budget before making it.
+ */
+size_t flat_ht_build_bytes(size_t n);
+
+/**
+ * @brief Group of `key`, or -1 if the key is not in the table.
+ */
+long flat_ht_find(const FlatHashTable* ht, int key);
+
+/**
+ * @brief Values stored under `key`, in insertion order; sets `*count` (0 if missing).
+ */
+const int* flat_ht_get(const FlatHashTable* ht, int key, size_t* count);
+
+/**
+ * @brief Growable pairs of positions, e.g. (left, right) matches of a join.
+ */
+typedef struct MatchBuffer {
+  int* left;
+  int* right;
+  size_t size;
+  size_t capacity;
+} MatchBuffer;
+
+int match_buffer_push(MatchBuffer* buf, int left, int right);
+void match_buffer_free(MatchBuffer* buf);
+
+/**
+ * @brief Probe `n` keys (`keys[i * stride]`) in one pass. For every stored value `v`
+ * matching probe `i`, appends `(v, payloads[i * stride])` to `out`, or
+ * `(payloads[i * stride], v)` if `values_left` is 0.
+ *
+ * @return 0 on success, -1 if `out` could not grow
+ */
+int flat_ht_probe(const FlatHashTable* ht, const int* keys, const int* payloads, size_t n,
+                  size_t stride, int values_left, MatchBuffer* out);
+
+void test_flat_hash(void);
+
+#endif
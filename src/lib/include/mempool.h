@@ -1 +1,58 @@
-#TODO
+#ifndef MEMPOOL_H
+#define MEMPOOL_H
+
+#include <stddef.h>
+
+#define ARENA_NUM_CLASSES 8             // slab capacities block_size << 0 .. << 7
+#define ARENA_HUGE_PAGE_SIZE (2 << 20)  // slabs this large are mapped on huge pages
+#define ARENA_MAX_CACHED_BYTES ((size_t)256 << 20)  // slabs kept across resets
+
+/**
+ * @brief A bump allocator over slabs, for memory that is dropped all at once: a join's
+ * hash table, or the scratch buffers of one query.
+ *
+ * Allocation is a pointer increment; nothing is freed individually. Slabs come in
+ * `ARENA_NUM_CLASSES` power-of-two size classes starting at `block_size`. A request
+ * that does not fit the current slab gets the smallest class that holds it, and one
+ * beyond the largest class gets a slab of its own. Slabs of `ARENA_HUGE_PAGE_SIZE` or
+ * more are mmap'd on huge-page boundaries and advised as huge pages, so a large scratch
+ * buffer costs a few TLB entries and faults instead of one per 4KB page.
+ *
+ * `arena_reset` does not return class slabs to the system. It parks them on per-class
+ * free lists (up to `ARENA_MAX_CACHED_BYTES`), so an arena reset after every query
+ * reuses memory that is already mapped and faulted in.
+ */
+typedef struct ArenaBlock ArenaBlock;
+
+typedef struct Arena {
+  ArenaBlock* head;  // slabs in use, newest (allocated from) first
+  ArenaBlock* free_slabs[ARENA_NUM_CLASSES];  // reset slabs waiting for reuse
+  size_t block_size;       // capacity of the smallest class
+  size_t bytes_allocated;  // handed out since the last reset
+  size_t bytes_cached;     // capacity parked on the free lists
+} Arena;
+
+/**
+ * @brief Create an arena whose smallest slabs hold `block_size` bytes (0 picks a
+ * default).
+ */
+Arena* arena_create(size_t block_size);
+
+/**
+ * @brief Allocate `size` bytes aligned to `alignment` (a power of two).
+ *
+ * @return NULL if out of memory
+ */
+void* arena_alloc(Arena* arena, size_t size, size_t alignment);
+
+/**
+ * @brief Release every allocation at once. Class slabs are kept for reuse; oversized
+ * ones are freed.
+ */
+void arena_reset(Arena* arena);
+
+void arena_destroy(Arena* arena);
+
+void test_mempool(void);
+
+#endif
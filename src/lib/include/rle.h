@@ -0,0 +1,88 @@
+#ifndef RLE_H
+#define RLE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * @brief Run-length encoding of an int column: run `r` repeats `values[r]` over the rows
+ * `[r ? ends[r - 1] : 0, ends[r])`. A sorted or clustered column has few, long runs, so
+ * predicates and aggregates are evaluated once per run instead of once per row, and a
+ * select's result comes out as row ranges rather than individual positions.
+ */
+typedef struct RunLengths {
+  int* values;
+  size_t* ends;  // row after the last row of each run, ascending
+  size_t num_runs;
+  size_t capacity;  // runs `values` and `ends` have room for
+} RunLengths;
+
+/**
+ * @brief Encodes the `n` values if they form at most `max_runs` runs.
+ *
+ * @return NULL if they form more, or if out of memory
+ */
+RunLengths* rle_create(const int* values, size_t n, size_t max_runs);
+
+void rle_destroy(RunLengths* rle);
+
+static inline size_t rle_num_rows(const RunLengths* rle) {
+  return rle->num_runs ? rle->ends[rle->num_runs - 1] : 0;
+}
+
+/**
+ * @brief Appends `value` as the next row, extending the last run when it repeats it.
+ *
+ * @return 0 on success, -1 if out of memory
+ */
+int rle_append(RunLengths* rle, int value);
+
+// Index of the run holding row `row`, which must be below `rle_num_rows`
+size_t rle_find(const RunLengths* rle, size_t row);
+
+static inline int rle_get(const RunLengths* rle, size_t row) {
+  return rle->values[rle_find(rle, row)];
+}
+
+/**
+ * @brief Writes the rows of `[start, end)` whose value is in `[low, high]` as ascending,
+ * disjoint ranges `[starts[i], ends[i])`; qualifying runs next to each other make one
+ * range. Both arrays need room for one range per run overlapping `[start, end)`.
+ *
+ * @return the number of ranges written
+ */
+size_t rle_select_ranges(const RunLengths* rle, size_t start, size_t end, int low,
+                         int high, size_t* starts, size_t* ends);
+
+/**
+ * @brief `scan_range` on the runs: writes the rows of `[start, end)` whose value is in
+ * `[low, high]` to `out`, ascending.
+ *
+ * @return the number of rows written
+ */
+size_t rle_scan_range(const RunLengths* rle, size_t start, size_t end, int low, int high,
+                      int* out);
+
+/**
+ * @brief `scan_range_bits` on the runs: sets bit `i` of `words` for every qualifying `i`
+ * in `[start, end)` and clears it for every other. `start` must be a multiple of 64, and
+ * whole words are written.
+ *
+ * @return the number of bits set
+ */
+size_t rle_scan_range_bits(const RunLengths* rle, size_t start, size_t end, int low,
+                           int high, uint64_t* words);
+
+/**
+ * @brief Adds the values of rows `[start, end)` to `*sum` and folds them into `*min` and
+ * `*max`, a run at a time: each run counts as its value times the rows it overlaps.
+ */
+void rle_range_stats(const RunLengths* rle, size_t start, size_t end, int64_t* sum,
+                     long* min, long* max);
+
+// Decodes rows `[start, end)` to `out[0 .. end - start)`
+void rle_decode(const RunLengths* rle, size_t start, size_t end, int* out);
+
+void test_rle(void);
+
+#endif
@@ -0,0 +1,64 @@
+#ifndef SCAN_H
+#define SCAN_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * @brief Range-scan kernels used by select.
+ *
+ * A kernel evaluates `low <= data[i] <= high` (both bounds inclusive) for every
+ * `i` in `[start, end)` and writes the qualifying positions to `out`, compacted and in
+ * ascending order. The position written is `i`, or `ref_posns[i]` when `ref_posns` is
+ * not NULL (e.g. a type 2 select over fetched values, or a scan over an index).
+ *
+ * The SIMD kernels compare a whole vector at once, turn the comparison into a bit
+ * mask and compact the positions with a shuffle table; none of them branch on data.
+ * To do so they may write up to one vector past the last qualifying position, so
+ * `out` must always have room for `end - start` elements.
+ */
+typedef enum ScanKernelType {
+  SCAN_SCALAR,
+  SCAN_SSE42,
+  SCAN_AVX2,
+  NUM_SCAN_KERNELS,
+} ScanKernelType;
+
+/**
+ * @brief Scan with the best kernel supported by the running CPU. The kernel is
+ * picked once at runtime (see `scan_best_kernel`), so the same binary runs on CPUs
+ * without AVX2 or SSE4.2.
+ *
+ * @return the number of positions written to `out`
+ */
+size_t scan_range(const int* data, size_t start, size_t end, int low, int high,
+                  const int* ref_posns, int* out);
+
+/**
+ * @brief Same as `scan_range`, but with an explicit kernel. The caller must check
+ * `scan_kernel_supported(type)` first; used by tests and benchmarks.
+ */
+size_t scan_range_with(ScanKernelType type, const int* data, size_t start, size_t end,
+                       int low, int high, const int* ref_posns, int* out);
+
+/**
+ * @brief Bitmap form of `scan_range`: sets bit `i` of `words` (bit `i % 64` of
+ * `words[i / 64]`) for every qualifying `i` in `[start, end)` and clears it for every
+ * other. `start` must be a multiple of 64; whole words are written, so a word that
+ * `end` cuts short gets zeros past `end`.
+ *
+ * @return the number of bits set
+ */
+size_t scan_range_bits(const int* data, size_t start, size_t end, int low, int high,
+                       uint64_t* words);
+
+size_t scan_range_bits_with(ScanKernelType type, const int* data, size_t start,
+                            size_t end, int low, int high, uint64_t* words);
+
+int scan_kernel_supported(ScanKernelType type);
+ScanKernelType scan_best_kernel(void);
+const char* scan_kernel_name(ScanKernelType type);
+
+void test_scan(void);
+
+#endif
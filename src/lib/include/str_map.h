@@ -0,0 +1,49 @@
+#ifndef STR_MAP_H
+#define STR_MAP_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * @brief A growable open-addressing map from strings to `size_t` values, e.g. from
+ * handle names to their slot in a client's handle table.
+ *
+ * Keys are copied in, and each slot caches its key's hash, so a probe only compares
+ * strings whose hashes match. The table doubles once it is half full; there is no
+ * erase, since names are only ever added or rebound.
+ */
+typedef struct StrMapSlot {
+  char* key;  // NULL if the slot is empty
+  uint64_t hash;
+  size_t value;
+} StrMapSlot;
+
+typedef struct StrMap {
+  StrMapSlot* slots;
+  size_t n_slots;  // power of two
+  size_t size;
+} StrMap;
+
+/**
+ * @brief Create a map sized for about `expected` keys without growing.
+ * @return NULL if out of memory
+ */
+StrMap* str_map_create(size_t expected);
+
+void str_map_destroy(StrMap* map);
+
+/**
+ * @brief Map `key` to `value`, replacing the value if the key is already present.
+ * @return 0 on success, -1 if out of memory (the map is unchanged)
+ */
+int str_map_put(StrMap* map, const char* key, size_t value);
+
+/**
+ * @brief Look up `key`; on a hit, stores its value in `*value`.
+ * @return 1 if found, 0 otherwise
+ */
+int str_map_get(const StrMap* map, const char* key, size_t* value);
+
+void test_str_map(void);
+
+#endif
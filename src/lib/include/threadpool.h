@@ -1 +1,87 @@
-#TODO
+#ifndef THREADPOOL_H
+#define THREADPOOL_H
+
+#include <pthread.h>
+#include <stddef.h>
+
+/**
+ * @brief A fixed set of worker threads that run submitted tasks.
+ *
+ * Every worker owns a deque of tasks. A worker pushes and pops tasks at the bottom of
+ * its own deque (LIFO, so nested tasks run while their data is still in cache) and,
+ * when it runs dry, steals from the top of another worker's deque (FIFO, so thieves
+ * take the oldest and usually largest pieces of work). Tasks submitted from outside the
+ * pool (e.g. the server thread) are spread round-robin over the deques.
+ *
+ * The pool is created once at startup (see `db_startup`), so queries only pay for a
+ * task submission rather than a `pthread_create`/`pthread_join` per thread.
+ */
+typedef struct ThreadPool ThreadPool;
+
+typedef void (*task_fn)(void* arg);
+
+/**
+ * @brief A set of tasks the submitter waits on together. Must be initialized with
+ * `taskgroup_init` and can be reused once `threadpool_wait` has returned.
+ */
+typedef struct TaskGroup {
+  size_t pending;
+  pthread_mutex_t lock;
+  pthread_cond_t done;
+} TaskGroup;
+
+/**
+ * @brief Create a pool with `num_threads` workers; 0 means one per online core.
+ */
+ThreadPool* threadpool_create(size_t num_threads);
+
+/**
+ * @brief Run all queued tasks, then join and free the workers.
+ */
+void threadpool_destroy(ThreadPool* pool);
+
+size_t threadpool_num_threads(ThreadPool* pool);
+
+void taskgroup_init(TaskGroup* group);
+void taskgroup_destroy(TaskGroup* group);
+
+/**
+ * @brief Whether every task of `group` has finished, without blocking; lets a submitter
+ * poll work it left running in the background.
+ */
+int taskgroup_done(TaskGroup* group);
+
+/**
+ * @brief Queue `fn(arg)` as part of `group`. If the pool is NULL, the task runs
+ * immediately on the calling thread.
+ *
+ * @return 0 on success, -1 if the task could not be queued
+ */
+int threadpool_submit(ThreadPool* pool, TaskGroup* group, task_fn fn, void* arg);
+
+/**
+ * @brief Block until every task of `group` has finished. The calling thread runs
+ * queued tasks while it waits, so tasks may themselves submit and wait on subtasks.
+ */
+void threadpool_wait(ThreadPool* pool, TaskGroup* group);
+
+typedef void (*range_fn)(size_t start, size_t end, void* arg);
+
+/**
+ * @brief Split `[0, n)` into morsels of `morsel_size` elements, run `fn` on each
+ * morsel as a task, and wait for all of them. Morsel `m` covers
+ * `[m * morsel_size, min((m + 1) * morsel_size, n))`, so `fn` can index per-morsel
+ * outputs with `start / morsel_size`. Runs serially when the pool is NULL.
+ *
+ * @return 0 on success, -1 on allocation failure (nothing was run)
+ */
+int threadpool_parallel_for(ThreadPool* pool, size_t n, size_t morsel_size, range_fn fn,
+                            void* arg);
+
+static inline size_t num_morsels(size_t n, size_t morsel_size) {
+  return (n + morsel_size - 1) / morsel_size;
+}
+
+void test_threadpool(void);
+
+#endif
@@ -0,0 +1,58 @@
+#ifndef TYPED_KERNELS_H
+#define TYPED_KERNELS_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * @brief Kernels over columns of `int`, `long` or `double` values.
+ *
+ * Every kernel is generated once per value type from the same macro body, so each
+ * inner loop works on one type only and the compiler can keep it branch-free and
+ * vectorize it, instead of dispatching on the type per value. The name of a kernel ends
+ * in its type, e.g. `typed_select_long`; callers dispatch on the column type once per
+ * call.
+ *
+ * `SUM_T` is the type sums are kept in: `int64_t` for `int` and `long`, `double` for
+ * `double`.
+ */
+#define TYPED_KERNEL_DECLS(T, NAME, SUM_T)                                              \
+  /* Writes the positions `i` in `[0, n)` with `low <= values[i] <= high` to `out`, in \
+   * ascending order, or `ref_posns[i]` when `ref_posns` is not NULL (see scan.h).    \
+   * Returns the number of positions written. */                                      \
+  size_t typed_select_##NAME(const T* values, size_t n, T low, T high,                \
+                             const int* ref_posns, int* out);                         \
+  /* `out[i] = values[positions[i]]` for every `i` in `[0, n)` */                     \
+  void typed_gather_##NAME(const T* values, const int* positions, size_t n, T* out);  \
+  /* Adds `values[0 .. n)` to `*sum` and folds them into `*min` and `*max` */         \
+  void typed_stats_##NAME(const T* values, size_t n, SUM_T* sum, T* min, T* max);     \
+  /* `out[i] = a[i] + b[i]`, resp. `a[i] - b[i]`, for every `i` in `[0, n)` */        \
+  void typed_add_##NAME(const T* a, const T* b, size_t n, T* out);                    \
+  void typed_sub_##NAME(const T* a, const T* b, size_t n, T* out);                    \
+  /* `values[i] = old values[order[i]]`; `scratch` needs room for `n` values */       \
+  void typed_reorder_##NAME(T* values, size_t n, const int* order, T* scratch);       \
+  /* Sorts `values` in place, stably, and writes the original position of every       \
+   * sorted value to `positions`. Returns 0 on success, -1 if out of memory. */       \
+  int typed_argsort_##NAME(T* values, size_t n, int* positions);                      \
+  /* Number of leading values of sorted `values` below `value`, resp. at most it */   \
+  size_t typed_lower_bound_##NAME(const T* values, size_t n, T value);                \
+  size_t typed_upper_bound_##NAME(const T* values, size_t n, T value);
+
+TYPED_KERNEL_DECLS(int, int, int64_t)
+TYPED_KERNEL_DECLS(long, long, int64_t)
+TYPED_KERNEL_DECLS(double, double, double)
+
+/**
+ * @brief Widening conversions, `out[i] = (TO)values[i]`, used to bring both operands of
+ * an arithmetic operation to the type of its result.
+ */
+#define TYPED_CONVERT_DECL(FROM, TO) \
+  void typed_convert_##FROM##_##TO(const FROM* values, size_t n, TO* out);
+
+TYPED_CONVERT_DECL(int, long)
+TYPED_CONVERT_DECL(int, double)
+TYPED_CONVERT_DECL(long, double)
+
+void test_typed_kernels(void);
+
+#endif
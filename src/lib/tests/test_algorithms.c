@@ -1,6 +1,8 @@
 #include <assert.h>
+#include <limits.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include "algorithms.h"
 
@@ -139,4 +141,39 @@ void test_sort(void) {
     free(original_pos);
     printf("✅\n");
   }
+
+  // Test 9: The parallel sort matches the serial one, equal values included
+  {
+    printf("test for parallel sort...");
+    size_t n_elements = 300000;
+    int* data = malloc(n_elements * sizeof(int));
+    int* expected = malloc(n_elements * sizeof(int));
+    int* original_pos = malloc(n_elements * sizeof(int));
+    int* expected_pos = malloc(n_elements * sizeof(int));
+    for (size_t i = 0; i < n_elements; i++) {
+      data[i] = rand() % 5000 - 2500;
+    }
+    data[0] = INT_MAX;
+    data[1] = INT_MIN;
+    memcpy(expected, data, n_elements * sizeof(int));
+    assert(sort(expected, n_elements, expected_pos) == 0);
+
+    ThreadPool* pool = threadpool_create(4);
+    assert(sort_parallel(pool, data, n_elements, original_pos) == 0);
+    threadpool_destroy(pool);
+
+    assert(expected[0] == INT_MIN && expected[n_elements - 1] == INT_MAX);
+    for (size_t i = 0; i < n_elements; i++) {
+      assert(data[i] == expected[i]);
+      assert(original_pos[i] == expected_pos[i]);
+      // stable: equal values keep their original order
+      if (i > 0 && data[i] == data[i - 1]) assert(original_pos[i] > original_pos[i - 1]);
+    }
+
+    free(data);
+    free(expected);
+    free(original_pos);
+    free(expected_pos);
+    printf("✅\n");
+  }
 }
@@ -0,0 +1,100 @@
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "bitmap.h"
+
+void test_bitmap(void) {
+  // Test 1: Set bits come back as ascending positions, also per word-aligned range
+  {
+    printf("test for positions of set bits...");
+    size_t n = 1000;
+    Bitmap* bitmap = bitmap_create(n);
+    assert(bitmap && bitmap_count(bitmap, 0, n) == 0);
+    size_t expected = 0;
+    for (size_t i = 0; i < n; i += 3) {
+      bitmap_set(bitmap, i);
+      expected++;
+    }
+    assert(bitmap_count(bitmap, 0, n) == expected);
+
+    int* positions = malloc(sizeof(int) * n);
+    assert(bitmap_positions(bitmap, 0, n, positions) == expected);
+    for (size_t k = 0; k < expected; k++) assert(positions[k] == (int)(k * 3));
+
+    // [128, n) starts on a word boundary and ends inside the last word
+    size_t tail = bitmap_positions(bitmap, 128, n, positions);
+    assert(tail == bitmap_count(bitmap, 128, n));
+    assert(positions[0] == 129 && positions[tail - 1] == 999);
+    for (size_t i = 0; i < n; i++) assert(bitmap_test(bitmap, i) == (i % 3 == 0));
+
+    // gathering values[i] = -i must give the negated positions
+    int* values = malloc(sizeof(int) * n);
+    for (size_t i = 0; i < n; i++) values[i] = -(int)i;
+    assert(bitmap_gather(bitmap, 0, n, values, positions) == expected);
+    for (size_t k = 0; k < expected; k++) assert(positions[k] == -(int)(k * 3));
+    free(values);
+    free(positions);
+    bitmap_destroy(bitmap);
+    printf("✅\n");
+  }
+
+  // Test 2: AND of two bitmaps, in place and per range
+  {
+    printf("test for bitmap and...");
+    size_t n = 10007;
+    Bitmap* a = bitmap_create(n);
+    Bitmap* b = bitmap_create(n);
+    Bitmap* dst = bitmap_create(n);
+    size_t expected = 0;
+    for (size_t i = 0; i < n; i++) {
+      if (i % 2 == 0) bitmap_set(a, i);
+      if (i % 5 == 0) bitmap_set(b, i);
+      expected += i % 10 == 0;
+    }
+    assert(bitmap_and(dst, a, b, 0, 4096) + bitmap_and(dst, a, b, 4096, n) == expected);
+    for (size_t i = 0; i < n; i++) assert(bitmap_test(dst, i) == (i % 10 == 0));
+    assert(bitmap_and(a, a, b, 0, n) == expected);
+    assert(bitmap_count(a, 0, n) == expected);
+    bitmap_destroy(a);
+    bitmap_destroy(b);
+    bitmap_destroy(dst);
+    printf("✅\n");
+  }
+
+  // Test 3: Dense and sparse words side by side, decoded per range into one array
+  {
+    printf("test for decoding ranges side by side...");
+    size_t n = 4096 + 100;
+    Bitmap* bitmap = bitmap_create(n);
+    for (size_t i = 0; i < n; i++) {
+      if (i < 2048 ? rand() % 10 != 0 : rand() % 50 == 0) bitmap_set(bitmap, i);
+    }
+    size_t total = bitmap_count(bitmap, 0, n);
+    int* positions = malloc(sizeof(int) * (total + 1));
+    positions[total] = -1;  // guard: nothing may be written past the last position
+    size_t k = 0;
+    for (size_t start = 0; start < n; start += 1024) {
+      size_t end = start + 1024 < n ? start + 1024 : n;
+      k += bitmap_positions(bitmap, start, end, positions + k);
+    }
+    assert(k == total && positions[total] == -1);
+    for (size_t j = 0, i = 0; i < n; i++) {
+      if (bitmap_test(bitmap, i)) assert(positions[j++] == (int)i);
+    }
+    free(positions);
+    bitmap_destroy(bitmap);
+    printf("✅\n");
+  }
+
+  // Test 4: An empty bitmap has nothing to report
+  {
+    printf("test for an empty bitmap...");
+    Bitmap* bitmap = bitmap_create(0);
+    int position;
+    assert(bitmap && bitmap_count(bitmap, 0, 0) == 0);
+    assert(bitmap_positions(bitmap, 0, 0, &position) == 0);
+    bitmap_destroy(bitmap);
+    printf("✅\n");
+  }
+}
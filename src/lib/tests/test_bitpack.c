@@ -0,0 +1,132 @@
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "bitpack.h"
+
+// The packed scans must select exactly what a plain loop over the values selects
+static void check_scans(const PackedInts* packed, const int* values, size_t start,
+                        size_t end, int low, int high) {
+  size_t n = end - start;
+  int* expected = malloc(sizeof(int) * (n + 1));
+  int* found = malloc(sizeof(int) * (n + 1));
+  uint64_t* words = malloc(sizeof(uint64_t) * ((end + 63) / 64 + 1));
+  size_t n_expected = 0;
+  for (size_t i = start; i < end; i++) {
+    if (values[i] >= low && values[i] <= high) expected[n_expected++] = (int)i;
+  }
+
+  assert(packed_scan_range(packed, start, end, low, high, found) == n_expected);
+  for (size_t i = 0; i < n_expected; i++) assert(found[i] == expected[i]);
+
+  if (start % 64 == 0) {
+    for (size_t w = 0; w < (end + 63) / 64; w++) words[w] = ~0ULL;
+    assert(packed_scan_range_bits(packed, start, end, low, high, words) == n_expected);
+    size_t e = 0;
+    for (size_t i = start; i < end; i++) {
+      int set = (words[i / 64] >> (i % 64)) & 1;
+      assert(set == (e < n_expected && expected[e] == (int)i));
+      e += set;
+    }
+    if (end % 64) assert(words[end / 64] >> (end % 64) == 0);
+  }
+  free(expected);
+  free(found);
+  free(words);
+}
+
+void test_bitpack(void) {
+  // Test 1: Code widths
+  {
+    printf("test for the bits a frame needs...");
+    assert(packed_bits_for(5, 5) == 0);
+    assert(packed_bits_for(0, 1) == 1);
+    assert(packed_bits_for(-8, 7) == 4);
+    assert(packed_bits_for(0, 4095) == 12);
+    assert(packed_bits_for(0, 4096) == 13);
+    assert(packed_bits_for(-2147483648L, 2147483647L) == 32);
+    printf("✅\n");
+  }
+
+  // Test 2: Every width, with negative bases, partial words and unaligned ranges
+  {
+    printf("test for scans, gets and decodes at every code width...");
+    size_t n = 3001;
+    int* values = malloc(sizeof(int) * n);
+    unsigned int widths[] = {0, 1, 3, 4, 7, 8, 12, 15, 16, 21, 31};
+    for (size_t w = 0; w < sizeof(widths) / sizeof(widths[0]); w++) {
+      unsigned int bits = widths[w];
+      long span = 1L << bits;
+      int base = -(int)(span / 3) - 7;
+      for (size_t i = 0; i < n; i++) {
+        long r = ((long)rand() << 16) ^ rand();
+        values[i] = base + (int)(r % span);
+      }
+      PackedInts* packed = packed_create(values, n, base, bits);
+      assert(packed && packed->width > bits && packed->per_word * packed->width == 64);
+      for (size_t i = 0; i < n; i++) assert(packed_get(packed, i) == values[i]);
+      int* decoded = malloc(sizeof(int) * n);
+      packed_decode(packed, 0, n, decoded);
+      for (size_t i = 0; i < n; i++) assert(decoded[i] == values[i]);
+      packed_decode(packed, 128, n - 70, decoded);
+      for (size_t i = 128; i < n - 70; i++) assert(decoded[i - 128] == values[i]);
+      free(decoded);
+
+      int mid = base + (int)(span / 2);
+      int lows[] = {base - 10, base, mid, base + (int)(span - 1), values[17]};
+      int highs[] = {base - 1, base, mid, base + (int)(span - 1), base + (int)span + 5};
+      for (size_t l = 0; l < sizeof(lows) / sizeof(lows[0]); l++) {
+        for (size_t h = 0; h < sizeof(highs) / sizeof(highs[0]); h++) {
+          check_scans(packed, values, 0, n, lows[l], highs[h]);
+          check_scans(packed, values, 64, n - 5, lows[l], highs[h]);
+          check_scans(packed, values, 13, 29, lows[l], highs[h]);
+          check_scans(packed, values, 5, 6, lows[l], highs[h]);
+        }
+      }
+      packed_destroy(packed);
+    }
+    free(values);
+    printf("✅\n");
+  }
+
+  // Test 3: Values outside the frame are rejected; appends may use the whole field
+  {
+    printf("test for values that do not fit the frame...");
+    int values[] = {10, 11, 26};
+    assert(packed_create(values, 3, 10, 4) == NULL);
+    assert(packed_create(values, 3, 11, 5) == NULL);
+    PackedInts* packed = packed_create(values, 3, 10, 5);
+    assert(packed && packed->bits == 7);
+    assert(packed_append(packed, 9) == -1);
+    assert(packed_append(packed, 10 + 128) == -1);
+    assert(packed->num_elements == 3);
+    assert(packed_append(packed, 10 + 127) == 0);
+    assert(packed_get(packed, 3) == 137 && packed_get(packed, 2) == 26);
+    packed_destroy(packed);
+    printf("✅\n");
+  }
+
+  // Test 4: Appends grow the packed column past its initial capacity
+  {
+    printf("test for appends...");
+    size_t n = 1000;
+    int* values = malloc(sizeof(int) * n);
+    for (size_t i = 0; i < n; i++) values[i] = 100 + rand() % 512;
+    PackedInts* packed = packed_create(values, 1, 100, 9);
+    assert(packed && packed->capacity == 64);
+    for (size_t i = 1; i < n; i++) assert(packed_append(packed, values[i]) == 0);
+    assert(packed->num_elements == n);
+    for (size_t i = 0; i < n; i++) assert(packed_get(packed, i) == values[i]);
+    check_scans(packed, values, 0, n, 200, 400);
+    check_scans(packed, values, 1, n - 1, 611, 611);
+    packed_destroy(packed);
+
+    packed = packed_create(NULL, 0, 0, 3);
+    assert(packed && packed->num_elements == 0);
+    for (int i = 0; i < 100; i++) assert(packed_append(packed, i % 8) == 0);
+    for (int i = 0; i < 100; i++) assert(packed_get(packed, i) == i % 8);
+    packed_destroy(packed);
+    free(values);
+    printf("✅\n");
+  }
+}
@@ -1,4 +1,5 @@
 #include <assert.h>
+#include <limits.h>
 #include <stdio.h>
 #include <stdlib.h>
 
@@ -6,25 +7,34 @@
 #include "test_helpers.h"
 #include "utils.h"
 
+// Number of values `< key` in sorted `data`
+static size_t count_less(const int* data, size_t n, int key) {
+  size_t left = 0, right = n;
+  while (left < right) {
+    size_t mid = left + (right - left) / 2;
+    if (data[mid] < key) {
+      left = mid + 1;
+    } else {
+      right = mid;
+    }
+  }
+  return left;
+}
+
 void test_btree(void) {
   test_title("\nB-tree tests: \n");
   {
-    /* The Simple tree version: n_elements = 8, fanout = 2
+    /* The simple tree version: n_elements = 8, one node of 16 keys
             B-tree structure:
-                    [child_ptr][10,50]
-                            |
-                [child_ptr][10,30,50,70]
-                     |
-        data        [10 20 30 40 50 60 70 80]
+        level 0     [10 20 30 40 50 60 70 80 | INT_MAX padding]
         index       [ 0  1  2  3  4  5  6  7]
      */
-    test_sub_title("\nTest 1: Lookup in a B-tree with uniqe numbers; fanout 2\n");
+    test_sub_title("\nTest 1: Lookup in a B-tree with uniqe numbers\n");
     int data[] = {10, 20, 30, 40, 50, 60, 70, 80};
     size_t data_size = sizeof(data) / sizeof(data[0]);
-    int fanout = 2;
 
     // Initialize B-tree
-    Btree* tree = init_btree(data, data_size, fanout);
+    Btree* tree = init_btree(data, data_size);
     printf("\nB-tree structure:\n");
     print_tree(tree);
 
@@ -40,16 +50,15 @@ void test_btree(void) {
     }
 
     {
-      test_title("\nTest 4: Lookup in a B-tree with duplicate numbers; fanout 2\n");
+      test_title("\nTest 4: Lookup in a B-tree with duplicate numbers\n");
       int data[] = {2, 2, 2, 5, 5, 6, 7, 7};
       size_t data_size = sizeof(data) / sizeof(data[0]);
-      int fanout = 2;
       printf("Data: ");
       for (size_t i = 0; i < data_size; i++) {
         printf("%d ", data[i]);
       }
       printf("\n");
-      Btree* tree = init_btree(data, data_size, fanout);
+      Btree* tree = init_btree(data, data_size);
       printf("\nB-tree structure:\n");
       print_tree(tree);
 
@@ -82,4 +91,73 @@ void test_btree(void) {
       }
     }
   }
+
+  {
+    test_sub_title("\nTest 5: Serialized B-tree answers lookups like the original\n");
+    size_t data_size = 5000;
+    int* data = malloc(sizeof(int) * data_size);
+    for (size_t i = 0; i < data_size; i++) data[i] = (int)(i / 3) * 2;  // duplicates
+    Btree* tree = init_btree(data, data_size);
+
+    size_t size = btree_serialized_size(tree);
+    void* buf = malloc(size);
+    btree_serialize(tree, buf);
+    Btree* mapped = btree_deserialize(buf, size);
+    assert(mapped);
+    for (int key = -1; key <= data[data_size - 1] + 1; key++) {
+      assert(lookup(key, mapped, 1) == lookup(key, tree, 1));
+      assert(lookup(key, mapped, 0) == lookup(key, tree, 0));
+    }
+    printf("lookups match ✅\n");
+
+    // A truncated buffer is rejected rather than read past its end
+    assert(btree_deserialize(buf, size - sizeof(int)) == NULL);
+    printf("truncated buffer rejected ✅\n");
+
+    free_btree(mapped);
+    free_btree(tree);
+    free(buf);
+    free(data);
+  }
+
+  {
+    test_sub_title("\nTest 6: Multi-level B-tree against binary search\n");
+    size_t data_size = 200000;
+    int* data = malloc(sizeof(int) * data_size);
+    int value = INT_MIN;
+    for (size_t i = 0; i < data_size; i++) {
+      value += rand() % 3 == 0 ? rand() % 20000 : 0;  // runs of duplicates
+      data[i] = value;
+    }
+    data[data_size - 1] = INT_MAX;
+    Btree* tree = init_btree(data, data_size);
+    assert(tree && tree->n_levels >= 4);
+
+    size_t n_keys = 5000;
+    int* keys = malloc(sizeof(int) * n_keys);
+    size_t* left = malloc(sizeof(size_t) * n_keys);
+    size_t* right = malloc(sizeof(size_t) * n_keys);
+    for (size_t k = 0; k < n_keys; k++) {
+      keys[k] = k % 2 ? data[rand() % data_size] : data[rand() % data_size] + 1;
+    }
+    keys[0] = INT_MIN;
+    keys[1] = INT_MAX;
+    lookup_batch(keys, n_keys, tree, 1, left);
+    lookup_batch(keys, n_keys, tree, 0, right);
+    for (size_t k = 0; k < n_keys; k++) {
+      int key = keys[k];
+      size_t first = count_less(data, data_size, key);  // first value >= key
+      size_t last = key == INT_MAX ? data_size : count_less(data, data_size, key + 1);
+      assert(lookup(key, tree, 1) == first && left[k] == first);
+      size_t expected_right = last > 0 ? last - 1 : 0;
+      assert(lookup(key, tree, 0) == expected_right && right[k] == expected_right);
+    }
+    printf("lookups and batched lookups match ✅\n");
+
+    free_btree(tree);
+    free(keys);
+    free(left);
+    free(right);
+    free(data);
+  }
 }
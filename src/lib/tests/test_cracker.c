@@ -0,0 +1,102 @@
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "cracker.h"
+
+// Every value sits on the right side of every crack, and every row appears once
+static void check_cracks(const Cracker* cracker, const int* column) {
+  for (size_t k = 0; k < cracker->num_cracks; k++) {
+    if (k > 0) assert(cracker->pivots[k - 1] < cracker->pivots[k]);
+    for (size_t i = 0; i < cracker->num_elements; i++) {
+      assert((cracker->values[i] < cracker->pivots[k]) == (i < cracker->offsets[k]));
+    }
+  }
+  char* seen = calloc(cracker->num_elements, 1);
+  for (size_t i = 0; i < cracker->num_elements; i++) {
+    int row = cracker->positions[i];
+    assert(!seen[row] && column[row] == cracker->values[i]);
+    seen[row] = 1;
+  }
+  free(seen);
+}
+
+void test_cracker(void) {
+  // Test 1: Every select returns exactly the rows in its range
+  {
+    printf("test for cracking selects...");
+    size_t n = 5000;
+    int* column = malloc(sizeof(int) * n);
+    srand(165);
+    for (size_t i = 0; i < n; i++) column[i] = rand() % 1000;
+    Cracker* cracker = cracker_create(column, n);
+    assert(cracker && cracker->num_cracks == 0);
+
+    for (int q = 0; q < 200; q++) {
+      int low = rand() % 1100 - 50;
+      int high = low + rand() % 200;
+      size_t start, end;
+      cracker_select(cracker, low, high, &start, &end);
+      size_t expected = 0;
+      for (size_t i = 0; i < n; i++) expected += column[i] >= low && column[i] <= high;
+      assert(end - start == expected);
+      for (size_t i = start; i < end; i++) {
+        assert(cracker->values[i] >= low && cracker->values[i] <= high);
+      }
+    }
+    check_cracks(cracker, column);
+
+    // a repeated query is answered by the cracks it left
+    size_t cracks = cracker->num_cracks, start, end;
+    cracker_select(cracker, 100, 199, &start, &end);
+    cracker_select(cracker, 100, 199, &start, &end);
+    assert(cracker->num_cracks <= cracks + 2);
+    cracker_destroy(cracker);
+    free(column);
+    printf("✅\n");
+  }
+
+  // Test 2: Inserts keep every crack valid
+  {
+    printf("test for cracker inserts...");
+    size_t n = 1000, inserts = 3000;
+    int* column = malloc(sizeof(int) * (n + inserts));
+    for (size_t i = 0; i < n; i++) column[i] = rand() % 500;
+    Cracker* cracker = cracker_create(column, n);
+    size_t start, end;
+    for (int pivot = 0; pivot < 500; pivot += 50) {
+      cracker_select(cracker, pivot, 600, &start, &end);
+    }
+
+    for (size_t i = n; i < n + inserts; i++) {
+      column[i] = rand() % 700 - 100;
+      assert(cracker_insert(cracker, column[i], (int)i) == 0);
+    }
+    assert(cracker->num_elements == n + inserts);
+    check_cracks(cracker, column);
+
+    cracker_select(cracker, -100, 49, &start, &end);
+    size_t expected = 0;
+    for (size_t i = 0; i < n + inserts; i++) expected += column[i] < 50;
+    assert(start == 0 && end == expected);
+    cracker_destroy(cracker);
+    free(column);
+    printf("✅\n");
+  }
+
+  // Test 3: An empty column and open ranges
+  {
+    printf("test for empty cracker...");
+    Cracker* cracker = cracker_create(NULL, 0);
+    size_t start, end;
+    cracker_select(cracker, 0, 10, &start, &end);
+    assert(start == 0 && end == 0);
+    assert(cracker_insert(cracker, 5, 0) == 0 && cracker_insert(cracker, 20, 1) == 0);
+    cracker_select(cracker, 0, 10, &start, &end);
+    assert(end - start == 1 && cracker->values[start] == 5);
+    cracker_select(cracker, 11, 10, &start, &end);
+    assert(start == end);
+    cracker_destroy(cracker);
+    printf("✅\n");
+  }
+}
@@ -0,0 +1,96 @@
+#include <assert.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "dictionary.h"
+
+void test_dictionary(void) {
+  // Test 1: Codes follow the order of the values
+  {
+    printf("test for order-preserving codes...");
+    int values[] = {1000000, -7, 42, 1000000, INT_MIN, 42, INT_MAX};
+    Dictionary* dict = dictionary_create(values, 7, 5);
+    assert(dict && dict->num_values == 5);
+    for (size_t i = 1; i < dict->num_values; i++) {
+      assert(dict->values[i - 1] < dict->values[i]);
+    }
+    for (size_t i = 0; i < 7; i++) {
+      int code = packed_get(dict->codes, i);
+      assert(dict->values[code] == values[i] && dictionary_get(dict, i) == values[i]);
+    }
+    assert(packed_get(dict->codes, 4) == 0 && packed_get(dict->codes, 6) == 4);
+    dictionary_destroy(dict);
+
+    assert(dictionary_create(values, 7, 4) == NULL);
+    printf("✅\n");
+  }
+
+  // Test 2: Value ranges translate to the code ranges of the values they contain
+  {
+    printf("test for code ranges...");
+    int values[] = {10, 20, 30, 40};
+    Dictionary* dict = dictionary_create(values, 4, 4);
+    int lo, hi;
+    assert(dictionary_code_range(dict, 10, 40, &lo, &hi) && lo == 0 && hi == 3);
+    assert(dictionary_code_range(dict, 11, 39, &lo, &hi) && lo == 1 && hi == 2);
+    assert(dictionary_code_range(dict, INT_MIN, 20, &lo, &hi) && lo == 0 && hi == 1);
+    assert(dictionary_code_range(dict, 35, INT_MAX, &lo, &hi) && lo == 3 && hi == 3);
+    assert(!dictionary_code_range(dict, 21, 29, &lo, &hi));
+    assert(!dictionary_code_range(dict, 41, INT_MAX, &lo, &hi));
+    assert(!dictionary_code_range(dict, 30, 20, &lo, &hi));
+    dictionary_destroy(dict);
+    printf("✅\n");
+  }
+
+  // Test 3: A scan of the codes selects what a scan of the values selects
+  {
+    printf("test for scans on the codes...");
+    size_t n = 4000;
+    int* values = malloc(sizeof(int) * n);
+    int* expected = malloc(sizeof(int) * n);
+    int* found = malloc(sizeof(int) * n);
+    for (size_t i = 0; i < n; i++) values[i] = (rand() % 300 - 150) * 1000003;
+    Dictionary* dict = dictionary_create(values, n, 1 << 15);
+    assert(dict && dict->num_values <= 300 && dict->codes->width == 16);
+    int lows[] = {INT_MIN, -100000300, 0, 7};
+    int highs[] = {-150000450, 5, 100000300, INT_MAX};
+    for (size_t q = 0; q < sizeof(lows) / sizeof(lows[0]); q++) {
+      size_t n_expected = 0;
+      for (size_t i = 0; i < n; i++) {
+        if (values[i] >= lows[q] && values[i] <= highs[q]) {
+          expected[n_expected++] = (int)i;
+        }
+      }
+      int lo, hi;
+      size_t n_found = 0;
+      if (dictionary_code_range(dict, lows[q], highs[q], &lo, &hi)) {
+        n_found = packed_scan_range(dict->codes, 0, n, lo, hi, found);
+      }
+      assert(n_found == n_expected);
+      for (size_t i = 0; i < n_found; i++) assert(found[i] == expected[i]);
+    }
+    dictionary_destroy(dict);
+    free(values);
+    free(expected);
+    free(found);
+    printf("✅\n");
+  }
+
+  // Test 4: Appends of known values; unknown ones are refused
+  {
+    printf("test for appends...");
+    int values[] = {5, 9, 5};
+    Dictionary* dict = dictionary_create(values, 3, 16);
+    assert(dictionary_append(dict, 9) == 0 && dictionary_append(dict, 5) == 0);
+    assert(dictionary_append(dict, 7) == -1 && dictionary_append(dict, 10) == -1);
+    assert(dict->codes->num_elements == 5);
+    assert(dictionary_get(dict, 3) == 9 && dictionary_get(dict, 4) == 5);
+    dictionary_destroy(dict);
+
+    dict = dictionary_create(NULL, 0, 16);
+    assert(dict && dict->num_values == 0 && dictionary_append(dict, 1) == -1);
+    dictionary_destroy(dict);
+    printf("✅\n");
+  }
+}
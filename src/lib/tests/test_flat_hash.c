@@ -0,0 +1,75 @@
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "flat_hash.h"
+
+void test_flat_hash(void) {
+  // Test 1: Duplicate keys keep their values together and in insertion order
+  {
+    printf("test for duplicate keys...");
+    size_t n = 100000;
+    int* keys = malloc(sizeof(int) * n);
+    int* values = malloc(sizeof(int) * n);
+    for (size_t i = 0; i < n; i++) {
+      keys[i] = (int)(i % 1000) * 7919 - 3000000;  // 1000 distinct keys, negatives too
+      values[i] = (int)i;
+    }
+    FlatHashTable* ht = flat_ht_build(keys, values, n, 1);
+    assert(ht && ht->n_groups == 1000);
+    for (size_t k = 0; k < 1000; k++) {
+      size_t count;
+      const int* found = flat_ht_get(ht, keys[k], &count);
+      assert(count == 100);
+      for (size_t j = 0; j < count; j++) assert(found[j] == (int)(k + j * 1000));
+    }
+    size_t count;
+    assert(flat_ht_get(ht, 1, &count) == NULL && count == 0);
+    flat_ht_destroy(ht);
+    free(keys);
+    free(values);
+    printf("✅\n");
+  }
+
+  // Test 2: Probe emits every matching pair, reading interleaved tuples
+  {
+    printf("test for single-pass probe...");
+    int build[][2] = {{5, 0}, {9, 1}, {5, 2}, {-1, 3}};
+    int probe[][2] = {{5, 10}, {7, 11}, {-1, 12}, {9, 13}};
+    FlatHashTable* ht = flat_ht_build(&build[0][0], &build[0][1], 4, 2);
+    MatchBuffer out = {0};
+    assert(flat_ht_probe(ht, &probe[0][0], &probe[0][1], 4, 2, 1, &out) == 0);
+    assert(out.size == 4);
+    int expected_left[] = {0, 2, 3, 1}, expected_right[] = {10, 10, 12, 13};
+    for (size_t i = 0; i < out.size; i++) {
+      assert(out.left[i] == expected_left[i] && out.right[i] == expected_right[i]);
+    }
+    match_buffer_free(&out);
+    flat_ht_destroy(ht);
+    printf("✅\n");
+  }
+
+  // Test 3: Group-by sum over the groups in first-appearance order
+  {
+    printf("test for group-by over groups...");
+    int keys[] = {3, 1, 3, 2, 1, 3};
+    int values[] = {10, 20, 30, 40, 50, 60};
+    FlatHashTable* ht = flat_ht_build(keys, values, 6, 1);
+    assert(ht->n_groups == 3);
+    // the budget estimate covers every slot and value, and more pairs never cost less
+    assert(flat_ht_build_bytes(6) >= ht->n_slots * 9 + 6 * 3 * sizeof(int));
+    assert(flat_ht_build_bytes(1000) > 1000 * 9 * 8 / 7);
+    assert(flat_ht_build_bytes(7) <= flat_ht_build_bytes(100000));
+    int expected_keys[] = {3, 1, 2};
+    long expected_sums[] = {100, 70, 40};
+    for (size_t g = 0; g < ht->n_groups; g++) {
+      long sum = 0;
+      for (uint32_t v = ht->group_starts[g]; v < ht->group_starts[g + 1]; v++) {
+        sum += ht->values[v];
+      }
+      assert(ht->group_keys[g] == expected_keys[g] && sum == expected_sums[g]);
+    }
+    flat_ht_destroy(ht);
+    printf("✅\n");
+  }
+}
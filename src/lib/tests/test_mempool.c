@@ -0,0 +1,57 @@
+#include <assert.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "mempool.h"
+
+void test_mempool(void) {
+  // Test 1: Allocations are aligned, disjoint and survive new blocks
+  {
+    printf("test for arena alignment and growth...");
+    Arena* arena = arena_create(1024);
+    char* chunks[100];
+    for (int i = 0; i < 100; i++) {
+      chunks[i] = arena_alloc(arena, 40, 16);
+      assert(chunks[i] && (uintptr_t)chunks[i] % 16 == 0);
+      memset(chunks[i], i, 40);
+    }
+    for (int i = 0; i < 100; i++) {
+      for (int b = 0; b < 40; b++) assert(chunks[i][b] == (char)i);
+    }
+    arena_destroy(arena);
+    printf("✅\n");
+  }
+
+  // Test 2: Oversized requests and reset
+  {
+    printf("test for oversized allocations and reset...");
+    Arena* arena = arena_create(256);
+    int* big = arena_alloc(arena, sizeof(int) * 10000, sizeof(int));
+    assert(big);
+    for (int i = 0; i < 10000; i++) big[i] = i;
+    assert(big[9999] == 9999);
+    assert(arena->bytes_allocated == sizeof(int) * 10000);
+    arena_reset(arena);
+    assert(arena->bytes_allocated == 0);
+    assert(arena_alloc(arena, 100, 8));
+    arena_destroy(arena);
+    printf("✅\n");
+  }
+
+  // Test 3: Reset parks class slabs and hands the same memory out again
+  {
+    printf("test for slab reuse across resets...");
+    Arena* arena = arena_create(1 << 16);
+    char* small = arena_alloc(arena, 1000, 64);
+    char* huge = arena_alloc(arena, 3 << 20, 64);  // a huge-page-backed class slab
+    assert(small && huge && (uintptr_t)huge % 64 == 0);
+    memset(huge, 1, 3 << 20);
+    arena_reset(arena);
+    assert(arena->head == NULL && arena->bytes_cached >= (3u << 20) + (1u << 16));
+    assert(arena_alloc(arena, 3 << 20, 64) == huge);
+    assert(arena_alloc(arena, 1000, 64) != NULL);
+    arena_destroy(arena);
+    printf("✅\n");
+  }
+}
@@ -0,0 +1,147 @@
+#include <assert.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "rle.h"
+
+// Runs of random length and value, `n_values` values to draw from
+static int* make_runs(size_t n, int n_values) {
+  int* values = malloc(sizeof(int) * n);
+  for (size_t i = 0; i < n;) {
+    int value = rand() % n_values - n_values / 2;
+    for (size_t len = 1 + rand() % 40; len > 0 && i < n; len--) values[i++] = value;
+  }
+  return values;
+}
+
+// The run-wise scans must select exactly what a plain loop over the values selects
+static void check_selects(const RunLengths* rle, const int* values, size_t start,
+                          size_t end, int low, int high) {
+  size_t n = end - start;
+  int* expected = malloc(sizeof(int) * (n + 1));
+  int* found = malloc(sizeof(int) * (n + 1));
+  size_t* starts = malloc(sizeof(size_t) * (rle->num_runs + 1));
+  size_t* ends = malloc(sizeof(size_t) * (rle->num_runs + 1));
+  uint64_t* words = malloc(sizeof(uint64_t) * ((end + 63) / 64 + 1));
+  size_t n_expected = 0;
+  for (size_t i = start; i < end; i++) {
+    if (values[i] >= low && values[i] <= high) expected[n_expected++] = (int)i;
+  }
+
+  assert(rle_scan_range(rle, start, end, low, high, found) == n_expected);
+  for (size_t i = 0; i < n_expected; i++) assert(found[i] == expected[i]);
+
+  // ranges are disjoint, ascending, never touching, and cover exactly the rows
+  size_t n_ranges = rle_select_ranges(rle, start, end, low, high, starts, ends);
+  size_t e = 0;
+  for (size_t r = 0; r < n_ranges; r++) {
+    assert(starts[r] < ends[r]);
+    if (r > 0) assert(ends[r - 1] < starts[r]);
+    for (size_t row = starts[r]; row < ends[r]; row++) {
+      assert(e < n_expected && expected[e++] == (int)row);
+    }
+  }
+  assert(e == n_expected);
+
+  if (start % 64 == 0) {
+    for (size_t w = 0; w < (end + 63) / 64; w++) words[w] = ~0ULL;
+    assert(rle_scan_range_bits(rle, start, end, low, high, words) == n_expected);
+    e = 0;
+    for (size_t i = start; i < end; i++) {
+      int set = (words[i / 64] >> (i % 64)) & 1;
+      assert(set == (e < n_expected && expected[e] == (int)i));
+      e += set;
+    }
+    if (end % 64) assert(words[end / 64] >> (end % 64) == 0);
+  }
+  free(expected);
+  free(found);
+  free(starts);
+  free(ends);
+  free(words);
+}
+
+// The run-wise statistics and decoding must match a plain loop over the values
+static void check_stats(const RunLengths* rle, const int* values, size_t start,
+                        size_t end) {
+  int64_t sum = 0, expected_sum = 0;
+  long min = LONG_MAX, max = LONG_MIN, expected_min = LONG_MAX, expected_max = LONG_MIN;
+  int* decoded = malloc(sizeof(int) * (end - start + 1));
+  for (size_t i = start; i < end; i++) {
+    expected_sum += values[i];
+    if (values[i] < expected_min) expected_min = values[i];
+    if (values[i] > expected_max) expected_max = values[i];
+  }
+  rle_range_stats(rle, start, end, &sum, &min, &max);
+  assert(sum == expected_sum && min == expected_min && max == expected_max);
+  rle_decode(rle, start, end, decoded);
+  for (size_t i = start; i < end; i++) assert(decoded[i - start] == values[i]);
+  free(decoded);
+}
+
+void test_rle(void) {
+  // Test 1: Runs are found, and columns with too many runs are refused
+  {
+    printf("test for building runs...");
+    int values[] = {3, 3, 3, 7, 7, -1, 3, 3};
+    RunLengths* rle = rle_create(values, 8, 4);
+    assert(rle && rle->num_runs == 4 && rle_num_rows(rle) == 8);
+    assert(rle->values[0] == 3 && rle->ends[0] == 3);
+    assert(rle->values[2] == -1 && rle->ends[2] == 6);
+    assert(rle_find(rle, 0) == 0 && rle_find(rle, 2) == 0 && rle_find(rle, 3) == 1);
+    assert(rle_find(rle, 7) == 3);
+    for (size_t i = 0; i < 8; i++) assert(rle_get(rle, i) == values[i]);
+    rle_destroy(rle);
+    assert(rle_create(values, 8, 3) == NULL);
+
+    rle = rle_create(NULL, 0, 0);
+    assert(rle && rle->num_runs == 0 && rle_num_rows(rle) == 0);
+    rle_destroy(rle);
+    printf("✅\n");
+  }
+
+  // Test 2: Selects, statistics and decoding over random runs and unaligned ranges
+  {
+    printf("test for selects and statistics over runs...");
+    size_t n = 5000;
+    int* values = make_runs(n, 50);
+    RunLengths* rle = rle_create(values, n, n);
+    assert(rle && rle_num_rows(rle) == n);
+    int lows[] = {INT_MIN, -25, -3, 0, 24};
+    int highs[] = {-26, -3, 0, 10, INT_MAX};
+    for (size_t l = 0; l < sizeof(lows) / sizeof(lows[0]); l++) {
+      for (size_t h = 0; h < sizeof(highs) / sizeof(highs[0]); h++) {
+        check_selects(rle, values, 0, n, lows[l], highs[h]);
+        check_selects(rle, values, 64, n - 5, lows[l], highs[h]);
+        check_selects(rle, values, 13, 29, lows[l], highs[h]);
+        check_selects(rle, values, 5, 6, lows[l], highs[h]);
+      }
+    }
+    check_stats(rle, values, 0, n);
+    check_stats(rle, values, 17, 18);
+    check_stats(rle, values, 100, n - 100);
+    rle_destroy(rle);
+    free(values);
+    printf("✅\n");
+  }
+
+  // Test 3: Appends extend the last run or start a new one
+  {
+    printf("test for appends...");
+    size_t n = 3000;
+    int* values = make_runs(n, 10);
+    RunLengths* rle = rle_create(values, 1, 1);
+    assert(rle && rle->capacity == 1);
+    for (size_t i = 1; i < n; i++) assert(rle_append(rle, values[i]) == 0);
+    assert(rle_num_rows(rle) == n);
+    RunLengths* built = rle_create(values, n, n);
+    assert(built && built->num_runs == rle->num_runs);
+    check_stats(rle, values, 0, n);
+    check_selects(rle, values, 0, n, -2, 2);
+    rle_destroy(built);
+    rle_destroy(rle);
+    free(values);
+    printf("✅\n");
+  }
+}
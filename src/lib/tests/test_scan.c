@@ -0,0 +1,131 @@
+#include <assert.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "scan.h"
+
+static size_t naive_scan(const int* data, size_t start, size_t end, int low, int high,
+                         const int* ref_posns, int* out) {
+  size_t count = 0;
+  for (size_t i = start; i < end; i++) {
+    if (data[i] >= low && data[i] <= high) out[count++] = ref_posns ? ref_posns[i] : (int)i;
+  }
+  return count;
+}
+
+// The bitmap kernels must set exactly the bits of the positions scan_range selects
+static void check_bits_kernels(const int* data, size_t start, size_t end, int low,
+                               int high) {
+  size_t n = end - start;
+  int* expected = malloc(sizeof(int) * (n + 1));
+  uint64_t* words = malloc(sizeof(uint64_t) * ((end + 63) / 64));
+  size_t n_expected = naive_scan(data, start, end, low, high, NULL, expected);
+
+  for (int k = 0; k < NUM_SCAN_KERNELS; k++) {
+    if (!scan_kernel_supported(k)) continue;
+    assert(scan_range_bits_with(k, data, start, end, low, high, words) == n_expected);
+    size_t e = 0;
+    for (size_t i = start; i < end; i++) {
+      int set = (words[i / 64] >> (i % 64)) & 1;
+      assert(set == (e < n_expected && expected[e] == (int)i));
+      e += set;
+    }
+    if (end % 64) assert(words[end / 64] >> (end % 64) == 0);
+  }
+  free(expected);
+  free(words);
+}
+
+static void check_all_kernels(const int* data, size_t start, size_t end, int low,
+                              int high, const int* ref_posns) {
+  size_t n = end - start;
+  int* expected = malloc(sizeof(int) * (n + 1));
+  int* found = malloc(sizeof(int) * (n + 1));
+  size_t n_expected = naive_scan(data, start, end, low, high, ref_posns, expected);
+
+  for (int k = 0; k < NUM_SCAN_KERNELS; k++) {
+    if (!scan_kernel_supported(k)) continue;
+    size_t n_found = scan_range_with(k, data, start, end, low, high, ref_posns, found);
+    assert(n_found == n_expected);
+    for (size_t i = 0; i < n_found; i++) assert(found[i] == expected[i]);
+  }
+  free(expected);
+  free(found);
+}
+
+void test_scan(void) {
+  printf("best kernel on this machine: %s\n", scan_kernel_name(scan_best_kernel()));
+
+  // Test 1: Small array that never fills a vector
+  {
+    printf("test for arrays shorter than a vector...");
+    int data[] = {5, -3, 7};
+    check_all_kernels(data, 0, 3, -3, 5, NULL);
+    check_all_kernels(data, 1, 3, 6, 7, NULL);
+    printf("✅\n");
+  }
+
+  // Test 2: Random data with every selectivity and odd tails
+  {
+    printf("test for random data at several selectivities...");
+    size_t n = 10007;
+    int* data = malloc(sizeof(int) * n);
+    for (size_t i = 0; i < n; i++) data[i] = rand() % 1000 - 500;
+    int highs[] = {-501, -499, -400, 0, 499};
+    for (size_t h = 0; h < sizeof(highs) / sizeof(highs[0]); h++) {
+      check_all_kernels(data, 0, n, -500, highs[h], NULL);
+      check_all_kernels(data, 3, n - 5, -500, highs[h], NULL);
+    }
+    free(data);
+    printf("✅\n");
+  }
+
+  // Test 3: Positions come from `ref_posns` (type 2 select / index scan)
+  {
+    printf("test for reference positions...");
+    size_t n = 1000;
+    int* data = malloc(sizeof(int) * n);
+    int* ref_posns = malloc(sizeof(int) * n);
+    for (size_t i = 0; i < n; i++) {
+      data[i] = rand() % 100;
+      ref_posns[i] = (int)(n - i) * 3;
+    }
+    check_all_kernels(data, 0, n, 10, 20, ref_posns);
+    check_all_kernels(data, 7, n, 0, 99, ref_posns);
+    free(data);
+    free(ref_posns);
+    printf("✅\n");
+  }
+
+  // Test 4: Extreme bounds must not overflow the comparisons
+  {
+    printf("test for INT_MIN / INT_MAX bounds...");
+    int data[] = {INT_MIN, INT_MAX, 0, -1, 1, INT_MIN + 1, INT_MAX - 1, 42, 7, INT_MIN};
+    size_t n = sizeof(data) / sizeof(data[0]);
+    check_all_kernels(data, 0, n, INT_MIN, INT_MAX, NULL);
+    check_all_kernels(data, 0, n, INT_MIN, INT_MIN, NULL);
+    check_all_kernels(data, 0, n, INT_MAX, INT_MAX, NULL);
+    check_all_kernels(data, 0, n, -1, 1, NULL);
+    printf("✅\n");
+  }
+
+  // Test 5: Bitmap kernels, from word-aligned starts with odd tails
+  {
+    printf("test for bitmap kernels...");
+    size_t n = 10007;
+    int* data = malloc(sizeof(int) * n);
+    for (size_t i = 0; i < n; i++) data[i] = rand() % 1000 - 500;
+    int highs[] = {-501, -499, 0, 499};
+    for (size_t h = 0; h < sizeof(highs) / sizeof(highs[0]); h++) {
+      check_bits_kernels(data, 0, n, -500, highs[h]);
+      check_bits_kernels(data, 64, n - 5, -500, highs[h]);
+      check_bits_kernels(data, 128, 150, -500, highs[h]);
+    }
+    int bounds[] = {INT_MIN, INT_MAX, 0, -1};
+    check_bits_kernels(bounds, 0, 4, INT_MIN, INT_MAX);
+    check_bits_kernels(bounds, 0, 4, INT_MAX, INT_MAX);
+    free(data);
+    printf("✅\n");
+  }
+}
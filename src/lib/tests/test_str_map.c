@@ -0,0 +1,39 @@
+#include <assert.h>
+#include <stdio.h>
+
+#include "str_map.h"
+
+void test_str_map(void) {
+  // Test 1: Lookups survive growth from the smallest table
+  {
+    printf("test for string map growth...");
+    StrMap* map = str_map_create(0);
+    char key[32];
+    for (size_t i = 0; i < 20000; i++) {
+      snprintf(key, sizeof(key), "s%zu", i);
+      assert(str_map_put(map, key, i) == 0);
+    }
+    assert(map->size == 20000);
+    for (size_t i = 0; i < 20000; i++) {
+      size_t value;
+      snprintf(key, sizeof(key), "s%zu", i);
+      assert(str_map_get(map, key, &value) && value == i);
+    }
+    assert(!str_map_get(map, "f0", NULL));
+    assert(!str_map_get(map, "", NULL));
+    str_map_destroy(map);
+    printf("✅\n");
+  }
+
+  // Test 2: Rebinding a key replaces its value without adding a key
+  {
+    printf("test for string map rebinding...");
+    StrMap* map = str_map_create(4);
+    assert(str_map_put(map, "a0", 1) == 0);
+    assert(str_map_put(map, "a0", 2) == 0);
+    size_t value;
+    assert(map->size == 1 && str_map_get(map, "a0", &value) && value == 2);
+    str_map_destroy(map);
+    printf("✅\n");
+  }
+}
@@ -0,0 +1,93 @@
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "threadpool.h"
+
+typedef struct {
+  ThreadPool* pool;
+  long* slots;
+  size_t n_children;
+} NestedArgs;
+
+static void fill_slot(void* arg) { *(long*)arg += 1; }
+
+// Submits and waits on subtasks from inside a worker
+static void spawn_children(void* arg) {
+  NestedArgs* args = (NestedArgs*)arg;
+  TaskGroup group;
+  taskgroup_init(&group);
+  for (size_t i = 0; i < args->n_children; i++) {
+    threadpool_submit(args->pool, &group, fill_slot, &args->slots[i]);
+  }
+  threadpool_wait(args->pool, &group);
+  taskgroup_destroy(&group);
+}
+
+static void sum_range(size_t start, size_t end, void* arg) {
+  long* partial_sums = (long*)arg;
+  long sum = 0;
+  for (size_t i = start; i < end; i++) sum += (long)i;
+  partial_sums[start / 100] = sum;  // morsel index; morsel size is 100 below
+}
+
+void test_threadpool(void) {
+  ThreadPool* pool = threadpool_create(4);
+  assert(pool);
+  assert(threadpool_num_threads(pool) == 4);
+
+  // Test 1: Many small tasks all run exactly once
+  {
+    printf("test for many independent tasks...");
+    size_t n = 10000;
+    long* slots = calloc(n, sizeof(long));
+    TaskGroup group;
+    taskgroup_init(&group);
+    for (size_t i = 0; i < n; i++) {
+      assert(threadpool_submit(pool, &group, fill_slot, &slots[i]) == 0);
+    }
+    threadpool_wait(pool, &group);
+    assert(taskgroup_done(&group));
+    for (size_t i = 0; i < n; i++) assert(slots[i] == 1);
+    taskgroup_destroy(&group);
+    free(slots);
+    printf("✅\n");
+  }
+
+  // Test 2: Tasks that wait on their own subtasks do not deadlock
+  {
+    printf("test for nested tasks...");
+    size_t n_parents = 16, n_children = 200;
+    long* slots = calloc(n_parents * n_children, sizeof(long));
+    NestedArgs args[16];
+    TaskGroup group;
+    taskgroup_init(&group);
+    for (size_t p = 0; p < n_parents; p++) {
+      args[p] = (NestedArgs){pool, slots + p * n_children, n_children};
+      threadpool_submit(pool, &group, spawn_children, &args[p]);
+    }
+    threadpool_wait(pool, &group);
+    for (size_t i = 0; i < n_parents * n_children; i++) assert(slots[i] == 1);
+    taskgroup_destroy(&group);
+    free(slots);
+    printf("✅\n");
+  }
+
+  // Test 3: parallel_for covers every element once, with and without a pool
+  {
+    printf("test for parallel_for over morsels...");
+    size_t n = 12345;
+    long expected = (long)n * (long)(n - 1) / 2;
+    long partial_sums[124];
+    ThreadPool* pools[] = {pool, NULL};
+    for (size_t p = 0; p < 2; p++) {
+      assert(threadpool_parallel_for(pools[p], n, 100, sum_range, partial_sums) == 0);
+      long total = 0;
+      for (size_t m = 0; m < num_morsels(n, 100); m++) total += partial_sums[m];
+      assert(total == expected);
+    }
+    printf("✅\n");
+  }
+
+  threadpool_destroy(pool);
+}
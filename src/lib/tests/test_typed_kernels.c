@@ -0,0 +1,120 @@
+#include <assert.h>
+#include <float.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "typed_kernels.h"
+
+void test_typed_kernels(void) {
+  // Test 1: Selects qualify the same rows as a plain loop, with and without ref_posns
+  {
+    printf("test for selects over long and double values...");
+    size_t n = 3000;
+    long* longs = malloc(sizeof(long) * n);
+    double* doubles = malloc(sizeof(double) * n);
+    int* ref_posns = malloc(sizeof(int) * n);
+    int* out = malloc(sizeof(int) * n);
+    for (size_t i = 0; i < n; i++) {
+      longs[i] = ((long)(rand() % 2000) - 1000) * 10000000000L;
+      doubles[i] = (rand() % 20000) / 100.0 - 100.0;
+      ref_posns[i] = (int)(7 * i + 3);
+    }
+
+    long low = -300 * 10000000000L, high = 250 * 10000000000L;
+    size_t n_out = typed_select_long(longs, n, low, high, NULL, out);
+    size_t k = 0;
+    for (size_t i = 0; i < n; i++) {
+      if (longs[i] >= low && longs[i] <= high) assert(out[k++] == (int)i);
+    }
+    assert(n_out == k);
+
+    n_out = typed_select_double(doubles, n, -12.5, 42.25, ref_posns, out);
+    k = 0;
+    for (size_t i = 0; i < n; i++) {
+      if (doubles[i] >= -12.5 && doubles[i] <= 42.25) assert(out[k++] == ref_posns[i]);
+    }
+    assert(n_out == k && k > 0);
+    assert(typed_select_double(doubles, n, 1.0, 0.5, NULL, out) == 0);
+
+    free(longs);
+    free(doubles);
+    free(ref_posns);
+    free(out);
+    printf("✅\n");
+  }
+
+  // Test 2: Gathers, statistics and arithmetic keep the full width of the values
+  {
+    printf("test for gathers, statistics and arithmetic...");
+    long longs[] = {5000000000L, -7, LONG_MAX / 4, 42};
+    int positions[] = {2, 0, 0, 3};
+    long gathered[4];
+    typed_gather_long(longs, positions, 4, gathered);
+    assert(gathered[0] == LONG_MAX / 4 && gathered[1] == 5000000000L &&
+           gathered[3] == 42);
+
+    int64_t sum = 0;
+    long min = LONG_MAX, max = LONG_MIN;
+    typed_stats_long(longs, 4, &sum, &min, &max);
+    assert(sum == 5000000000L - 7 + LONG_MAX / 4 + 42);
+    assert(min == -7 && max == LONG_MAX / 4);
+
+    double doubles[] = {1.5, -0.25, 1e15, 3.0};
+    double dsum = 0, dmin = DBL_MAX, dmax = -DBL_MAX;
+    typed_stats_double(doubles, 4, &dsum, &dmin, &dmax);
+    assert(dsum == 1.5 - 0.25 + 1e15 + 3.0 && dmin == -0.25 && dmax == 1e15);
+
+    double sums[4], diffs[4];
+    typed_add_double(doubles, doubles, 4, sums);
+    typed_sub_double(doubles, sums, 4, diffs);
+    for (size_t i = 0; i < 4; i++) {
+      assert(sums[i] == 2 * doubles[i] && diffs[i] == -doubles[i]);
+    }
+
+    int ints[] = {INT_MAX, -3, 0, INT_MIN};
+    long widened[4];
+    double as_doubles[4];
+    typed_convert_int_long(ints, 4, widened);
+    typed_convert_long_double(widened, 4, as_doubles);
+    long added[4];
+    typed_add_long(widened, widened, 4, added);
+    assert(added[0] == 2L * INT_MAX && added[3] == 2L * INT_MIN);
+    assert(as_doubles[0] == (double)INT_MAX && as_doubles[1] == -3.0);
+    printf("✅\n");
+  }
+
+  // Test 3: Argsort is stable, and a reorder by its positions sorts a copy of the data
+  {
+    printf("test for sorting and reordering...");
+    size_t n = 5000;
+    double* values = malloc(sizeof(double) * n);
+    double* copy = malloc(sizeof(double) * n);
+    double* scratch = malloc(sizeof(double) * n);
+    int* positions = malloc(sizeof(int) * n);
+    for (size_t i = 0; i < n; i++) values[i] = copy[i] = (rand() % 100) * 0.5;
+    assert(typed_argsort_double(values, n, positions) == 0);
+    for (size_t i = 1; i < n; i++) {
+      assert(values[i - 1] <= values[i]);
+      if (values[i - 1] == values[i]) assert(positions[i - 1] < positions[i]);
+    }
+    typed_reorder_double(copy, n, positions, scratch);
+    for (size_t i = 0; i < n; i++) assert(copy[i] == values[i]);
+
+    size_t lo = typed_lower_bound_double(values, n, 10.0);
+    size_t hi = typed_upper_bound_double(values, n, 10.0);
+    assert(lo < hi && values[lo] == 10.0 && values[hi - 1] == 10.0);
+    assert(lo == 0 || values[lo - 1] < 10.0);
+    assert(hi == n || values[hi] > 10.0);
+    assert(typed_lower_bound_double(values, n, 1000.0) == n);
+    assert(typed_upper_bound_double(values, n, -1.0) == 0);
+
+    long empty[1];
+    assert(typed_argsort_long(empty, 0, positions) == 0);
+    free(values);
+    free(copy);
+    free(scratch);
+    free(positions);
+    printf("✅\n");
+  }
+}
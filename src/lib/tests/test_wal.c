@@ -0,0 +1,58 @@
+#define _POSIX_C_SOURCE 200809L  // for setrlimit and SIGXFSZ
+#include <assert.h>
+#include <signal.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "wal.h"
+
+void test_wal(void) {
+  // Test 1: A log that failed to sync fails every commit until a checkpoint empties it
+  {
+    printf("test for a failed sync followed by a checkpoint...");
+    mkdir(STORAGE_PATH, 0777);
+    Db db = {.name = "test_wal"};
+    Db* saved_db = current_db;
+    current_db = &db;
+    Table table = {.name = "tbl", .num_cols = 2};
+    InsertValue values[2] = {{.i = 1}, {.i = 2}};
+
+    // Writes past a zero file size limit fail with EFBIG instead of raising SIGXFSZ
+    struct rlimit saved_limit, limit;
+    getrlimit(RLIMIT_FSIZE, &saved_limit);
+    limit = saved_limit;
+    limit.rlim_cur = 0;
+    void (*saved_handler)(int) = signal(SIGXFSZ, SIG_IGN);
+    setrlimit(RLIMIT_FSIZE, &limit);
+
+    uint64_t failed_lsn = wal_log_insert(&table, values, 0);
+    assert(failed_lsn > 0);
+    assert(wal_commit(failed_lsn) == -1);
+    setrlimit(RLIMIT_FSIZE, &saved_limit);
+    signal(SIGXFSZ, saved_handler);
+
+    // The file could be written again, but the log stays failed until a checkpoint
+    uint64_t lsn = wal_log_insert(&table, values, 1);
+    assert(lsn > failed_lsn);
+    assert(wal_commit(lsn) == -1);
+
+    wal_checkpoint();
+    assert(wal_commit(failed_lsn) == 0);  // the catalog holds these rows now
+    assert(wal_commit(lsn) == 0);
+    lsn = wal_log_insert(&table, values, 2);
+    assert(wal_commit(lsn) == 0);
+
+    char path[MAX_PATH_LEN];
+    snprintf(path, sizeof(path), "%s/%s.wal", STORAGE_PATH, db.name);
+    struct stat st;
+    assert(stat(path, &st) == 0 && st.st_size > 0);
+
+    wal_close();
+    unlink(path);
+    current_db = saved_db;
+    printf("passed\n");
+  }
+}
@@ -1,8 +1,20 @@
 #include <stdio.h>
 
 #include "algorithms.h"
+#include "bitmap.h"
+#include "bitpack.h"
 #include "btree.h"
+#include "cracker.h"
+#include "dictionary.h"
+#include "flat_hash.h"
 #include "hash_table.h"
+#include "mempool.h"
+#include "rle.h"
+#include "scan.h"
+#include "str_map.h"
+#include "threadpool.h"
+#include "typed_kernels.h"
+#include "wal.h"
 
 int main(void) {
   printf("\n\ntesting sort...\n");
@@ -11,6 +23,42 @@ int main(void) {
   printf("\n\ntesting btree...\n");
   test_btree();
 
+  printf("\n\ntesting cracker...\n");
+  test_cracker();
+
+  printf("\n\ntesting scan kernels...\n");
+  test_scan();
+
+  printf("\n\ntesting bitmaps...\n");
+  test_bitmap();
+
+  printf("\n\ntesting bit-packed columns...\n");
+  test_bitpack();
+
+  printf("\n\ntesting dictionary-encoded columns...\n");
+  test_dictionary();
+
+  printf("\n\ntesting run-length encoded columns...\n");
+  test_rle();
+
+  printf("\n\ntesting long and double kernels...\n");
+  test_typed_kernels();
+
+  printf("\n\ntesting threadpool...\n");
+  test_threadpool();
+
+  printf("\n\ntesting arena...\n");
+  test_mempool();
+
+  printf("\n\ntesting flat hash table...\n");
+  test_flat_hash();
+
+  printf("\n\ntesting string map...\n");
+  test_str_map();
+
+  printf("\n\ntesting write-ahead log...\n");
+  test_wal();
+
   printf("\n\nAll tests passed!\n");
 
   printf("\n\ntesting hashmap...\n");